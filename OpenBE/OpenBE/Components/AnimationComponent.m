@@ -9,6 +9,7 @@
 #import "RobotMeshControllerComponent.h"
 #import "../Utils/ComponentUtils.h"
 #import "../Utils/SceneKitExtensions.h"
+#import "../Core/BakedAssetLibrary.h"
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wprotocol"
@@ -22,6 +23,12 @@
 @dynamic animationKeys;
 
 + (CAAnimation*) animationWithSceneNamed:(NSString*)name {
+    // Baked by Tools/AssetBaker: mapped in place, no COLLADA parsing.
+    CAAnimation *bakedAnimation = [[BakedAssetLibrary main] animationWithSceneNamed:[@"Models/Animations" stringByAppendingPathComponent:name]];
+    if( bakedAnimation ) {
+        return bakedAnimation;
+    }
+
     NSURL *sceneURL;
 
 // DAE files will not load at runtime.  They must be converted to SCN archive format.
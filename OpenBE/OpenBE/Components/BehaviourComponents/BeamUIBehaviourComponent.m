@@ -41,10 +41,12 @@ bool menuSoundPlayed;
     self.beamComponent = (BeamComponent *)[self.entity componentForClass:[BeamComponent class]];
     [self.beamComponent setEnabled:NO];
     [self.uiComponent setEnabled:NO];
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.menuOpenSound = [[AudioEngine main] loadAudioNamed:@"Robot_MenuOpen.caf"];
-        self.menuCloseSound = [[AudioEngine main] loadAudioNamed:@"Robot_MenuClose.caf"];
-    });
+    [[AudioEngine main] loadAudioNamed:@"Robot_MenuOpen.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.menuOpenSound = audioNode;
+    }];
+    [[AudioEngine main] loadAudioNamed:@"Robot_MenuClose.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.menuCloseSound = audioNode;
+    }];
     menuSoundPlayed = NO;
 }
 
@@ -82,9 +82,9 @@
     }
     
     if( audioName != nil ) {
-        dispatch_async(dispatch_get_main_queue(), ^{
-            expr.audio = [[AudioEngine main] loadAudioNamed:audioName];
-        });
+        [[AudioEngine main] loadAudioNamed:audioName priority:AssetPriorityBackground completion:^(AudioNode *audioNode) {
+            expr.audio = audioNode;
+        }];
     }
     
     expr.vemojiSequence = vemojiSequence;
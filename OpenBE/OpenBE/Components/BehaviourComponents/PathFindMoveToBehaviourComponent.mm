@@ -9,15 +9,21 @@
 #import "MoveToBehaviourComponent.h"
 #import "../../Utils/Math.h"
 #import "../../Core/PathFinding.h"
+#import "../../Core/OccupancyGridLoader.h"
 
 #import "../RobotVemojiComponent.h"
 #import "../AnimationComponent.h"
 #import "../../Core/AudioEngine.h"
+#import "../../Core/ObjectPool.h"
 #import "../../Utils/SceneKitExtensions.h"
+#import "../../Utils/GridOverlay.h"
 
 #import <GLKit/GLKit.h>
 
 #define GROUND_HEIGHT (-0.02f);//roughly above the ground's scanned mesh result
+#define OCCUPANCY_OVERLAY_HEIGHT -0.004f // Just above the floor, up is -y, obstacles over components.
+#define COMPONENTS_OVERLAY_HEIGHT -0.002f
+#define PATH_NODE_POOL_SIZE 32 // Waypoint markers made up front, a long path grows the pool.
 typedef void (^callback)(void);
 
 @interface PathFindMoveToBehaviourComponent()
@@ -41,10 +47,11 @@ typedef void (^callback)(void);
 
 @property(nonatomic, strong) SCNGeometry *pathGeo;
 @property(nonatomic, strong) NSMutableArray *pathNodes;
+@property(nonatomic, strong) ObjectPool<SCNNode *> *pathNodePool;
 @property(nonatomic, strong) SCNNode *pathParentNode;
 
-@property(nonatomic, strong) SCNNode *occupancyParentNode;
-@property(nonatomic, strong) SCNNode *connectedComponentsParentNode;
+@property(nonatomic, strong) GridOverlay *occupancyOverlay;
+@property(nonatomic, strong) GridOverlay *connectedComponentsOverlay;
 
 @property(nonatomic) float groundY;
 @end
@@ -56,75 +63,39 @@ typedef void (^callback)(void);
     [self deallocPath];
 }
 
-+ (uint8_t*) unlockImage:(UIImage*) image
-{
-    CGImageRef imageRef = [image CGImage];
-    NSUInteger width = CGImageGetWidth(imageRef);
-    NSUInteger height = CGImageGetHeight(imageRef);
-    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-    uint8_t *rawData = (uint8_t*)malloc(height * width * 4);
-    NSUInteger bytesPerPixel = 4;
-    NSUInteger bytesPerRow = bytesPerPixel * width;
-    NSUInteger bitsPerComponent = 8;
-    CGContextRef context = CGBitmapContextCreate(rawData, width, height,
-                                                 bitsPerComponent, bytesPerRow, colorSpace,
-                                                 kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
-
-    CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
-    CGContextRelease(context);
-
-    return rawData;
-}
-
-+ (void) lockImage:(UIImage**)image buffer:(uint8_t*) rawData
-{
-    CGContextRef ctx;
-    CGImageRef imageRef = [*image CGImage];
-    NSUInteger width = CGImageGetWidth(imageRef);
-    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-    NSUInteger bytesPerPixel = 4;
-    NSUInteger bytesPerRow = bytesPerPixel * width;
-    ctx = CGBitmapContextCreate(rawData,
-                                CGImageGetWidth( imageRef ),
-                                CGImageGetHeight( imageRef ),
-                                8,
-                                bytesPerRow,
-                                colorSpace,
-                                kCGImageAlphaPremultipliedLast );
-    CGColorSpaceRelease(colorSpace);
-
-    imageRef = CGBitmapContextCreateImage (ctx);
-    *image = [UIImage imageWithCGImage:imageRef];
-    CGImageRelease(imageRef);
-
-    CGContextRelease(ctx);
-    free(rawData);
-}
-
 - (void) start {
     [super start];
 
     {
-        NSArray *paths = NSSearchPathForDirectoriesInDomains(NSDocumentDirectory,
-                                                             NSUserDomainMask, YES);
-
-        NSString *documentsDirectory = [paths objectAtIndex:0];
-        NSString *scenePath = [documentsDirectory stringByAppendingPathComponent:@"BridgeEngineScene"];
-        NSString *occupancyImagePath = [scenePath stringByAppendingPathComponent:@"occupancy_grid.png"];
-        NSString *occupancyMetadata = [scenePath stringByAppendingPathComponent:@"occupancy_grid_metadata.json"];
+        NSString *occupancyImagePath = [OccupancyGridLoader defaultGridPath];
+        NSString *occupancyMetadata = [OccupancyGridLoader defaultMetadataPath];
         
-        BEOccupancyGrid *grid = [[BEOccupancyGrid alloc] init];
-        BEOccupancyGrid *obstacleGrid = [[BEOccupancyGrid alloc] init];
-        
-        bool couldLoad = [grid loadGridFromFilePath:occupancyImagePath metaDataPath:occupancyMetadata];
-        [BEOccupancyGrid convertToObstacleGrid:grid outputGrid:obstacleGrid];
+        // Decoded once and read in place, instead of a message per pixel.
+        BE::OccupancyGridImage obstacleGrid;
+        bool couldLoad = [OccupancyGridLoader loadObstacleGridAtPath:occupancyImagePath metadataPath:occupancyMetadata into:obstacleGrid];
         
         if (couldLoad)
         {
-            self.pathFinding = [[PathFinding alloc] initWithGrid:obstacleGrid];
+            self.pathFinding = [[PathFinding alloc] initWithGridView:obstacleGrid.view()];
             self.noCoverPathFinding = nil;
         }
         else
+        {
+            // Whatever ImageIO couldn't read, BEOccupancyGrid might.
+            BEOccupancyGrid *grid = [[BEOccupancyGrid alloc] init];
+            BEOccupancyGrid *gridObstacles = [[BEOccupancyGrid alloc] init];
+            couldLoad = [grid loadGridFromFilePath:occupancyImagePath metaDataPath:occupancyMetadata];
+            if (couldLoad)
+            {
+                [BEOccupancyGrid convertToObstacleGrid:grid outputGrid:gridObstacles];
+                self.pathFinding = [[PathFinding alloc] initWithGrid:gridObstacles];
+                self.noCoverPathFinding = nil;
+            }
+        }
+        
+        [self updateOverlays];
+        
+        if (!couldLoad)
         {
             be_assert(false, "Could not load occupancy grid and metadata from [%s] and [%s] respectively",
                       [occupancyImagePath UTF8String], [occupancyMetadata UTF8String]);
@@ -143,12 +114,13 @@ typedef void (^callback)(void);
     self.vemojiThinkingSequence = [RobotVemojiComponent nameArrayBase:@"Vemoji_Scanning" start:1 end:16 digits:2];
     self.animComponent=(AnimationComponent*)[self.entity componentForClass:AnimationComponent.class];
     self.vemojiComponent = (RobotVemojiComponent*)[self.entity componentForClass:RobotVemojiComponent.class];
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.thinkingAudio = [[AudioEngine main] loadAudioNamed:@"Robot_ThinkingLoop.caf"];
+    [[AudioEngine main] loadAudioNamed:@"Robot_ThinkingLoop.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.thinkingAudio = audioNode;
         _thinkingAudio.looping = YES;
-
-        self.pathUmWhatCorrection = [[AudioEngine main] loadAudioNamed:@"Robot_UmWhat.caf"];
-    });
+    }];
+    [[AudioEngine main] loadAudioNamed:@"Robot_UmWhat.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.pathUmWhatCorrection = audioNode;
+    }];
     
     [self initPath];
 }
@@ -195,84 +167,38 @@ typedef void (^callback)(void);
 - (void) setShowOccupancy:(BOOL)showOccupancy {
     _showOccupancy = showOccupancy;
     
-    if( _showOccupancy ) {
-        if( _occupancyParentNode == nil ) {
-            _occupancyParentNode = [[SCNNode alloc] init];
-            
-            float nodeSize = [_pathFinding pixelSizeInMeters];
-            SCNGeometry *geo = [SCNBox boxWithWidth:nodeSize height:nodeSize length:nodeSize chamferRadius:0];
-            geo.firstMaterial.diffuse.contents = [UIColor yellowColor]; // [[UIColor yellowColor] colorWithAlphaComponent:0.5];
-
-            NSMutableArray<NSValue*> *points = [_pathFinding occupiedPoints];
-            for( NSValue *pt in points ){
-                GLKVector3 p;
-                [pt getValue:&p];
-                p.y -= nodeSize*0.5; // Offset above ground
-                
-                // Create SCNNodes
-                SCNNode *node = [SCNNode nodeWithGeometry:geo];
-                node.categoryBitMask |= RAYCAST_IGNORE_BIT;
-                node.categoryBitMask |= BEShadowCategoryBitMaskCastShadowOntoSceneKit | BEShadowCategoryBitMaskCastShadowOntoEnvironment; // add lighting
-                node.castsShadow = NO;
-                node.position = SCNVector3FromGLKVector3(p);
-                [_occupancyParentNode addChildNode:node];
-            }
-            
-            [[Scene main].rootNode addChildNode:_occupancyParentNode];
-        }
+    if( _showOccupancy && _occupancyOverlay == nil ) {
+        _occupancyOverlay = [GridOverlay obstacleOverlay];
+        _occupancyOverlay.node.position = SCNVector3Make(0, OCCUPANCY_OVERLAY_HEIGHT, 0);
+        [[Scene main].rootNode addChildNode:_occupancyOverlay.node];
+        [self updateOverlays];
     }
     
-    _occupancyParentNode.hidden = _showOccupancy == NO;
+    _occupancyOverlay.node.hidden = _showOccupancy == NO;
 }
 
 - (void) setShowConnectedComponents:(BOOL)show {
     _showConnectedComponents = show;
     
-    if( _showConnectedComponents ) {
-        if( _connectedComponentsParentNode == nil ) {
-            _connectedComponentsParentNode = [[SCNNode alloc] init];
-            
-            float nodeSize = [_pathFinding pixelSizeInMeters];
-            
-            NSArray<UIColor*> *colors = @[
-                [UIColor brownColor],
-                [UIColor redColor],
-                [UIColor orangeColor],
-                [UIColor magentaColor],
-                [UIColor greenColor],
-                [UIColor cyanColor],
-                [UIColor blueColor],
-                [UIColor purpleColor]
-            ];
-            
-            NSMutableArray<SCNGeometry*> *geoColors = [[NSMutableArray alloc] initWithCapacity:8];
-            for( int i=0; i<8; i++ ) {
-                SCNGeometry *geo = [SCNBox boxWithWidth:nodeSize height:nodeSize*2 length:nodeSize chamferRadius:0];
-                geo.firstMaterial.diffuse.contents = colors[i];
-                [geoColors addObject:geo];
-            }
-            
-            NSMutableArray<NSValue*> *points = [_pathFinding connectedComponentPoints];
-            for( NSValue *pt in points ){
-                GLKVector3 p;
-                [pt getValue:&p];
-                
-                // Create SCNNodes with a component colour
-                int componentSet = (int)p.y % 8;
-                SCNGeometry *geo = geoColors[componentSet];
-                SCNNode *node = [SCNNode nodeWithGeometry:geo];
-                node.categoryBitMask |= RAYCAST_IGNORE_BIT;
-                node.categoryBitMask |= BEShadowCategoryBitMaskCastShadowOntoSceneKit | BEShadowCategoryBitMaskCastShadowOntoEnvironment; // add lighting
-                node.castsShadow = NO;
-                node.position = SCNVector3Make(p.x, -nodeSize, p.z);
-                [_connectedComponentsParentNode addChildNode:node];
-            }
-            
-            [[Scene main].rootNode addChildNode:_connectedComponentsParentNode];
-        }
+    if( _showConnectedComponents && _connectedComponentsOverlay == nil ) {
+        _connectedComponentsOverlay = [GridOverlay componentOverlay];
+        _connectedComponentsOverlay.node.position = SCNVector3Make(0, COMPONENTS_OVERLAY_HEIGHT, 0);
+        [[Scene main].rootNode addChildNode:_connectedComponentsOverlay.node];
+        [self updateOverlays];
     }
 
-    _connectedComponentsParentNode.hidden = _showConnectedComponents == NO;
+    _connectedComponentsOverlay.node.hidden = _showConnectedComponents == NO;
+}
+
+/**
+ * Bring the overlays up to date with the path finding maps. Only what changed is uploaded.
+ */
+- (void) updateOverlays {
+    if( _pathFinding == nil ) return;
+    
+    const BE::NavigationGrid &grid = [_pathFinding navigationGrid];
+    if( _occupancyOverlay ) [_occupancyOverlay updateWithGrid:grid.dilatedView()];
+    if( _connectedComponentsOverlay ) [_connectedComponentsOverlay updateWithGrid:grid.componentView()];
 }
 
 
@@ -528,19 +454,29 @@ typedef void (^callback)(void);
     self.pathParentNode = [[SCNNode alloc] init];
     [[Scene main].rootNode addChildNode:_pathParentNode];
         
-    self.pathNodes = [NSMutableArray arrayWithCapacity:16];
+    self.pathNodes = [NSMutableArray arrayWithCapacity:PATH_NODE_POOL_SIZE];
+
+    // Waypoint markers are reused from plan to plan instead of made each time.
+    SCNNode *waypointPrototype = [SCNNode nodeWithGeometry:_pathGeo];
+    waypointPrototype.categoryBitMask |= RAYCAST_IGNORE_BIT | BEShadowCategoryBitMaskCastShadowOntoSceneKit | BEShadowCategoryBitMaskCastShadowOntoEnvironment;
+    waypointPrototype.eulerAngles = SCNVector3Make(M_PI, 0, 0);
+    self.pathNodePool = [ObjectPool nodePoolWithName:@"PathWaypoints"
+                                            capacity:PATH_NODE_POOL_SIZE
+                                              growth:ObjectPoolGrowthDouble
+                                           prototype:waypointPrototype
+                                              parent:nil];
+    [_pathNodePool prewarmInBackground:nil];
 }
 
 - (void) deallocPath {
-    for( SCNNode *node in _pathNodes ) {
-        [node removeFromParentNode];
-    }
+    [_pathNodePool releaseAll];
     [_pathParentNode removeFromParentNode];
 }
 
 - (void) clearPath {
     if( _pathNodes.count > 0 ) {
         NSArray *pathNodes = [_pathNodes copy];
+        ObjectPool<SCNNode *> *pathNodePool = _pathNodePool;
         [SCNTransaction begin];
         [SCNTransaction setAnimationDuration:1];
         [SCNTransaction setAnimationTimingFunction:[CAMediaTimingFunction functionWithName:kCAMediaTimingFunctionEaseIn]];
@@ -549,7 +485,7 @@ typedef void (^callback)(void);
         }
         [SCNTransaction setCompletionBlock:^{
             for( SCNNode *node in pathNodes ) {
-                [node removeFromParentNode];
+                [pathNodePool releaseObject:node];
             }
         }];
         [SCNTransaction commit];
@@ -577,9 +513,7 @@ typedef void (^callback)(void);
         GLKVector3 target;
         [waypoint getValue:&target];
         
-        SCNNode *wpNode = [SCNNode nodeWithGeometry:_pathGeo];
-        wpNode.categoryBitMask |= RAYCAST_IGNORE_BIT | BEShadowCategoryBitMaskCastShadowOntoSceneKit | BEShadowCategoryBitMaskCastShadowOntoEnvironment;
-        wpNode.eulerAngles = SCNVector3Make(M_PI, 0, 0);
+        SCNNode *wpNode = [_pathNodePool acquire];
         SCNVector3 nodePos = SCNVector3FromGLKVector3(target);
         wpNode.position = nodePos;
         float scale =
@@ -26,9 +26,9 @@ typedef void (^callback)(void);
     
     self.callbackBlock = callbackBlock;
     
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.buttonClickSound = [[AudioEngine main] loadAudioNamed:@"Robot_MenuClick.caf"];
-    });
+    [[AudioEngine main] loadAudioNamed:@"Robot_MenuClick.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.buttonClickSound = audioNode;
+    }];
     
     return self;
 }
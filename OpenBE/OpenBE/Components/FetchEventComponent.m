@@ -159,11 +159,15 @@ typedef NS_ENUM (NSUInteger, FetchPositionState) {
     self.lookAt = (LookAtBehaviourComponent *)[self.robotBehaviourComponent.entity componentForClass:[LookAtBehaviourComponent class]];
     self.vemojiComponent = (RobotVemojiComponent *)[self.robotBehaviourComponent.entity componentForClass:[RobotVemojiComponent class]];
 
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.audioBallToss = [[AudioEngine main] loadAudioNamed:@"BallToss.caf"];
-        self.audioBallPickup = [[AudioEngine main] loadAudioNamed:@"BallPickup.caf"];
-        self.audioBallReturn = [[AudioEngine main] loadAudioNamed:@"BallReturn.caf"];
-    });
+    [[AudioEngine main] loadAudioNamed:@"BallToss.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.audioBallToss = audioNode;
+    }];
+    [[AudioEngine main] loadAudioNamed:@"BallPickup.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.audioBallPickup = audioNode;
+    }];
+    [[AudioEngine main] loadAudioNamed:@"BallReturn.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.audioBallReturn = audioNode;
+    }];
 
     self.bounce = [_physicsContactAudio addNodeName:@"ball" audioName:@"BallBounce.caf"];
     
@@ -21,6 +21,8 @@
 @property (nonatomic) float currentDistance;
 @property (nonatomic) float targetDistance;
 @property (nonatomic) float interactive;
+@property (nonatomic, strong) StereoDraw *stereoDraw; // Draws both eyes at once in stereo, nil when the SCNProgram draws.
+@property (nonatomic, strong) UniformBlock *reticleUniforms; // Metal render properties, updated in place every frame.
 
 @end
 
@@ -84,8 +86,9 @@ typedef struct  {
     SCNProgram *program;
     
     if ([SceneManager main].renderingAPI == BEViewRenderingAPIMetal) {  // Uses Metal
-        program = [SCNProgram openbeMetalProgramWithVertexFunctionName:@"OBEFixedSizeReticleVertex"
-                                                              fragmentFunctionName:@"OBEFixedSizeReticleFragment"];
+        program = [[ShaderCache main] metalProgramWithVertexFunctionName:@"OBEFixedSizeReticleVertex"
+                                                    fragmentFunctionName:@"OBEFixedSizeReticleFragment"
+                                                                 variant:ShaderVariantTransparent];
     }
     else  // uses OpenGLES2
     {
@@ -97,10 +100,8 @@ typedef struct  {
             glUniform1f(location, self.interactive);
         }];
         
-        program = [SCNProgram programWithGLShader:@"Shaders/CombinedShader/combinedShader"];
+        program = [[ShaderCache main] glProgramNamed:@"Shaders/CombinedShader/combinedShader" variant:ShaderVariantTransparent];
     }
-    
-    [program setOpaque:NO];
 
     SCNMaterial *material = self.node.geometry.firstMaterial;
     material.program = program;
@@ -111,6 +112,17 @@ typedef struct  {
     self.node.renderingOrder = TRANSPARENCY_RENDERING_ORDER + 1000;
     
     [self.node setCastsShadowRecursively:NO];
+
+    if ([SceneManager main].renderingAPI == BEViewRenderingAPIMetal) {
+        self.reticleUniforms = [[UniformRing main] reserveBlockWithLength:sizeof(OBEFixedSizeReticleProperties)];
+        self.stereoDraw = [[StereoRenderer main] drawNode:self.node
+                                       vertexFunctionName:@"OBEFixedSizeReticleVertex"
+                                     fragmentFunctionName:@"OBEFixedSizeReticleFragment"
+                                                blendMode:SCNBlendModeAlpha
+                                         readsDepthBuffer:NO
+                                        writesDepthBuffer:NO];
+        self.stereoDraw.properties = self.reticleUniforms;
+    }
 }
 
 - (void) onGazeStart:(GazeComponent *) gazeComponent targetEntity:(GKEntity *) targetEntity intersection:(SCNHitTestResult *) intersection isInteractive:(bool)isInteractive {
@@ -157,8 +169,10 @@ typedef struct  {
     if ([SceneManager main].renderingAPI == BEViewRenderingAPIMetal)
     {
         _reticleProperties.active = self.interactive;
-        NSData* data = [NSData dataWithBytes:&_reticleProperties length:sizeof(OBEFixedSizeReticleProperties)];
-        [self.node.geometry.firstMaterial setValue:data forKey:@"reticle_properties"];
+        NSData* data = [self.reticleUniforms update:&_reticleProperties];
+        if( self.stereoDraw == nil ) {
+            [self.node.geometry.firstMaterial setValue:data forKey:@"reticle_properties"];
+        }
     }
 }
 
@@ -107,13 +107,7 @@
 
     if( result ) {
         // find entity of component
-        GKEntity * resultEntity = [result.node valueForKey:@"entity"];
-        SCNNode * resultNode = result.node;
-        
-        while( !resultEntity && resultNode.parentNode ) {
-            resultNode = resultNode.parentNode;
-            resultEntity = [resultNode valueForKey:@"entity"];
-        }
+        GKEntity * resultEntity = [[SceneManager main].registry entityForNode:result.node];
 
         GKComponent<EventComponentProtocol> *entityEventComponent = (GKComponent<EventComponentProtocol> *)[ComponentUtils getComponentFromEntity:resultEntity ofProtocol:@protocol(EventComponentProtocol)];
         bool isInteractive = entityEventComponent != NULL;
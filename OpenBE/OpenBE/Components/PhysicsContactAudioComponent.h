@@ -16,7 +16,8 @@
  */
 @interface PhysicsContactAudio : NSObject
 @property(nonatomic, copy) NSString *nodeName; // The scene's node to play this sound on.
-@property(nonatomic, strong) AudioNode *audioNode; // The audio node playing the sound.
+@property(nonatomic) AudioSoundID soundID; // Pooled sound to trigger, AUDIO_SOUND_INVALID until loaded.
+@property(nonatomic) NSUInteger maxInstances; // Overlapping bounces of this sound, set before it loads.
 @property(nonatomic) NSTimeInterval bounceCoolOffTime;  // Interval to wait before re-triggering the sound effect.
 @property(nonatomic) float minImpulse; // Minimum impulse threshold to consider playing the sound.
 @property(nonatomic) float maxImpulse; // Upper max impulse threshold, for calculating peak volume.
@@ -10,13 +10,30 @@
 #import "../Utils/Math.h"
 #import "../Utils/SceneKitTools.h"
 
+#include <vector>
+
 #define PHYSICS_BOUNCE_IMPULSE_POWER 0.7f
 
+// Default overlapping bounces per sound.
+#define PHYSICS_BOUNCE_MAX_INSTANCES 4
+
+// Contacts on indexed nodes further than this from the camera are not heard.
+#define PHYSICS_AUDIBLE_RANGE 10.f
+
+// Contacts buffered per frame before the first reallocation.
+#define PHYSICS_CONTACT_RESERVE 256
+
+// Body index of nodes that have no contact audio.
+#define PHYSICS_BODY_NONE UINT32_MAX
+
+@interface PhysicsContactAudioComponent ()
+- (void) syncBodyFromAudio:(PhysicsContactAudio*)contactAudio;
+- (void) resetCoolOffForBody:(uint32_t)bodyIndex;
+@end
+
 @interface PhysicsContactAudio ()
-@property(nonatomic) NSTimeInterval bounceCoolOffTimer;
-@property(nonatomic) float bounceCoolOffMaxImpulse;
-@property(nonatomic) float bounceHighestImpulse;
-@property(nonatomic) SCNVector3 bouncePosition;
+@property(nonatomic, weak) PhysicsContactAudioComponent *owner;
+@property(nonatomic) uint32_t bodyIndex;
 @end
 
 @implementation PhysicsContactAudio
@@ -26,8 +43,11 @@
     self = [super init];
     if (self) {
         self.nodeName = nodeName;
+        self.soundID = AUDIO_SOUND_INVALID;
+        self.maxInstances = PHYSICS_BOUNCE_MAX_INSTANCES;
+        self.bodyIndex = PHYSICS_BODY_NONE;
         dispatch_async(dispatch_get_main_queue(), ^{
-            self.audioNode = [[AudioEngine main] loadAudioNamed:audioName];
+            self.soundID = [[AudioEngine main] loadSoundNamed:audioName maxInstances:self.maxInstances priority:AudioPriorityNormal];
         });
         
         self.minImpulse = 25;
@@ -37,58 +57,33 @@
     return self;
 }
 
-/**
- * Reset the cooloff timer, so next bounce will always trigger.
- */
-- (void) resetBounceCooloffTimer {
-    _bounceCoolOffTimer = -1;
-}
+// The component's body arrays are what's read per frame, so settings write through.
 
-- (void) calculatePeakImpulseForContact:(SCNPhysicsContact *)contact forNode:(SCNNode*)node {
-    // Calculate the momentary impact speed: (velocityNormal•contactNormal)*velocitySpeed = velocity•contactNormal = impactSpeed
-    GLKVector3 velocity = SCNVector3ToGLKVector3(node.physicsBody.velocity);
-    GLKVector3 contactNormal = SCNVector3ToGLKVector3(contact.contactNormal);
-    float impactSpeed = GLKVector3DotProduct(velocity, contactNormal);
+- (void) setSoundID:(AudioSoundID)soundID {
+    _soundID = soundID;
+    [_owner syncBodyFromAudio:self];
+}
 
-    // Replace the totally unreliable SceneKit physics system reports of impulse.
-    // Assume a mass of 100, so we get a similar range to that collisionImpulse was returning.
-    float collisionImpulse = impactSpeed * 100;// contact.collisionImpulse;
-    if( isnan(collisionImpulse) || collisionImpulse < self.minImpulse ) {
-        return;
-    }
+- (void) setBounceCoolOffTime:(NSTimeInterval)bounceCoolOffTime {
+    _bounceCoolOffTime = bounceCoolOffTime;
+    [_owner syncBodyFromAudio:self];
+}
 
-    if( _bounceHighestImpulse < collisionImpulse ) {
-        _bounceHighestImpulse = collisionImpulse;
-        _bouncePosition = contact.contactPoint;
-    }
+- (void) setMinImpulse:(float)minImpulse {
+    _minImpulse = minImpulse;
+    [_owner syncBodyFromAudio:self];
 }
 
-- (void) updatePhysics:(float) dt {
-    _bounceCoolOffTimer -= dt;
+- (void) setMaxImpulse:(float)maxImpulse {
+    _maxImpulse = maxImpulse;
+    [_owner syncBodyFromAudio:self];
+}
 
-    if(_bounceCoolOffTimer < 0 && _bounceCoolOffMaxImpulse > 0 )
-    {
-        _bounceCoolOffMaxImpulse = 0;
-        _bounceHighestImpulse = 0;
-//        NSLog(@"bounce reset");
-    }
-    
-    if( _bounceCoolOffMaxImpulse < _bounceHighestImpulse ) {
-        // Hit a new peak impulse, reset our cool-off timer.
-        _bounceCoolOffTimer = _bounceCoolOffTime;
-        
-        // Record new maxImpulse for our cool-off timer.
-        _bounceCoolOffMaxImpulse = _bounceHighestImpulse;
-        _bounceHighestImpulse = 0;
-        
-        // Play with new peak impulse.
-        float bounceImpulse = clampf(_minImpulse, _maxImpulse, _bounceCoolOffMaxImpulse);
-        float bounceVolume = clampf(1, 0, powf(bounceImpulse - _minImpulse, PHYSICS_BOUNCE_IMPULSE_POWER) / powf(_maxImpulse-_minImpulse, PHYSICS_BOUNCE_IMPULSE_POWER) );
-//         NSLog(@"bounce volume: %f, impulse: %f, actual impulse: %f", bounceVolume, bounceImpulse, _bounceCoolOffMaxImpulse );
-        _audioNode.volume = bounceVolume;
-        _audioNode.position = _bouncePosition;
-        [self.audioNode play];
-    }
+/**
+ * Reset the cooloff timer, so next bounce will always trigger.
+ */
+- (void) resetBounceCooloffTimer {
+    [_owner resetCoolOffForBody:_bodyIndex];
 }
 
 @end
@@ -98,12 +93,57 @@
 @end
 
 @implementation PhysicsContactAudioComponent
+{
+    // Body index of each node seen in a contact, so names are only looked up once per node.
+    NSMapTable<SCNNode*, NSNumber*> *_bodiesByNode;
+
+    // Per body settings and cool-off state, indexed by PhysicsContactAudio bodyIndex.
+    std::vector<AudioSoundID> _bodySound;
+    std::vector<float> _bodyMinImpulse;
+    std::vector<float> _bodyMaxImpulse;
+    std::vector<float> _bodyCoolOffTime;
+    std::vector<float> _bodyCoolOffTimer;
+    std::vector<float> _bodyCoolOffMaxImpulse;
+    std::vector<float> _bodyHighestImpulse;
+    std::vector<GLKVector3> _bodyPosition;
+    std::vector<uint32_t> _freeBodies;
+
+    // This frame's contacts, reduced and cleared in updateWithDeltaTime:.
+    std::vector<uint32_t> _contactBody;
+    std::vector<float> _contactImpulse;
+    std::vector<GLKVector3> _contactPoint;
+
+    // This frame's triggers, sent to the AudioEngine as one batch.
+    std::vector<AudioSoundID> _triggerSound;
+    std::vector<float> _triggerVolume;
+    std::vector<GLKVector3> _triggerPosition;
+}
+
+/**
+ * Camera relative audible sphere, evaluated by the SpatialIndex each frame.
+ */
++ (SpatialStandingQuery) audibleQuery {
+    static SpatialStandingQuery audibleQuery;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        SpatialQuery query = SpatialQuerySphere(GLKVector3Make(0, 0, 0), PHYSICS_AUDIBLE_RANGE);
+        query.cameraRelative = YES;
+        audibleQuery = [[SpatialIndex main] addStandingQuery:query];
+    });
+    
+    return audibleQuery;
+}
 
 - (instancetype)init
 {
     self = [super init];
     if (self) {
         _physicsContactNodes = [[NSMutableDictionary alloc] init];
+        _bodiesByNode = [NSMapTable weakToStrongObjectsMapTable];
+
+        _contactBody.reserve(PHYSICS_CONTACT_RESERVE);
+        _contactImpulse.reserve(PHYSICS_CONTACT_RESERVE);
+        _contactPoint.reserve(PHYSICS_CONTACT_RESERVE);
     }
     return self;
 }
@@ -123,13 +163,42 @@
  */ 
 - (PhysicsContactAudio*) addNodeName:(NSString*)nodeName audioName:(NSString*)audioName {
 
-    if( _physicsContactNodes[nodeName] != nil ) {
+    PhysicsContactAudio *existing = _physicsContactNodes[nodeName];
+    if( existing != nil ) {
         NSLog(@"PhysicsSoundComonent: === Warning === Already associated audioName: %@ with nodeName: %@", audioName, nodeName );
+        [self releaseBodyOfAudio:existing];
     }
 
     PhysicsContactAudio *contactSound = [[PhysicsContactAudio alloc] initWithNodeName:nodeName audioName:audioName];
     _physicsContactNodes[nodeName] = contactSound;
 
+    uint32_t bodyIndex;
+    if( !_freeBodies.empty() ) {
+        bodyIndex = _freeBodies.back();
+        _freeBodies.pop_back();
+    } else {
+        bodyIndex = (uint32_t)_bodySound.size();
+        _bodySound.push_back(AUDIO_SOUND_INVALID);
+        _bodyMinImpulse.push_back(0);
+        _bodyMaxImpulse.push_back(0);
+        _bodyCoolOffTime.push_back(0);
+        _bodyCoolOffTimer.push_back(0);
+        _bodyCoolOffMaxImpulse.push_back(0);
+        _bodyHighestImpulse.push_back(0);
+        _bodyPosition.push_back(GLKVector3Make(0, 0, 0));
+    }
+
+    _bodyCoolOffTimer[bodyIndex] = 0;
+    _bodyCoolOffMaxImpulse[bodyIndex] = 0;
+    _bodyHighestImpulse[bodyIndex] = 0;
+
+    contactSound.bodyIndex = bodyIndex;
+    contactSound.owner = self;
+    [self syncBodyFromAudio:contactSound];
+
+    // Nodes that had no contact audio before may have one now.
+    [_bodiesByNode removeAllObjects];
+
     return contactSound;
 }
 
@@ -144,18 +213,159 @@
  * Remove the physics audio node name.
  */ 
 - (void) removeNodeName:(NSString*)nodeName {
+    PhysicsContactAudio *contactSound = _physicsContactNodes[nodeName];
+    if( contactSound == nil ) return;
+
+    [self releaseBodyOfAudio:contactSound];
     [_physicsContactNodes removeObjectForKey:nodeName];
+    [_bodiesByNode removeAllObjects];
+}
+
+/**
+ * Free the audio's body index, dropping the contacts already buffered for it,
+ * so a body reusing the index this frame doesn't pick them up.
+ */
+- (void) releaseBodyOfAudio:(PhysicsContactAudio*)contactSound {
+    uint32_t bodyIndex = contactSound.bodyIndex;
+    if( bodyIndex == PHYSICS_BODY_NONE ) return;
+
+    [self dropContactsOfBody:bodyIndex];
+    _bodySound[bodyIndex] = AUDIO_SOUND_INVALID;
+    _freeBodies.push_back(bodyIndex);
+
+    contactSound.owner = nil;
+    contactSound.bodyIndex = PHYSICS_BODY_NONE;
+}
+
+- (void) syncBodyFromAudio:(PhysicsContactAudio*)contactAudio {
+    uint32_t bodyIndex = contactAudio.bodyIndex;
+    if( bodyIndex == PHYSICS_BODY_NONE ) return;
+
+    _bodySound[bodyIndex] = contactAudio.soundID;
+    _bodyMinImpulse[bodyIndex] = contactAudio.minImpulse;
+    _bodyMaxImpulse[bodyIndex] = contactAudio.maxImpulse;
+    _bodyCoolOffTime[bodyIndex] = contactAudio.bounceCoolOffTime;
+}
+
+- (void) resetCoolOffForBody:(uint32_t)bodyIndex {
+    if( bodyIndex == PHYSICS_BODY_NONE ) return;
+    _bodyCoolOffTimer[bodyIndex] = -1;
+}
+
+/**
+ * Body index for a contact node, resolved by name the first time the node is seen.
+ */
+- (uint32_t) bodyIndexForNode:(SCNNode*)node {
+    NSNumber *cached = [_bodiesByNode objectForKey:node];
+    if( cached ) return cached.unsignedIntValue;
+
+    PhysicsContactAudio *contactSound = node.name ? _physicsContactNodes[node.name] : nil;
+    uint32_t bodyIndex = contactSound ? contactSound.bodyIndex : PHYSICS_BODY_NONE;
+    [_bodiesByNode setObject:@(bodyIndex) forKey:node];
+    return bodyIndex;
 }
 
 #pragma mark - Update Methods
  
 - (void) updateWithDeltaTime:(NSTimeInterval)dt {
-    if( ![self isEnabled] ) return;
-    
-    // Update all the physics nodes.
-    for( PhysicsContactAudio *contactAudio in _physicsContactNodes.allValues ) {
-        [contactAudio updatePhysics:dt];
+    if( ![self isEnabled] ) {
+        [self clearContacts];
+        return;
+    }
+
+    const size_t contactCount = _contactBody.size();
+    const size_t bodyCount = _bodySound.size();
+
+    // Reduce this frame's contacts to the peak impulse of each body, in one pass.
+    const uint32_t *contactBody = _contactBody.data();
+    const float *contactImpulse = _contactImpulse.data();
+    const GLKVector3 *contactPoint = _contactPoint.data();
+    const float *minImpulse = _bodyMinImpulse.data();
+    float *highestImpulse = _bodyHighestImpulse.data();
+    GLKVector3 *bodyPosition = _bodyPosition.data();
+    for( size_t i=0; i<contactCount; i++ ) {
+        uint32_t b = contactBody[i];
+        float impulse = contactImpulse[i];
+
+        // Written so NaN fails too.
+        if( !(impulse >= minImpulse[b]) ) continue;
+
+        if( highestImpulse[b] < impulse ) {
+            highestImpulse[b] = impulse;
+            bodyPosition[b] = contactPoint[i];
+        }
+    }
+    [self clearContacts];
+
+    // Advance every body's cool-off, collecting a trigger for each new peak.
+    const float fdt = (float)dt;
+    const float *maxImpulse = _bodyMaxImpulse.data();
+    const float *coolOffTime = _bodyCoolOffTime.data();
+    float *coolOffTimer = _bodyCoolOffTimer.data();
+    float *coolOffMaxImpulse = _bodyCoolOffMaxImpulse.data();
+    for( size_t b=0; b<bodyCount; b++ ) {
+        coolOffTimer[b] -= fdt;
+
+        if( coolOffTimer[b] < 0 && coolOffMaxImpulse[b] > 0 ) {
+            coolOffMaxImpulse[b] = 0;
+            highestImpulse[b] = 0;
+        }
+
+        if( coolOffMaxImpulse[b] < highestImpulse[b] ) {
+            // Hit a new peak impulse, reset our cool-off timer.
+            coolOffTimer[b] = coolOffTime[b];
+
+            // Record new maxImpulse for our cool-off timer.
+            coolOffMaxImpulse[b] = highestImpulse[b];
+            highestImpulse[b] = 0;
+
+            if( _bodySound[b] == AUDIO_SOUND_INVALID ) continue;
+
+            // Play with new peak impulse.
+            float minI = minImpulse[b];
+            float maxI = maxImpulse[b];
+            float bounceImpulse = clampf(minI, maxI, coolOffMaxImpulse[b]);
+            float bounceVolume = clampf(1, 0, powf(bounceImpulse - minI, PHYSICS_BOUNCE_IMPULSE_POWER) / powf(maxI - minI, PHYSICS_BOUNCE_IMPULSE_POWER) );
+
+            _triggerSound.push_back(_bodySound[b]);
+            _triggerVolume.push_back(bounceVolume);
+            _triggerPosition.push_back(bodyPosition[b]);
+        }
+    }
+
+    if( !_triggerSound.empty() ) {
+        [[AudioEngine main] triggerSounds:_triggerSound.data()
+                                atVolumes:_triggerVolume.data()
+                                positions:_triggerPosition.data()
+                                    count:_triggerSound.size()];
+        _triggerSound.clear();
+        _triggerVolume.clear();
+        _triggerPosition.clear();
+    }
+}
+
+- (void) clearContacts {
+    _contactBody.clear();
+    _contactImpulse.clear();
+    _contactPoint.clear();
+}
+
+/**
+ * Remove one body's contacts from this frame's buffers, keeping the others in order.
+ */
+- (void) dropContactsOfBody:(uint32_t)bodyIndex {
+    size_t kept = 0;
+    for( size_t i=0; i<_contactBody.size(); i++ ) {
+        if( _contactBody[i] == bodyIndex ) continue;
+
+        _contactBody[kept] = _contactBody[i];
+        _contactImpulse[kept] = _contactImpulse[i];
+        _contactPoint[kept] = _contactPoint[i];
+        kept++;
     }
+    _contactBody.resize(kept);
+    _contactImpulse.resize(kept);
+    _contactPoint.resize(kept);
 }
 
 - (void) calculatePeakImpulseForContact:(SCNPhysicsContact *)contact {
@@ -176,10 +386,28 @@
         return; //Reject non-mutual collision.
     } 
 
-    PhysicsContactAudio *contactSound = _physicsContactNodes[contact.nodeA.name];
-    if( contactSound != nil ) {
-        [contactSound calculatePeakImpulseForContact:contact forNode:contact.nodeA];
+    uint32_t bodyIndex = [self bodyIndexForNode:contact.nodeA];
+    if( bodyIndex == PHYSICS_BODY_NONE ) return;
+
+    // Cull contacts out of earshot. Nodes not in the SpatialIndex are always heard.
+    SpatialIndex *spatialIndex = [SpatialIndex main];
+    SpatialHandle handle = [spatialIndex handleForNode:contact.nodeA];
+    if( handle != SPATIAL_HANDLE_INVALID && ![spatialIndex handle:handle matchesStandingQuery:[PhysicsContactAudioComponent audibleQuery]] ) {
+        return;
     }
+
+    // Calculate the momentary impact speed: (velocityNormal•contactNormal)*velocitySpeed = velocity•contactNormal = impactSpeed
+    GLKVector3 velocity = SCNVector3ToGLKVector3(bodyA.velocity);
+    GLKVector3 contactNormal = SCNVector3ToGLKVector3(contact.contactNormal);
+    float impactSpeed = GLKVector3DotProduct(velocity, contactNormal);
+
+    // Replace the totally unreliable SceneKit physics system reports of impulse.
+    // Assume a mass of 100, so we get a similar range to that collisionImpulse was returning.
+    float collisionImpulse = impactSpeed * 100;// contact.collisionImpulse;
+
+    _contactBody.push_back(bodyIndex);
+    _contactImpulse.push_back(collisionImpulse);
+    _contactPoint.push_back(SCNVector3ToGLKVector3(contact.contactPoint));
 }
 
 #pragma mark - PhysicsWorld contact delegate methods
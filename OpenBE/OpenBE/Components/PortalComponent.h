@@ -8,7 +8,8 @@
 //  Description:
 //  Portal is composed of a bunch of nodes that work to drive the OpenGL
 //  state changes and handle the switched rendering order needed to make the
-//  illusion of a portal into the VR world.
+//  illusion of a portal into the VR world. The state itself is applied by the
+//  PortalRenderer, which also culls the portal and clips the VR world with Metal.
 //
 //  The visualization of real-world obstacles must be maintained when
 //  walking into the VR world.  So this last visualization is rendered
@@ -78,7 +79,7 @@ typedef NS_ENUM (NSUInteger, PortalMode) {
  *
  * These nodes require manual updates to their transform if the portal node's transform changes.
  */
-@interface PortalComponent : Component  <SCNNodeRendererDelegate, PortalComponentJS>
+@interface PortalComponent : Component  <PortalComponentJS>
 
 @property(nonatomic, weak) BEMixedRealityMode *mixedReality;
 // @property(nonatomic, strong) SCNNode *node; (protect the node)
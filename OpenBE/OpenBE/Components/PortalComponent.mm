@@ -26,6 +26,7 @@
 #import <GLKit/GLKit.h>
 #import "../Utils/SceneKitTools.h"
 #import "../Utils/SceneKitExtensions.h"
+#import "../Utils/NodeSet.h"
 #import "../Utils/Math.h"
 
 //#define PORTAL_WIDTH 1.0
@@ -77,6 +78,9 @@ typedef NS_ENUM (NSUInteger, PortalState) {
 @property(nonatomic, strong) SCNNode *portalDone;
 @property(nonatomic, strong) SCNNode *portalCleanup;
 
+// Hole and occluders, culled and clipped against by the PortalRenderer.
+@property(nonatomic, strong) PortalView *portalView;
+
 // @property(nonatomic) BOOL collisionAvoidance;
 
 @property(atomic) GLKVector3 oldCameraPos;
@@ -93,6 +97,9 @@ typedef NS_ENUM (NSUInteger, PortalState) {
 
 @property(nonatomic) BOOL isInsideAR_1FrameDelayedSwitch;
 
+// Rendering order swapped on crossing, looked up on the first crossing.
+@property(nonatomic, weak) SCNNode *scanNode;
+
 @end
 
 @implementation PortalComponent
@@ -194,6 +201,25 @@ typedef NS_ENUM (NSUInteger, PortalState) {
     }
 
     [self.node setCastsShadowRecursively:NO];
+
+    [self updatePortalView];
+}
+
+/**
+ * Point the PortalRenderer at the current mode's hole and occluders.
+ */
+- (void) updatePortalView {
+    if( _portalView == nil ) return;
+
+    _portalView.holeNode = _portalGeometryNode;
+    if( _mode == PortalRectangleOnFloor ) {
+        _portalView.shape = PortalShapeRectangle;
+        _portalView.halfExtents = GLKVector2Make(0.5 * PORTAL_WIDTH, 0.5 * PORTAL_HEIGHT);
+    } else {
+        _portalView.shape = PortalShapeCircle;
+        _portalView.halfExtents = GLKVector2Make(PORTAL_CIRCLE_RADIUS, PORTAL_CIRCLE_RADIUS);
+    }
+    _portalView.occluderNodes = (_occlude && _depth) ? @[_occlude, _depth] : @[];
 }
 
 - (void) setEnabled:(bool)enabled {
@@ -209,6 +235,7 @@ typedef NS_ENUM (NSUInteger, PortalState) {
     self.postVR.hidden = !enabled;
     self.portalDone.hidden = !enabled;
     self.portalCleanup.hidden = !enabled;
+    self.portalView.enabled = enabled;
 
     self.oldCameraPos = [Camera main].position;
     self.portalState = PORTAL_IDLE;
@@ -467,6 +494,7 @@ typedef NS_ENUM (NSUInteger, PortalState) {
     if( _isInsideAR == isInsideAR ) return; // Early exit, redudant hits causes the screen to fade out.
     
     _isInsideAR = isInsideAR;
+    [PortalRenderer main].insideAR = isInsideAR;
 
     // Switch around the rendering orders for things.
     [SCNTransaction begin];
@@ -515,24 +543,26 @@ typedef NS_ENUM (NSUInteger, PortalState) {
     [SCNTransaction disableActions];
     [SCNTransaction setAnimationDuration:0];
     
-    SCNNode *scanNode = [_mixedReality.sceneKitScene.rootNode childNodeWithName:@"customVizNode" recursively:YES];
+    // Looked up once, the sets flattened once; this is the frame we cross in.
+    if( _scanNode == nil ) {
+        self.scanNode = [_mixedReality.sceneKitScene.rootNode childNodeWithName:@"customVizNode" recursively:YES];
+    }
+    NodeSet *robotNodes = ((GeometryComponent *)[self.robotEntity componentForClass:[GeometryComponent class]]).nodeSet;
+    NodeSet *controllerNodes = self.bridgeControllerComponent.nodeSet;
+
     if (_isInsideAR)
     {
-        [scanNode setRenderingOrder:BEEnvironmentScanRenderingOrder];
-        [((GeometryComponent *)[self.robotEntity componentForClass:[GeometryComponent class]]).node
-         setRenderingOrderRecursively:1];
+        [_scanNode setRenderingOrder:BEEnvironmentScanRenderingOrder];
+        [robotNodes setValue:NodeSetInteger(1) forProperty:NodeSetPropertyRenderingOrder];
     }
     else
     {
         // Make the room mesh render after the vr world so that we get transparency on collision avoidance to work
-        [scanNode setRenderingOrder:VR_WORLD_RENDERING_ORDER + 100];
+        [_scanNode setRenderingOrder:VR_WORLD_RENDERING_ORDER + 100];
         
         // Make sure Robot and Controller appear after world render.
-        [((GeometryComponent *)[self.robotEntity componentForClass:[GeometryComponent class]]).node
-         setRenderingOrderRecursively:(VR_WORLD_RENDERING_ORDER+6)];
-        
-        [self.bridgeControllerComponent.node
-         setRenderingOrderRecursively:(VR_WORLD_RENDERING_ORDER+6)];
+        [robotNodes setValue:NodeSetInteger(VR_WORLD_RENDERING_ORDER+6) forProperty:NodeSetPropertyRenderingOrder];
+        [controllerNodes setValue:NodeSetInteger(VR_WORLD_RENDERING_ORDER+6) forProperty:NodeSetPropertyRenderingOrder];
     }
     
     [SCNTransaction commit];
@@ -562,13 +592,18 @@ typedef NS_ENUM (NSUInteger, PortalState) {
 - (void) start{
     [super start];
     
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.audioWarpIn = [[AudioEngine main] loadAudioNamed:@"Robot_WarpIn.caf"];
-        self.audioWarpOut = [[AudioEngine main] loadAudioNamed:@"Robot_WarpOut.caf"];
-        
-        self.emergencyExitPowerUp = [[AudioEngine main] loadAudioNamed:@"ExitVR_PowerUp.caf"];
-        self.emergencyExitPowerAbort = [[AudioEngine main] loadAudioNamed:@"ExitVR_PowerAbort.caf"];
-    });
+    [[AudioEngine main] loadAudioNamed:@"Robot_WarpIn.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.audioWarpIn = audioNode;
+    }];
+    [[AudioEngine main] loadAudioNamed:@"Robot_WarpOut.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.audioWarpOut = audioNode;
+    }];
+    [[AudioEngine main] loadAudioNamed:@"ExitVR_PowerUp.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.emergencyExitPowerUp = audioNode;
+    }];
+    [[AudioEngine main] loadAudioNamed:@"ExitVR_PowerAbort.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.emergencyExitPowerAbort = audioNode;
+    }];
     
     _open = NO;
     
@@ -582,30 +617,20 @@ typedef NS_ENUM (NSUInteger, PortalState) {
     [_node addChildNode:_portalCrossingTransformNode];
 
     
-    // Set the stencil State
-    self.prePortal = [SCNNode node];
-    [self.prePortal setName:@"PrePortal"];
-    [self.prePortal setRenderingOrder: VR_WORLD_RENDERING_ORDER-5 ];
-    [self.prePortal setRendererDelegate:self];
+    // Stage nodes, ordered around the VR world. The PortalRenderer sets the state for each.
+    self.prePortal = [[PortalRenderer main] nodeForStage:PortalStagePrePortal];
     [_node addChildNode:self.prePortal];
 
     // Render _occlude node
     // Write the stencil of the portal, masking the areas that the world can render into.
 
-    // Set Stencil Test Func
-    self.postPortal = [SCNNode node];
-    [self.postPortal setName:@"PostPortal"];
-    [self.postPortal setRenderingOrder:VR_WORLD_RENDERING_ORDER-3];
-    [self.postPortal setRendererDelegate:self];
+    self.postPortal = [[PortalRenderer main] nodeForStage:PortalStagePostPortal];
     [_node addChildNode:self.postPortal];
 
     // VR world is renderingOrder VR_WORLD_RENDERING_ORDER
     // Will only render with correct stencil test
     
-    self.postVR = [SCNNode node];
-    [self.postVR setName:@"PostVRScene"];
-    [self.postVR setRenderingOrder:VR_WORLD_RENDERING_ORDER+3];
-    [self.postVR setRendererDelegate:self];
+    self.postVR = [[PortalRenderer main] nodeForStage:PortalStagePostVRScene];
     [_node addChildNode:self.postVR];
     
     // Render _depth node
@@ -613,11 +638,13 @@ typedef NS_ENUM (NSUInteger, PortalState) {
     // so that the environment isn't rendered back in there.
     // This may not be necessary but can't figure out a smarter way...
 
-    self.portalDone = [SCNNode node];
-    [self.portalDone setName:@"portalDone"];
-    [self.portalDone setRenderingOrder:VR_WORLD_RENDERING_ORDER+5 ];
-    [self.portalDone setRendererDelegate:self];
+    self.portalDone = [[PortalRenderer main] nodeForStage:PortalStageDone];
     [_node addChildNode:self.portalDone];
+
+    self.portalView = [[PortalView alloc] init];
+    self.portalView.enabled = [self isEnabled];
+    [self updatePortalView];
+    [[PortalRenderer main] addPortal:self.portalView];
     
     self.isInsideAR = YES;
     self.time = 0;
@@ -625,68 +652,4 @@ typedef NS_ENUM (NSUInteger, PortalState) {
     self.oldCameraPos = [Camera main].position;
 }
 
-#pragma mark - SceneKit Node Renderer Methods
-
-
-// Invoked by SceneKit just before portal will be rendered
--(void)renderNode:(SCNNode *)node
-         renderer:(SCNRenderer *)renderer
-        arguments:(NSDictionary *)arguments
-{
-    NSString *passName = arguments[@"kRenderPassName"];
-    
-    // Don't render in the light pass, or any other pass
-    // NOTE: in stereo this gets called twice with pass names sceneLeft and sceneRight
-    if ([passName isEqualToString:@"SceneKit_renderSceneFromLight"] )
-        return;
-    
-    
-    if ([node.name isEqualToString:@"PrePortal"] )
-    {
-        glEnable(GL_STENCIL_TEST);
-        glStencilFunc(GL_ALWAYS, PORTAL_STENCIL_VALUE, 0xFF);
-        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-
-        // Only write to stencil, not depth or color
-        glStencilMask(0xFF);
-        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-        glDepthMask(GL_FALSE);
-        
-        glClearStencil(0);
-        glClear(GL_STENCIL_BUFFER_BIT);
-    }
-    
-    // Portal renders to stencil here
-    if ([node.name isEqualToString:@"PostPortal"] )
-    {
-        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-        glDepthMask(GL_TRUE);
-        glStencilMask(0x0);
-        
-        // This clears the depth buffer which breaks MR occulsion for all rendering.  Needs to be reworked.
-        // glClear(GL_DEPTH_BUFFER_BIT); // always clear now that stencil buffer has ben rendered to
-
-        if(self.isInsideAR) {
-            // Only draw where the stencil == PORTAL_STENCIL_VALUE
-            glStencilFunc(GL_EQUAL, PORTAL_STENCIL_VALUE, 0xFF);
-        } else {
-            glStencilFunc(GL_NOTEQUAL, PORTAL_STENCIL_VALUE, PORTAL_STENCIL_VALUE);
-        }
-    }
-    
-    // VR world renders here
-    if ([node.name isEqualToString:@"PostVRScene"] )
-    {
-        glDisable(GL_STENCIL_TEST);
-
-        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-    }
-
-    if ([node.name isEqualToString:@"portalDone"] )
-    {
-        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    }
-
-}
-
 @end
@@ -8,6 +8,7 @@
 
 #import "ProjectedGeometryComponent.h"
 #import "../Utils/SceneKitExtensions.h"
+#import "../Core/ShaderCache.h"
 
 @implementation ProjectedGeometryComponent
 
@@ -27,17 +28,17 @@
 
 // This recursive method sets the shader type for the component and all child nodes to the projection shader in combined shader.
 - (void)setShaderForChildren:(SCNNode *)rootNode {
+    // Shared by every projected geometry.
     SCNProgram * program;
     
     if( SceneManager.main.renderingAPI == BEViewRenderingAPIOpenGLES2) {
-        program = [SCNProgram programWithGLShader:@"Shaders/CombinedShader/combinedShader"];
+        program = [[ShaderCache main] glProgramNamed:@"Shaders/CombinedShader/combinedShader" variant:ShaderVariantTransparent];
     } else {
-        program = [SCNProgram openbeMetalProgramWithVertexFunctionName:@"OBEProjectionVertex"
-                                                  fragmentFunctionName:@"OBEProjectionFragment"];
+        program = [[ShaderCache main] metalProgramWithVertexFunctionName:@"OBEProjectionVertex"
+                                                    fragmentFunctionName:@"OBEProjectionFragment"
+                                                                 variant:ShaderVariantTransparent];
     }
     
-    [program setOpaque:NO];
-    
     [rootNode _enumerateHierarchyUsingBlock:^(SCNNode * _Nonnull node, BOOL * _Nonnull stop) {
         node.renderingOrder = TRANSPARENCY_RENDERING_ORDER + 1000;
         node.castsShadow = NO;
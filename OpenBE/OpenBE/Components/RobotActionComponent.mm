@@ -14,6 +14,7 @@
 #import "RobotSeesMeComponent.h"
 #import "RobotVemojiComponent.h"
 #import "../Utils/SceneKitExtensions.h"
+#import "../Utils/NodeSet.h"
 #import "../Utils/ComponentUtils.h"
 #import "../Utils/Math.h"
 #import "../Core/AudioEngine.h"
@@ -38,6 +39,7 @@
 @property(nonatomic, weak) RobotBehaviourComponent *robotBehaviour;
 @property (weak) GeometryComponent * geometryComponent;
 @property (weak) AnimationComponent * animationComponent;
+@property (weak) RobotSeesMeComponent * seesMeComponent;
 @property(nonatomic, strong) NSMutableArray *actionBuffer;
 
 @property(nonatomic, strong) NSMutableArray<ComponentProtocol> *componentsToDisableOnModeChange;
@@ -62,6 +64,7 @@
     self.robotBehaviour = (RobotBehaviourComponent * )[ComponentUtils getComponentFromEntity:self.entity ofClass:[RobotBehaviourComponent class]];
     self.geometryComponent = (GeometryComponent * )[ComponentUtils getComponentFromEntity:self.entity ofClass:[GeometryComponent class]];
     self.animationComponent = (AnimationComponent *)[ComponentUtils getComponentFromEntity:self.entity ofClass:[AnimationComponent class]];
+    self.seesMeComponent = (RobotSeesMeComponent *)[ComponentUtils getComponentFromEntity:self.entity ofClass:[RobotSeesMeComponent class]];
 }
 
 /**
@@ -121,27 +124,25 @@
         
 
         [_geometryComponent.node runAction:nextAction forKey:ROBOT_ACTION_BUFFER_KEY completionHandler:^{
-            [[SceneManager main].mixedRealityMode runBlockInRenderThread:^(void) {
-                [self _runNextBufferedAction];
-            }];
+            [[RenderCommandQueue main] postTarget:self selector:@selector(_runNextBufferedAction)];
         }];
     }
 }
 
 /**
  * Check if robot can see the main camera.
+ * As of this frame's update, with nothing in the way.
  */
 - (BOOL) canSeeMe {
-    RobotSeesMeComponent *sees = (RobotSeesMeComponent * )[ComponentUtils getComponentFromEntity:self.entity ofClass:[RobotSeesMeComponent class]];
-    return sees.robotSeesMainCamera;
+    return _seesMeComponent.robotSeesMainCamera;
 }
 
 /**
  * Check if we are looking at the robot.
+ * As of this frame's update, with nothing in the way.
  */
 - (BOOL) canSeeRobot {
-    RobotSeesMeComponent *sees = (RobotSeesMeComponent * )[ComponentUtils getComponentFromEntity:self.entity ofClass:[RobotSeesMeComponent class]];
-    return sees.mainCameraSeesRobot;
+    return _seesMeComponent.mainCameraSeesRobot;
 }
 
 /**
@@ -368,7 +369,7 @@
 - (SCNAction*)renderInWorldsAR:(BOOL)arWorld VR:(BOOL)vrWorld {
     SCNAction *action = [SCNAction runBlock:^(SCNNode * _Nonnull node) {
         RobotMeshControllerComponent * geometry = (RobotMeshControllerComponent *)[ComponentUtils getComponentFromEntity:self.entity ofClass:[RobotMeshControllerComponent class]];
-        [geometry.node setRenderingOrderRecursively:(vrWorld ? VR_WORLD_RENDERING_ORDER + 1000 : 0)];
+        [geometry.nodeSet setValue:NodeSetInteger(vrWorld ? VR_WORLD_RENDERING_ORDER + 1000 : 0) forProperty:NodeSetPropertyRenderingOrder];
     }];
 
     [self appendAction:action];
@@ -9,6 +9,7 @@
 #import "../Utils/ComponentUtils.h"
 #import "../Utils/Math.h"
 #import "../Utils/SceneKitExtensions.h"
+#import "../Utils/FlipbookAtlas.h"
 #import "AnimationComponent.h"
 #import "MoveRobotEventComponent.h"
 #import "SelectableModelComponent.h"
@@ -35,6 +36,12 @@
 
 #define ROBOT_BOX_ANIMATION_KEY @"RobotMeshControllerComponent.Box"
 
+// Vemoji texture atlases, the face images and the body door status images.
+#define ROBOT_VEMOJI_ATLAS @"RobotMeshControllerComponent.Vemoji"
+#define ROBOT_VEMOJI_PREFIXES @[@"Vemoji"]
+#define ROBOT_BODY_EMOJI_ATLAS @"RobotMeshControllerComponent.BodyEmoji"
+#define ROBOT_BODY_EMOJI_PREFIXES @[@"Status"]
+
 @interface RobotMeshControllerComponent ()
 
 @property (nonatomic) float time;
@@ -90,6 +97,11 @@
 @implementation RobotMeshControllerComponent
 {
     NSString* _vemojiFolderPath;
+
+    FlipbookAtlas *_vemojiAtlas;
+    FlipbookAtlas *_bodyEmojiAtlas;
+    SCNMaterial *_headEmojiMaterial;
+    SCNMaterial *_bodyEmojiMaterial;
 }
 
 @synthesize robotBoxUnfolded = _robotBoxUnfolded;
@@ -112,6 +124,10 @@
         
         _vemojiFolderPath = [SceneKit pathForResourceNamed:@"Textures/Vemoji"];
         be_assert (_vemojiFolderPath != nil, "Cannot find the Vemoji folder.");
+
+        // Pack the atlases in the background while the robot model loads.
+        [FlipbookAtlas prefetchAtlasNamed:ROBOT_VEMOJI_ATLAS folder:_vemojiFolderPath prefixes:ROBOT_VEMOJI_PREFIXES];
+        [FlipbookAtlas prefetchAtlasNamed:ROBOT_BODY_EMOJI_ATLAS folder:_vemojiFolderPath prefixes:ROBOT_BODY_EMOJI_PREFIXES];
     }
     return self;
 }
@@ -154,6 +170,8 @@
         [self setupRobotPhysics];
     }
     
+    [self setupEmojiMaterials];
+
     // default
     [self setBodyEmojiDiffuse:@"Status Battery2"];
     
@@ -161,14 +179,13 @@
     
     self.movementPeakVolume = 0.5;
     
-    dispatch_async(dispatch_get_main_queue(), ^{
-        // Init a default audio for movement.
-        // Special set-up happens in the setMovementAudio setter.
-        AudioNode *moveAudio = [[AudioEngine main] loadAudioNamed:@"Robot_IdleMovingLoop.caf"];
+    // Init a default audio for movement.
+    // Special set-up happens in the setMovementAudio setter.
+    [[AudioEngine main] loadAudioNamed:@"Robot_IdleMovingLoop.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *moveAudio) {
         moveAudio.looping = YES;
         moveAudio.volume = 0;
         [self setMovementAudio:moveAudio];
-    });
+    }];
 
     // Re-parent the head to a controllable node.
     self.headCtrl = [SCNNode node];
@@ -279,10 +296,7 @@
         self.robotBoxSelectable = [[SelectableModelComponent alloc] initWithMarkupName:@"RobotBox" withRadius:_robotBoxRadius];
         
         // Defer hooking up the component so we don't mutate the SceneManager entities while starting.
-        [[SceneManager main].mixedRealityMode runBlockInRenderThread:^(void) {
-            [[[SceneManager main] createEntity] addComponent:_robotBoxSelectable];
-            [_robotBoxSelectable start];
-        }];
+        [[RenderCommandQueue main] postAddComponentToNewEntity:_robotBoxSelectable];
 
         // Handle selecting the box, kick off the box unfolding sequence and remove the callback handler.
         _robotBoxSelectable.callbackBlock = ^{
@@ -295,9 +309,9 @@
             }
         };
 
-        dispatch_async(dispatch_get_main_queue(), ^{
-            self.robotBoxUnfoldingSound = [[AudioEngine main] loadAudioNamed:@"Robot_Unboxing.caf"];
-        });
+        [[AudioEngine main] loadAudioNamed:@"Robot_Unboxing.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+            self.robotBoxUnfoldingSound = audioNode;
+        }];
     } else {
         // Robot is already unfolded.
         _robotBoxUnfolded = YES; 
@@ -309,6 +323,9 @@
         
         [self loadIdleAnimation];
     }
+
+    // The head was re-parented and the box added, so whatever was captured is out of date.
+    [self refreshNodeSet];
     //  [SceneKit printSceneHierarchy:self.node];
 }
                                                   
@@ -320,6 +337,7 @@
     colliderNode.name = @"Robot Collider";
     colliderNode.physicsBody = [SCNPhysicsBody bodyWithType:SCNPhysicsBodyTypeKinematic shape:nil];
     [self.robotBodyNode addChildNode:colliderNode];
+    [self refreshNodeSet];
 }
                                                 
    
@@ -673,65 +691,56 @@ float angleDifference(float a, float b) {
 
 #pragma mark - Robot Material Assignments
 
-- (NSString*)vemojiFilePathFromName:(NSString*)vemojiName
-{
-    return [NSString stringWithFormat:@"%@/%@.png", _vemojiFolderPath, vemojiName];
-}
-
 /**
- * Set's the <nodeName>.geometry.<materialName>.diffuse to the <diffuseImage>
+ * Look up the emoji materials and atlases once.
+ * From then on, changing an image only writes a property's contentsTransform.
  */
--(void) setNodeNamed:(NSString*)nodeName materialNamed:(NSString*)materialName withDiffuseImageNamed:(NSString*)diffuseImageName {
-    
+- (void) setupEmojiMaterials {
+    _vemojiAtlas = [FlipbookAtlas atlasNamed:ROBOT_VEMOJI_ATLAS folder:_vemojiFolderPath prefixes:ROBOT_VEMOJI_PREFIXES];
+    _bodyEmojiAtlas = [FlipbookAtlas atlasNamed:ROBOT_BODY_EMOJI_ATLAS folder:_vemojiFolderPath prefixes:ROBOT_BODY_EMOJI_PREFIXES];
+
+    _headEmojiMaterial = [self materialNamed:@"EmojiPrimary_Material" onNodeNamed:@"Vemoji_Head_Mesh"];
+    _bodyEmojiMaterial = [self materialNamed:@"EmojiSecondary_Material" onNodeNamed:@"Body_Door_Mesh"];
+
+    // Re-apply anything set before the materials were ready.
+    NSString *headDiffuse = _headVemojiDiffuse, *headEmissive = _headVemojiEmissive, *bodyDiffuse = _bodyEmojiDiffuse;
+    _headVemojiDiffuse = _headVemojiEmissive = _bodyEmojiDiffuse = nil;
+    if( headDiffuse ) [self setHeadVemojiDiffuse:headDiffuse];
+    if( headEmissive ) [self setHeadVemojiEmissive:headEmissive];
+    if( bodyDiffuse ) [self setBodyEmojiDiffuse:bodyDiffuse];
+}
+
+- (SCNMaterial*) materialNamed:(NSString*)materialName onNodeNamed:(NSString*)nodeName {
     SCNNode *node = [self.node childNodeWithName:nodeName recursively:YES];
     if( node == nil ) {
-        NSLog(@"setNodeNamed:materialNamed:withDiffuseImageNamed: - Missing node: %@", nodeName);
-        return;
+        NSLog(@"RobotMeshControllerComponent: Missing node: %@", nodeName);
+        return nil;
     }
-    
+
     SCNMaterial *material = [node.geometry materialWithName:materialName];
     if( material == nil ) {
-        NSLog(@"setNodeNamed:materialNamed:withDiffuseImageNamed: - Missing material: %@", materialName);
-        return;
-    }
-    
-    NSString* resourcePath = [self vemojiFilePathFromName:diffuseImageName];
-    UIImage *image = [UIImage imageNamed:resourcePath];
-    if( image == nil ) {
-        NSLog(@"setNodeNamed:materialNamed:withDiffuseImageNamed: - Missing image: %@ (%@)", diffuseImageName, resourcePath);
-        return;
+        NSLog(@"RobotMeshControllerComponent: Missing material: %@", materialName);
     }
-    
-//    NSLog(@"Showing %@.%@, %@", nodeName, materialName, diffuseImageName );
-    material.diffuse.contents = image;
+    return material;
 }
 
 /**
- * Set's the <nodeName>.geometry.<materialName>.emissive to the <emissiveImage>
+ * Show the atlas frame named imageName through property.
+ * The property's own contents are kept until its first frame is shown.
  */
--(void) setNodeNamed:(NSString*)nodeName materialNamed:(NSString*)materialName withEmissiveImageNamed:(NSString*)emissiveImageName {
-    SCNNode *node = [self.node childNodeWithName:nodeName recursively:YES];
-    if( node == nil ) {
-        NSLog(@"setNodeNamed:materialNamed:withEmissiveImageNamed: - Missing node: %@", nodeName);
-        return;
-    }
-    
-    
-    SCNMaterial *material = [node.geometry materialWithName:materialName];
-    if( material == nil ) {
-        NSLog(@"setNodeNamed:materialNamed:withEmissiveImageNamed: - Missing material: %@", materialName);
-        return;
-    }
-    
-    NSString* resourcePath = [self vemojiFilePathFromName:emissiveImageName];
-    UIImage *image = [UIImage imageNamed:resourcePath];
-    if( image == nil ) {
-        NSLog(@"setNodeNamed:materialNamed:withEmissiveImageNamed: - Missing image: %@ (%@)", emissiveImageName, resourcePath );
+- (void) showFrameNamed:(NSString*)imageName ofAtlas:(FlipbookAtlas*)atlas onProperty:(SCNMaterialProperty*)property {
+    if( property == nil ) return;
+
+    NSInteger frame = [atlas frameForName:imageName];
+    if( frame == FLIPBOOK_FRAME_NONE ) {
+        NSLog(@"RobotMeshControllerComponent: Missing image: %@", imageName);
         return;
     }
 
-//    NSLog(@"Showing %@.%@, %@", nodeName, materialName, emissiveImageName );
-    material.emission.contents = image;
+    if( property.contents != atlas.image ) {
+        [atlas applyToMaterialProperty:property];
+    }
+    property.contentsTransform = [atlas contentsTransformForFrame:frame];
 }
 
 /**
@@ -742,7 +751,7 @@ float angleDifference(float a, float b) {
         return;
     
     _headVemojiDiffuse = vemoji;
-    [self setNodeNamed:@"Vemoji_Head_Mesh" materialNamed:@"EmojiPrimary_Material" withDiffuseImageNamed:vemoji];
+    [self showFrameNamed:vemoji ofAtlas:_vemojiAtlas onProperty:_headEmojiMaterial.diffuse];
 }
 
 /**
@@ -753,7 +762,7 @@ float angleDifference(float a, float b) {
         return;
     
     _headVemojiEmissive = vemoji;
-    [self setNodeNamed:@"Vemoji_Head_Mesh" materialNamed:@"EmojiPrimary_Material" withEmissiveImageNamed:vemoji];
+    [self showFrameNamed:vemoji ofAtlas:_vemojiAtlas onProperty:_headEmojiMaterial.emission];
 }
 
 /**
@@ -764,7 +773,7 @@ float angleDifference(float a, float b) {
         return;
     
     _bodyEmojiDiffuse = bodyEmoji;
-    [self setNodeNamed:@"Body_Door_Mesh" materialNamed:@"EmojiSecondary_Material" withDiffuseImageNamed:bodyEmoji];
+    [self showFrameNamed:bodyEmoji ofAtlas:_bodyEmojiAtlas onProperty:_bodyEmojiMaterial.diffuse];
 }
 
 /**
@@ -11,6 +11,7 @@
 /**
  * Calculate if robot can see the main camera,
  * or if the gaze is obscured by an obstacle.
+ * Obstacles are those of the LineOfSight's occlusion grid, tested once a frame.
  */
 @interface RobotSeesMeComponent : Component
 <
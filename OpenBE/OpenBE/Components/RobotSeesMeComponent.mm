@@ -12,48 +12,118 @@
 #import "../Utils/SceneKitTools.h"
 #import <GLKit/GLKit.h>
 
+// Further than any room, and bounded, so the SpatialIndex only looks at the cells in range.
+#define ROBOT_SEES_ME_GAZE_RANGE 20.f
+
 @implementation RobotSeesMeComponent
+{
+    __weak RobotMeshControllerComponent *_meshController;
+    SpatialHandle _sensorHandle;
+    LineOfSightQuery _sightQuery;           // Sensor to camera.
+    BOOL _hasSightQuery;
+}
 
 - (void) start {
     [super start];
 }
 
+- (void) dealloc {
+    [self releaseSensor];
+}
+
+- (void) willRemoveFromEntity {
+    [self releaseSensor];
+    [super willRemoveFromEntity];
+}
+
+/**
+ * Drop the sensor's sight line and index entry, on the render thread that resolves them.
+ * Safe from dealloc: only the values are captured.
+ */
+- (void) releaseSensor {
+    if( !_hasSightQuery ) return;
+    _hasSightQuery = NO;
+
+    LineOfSightQuery sightQuery = _sightQuery;
+    SpatialHandle sensorHandle = _sensorHandle;
+    [[RenderCommandQueue main] postBlock:^{
+        [[LineOfSight main] removeQuery:sightQuery];
+        [[SpatialIndex main] removeHandle:sensorHandle];
+    }];
+}
+
+/**
+ * Camera relative 45 degree gaze cone, evaluated by the SpatialIndex each frame.
+ */
++ (SpatialStandingQuery) cameraGazeQuery {
+    static SpatialStandingQuery cameraGazeQuery;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        SpatialQuery query = SpatialQueryCone(GLKVector3Make(0, 0, 0), GLKVector3Make(0, 0, -1), M_PI_4, ROBOT_SEES_ME_GAZE_RANGE);
+        query.cameraRelative = YES;
+        cameraGazeQuery = [[SpatialIndex main] addStandingQuery:query];
+    });
+    
+    return cameraGazeQuery;
+}
+
+/**
+ * Index the robot's sensor once, and have the LineOfSight resolve it to the camera every frame.
+ * The mesh controller finds the sensor in its own start, so this waits for it.
+ */
+- (BOOL) trackSensor {
+    SpatialIndex *spatialIndex = [SpatialIndex main];
+    if( _hasSightQuery && [spatialIndex nodeForHandle:_sensorHandle] != nil ) return YES;
+
+    if( _meshController == nil ) {
+        _meshController = (RobotMeshControllerComponent * )[ComponentUtils getComponentFromEntity:self.entity ofClass:[RobotMeshControllerComponent class]];
+    }
+
+    SCNNode *robotSensorNode = _meshController.sensorCtrl;
+    if( robotSensorNode == nil ) return NO;
+
+    _sensorHandle = [spatialIndex addNode:robotSensorNode radius:0];
+    if( _hasSightQuery ) {
+        [[LineOfSight main] setQuery:_sightQuery from:_sensorHandle to:LINE_OF_SIGHT_CAMERA];
+    } else {
+        _sightQuery = [[LineOfSight main] addQueryFrom:_sensorHandle to:LINE_OF_SIGHT_CAMERA];
+        _hasSightQuery = YES;
+    }
+    return YES;
+}
+
 - (void) updateWithDeltaTime:(NSTimeInterval)seconds {
     if( ![self isEnabled] ) return;
     
-    RobotMeshControllerComponent *meshControllerComponent = (RobotMeshControllerComponent * )[ComponentUtils getComponentFromEntity:self.entity ofClass:[RobotMeshControllerComponent class]];
-    SCNNode *robotSensorNode = meshControllerComponent.sensorCtrl;
-    
-    SCNNode *cameraNode = [Camera main].node;
-    if( cameraNode == nil ) {
+    if( [Camera main].node == nil || ![self trackSensor] ) {
         return;
     }
     
-    GLKVector3 from = SCNVector3ToGLKVector3([SceneKitTools getWorldPos:cameraNode]);
-    GLKVector3 fromFwd = SCNVector3ToGLKVector3([SceneKitTools getLookAtVectorOfNode:cameraNode]);
-    GLKVector3 to = SCNVector3ToGLKVector3([SceneKitTools getWorldPos:robotSensorNode]);
-    GLKVector3 toFwd = SCNVector3ToGLKVector3([SceneKitTools getLookAtVectorOfNode:robotSensorNode]);
+    SpatialIndex *spatialIndex = [SpatialIndex main];
 
     // Early orientation checks...
     
     // if camera gaze is within 45 degrees of line of sight of robot.
-    GLKVector3 fromAimAtTo = GLKVector3Normalize(GLKVector3Subtract(to, from));
-    if( GLKVector3DotProduct(fromFwd, fromAimAtTo) < cos(M_PI_4) ) {
+    if( ![spatialIndex handle:_sensorHandle matchesStandingQuery:[RobotSeesMeComponent cameraGazeQuery]] ) {
         self.mainCameraSeesRobot = NO;
         self.robotSeesMainCamera = NO;
         return;
-    } else {
-        self.mainCameraSeesRobot = YES;
     }
 
-    // if robot gaze is within 45 degrees of line of sight of camera.
-    GLKVector3 toAimAtFrom = GLKVector3Normalize(GLKVector3Subtract(from, to));
-    if( GLKVector3DotProduct(toFwd, toAimAtFrom) < cos(M_PI_4) ) {
+    // Nothing in the way, resolved with every other sight line this frame.
+    BOOL unobstructed = [[LineOfSight main] queryIsVisible:_sightQuery];
+    self.mainCameraSeesRobot = unobstructed;
+    if( !unobstructed ) {
         self.robotSeesMainCamera = NO;
         return;
     }
 
-    // TODO: Get gaze point-to-point testing working.... for now just see camera.
-    self.robotSeesMainCamera = YES;
+    GLKVector3 from = [Camera main].position;
+    GLKVector3 to = [spatialIndex positionForHandle:_sensorHandle];
+    GLKVector3 toFwd = SCNVector3ToGLKVector3([SceneKitTools getLookAtVectorOfNode:_meshController.sensorCtrl]);
+
+    // if robot gaze is within 45 degrees of line of sight of camera.
+    GLKVector3 toAimAtFrom = GLKVector3Normalize(GLKVector3Subtract(from, to));
+    self.robotSeesMainCamera = GLKVector3DotProduct(toFwd, toAimAtFrom) >= cos(M_PI_4);
 }
 @end
@@ -27,9 +27,9 @@
     self.scanTime = 0.f;
     self.scanRadius = 2.f;
     
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.scanSound = [[AudioEngine main] loadAudioNamed:@"Robot_ScanBeam.caf"];
-    });
+    [[AudioEngine main] loadAudioNamed:@"Robot_ScanBeam.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.scanSound = audioNode;
+    }];
 }
 
 - (void) updateWithDeltaTime:(NSTimeInterval)seconds {
@@ -24,6 +24,7 @@
 @property(nonatomic, strong) ButtonComponent *target;
 @property(nonatomic, readwrite) BOOL targetArmed;  // Target is active.
 @property(nonatomic, strong) SCNNode *targetSphere;
+@property(nonatomic) SpatialHandle spatialHandle;
 @end
 
 @implementation SelectableModelComponent
@@ -50,6 +51,9 @@
         [self.node setReadsFromDepthBufferRecursively:YES];
         self.node.name = @"Target";
 
+        // Proximity is checked in batch by the SpatialIndex, against the node's origin.
+        self.spatialHandle = [[SpatialIndex main] addNode:self.node radius:0];
+
         self.callbackBlock = nil;
     }
     
@@ -145,13 +149,29 @@
     }
 }
 
+/**
+ * Camera relative ground circle of SELECTABLE_PROXIMITY, shared by all selectables.
+ */
++ (SpatialStandingQuery) proximityQuery {
+    static SpatialStandingQuery proximityQuery;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        SpatialQuery query = SpatialQueryGroundCircle(GLKVector3Make(0, 0, 0), SELECTABLE_PROXIMITY);
+        query.cameraRelative = YES;
+        proximityQuery = [[SpatialIndex main] addStandingQuery:query];
+    });
+    
+    return proximityQuery;
+}
+
 - (void) updateTarget {
+    BOOL inProximity = [[SpatialIndex main] handle:_spatialHandle matchesStandingQuery:[SelectableModelComponent proximityQuery]];
     if( [[SceneManager main] isStereo] ) {
         // Use the Gaze to arm the target.
-        self.targetArmed = self.gazeActive && [self groundDistanceToCamera] < SELECTABLE_PROXIMITY;
+        self.targetArmed = self.gazeActive && inProximity;
     } else {
         // Mono, just use distance to target.
-        self.targetArmed = [self groundDistanceToCamera] < SELECTABLE_PROXIMITY;
+        self.targetArmed = inProximity;
     }
     
     // Match camera orientation.
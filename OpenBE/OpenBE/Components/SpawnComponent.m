@@ -8,6 +8,7 @@
 #import "SpawnComponent.h"
 #import "../Core/AudioEngine.h"
 #import "../Core/Core.h"
+#import "../Core/ObjectPool.h"
 @import GLKit;
 
 #import "PhysicsContactAudioComponent.h"
@@ -26,8 +27,8 @@
 #define SPAWN_COMPONENT_BOX_POOL_SIZE 64
 
 @interface SpawnComponent()
-@property (nonatomic, strong) NSMutableArray * boxPool;
-@property (nonatomic) int boxPoolIndex;
+@property (nonatomic, strong) ObjectPool<SCNNode *> * boxPool;
+@property (nonatomic) int furnitureIndex; // Next piece of furniture to place.
 
 @property (nonatomic, strong) AudioNode *spawnSound; // Plays when placing each piece of furniture.
 @property (nonatomic, strong) AudioNode *resetSound; // Plays when resetting to no furniture.
@@ -52,10 +53,12 @@
 - (void) start{
     [super start];
     
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.spawnSound = [[AudioEngine main] loadAudioNamed:@"BallToss.caf"];
-        self.resetSound = [[AudioEngine main] loadAudioNamed:@"BallReturn.caf"];
-    });
+    [[AudioEngine main] loadAudioNamed:@"BallToss.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.spawnSound = audioNode;
+    }];
+    [[AudioEngine main] loadAudioNamed:@"BallReturn.caf" priority:AssetPriorityVisibleSoon completion:^(AudioNode *audioNode) {
+        self.resetSound = audioNode;
+    }];
     
     self.furniture = [[NSMutableArray alloc] init];
     
@@ -126,6 +129,15 @@
         [_physicsContactAudio addNodeName:thing.name audioName:@"BallBounce.caf"];
         
         [[Scene main].rootNode addChildNode:thing];
+
+        // Track for proximity and audio culling queries.
+        SCNVector3 boundsCenter;
+        CGFloat boundsRadius = 0;
+        [thing getBoundingSphereCenter:&boundsCenter radius:&boundsRadius];
+        [[SpatialIndex main] addNode:thing radius:(float)boundsRadius];
+
+        // Parked while hidden, asleep when resting out of view.
+        [[PhysicsManager main] manageNode:thing];
     }
     
 
@@ -137,18 +149,27 @@
     // it's never been fixed.
     //
     // :(
-    
-    self.boxPool = [[NSMutableArray alloc] init];
+    //
+    // So the pool never grows, when it runs out the oldest box is taken back.
+    __weak SpawnComponent *weakSelf = self;
+    self.boxPool = [[ObjectPool alloc] initWithName:@"SpawnBoxes"
+                                           capacity:SPAWN_COMPONENT_BOX_POOL_SIZE
+                                             growth:ObjectPoolGrowthRecycle
+                                             create:^SCNNode *{
+        return [weakSelf addBlockToNode:[Scene main].rootNode];
+    } reset:^(SCNNode *box) {
+        box.hidden = YES;
+        box.physicsBody.velocity = SCNVector3Zero;
+        box.physicsBody.angularVelocity = SCNVector4Zero;
+        [box.physicsBody clearAllForces];
+        [box.physicsBody resetTransform];
 
+        // Pooled boxes stay in the world, but out of the simulation.
+        [[PhysicsManager main] parkNode:box];
+    }];
+    [self.boxPool prewarm];
 
-    for( int i=0; i<SPAWN_COMPONENT_BOX_POOL_SIZE; i++) {
-        SCNNode * box = [self addBlockToNode:[Scene main].rootNode];
-        box.hidden = YES;
-        
-        [self.boxPool addObject:box];
-    }
-    
-    self.boxPoolIndex = 0;
+    self.furnitureIndex = 0;
 }
 
 - (bool) touchBeganButton:(uint8_t)button forward:(GLKVector3)touchForward hit:(SCNHitTestResult *) hit {
@@ -171,10 +192,10 @@
 
 - (BOOL) placeObject:(SCNHitTestResult *) hit  {
     
-    if( self.boxPoolIndex < [self.furniture count]){
+    if( self.furnitureIndex < [self.furniture count]){
         [_spawnSound play];
         
-        SCNNode *node = [self.furniture objectAtIndex:self.boxPoolIndex];
+        SCNNode *node = [self.furniture objectAtIndex:self.furnitureIndex];
         node.hidden = NO;
         
         SCNVector3 hitPosition = hit.worldCoordinates;
@@ -198,10 +219,10 @@
         [node.physicsBody clearAllForces];
         
         [self.robotBehaviourComponent startLookAtNode:node];
-        self.boxPoolIndex ++;
+        self.furnitureIndex ++;
     } else {
         [_resetSound play];
-        self.boxPoolIndex = 0;
+        self.furnitureIndex = 0;
         for (int i =0; i < [self.furniture count]; i++ ) {
             SCNNode *thing = [self.furniture objectAtIndex:i];
             thing.hidden = YES;
@@ -209,7 +230,7 @@
             [thing.physicsBody clearAllForces];
         }
     }
-    return self.boxPoolIndex > 0;
+    return self.furnitureIndex > 0;
 }
 
 - (void) placeNode:(SCNNode*)node forward:(GLKVector3)forward hit:(SCNHitTestResult *) hit {
@@ -254,17 +275,10 @@
 
 - (SCNNode *)spawnBoxFromPool
 {
-    SCNNode * node = (SCNNode *)[self.boxPool objectAtIndex:self.boxPoolIndex];
-    
+    // Boxes come back from the pool reset, still hidden.
+    SCNNode * node = [self.boxPool acquire];
     node.hidden = NO;
-    
-    node.physicsBody.velocity = SCNVector3Zero;
-    node.physicsBody.angularVelocity = SCNVector4Zero;
-    
-    [node.physicsBody clearAllForces];
-    [node.physicsBody resetTransform];
-    
-    self.boxPoolIndex = (self.boxPoolIndex + 1) % SPAWN_COMPONENT_BOX_POOL_SIZE;
+    [[PhysicsManager main] wakeNode:node];
     
     return node;
 }
@@ -296,6 +310,8 @@
     
     //add to the scene
     [rootNode addChildNode:block];
+    [[SpatialIndex main] addNode:block radius:0.075f * 0.5f * sqrtf(3.f)];
+    [[PhysicsManager main] manageNode:block];
     
     return block;
 }
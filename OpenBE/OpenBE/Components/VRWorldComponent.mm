@@ -22,9 +22,11 @@
 #import "PortalComponent.h"
 #import "../Utils/SceneKitTools.h"
 #import "../Utils/SceneKitExtensions.h"
+#import "../Utils/NodeSet.h"
 #import "../Utils/Math.h"
 #import "../Core/Core.h"
 #import "../Core/AudioEngine.h"
+#import "../Core/AssetStreamer.h"
 #import <GLKit/GLKit.h>
 
 #define VR_LIGHTS_MAX 3
@@ -41,6 +43,7 @@
 @interface VRWorldComponent()
 @property(nonatomic, strong) SCNNode *node;
 @property (nonatomic, strong) SCNNode *bookstoreNode;
+@property (nonatomic, strong) NodeSet *nodeSet;     // All of node, captured once it's loaded.
 #ifdef ENABLE_ROBOTROOM
 // ------ Robot Room Mode properties -----
 @property (nonatomic, strong) SCNNode *robotRoomNode;
@@ -64,8 +67,6 @@
 @property (nonatomic, strong) NSArray * displayCubes;
 @property (nonatomic) float displayTime;
 #endif
-
-@property (nonatomic) float lastGrayness;
 @end
 
 
@@ -77,7 +78,6 @@
 
 - (void) start{
     [super start];
-    self.lastGrayness = NSNotFound;
     
     self.node = [[SCNNode alloc] init];
     _node.position = SCNVector3Make(0, .01, 0); // Give a 1cm offset, so we don't get co-planar z-fighting between VR world and real world floor.
@@ -121,22 +121,28 @@
     
     SCNNode *SphereNode = [_robotRoomNode childNodeWithName:@"Sphere" recursively:YES];
     
-    //need to populate arrays.
-    [SphereNode.geometry.firstMaterial.reflective setContents:@[[SceneKit pathForImageResourceNamed:@"Space_right.jpg"],
-                                                                [SceneKit pathForImageResourceNamed:@"Space_left.jpg"],
-                                                                [SceneKit pathForImageResourceNamed:@"Space_up.jpg"],
-                                                                [SceneKit pathForImageResourceNamed:@"Space_down.jpg"],
-                                                                [SceneKit pathForImageResourceNamed:@"Space_back.jpg"],
-                                                                [SceneKit pathForImageResourceNamed:@"Space_front.jpg"]]];
+    // The cube map is only seen once the portal opens, decode it in the background.
+    NSMutableArray<AssetFuture *> *skyFaces = [NSMutableArray array];
+    for( NSString *face in @[@"Space_right.jpg", @"Space_left.jpg", @"Space_up.jpg", @"Space_down.jpg", @"Space_back.jpg", @"Space_front.jpg"] ) {
+        [skyFaces addObject:[[AssetStreamer main] requestImageNamed:face priority:AssetPriorityBackground]];
+    }
+    SCNMaterialProperty *reflective = SphereNode.geometry.firstMaterial.reflective;
+    [[AssetStreamer main] whenAllDone:skyFaces queue:dispatch_get_main_queue() completion:^(NSArray *images) {
+        if( images ) {
+            [reflective setContents:images];
+        }
+    }];
     
     _targetLightLevel = VR_LIGHT_LEVEL_OUTSIDE;
     [self setLightLevel:VR_LIGHT_LEVEL_OUTSIDE];
 
     
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.lightsOnAudio = [[AudioEngine main] loadAudioNamed:@"VRWorld_LightsOn.caf"];
-        self.openBayDoorsAudio = [[AudioEngine main] loadAudioNamed:@"VRWorld_BayDoorsOpening.caf"];
-    });
+    [[AudioEngine main] loadAudioNamed:@"VRWorld_LightsOn.caf" priority:AssetPriorityBackground completion:^(AudioNode *audioNode) {
+        self.lightsOnAudio = audioNode;
+    }];
+    [[AudioEngine main] loadAudioNamed:@"VRWorld_BayDoorsOpening.caf" priority:AssetPriorityBackground completion:^(AudioNode *audioNode) {
+        self.openBayDoorsAudio = audioNode;
+    }];
 // ------ /Robot Room ----
 #endif
     
@@ -144,18 +150,39 @@
     self.bookstoreNode = [SCNNode firstNodeFromSceneNamed:@"bookstore.dae"];
     [_node addChildNode:_bookstoreNode];
     [_node setRenderingOrderRecursively:VR_WORLD_RENDERING_ORDER];
-    [_node setCastsShadowRecursively:NO];
+    // Starts hidden, its shadows can wait a few frames.
+    self.nodeSet = [NodeSet nodeSetWithRoot:_node];
+    [_nodeSet deferValue:NodeSetInteger(NO) forProperty:NodeSetPropertyCastsShadow];
     
     [[Scene main].rootNode addChildNode:_node];
     
-    // this is for greying out the VR world as tracking feedback
+    // Tag the materials with the shared parameters they read, once. Setting them then costs the same whatever the scene.
+    // Grayness is for greying out the VR world as tracking feedback, light level for the lights coming on.
     [self.node enumerateChildNodesUsingBlock:^(SCNNode * _Nonnull child, BOOL * _Nonnull stop) {
         for( SCNMaterial * material in child.geometry.materials ) {
-            material.shaderModifiers = @{ SCNShaderModifierEntryPointFragment :
+            MaterialParameterMask parameters = MaterialParameterMaskGrayness;
+            NSMutableDictionary *modifiers = [NSMutableDictionary dictionary];
+            modifiers[SCNShaderModifierEntryPointFragment] =
                @"uniform float grayAmount;\n"
                "#pragma body\n"
                "vec3 grayColor = vec3(dot(_output.color.rgb, vec3(0.2989, 0.5870, 0.1140)));\n"
-               "_output.color.rgb = (1.0 - grayAmount) * _output.color.rgb + grayAmount * grayColor;\n "};
+               "_output.color.rgb = (1.0 - grayAmount) * _output.color.rgb + grayAmount * grayColor;\n ";
+
+#ifdef ENABLE_ROBOTROOM
+            if( [material.name containsString:@"Default"] || [material.name isEqualToString:@"PrimaryTrim"] ) {
+                material.lightingModelName = SCNLightingModelConstant;
+                modifiers[SCNShaderModifierEntryPointSurface] =
+                   @"uniform float lightLevel;\n"
+                   "#pragma body\n"
+                   "_surface.diffuse.rgb *= lightLevel;\n";
+                parameters |= MaterialParameterMaskLightLevel;
+            }
+#endif
+            material.shaderModifiers = modifiers;
+            [[MaterialParameters main] addMaterial:material parameters:parameters];
+
+            // With Metal, the VR world is clipped to the portals here rather than by the stencil.
+            [[PortalRenderer main] clipMaterial:material];
         };
     }];
     
@@ -278,14 +305,7 @@
     }
     grayness = fmaxf(fminf(grayness, 1.0), 0.0);
     
-    if (self.lastGrayness != grayness) {
-        self.lastGrayness = grayness;
-        [self.node enumerateChildNodesUsingBlock:^(SCNNode * _Nonnull child, BOOL * _Nonnull stop) {
-            for( SCNMaterial * material in child.geometry.materials ) {
-                [material setValue: @(grayness) forKeyPath:@"grayAmount"];
-            };
-        }];
-    }
+    [[MaterialParameters main] setFloat:grayness forParameter:MaterialParameterGrayness];
 }
 
 #ifdef ENABLE_ROBOTROOM
@@ -315,14 +335,8 @@
     self.currentLightLevel = lightLevel;
     be_dbg("Light level: %.2f", lightLevel);
     
-    [self.node enumerateChildNodesUsingBlock:^(SCNNode * _Nonnull child, BOOL * _Nonnull stop) {
-        for( SCNMaterial * material in child.geometry.materials ) {
-            if( [material.name containsString:@"Default"] || [material.name isEqualToString:@"PrimaryTrim"] ) {
-                material.lightingModelName = SCNLightingModelConstant;
-                material.diffuse.intensity = lightLevel;
-            }
-        }
-    }];
+    // Read by the materials tagged in start.
+    [[MaterialParameters main] setFloat:lightLevel forParameter:MaterialParameterLightLevel];
 }
 
 - (void) setBayDoors:(float)open {
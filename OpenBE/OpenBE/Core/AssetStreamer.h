@@ -0,0 +1,117 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  One place to load assets off the main and render threads.
+//
+//  Requests go to a small worker pool and are served by priority: blocking
+//  first, then visible-soon, then background. Asking for a key that's already
+//  in flight returns the same AssetFuture, raising its priority if needed.
+//  A future can be waited on, which runs a still queued load on the calling
+//  thread, or observed with callbacks delivered on a chosen queue.
+//
+
+#import <Foundation/Foundation.h>
+#import <SceneKit/SceneKit.h>
+#import <UIKit/UIKit.h>
+
+typedef NS_ENUM(NSInteger, AssetPriority) {
+    AssetPriorityBlocking = 0,      // Needed now, the caller is going to wait.
+    AssetPriorityVisibleSoon,       // On screen within a few frames.
+    AssetPriorityBackground,        // Prefetch, whenever workers are free.
+    AssetPriorityCount
+};
+
+/// Domain of the errors the built-in loaders report, code is always 0.
+FOUNDATION_EXPORT NSString * const AssetStreamerErrorDomain;
+
+/// Runs on a worker. Return nil and set error on failure.
+typedef id (^AssetLoader)(NSError **error);
+
+typedef struct {
+    NSUInteger requested;           // Calls to requestAssetForKey:, including duplicates.
+    NSUInteger deduplicated;        // Served by a request already in flight.
+    NSUInteger loaded;
+    NSUInteger failed;
+    NSUInteger waitedInline;        // Loads run by wait on the waiting thread.
+    NSUInteger pending[AssetPriorityCount];
+    double loadMs;                  // Total time in loaders.
+} AssetStreamerStats;
+
+@interface AssetFuture : NSObject
+
+@property (nonatomic, readonly) NSString *key;
+@property (nonatomic, readonly) AssetPriority priority;
+
+/// THREAD SAFE
+@property (nonatomic, readonly, getter=isDone) BOOL done;
+
+/// nil until done, and on failure.
+@property (nonatomic, readonly) id asset;
+@property (nonatomic, readonly) NSError *error;
+
+/**
+ * Block until loaded. If no worker has picked the load up yet, it runs on this thread.
+ * Don't call from a loader.
+ * @return The asset, nil on failure.
+ */
+- (id) wait;
+
+/**
+ * Call completion on queue once loaded, right away if it already is.
+ * THREAD SAFE
+ */
+- (void) whenDone:(void (^)(id asset, NSError *error))completion queue:(dispatch_queue_t)queue;
+
+/// whenDone: on the main queue.
+- (void) whenDoneOnMain:(void (^)(id asset, NSError *error))completion;
+
+@end
+
+@interface AssetStreamer : NSObject
+
+/// Singleton.
++ (AssetStreamer *) main;
+
+/// Workers loading at once. Defaults to one less than the active cores, at most 3.
+@property (nonatomic) NSUInteger maxWorkers;
+
+/**
+ * Load the asset for key with loader, unless it's already in flight.
+ * Futures aren't kept once done, the loaded asset's own cache is what makes a second request cheap.
+ * THREAD SAFE
+ */
+- (AssetFuture *) requestAssetForKey:(NSString *)key priority:(AssetPriority)priority loader:(AssetLoader)loader;
+
+/**
+ * UIImage decoded on the worker, so setting it as material contents doesn't decode on the render thread.
+ * Name is resolved with pathForImageResourceNamed:.
+ */
+- (AssetFuture *) requestImageNamed:(NSString *)name priority:(AssetPriority)priority;
+
+/// SCNScene loaded with sceneInFrameworkOrAppNamed:.
+- (AssetFuture *) requestSceneNamed:(NSString *)name priority:(AssetPriority)priority;
+
+/**
+ * Sound decoded into the AudioAssetManager cache, or its path if it's long enough to stream.
+ * Complete with AudioEngine loadAudioNamed: on the main queue, it then finds the buffer ready.
+ */
+- (AssetFuture *) requestSoundNamed:(NSString *)name priority:(AssetPriority)priority;
+
+/**
+ * Call completion on queue once all futures are done, with their assets in the same order.
+ * assets is nil if any failed.
+ * THREAD SAFE
+ */
+- (void) whenAllDone:(NSArray<AssetFuture *> *)futures queue:(dispatch_queue_t)queue completion:(void (^)(NSArray *assets))completion;
+
+/// THREAD SAFE
+- (AssetStreamerStats) stats;
+
+@end
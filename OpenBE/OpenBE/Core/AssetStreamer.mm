@@ -0,0 +1,420 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "AssetStreamer.h"
+#import "AudioAssetManager.h"
+#import "../Utils/SceneKitExtensions.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <mutex>
+
+// Upper bound on the default worker count, loads are mostly I/O and decode bound.
+#define ASSET_STREAMER_MAX_DEFAULT_WORKERS 3
+
+NSString * const AssetStreamerErrorDomain = @"AssetStreamerErrorDomain";
+
+namespace {
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    NSError * assetError( NSString *format, NSString *name ) {
+        NSString *description = [NSString stringWithFormat:format, name];
+        return [NSError errorWithDomain:AssetStreamerErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey:description}];
+    }
+
+    /// Draw into a bitmap so the pixels are decoded here, not when SceneKit first uploads them.
+    UIImage * decodedImage( UIImage *image ) {
+        CGImageRef source = image.CGImage;
+        if( source == NULL ) return image;
+
+        size_t width = CGImageGetWidth(source);
+        size_t height = CGImageGetHeight(source);
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+        CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, width * 4, colorSpace, kCGImageAlphaPremultipliedLast);
+        CGColorSpaceRelease(colorSpace);
+        if( context == NULL ) return image;
+
+        CGContextDrawImage(context, CGRectMake(0, 0, width, height), source);
+        CGImageRef decoded = CGBitmapContextCreateImage(context);
+        CGContextRelease(context);
+
+        UIImage *result = [UIImage imageWithCGImage:decoded scale:image.scale orientation:image.imageOrientation];
+        CGImageRelease(decoded);
+        return result;
+    }
+
+} // anonymous
+
+#pragma mark - AssetFuture
+
+@interface AssetFuture ()
+- (instancetype) initWithKey:(NSString *)key priority:(AssetPriority)priority loader:(AssetLoader)loader streamer:(AssetStreamer *)streamer;
+@end
+
+@interface AssetStreamer ()
+- (std::mutex &) mutex;
+- (AssetLoader) takeLoaderOfFuture:(AssetFuture *)future;
+- (void) runLoader:(AssetLoader)loader forFuture:(AssetFuture *)future;
+@end
+
+@interface AssetCallback : NSObject
+@property (nonatomic, copy) void (^completion)(id asset, NSError *error);
+@property (nonatomic, strong) dispatch_queue_t queue;
+@end
+
+@implementation AssetCallback
+@end
+
+@implementation AssetFuture
+{
+@public
+    AssetStreamer *_streamer;           // Never reassigned. The streamer only keeps futures in flight, so no cycle outlives a load.
+    dispatch_group_t _group;            // Entered until done.
+
+    // Guarded by the streamer's mutex.
+    AssetLoader _loader;                // nil once a worker or waiter took it.
+    NSMutableArray<AssetCallback *> *_callbacks;
+    AssetPriority _priority;
+    id _asset;
+    NSError *_error;
+    BOOL _done;
+}
+
+- (instancetype) initWithKey:(NSString *)key priority:(AssetPriority)priority loader:(AssetLoader)loader streamer:(AssetStreamer *)streamer {
+    self = [super init];
+    if( self ) {
+        _key = [key copy];
+        _priority = priority;
+        _loader = [loader copy];
+        _streamer = streamer;
+        _callbacks = [NSMutableArray array];
+        _group = dispatch_group_create();
+        dispatch_group_enter(_group);
+    }
+    return self;
+}
+
+- (AssetPriority) priority {
+    std::lock_guard<std::mutex> lock([_streamer mutex]);
+    return _priority;
+}
+
+- (BOOL) isDone {
+    std::lock_guard<std::mutex> lock([_streamer mutex]);
+    return _done;
+}
+
+- (id) asset {
+    std::lock_guard<std::mutex> lock([_streamer mutex]);
+    return _asset;
+}
+
+- (NSError *) error {
+    std::lock_guard<std::mutex> lock([_streamer mutex]);
+    return _error;
+}
+
+- (id) wait {
+    // Rather than wait behind the queue, load it here.
+    AssetStreamer *streamer = _streamer;
+    AssetLoader loader = [streamer takeLoaderOfFuture:self];
+    if( loader ) {
+        [streamer runLoader:loader forFuture:self];
+    }
+
+    dispatch_group_wait(_group, DISPATCH_TIME_FOREVER);
+    return self.asset;
+}
+
+- (void) whenDone:(void (^)(id asset, NSError *error))completion queue:(dispatch_queue_t)queue {
+    be_assert(completion && queue);
+
+    id asset;
+    NSError *error;
+    {
+        std::lock_guard<std::mutex> lock([_streamer mutex]);
+        if( !_done ) {
+            AssetCallback *callback = [[AssetCallback alloc] init];
+            callback.completion = completion;
+            callback.queue = queue;
+            [_callbacks addObject:callback];
+            return;
+        }
+        asset = _asset;
+        error = _error;
+    }
+
+    dispatch_async(queue, ^{
+        completion(asset, error);
+    });
+}
+
+- (void) whenDoneOnMain:(void (^)(id asset, NSError *error))completion {
+    [self whenDone:completion queue:dispatch_get_main_queue()];
+}
+
+@end
+
+#pragma mark - AssetStreamer
+
+@implementation AssetStreamer
+{
+    std::mutex _mutex;
+
+    // Guarded by _mutex.
+    NSMutableDictionary<NSString *, AssetFuture *> *_inFlight;
+    NSMutableArray<AssetFuture *> *_pending[AssetPriorityCount];    // FIFO per priority.
+    NSUInteger _activeWorkers;
+    AssetStreamerStats _stats;
+}
+
++ (AssetStreamer *) main {
+    static AssetStreamer *mainStreamer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainStreamer = [[AssetStreamer alloc] init];
+    });
+
+    return mainStreamer;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _inFlight = [NSMutableDictionary dictionary];
+        for( int p=0; p<AssetPriorityCount; p++ ) {
+            _pending[p] = [NSMutableArray array];
+        }
+
+        NSUInteger cores = [NSProcessInfo processInfo].activeProcessorCount;
+        _maxWorkers = MIN((NSUInteger)ASSET_STREAMER_MAX_DEFAULT_WORKERS, MAX((NSUInteger)1, cores - 1));
+        _stats = AssetStreamerStats();
+    }
+    return self;
+}
+
+- (std::mutex &) mutex {
+    return _mutex;
+}
+
+- (AssetFuture *) requestAssetForKey:(NSString *)key priority:(AssetPriority)priority loader:(AssetLoader)loader {
+    be_assert(key && loader);
+    be_assert(priority >= AssetPriorityBlocking && priority < AssetPriorityCount);
+
+    AssetFuture *future;
+    BOOL spawnWorker = NO;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.requested++;
+
+        future = _inFlight[key];
+        if( future ) {
+            _stats.deduplicated++;
+
+            // Move a queued load up, one that's already running can't go any faster.
+            if( priority < future->_priority ) {
+                if( future->_loader ) {
+                    [_pending[future->_priority] removeObjectIdenticalTo:future];
+                    [_pending[priority] addObject:future];
+                }
+                future->_priority = priority;
+            }
+            return future;
+        }
+
+        future = [[AssetFuture alloc] initWithKey:key priority:priority loader:loader streamer:self];
+        _inFlight[key] = future;
+        [_pending[priority] addObject:future];
+
+        if( _activeWorkers < _maxWorkers ) {
+            _activeWorkers++;
+            spawnWorker = YES;
+        }
+    }
+
+    if( spawnWorker ) {
+        qos_class_t qos = priority == AssetPriorityBlocking ? QOS_CLASS_USER_INITIATED : QOS_CLASS_UTILITY;
+        dispatch_async(dispatch_get_global_queue(qos, 0), ^{
+            [self workerLoop];
+        });
+    }
+
+    return future;
+}
+
+/**
+ * Take queued loads, highest priority first, until none are left.
+ */
+- (void) workerLoop {
+    for( ;; ) {
+        AssetFuture *future = nil;
+        AssetLoader loader = nil;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for( int p=0; p<AssetPriorityCount && future == nil; p++ ) {
+                if( _pending[p].count ) {
+                    future = _pending[p].firstObject;
+                    [_pending[p] removeObjectAtIndex:0];
+                }
+            }
+
+            if( future == nil ) {
+                _activeWorkers--;
+                return;
+            }
+
+            loader = future->_loader;
+            future->_loader = nil;
+        }
+
+        [self runLoader:loader forFuture:future];
+    }
+}
+
+- (AssetLoader) takeLoaderOfFuture:(AssetFuture *)future {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    AssetLoader loader = future->_loader;
+    if( loader ) {
+        [_pending[future->_priority] removeObjectIdenticalTo:future];
+        future->_loader = nil;
+        _stats.waitedInline++;
+    }
+    return loader;
+}
+
+- (void) runLoader:(AssetLoader)loader forFuture:(AssetFuture *)future {
+    uint64_t start = mach_absolute_time();
+
+    id asset = nil;
+    NSError *error = nil;
+    @autoreleasepool {
+        NSError *loaderError = nil;
+        asset = loader(&loaderError);
+        error = loaderError;
+    }
+    if( asset == nil && error == nil ) {
+        error = assetError(@"Nothing loaded for %@", future.key);
+    }
+
+    double ms = machTicksToMs(mach_absolute_time() - start);
+
+    NSArray<AssetCallback *> *callbacks;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        future->_asset = asset;
+        future->_error = asset ? nil : error;
+        future->_done = YES;
+        callbacks = future->_callbacks;
+        future->_callbacks = nil;
+
+        if( _inFlight[future.key] == future ) {
+            [_inFlight removeObjectForKey:future.key];
+        }
+
+        if( asset ) _stats.loaded++;
+        else _stats.failed++;
+        _stats.loadMs += ms;
+    }
+
+    if( asset == nil ) {
+        NSLog(@"AssetStreamer: === Error === Failed to load %@: %@", future.key, error.localizedDescription);
+    } else {
+        error = nil;
+    }
+
+    dispatch_group_leave(future->_group);
+
+    for( AssetCallback *callback in callbacks ) {
+        void (^completion)(id, NSError *) = callback.completion;
+        dispatch_async(callback.queue, ^{
+            completion(asset, error);
+        });
+    }
+}
+
+- (void) whenAllDone:(NSArray<AssetFuture *> *)futures queue:(dispatch_queue_t)queue completion:(void (^)(NSArray *assets))completion {
+    be_assert(completion && queue);
+
+    dispatch_group_t group = dispatch_group_create();
+    for( AssetFuture *future in futures ) {
+        dispatch_group_enter(group);
+        [future whenDone:^(id asset, NSError *error) {
+            dispatch_group_leave(group);
+        } queue:dispatch_get_global_queue(QOS_CLASS_UTILITY, 0)];
+    }
+
+    dispatch_group_notify(group, queue, ^{
+        NSMutableArray *assets = [NSMutableArray arrayWithCapacity:futures.count];
+        for( AssetFuture *future in futures ) {
+            id asset = future.asset;
+            if( asset == nil ) {
+                completion(nil);
+                return;
+            }
+            [assets addObject:asset];
+        }
+        completion(assets);
+    });
+}
+
+- (AssetStreamerStats) stats {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    AssetStreamerStats stats = _stats;
+    for( int p=0; p<AssetPriorityCount; p++ ) {
+        stats.pending[p] = _pending[p].count;
+    }
+    return stats;
+}
+
+#pragma mark - Loaders
+
+- (AssetFuture *) requestImageNamed:(NSString *)name priority:(AssetPriority)priority {
+    return [self requestAssetForKey:[@"image:" stringByAppendingString:name] priority:priority loader:^id(NSError **error) {
+        NSString *path = [SceneKit pathForImageResourceNamed:name];
+        UIImage *image = path ? [UIImage imageWithContentsOfFile:path] : nil;
+        if( image == nil ) {
+            *error = assetError(@"No image named %@", name);
+            return nil;
+        }
+        return decodedImage(image);
+    }];
+}
+
+- (AssetFuture *) requestSceneNamed:(NSString *)name priority:(AssetPriority)priority {
+    return [self requestAssetForKey:[@"scene:" stringByAppendingString:name] priority:priority loader:^id(NSError **error) {
+        SCNScene *scene = [SCNScene sceneInFrameworkOrAppNamed:name];
+        if( scene == nil ) {
+            *error = assetError(@"No scene named %@", name);
+        }
+        return scene;
+    }];
+}
+
+- (AssetFuture *) requestSoundNamed:(NSString *)name priority:(AssetPriority)priority {
+    return [self requestAssetForKey:[@"sound:" stringByAppendingString:name] priority:priority loader:^id(NSError **error) {
+        AudioAssetManager *manager = [AudioAssetManager main];
+
+        // Streamed sounds aren't decoded ahead, resolving the path is all there is to do.
+        id sound = [manager shouldStreamSoundNamed:name] ? [manager pathForSoundNamed:name] : [manager bufferForName:name];
+        if( sound == nil ) {
+            *error = assetError(@"No sound named %@", name);
+        }
+        return sound;
+    }];
+}
+
+@end
@@ -0,0 +1,123 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Audio asset manager, used by the AudioEngine to load sounds from
+//  <resources>/Sounds/<name>.
+//
+//  Decoded PCM is kept in an LRU cache under a byte budget. A sound bank can be
+//  prefetched in the background at scene start, so that components loading
+//  their sounds from init or start find them already decoded.
+//
+//  Clips longer than AUDIO_STREAM_MIN_SECONDS aren't decoded whole for
+//  AudioNodes; an AudioStream reads them from disk into two small buffers
+//  in turn while they play. Of the shipped sounds, that's Robot_ScanBeam
+//  and PowerPlug_PowerUp; the one-shots up to about 4 s are decoded.
+//
+//  Evicting a buffer only drops the cache's reference, buffers still held by
+//  an AudioNode or the voice pool stay alive until those let go.
+//
+
+#import <AVFoundation/AVFoundation.h>
+
+/// Clips longer than this are streamed by AudioNodes. Above the longest one-shots, which are decoded.
+#define AUDIO_STREAM_MIN_SECONDS 5.0
+
+/// Default decoded PCM budget.
+#define AUDIO_CACHE_DEFAULT_BUDGET_BYTES (24 * 1024 * 1024)
+
+typedef struct {
+    NSUInteger budgetBytes;
+    NSUInteger residentBytes;       // Decoded PCM in the cache.
+    NSUInteger peakResidentBytes;
+    NSUInteger cachedSounds;
+    NSUInteger activeStreams;
+    NSUInteger streamBytes;         // Buffers owned by active streams.
+    uint64_t hits;
+    uint64_t misses;                // Decoded on the asking thread.
+    uint64_t prefetched;            // Decoded in the background.
+    uint64_t evictions;
+    double decodeMs;                // Total time spent decoding.
+} AudioAssetStats;
+
+@class AudioStream;
+
+@interface AudioAssetManager : NSObject
+
+/// Singleton.
++ (AudioAssetManager *) main;
+
+/**
+ * Decoded PCM byte budget. Lowering it evicts least recently used sounds straight away.
+ * THREAD SAFE
+ */
+@property (nonatomic) NSUInteger budgetBytes;
+
+/// Full path of a sound. THREAD SAFE
+- (NSString *) pathForSoundNamed:(NSString *)name;
+
+/**
+ * Is the sound long enough to be streamed. Only reads the file header, once.
+ * THREAD SAFE
+ */
+- (BOOL) shouldStreamSoundNamed:(NSString *)name;
+
+/**
+ * Decoded sound, from the cache, or decoded on the calling thread.
+ * Waits on a background decode of the same sound rather than decoding it twice.
+ * THREAD SAFE
+ */
+- (AVAudioPCMBuffer *) bufferForName:(NSString *)name;
+
+/// Decoded sound if it's in the cache, nil otherwise. Never decodes. THREAD SAFE
+- (AVAudioPCMBuffer *) cachedBufferForName:(NSString *)name;
+
+/**
+ * Decode the named sounds in the background, skipping ones that will be streamed.
+ * completion, if any, is called on the main queue once they are all cached.
+ * THREAD SAFE
+ */
+- (void) prefetchSoundBank:(NSArray<NSString *> *)names completion:(void (^)(void))completion;
+
+/// Open a double-buffered disk stream on a sound. nil if the file can't be read. THREAD SAFE
+- (AudioStream *) streamForName:(NSString *)name;
+
+/// Snapshot of the counters. THREAD SAFE
+- (AudioAssetStats) stats;
+
+/// Human readable memory report, one line per cached sound. THREAD SAFE
+- (NSString *) memoryReport;
+
+@end
+
+/**
+ * Double-buffered disk stream, playing a file on an AVAudioPlayerNode.
+ * One buffer plays while the other is refilled on a background queue.
+ */
+@interface AudioStream : NSObject
+
+@property (nonatomic, readonly) NSString *name;
+@property (nonatomic, readonly) AVAudioFormat *format;
+@property (nonatomic, readonly) float duration;
+
+/**
+ * Prime both buffers and schedule them on player, from the start of the file.
+ * The caller still starts the player. completion is called when a
+ * non-looping stream has finished playing, on the stream's queue.
+ * THREAD SAFE
+ */
+- (void) scheduleOnPlayer:(AVAudioPlayerNode *)player looping:(BOOL)looping completion:(void (^)(void))completion;
+
+/**
+ * Stop refilling. Buffers already scheduled are cut by stopping the player.
+ * THREAD SAFE
+ */
+- (void) stop;
+
+@end
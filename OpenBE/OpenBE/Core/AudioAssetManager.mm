@@ -0,0 +1,440 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "AudioAssetManager.h"
+#import "../Utils/SceneKitExtensions.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <atomic>
+#include <mutex>
+
+// Length of each of a stream's two buffers.
+#define AUDIO_STREAM_CHUNK_SECONDS 0.5
+
+namespace {
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    NSUInteger bytesOfBuffer( AVAudioPCMBuffer *buffer ) {
+        const AudioStreamBasicDescription *description = buffer.format.streamDescription;
+        NSUInteger channels = buffer.format.isInterleaved ? 1 : buffer.format.channelCount;
+        return (NSUInteger)buffer.frameCapacity * description->mBytesPerFrame * channels;
+    }
+
+    std::atomic<NSUInteger> gActiveStreams(0);
+    std::atomic<NSUInteger> gStreamBytes(0);
+
+} // anonymous
+
+#pragma mark - Cache Entry
+
+@interface AudioAssetEntry : NSObject
+@property (nonatomic, strong) AVAudioPCMBuffer *buffer;
+@property (nonatomic) NSUInteger bytes;
+@end
+
+@implementation AudioAssetEntry
+@end
+
+#pragma mark - AudioStream
+
+@interface AudioStream ()
+- (instancetype) initWithName:(NSString *)name file:(AVAudioFile *)file queue:(dispatch_queue_t)queue;
+@end
+
+@implementation AudioStream
+{
+    AVAudioFile *_file;
+    AVAudioPCMBuffer *_buffers[2];
+    NSUInteger _bufferBytes;
+    dispatch_queue_t _queue;
+
+    // Only touched on _queue.
+    __weak AVAudioPlayerNode *_player;
+    BOOL _looping;
+    BOOL _reachedEnd;
+    int _pending;
+    void (^_completion)(void);
+
+    // Bumped by every schedule and stop, so stale refills are dropped.
+    std::atomic<uint32_t> _generation;
+}
+
+- (instancetype) initWithName:(NSString *)name file:(AVAudioFile *)file queue:(dispatch_queue_t)queue {
+    self = [super init];
+    if( self ) {
+        _name = name;
+        _file = file;
+        _format = file.processingFormat;
+        _duration = file.length / _format.sampleRate;
+        _queue = queue;
+        _generation.store(0, std::memory_order_relaxed);
+
+        AVAudioFrameCount chunkFrames = (AVAudioFrameCount)(AUDIO_STREAM_CHUNK_SECONDS * _format.sampleRate);
+        for( int i=0; i<2; i++ ) {
+            _buffers[i] = [[AVAudioPCMBuffer alloc] initWithPCMFormat:_format frameCapacity:chunkFrames];
+        }
+        _bufferBytes = bytesOfBuffer(_buffers[0]) * 2;
+
+        gActiveStreams.fetch_add(1, std::memory_order_relaxed);
+        gStreamBytes.fetch_add(_bufferBytes, std::memory_order_relaxed);
+    }
+    return self;
+}
+
+- (void) dealloc {
+    gActiveStreams.fetch_sub(1, std::memory_order_relaxed);
+    gStreamBytes.fetch_sub(_bufferBytes, std::memory_order_relaxed);
+}
+
+- (void) scheduleOnPlayer:(AVAudioPlayerNode *)player looping:(BOOL)looping completion:(void (^)(void))completion {
+    uint32_t generation = _generation.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    // Prime synchronously, so the player has audio as soon as it starts.
+    dispatch_sync(_queue, ^{
+        _player = player;
+        _looping = looping;
+        _reachedEnd = NO;
+        _pending = 0;
+        _completion = completion;
+        _file.framePosition = 0;
+
+        for( int i=0; i<2; i++ ) {
+            [self fillAndScheduleBuffer:i generation:generation];
+        }
+    });
+}
+
+- (void) stop {
+    _generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Read the next chunk into buffer index and schedule it. ON _queue ONLY.
+ */
+- (void) fillAndScheduleBuffer:(int)index generation:(uint32_t)generation {
+    if( generation != _generation.load(std::memory_order_relaxed) ) return;
+
+    AVAudioPlayerNode *player = _player;
+    if( player == nil ) return;
+
+    AVAudioPCMBuffer *buffer = _buffers[index];
+    buffer.frameLength = 0;
+    if( !_reachedEnd ) {
+        if( _looping && _file.framePosition >= _file.length ) {
+            _file.framePosition = 0;
+        }
+
+        NSError *error = nil;
+        if( _file.framePosition < _file.length && ![_file readIntoBuffer:buffer error:&error] ) {
+            NSLog(@"AudioStream: === Error === Read failed on %@: %@", _name, error.localizedDescription);
+        }
+
+        // The tail chunk of a loop plays short; scheduled buffers are gapless, so the next one picks up at 0.
+        if( !_looping && _file.framePosition >= _file.length ) {
+            _reachedEnd = YES;
+        }
+    }
+
+    if( buffer.frameLength == 0 ) {
+        [self finishIfDrained];
+        return;
+    }
+
+    _pending++;
+    __weak AudioStream *weakSelf = self;
+    dispatch_queue_t queue = _queue;
+    [player scheduleBuffer:buffer completionHandler:^{
+        dispatch_async(queue, ^{
+            AudioStream *strongSelf = weakSelf;
+            if( strongSelf == nil ) return;
+
+            // Buffers of an earlier schedule still complete after a stop, they aren't counted in _pending any more.
+            if( generation == strongSelf->_generation.load(std::memory_order_relaxed) ) {
+                strongSelf->_pending--;
+                [strongSelf fillAndScheduleBuffer:index generation:generation];
+            }
+        });
+    }];
+}
+
+- (void) finishIfDrained {
+    if( _reachedEnd && _pending == 0 && _completion ) {
+        void (^completion)(void) = _completion;
+        _completion = nil;
+        completion();
+    }
+}
+
+@end
+
+#pragma mark - AudioAssetManager
+
+@implementation AudioAssetManager
+{
+    std::mutex _mutex;
+
+    // Guarded by _mutex.
+    NSMutableDictionary<NSString *, AudioAssetEntry *> *_entries;
+    NSMutableOrderedSet<NSString *> *_lru;                  // Least recently used first.
+    NSMutableDictionary<NSString *, dispatch_group_t> *_inflight;
+    NSMutableDictionary<NSString *, NSNumber *> *_durations;
+    NSUInteger _budgetBytes;
+    NSUInteger _residentBytes;
+    NSUInteger _peakResidentBytes;
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _prefetched;
+    uint64_t _evictions;
+    uint64_t _decodeTicks;
+
+    dispatch_queue_t _prefetchQueue;
+    dispatch_queue_t _streamQueue;
+}
+
++ (AudioAssetManager *) main {
+    static AudioAssetManager *mainManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainManager = [[AudioAssetManager alloc] init];
+    });
+
+    return mainManager;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _entries = [[NSMutableDictionary alloc] init];
+        _lru = [[NSMutableOrderedSet alloc] init];
+        _inflight = [[NSMutableDictionary alloc] init];
+        _durations = [[NSMutableDictionary alloc] init];
+        _budgetBytes = AUDIO_CACHE_DEFAULT_BUDGET_BYTES;
+
+        _prefetchQueue = dispatch_queue_create("OpenBE.AudioAssetManager.prefetch", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+        _streamQueue = dispatch_queue_create("OpenBE.AudioAssetManager.stream", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INTERACTIVE, 0));
+    }
+    return self;
+}
+
+- (NSUInteger) budgetBytes {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _budgetBytes;
+}
+
+- (void) setBudgetBytes:(NSUInteger)budgetBytes {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budgetBytes = budgetBytes;
+    [self evictOverBudgetKeeping:nil];
+}
+
+- (NSString *) pathForSoundNamed:(NSString *)name {
+    return [SceneKit pathForResourceNamed:[@"Sounds" stringByAppendingPathComponent:name]];
+}
+
+- (BOOL) shouldStreamSoundNamed:(NSString *)name {
+    NSNumber *duration = nil;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        duration = _durations[name];
+    }
+
+    if( duration == nil ) {
+        NSString *soundPath = [self pathForSoundNamed:name];
+        if( soundPath == nil ) return NO;
+
+        AVAudioFile *file = [[AVAudioFile alloc] initForReading:[NSURL fileURLWithPath:soundPath] error:nil];
+        duration = @(file ? file.length / file.processingFormat.sampleRate : 0.0);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _durations[name] = duration;
+    }
+
+    return duration.doubleValue > AUDIO_STREAM_MIN_SECONDS;
+}
+
+#pragma mark - Cache
+
+/**
+ * Drop least recently used sounds until under budget. Call with _mutex held.
+ */
+- (void) evictOverBudgetKeeping:(NSString *)keep {
+    NSUInteger i = 0;
+    while( _residentBytes > _budgetBytes && i < _lru.count ) {
+        NSString *name = _lru[i];
+        if( [name isEqualToString:keep] ) {
+            i++;
+            continue;
+        }
+
+        _residentBytes -= _entries[name].bytes;
+        [_entries removeObjectForKey:name];
+        [_lru removeObjectAtIndex:i];
+        _evictions++;
+    }
+}
+
+- (AVAudioPCMBuffer *) cachedBufferForName:(NSString *)name {
+    std::lock_guard<std::mutex> lock(_mutex);
+    AudioAssetEntry *entry = _entries[name];
+    if( entry ) {
+        // Most recently used goes last.
+        [_lru removeObject:name];
+        [_lru addObject:name];
+    }
+    return entry.buffer;
+}
+
+- (AVAudioPCMBuffer *) decodeSoundNamed:(NSString *)name {
+    NSString *soundPath = [self pathForSoundNamed:name];
+    if( soundPath == nil ) return nil;
+
+    AVAudioFile *file = [[AVAudioFile alloc] initForReading:[NSURL fileURLWithPath:soundPath] error:nil];
+    if( file == nil ) return nil;
+
+    AVAudioPCMBuffer *buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:file.processingFormat frameCapacity:(AVAudioFrameCount)file.length];
+    NSError *error = nil;
+    if( ![file readIntoBuffer:buffer error:&error] ) {
+        NSLog(@"AudioAssetManager: === Error === Could not decode %@: %@", name, error.localizedDescription);
+        return nil;
+    }
+    return buffer;
+}
+
+/**
+ * Shared by bufferForName: and prefetch.
+ */
+- (AVAudioPCMBuffer *) bufferForName:(NSString *)name prefetch:(BOOL)prefetch {
+    for(;;) {
+        dispatch_group_t group = nil;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            AudioAssetEntry *entry = _entries[name];
+            if( entry ) {
+                [_lru removeObject:name];
+                [_lru addObject:name];
+                if( !prefetch ) _hits++;
+                return entry.buffer;
+            }
+
+            group = _inflight[name];
+            if( group == nil ) {
+                // We decode it.
+                group = dispatch_group_create();
+                dispatch_group_enter(group);
+                _inflight[name] = group;
+                lock.unlock();
+
+                uint64_t start = mach_absolute_time();
+                AVAudioPCMBuffer *buffer = [self decodeSoundNamed:name];
+                uint64_t ticks = mach_absolute_time() - start;
+
+                lock.lock();
+                [_inflight removeObjectForKey:name];
+                _decodeTicks += ticks;
+                if( prefetch ) _prefetched++; else _misses++;
+
+                if( buffer ) {
+                    AudioAssetEntry *newEntry = [[AudioAssetEntry alloc] init];
+                    newEntry.buffer = buffer;
+                    newEntry.bytes = bytesOfBuffer(buffer);
+                    _entries[name] = newEntry;
+                    [_lru addObject:name];
+                    _residentBytes += newEntry.bytes;
+                    _peakResidentBytes = MAX(_peakResidentBytes, _residentBytes);
+                    [self evictOverBudgetKeeping:name];
+                }
+                lock.unlock();
+
+                dispatch_group_leave(group);
+                return buffer;
+            }
+        }
+
+        // Someone else is decoding it, wait and look again.
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        if( prefetch ) return nil;
+    }
+}
+
+- (AVAudioPCMBuffer *) bufferForName:(NSString *)name {
+    return [self bufferForName:name prefetch:NO];
+}
+
+- (void) prefetchSoundBank:(NSArray<NSString *> *)names completion:(void (^)(void))completion {
+    NSArray<NSString *> *bank = [names copy];
+    dispatch_async(_prefetchQueue, ^{
+        for( NSString *name in bank ) {
+            if( [self shouldStreamSoundNamed:name] ) {
+                be_NSDbg(@"AudioAssetManager: Not prefetching %@, it's streamed", name);
+                continue;
+            }
+            [self bufferForName:name prefetch:YES];
+        }
+
+        if( completion ) {
+            dispatch_async(dispatch_get_main_queue(), completion);
+        }
+    });
+}
+
+- (AudioStream *) streamForName:(NSString *)name {
+    NSString *soundPath = [self pathForSoundNamed:name];
+    if( soundPath == nil ) return nil;
+
+    AVAudioFile *file = [[AVAudioFile alloc] initForReading:[NSURL fileURLWithPath:soundPath] error:nil];
+    if( file == nil ) return nil;
+
+    return [[AudioStream alloc] initWithName:name file:file queue:_streamQueue];
+}
+
+#pragma mark - Reporting
+
+- (AudioAssetStats) stats {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    AudioAssetStats stats = {};
+    stats.budgetBytes = _budgetBytes;
+    stats.residentBytes = _residentBytes;
+    stats.peakResidentBytes = _peakResidentBytes;
+    stats.cachedSounds = _entries.count;
+    stats.activeStreams = gActiveStreams.load(std::memory_order_relaxed);
+    stats.streamBytes = gStreamBytes.load(std::memory_order_relaxed);
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.prefetched = _prefetched;
+    stats.evictions = _evictions;
+    stats.decodeMs = machTicksToMs(_decodeTicks);
+    return stats;
+}
+
+- (NSString *) memoryReport {
+    AudioAssetStats stats = [self stats];
+
+    NSMutableString *report = [NSMutableString stringWithFormat:
+        @"Audio assets: %0.2f / %0.2f MB resident (peak %0.2f), %lu sounds, %lu streams (%0.2f MB)\n"
+         "  hits %llu, misses %llu, prefetched %llu, evictions %llu, decode %0.1f ms\n",
+        stats.residentBytes / 1048576.0, stats.budgetBytes / 1048576.0, stats.peakResidentBytes / 1048576.0,
+        (unsigned long)stats.cachedSounds, (unsigned long)stats.activeStreams, stats.streamBytes / 1048576.0,
+        stats.hits, stats.misses, stats.prefetched, stats.evictions, stats.decodeMs];
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for( NSString *name in _lru.reverseObjectEnumerator ) {
+        [report appendFormat:@"  %8.1f KB  %@\n", _entries[name].bytes / 1024.0, name];
+    }
+    return report;
+}
+
+@end
@@ -11,7 +11,11 @@
 #import <AVFoundation/AVFoundation.h>
 #import <JavascriptCore/JavascriptCore.h>
 
+#import "AudioVoicePool.h"
+#import "AssetStreamer.h"
+
 @class AudioNode;
+@class SpatialAudioMixerUnit;
 
 /**
  Audio Engine class built to render audio into the BridgeEngine scene environment.
@@ -29,17 +33,72 @@
 
 
 /**
- * Single shot audio playback at volume.
+ * One-shot voices, shared by all triggered sounds.
+ */
+@property (nonatomic, readonly) AudioVoicePool *voicePool;
+
+/**
+ * Optional portable software spatial mixer, rendering next to the environment node.
+ * nil until startSoftwareMixer has finished. Follows the listener like the environment.
+ */
+@property (nonatomic, readonly) SpatialAudioMixerUnit *softwareMixer;
+
+/**
+ * Attach a SpatialAudioMixerUnit to the engine, and play the voice pool's positional
+ * one-shots on it instead of the environment node. Head relative ones, from playAudio:atVolume:,
+ * stay on the pool's voices. Started at init when AUDIO_SOFTWARE_MIXER is set.
+ * The mixer is recreated, with the pool's sounds, if the engine restarts.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (void) startSoftwareMixer;
+
+/**
+ * Single shot audio playback at volume, not positional: the voice follows the listener.
+ * Plays on a pooled voice, so repeated calls overlap rather than cut each other off.
  * THREAD SAFE
  */
 - (void) playAudio:(NSString*)named atVolume:(float)volume;
 
+/**
+ * Load an audio file as a pooled one-shot sound.
+ * @param maxInstances How many copies of the sound may play at once.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (AudioSoundID) loadSoundNamed:(NSString*)named maxInstances:(NSUInteger)maxInstances priority:(AudioPriority)priority;
+
+/**
+ * Play a loaded sound once at a world position, on a pooled voice.
+ * Lock-free and allocation-free, safe to call from physics callbacks.
+ * THREAD SAFE
+ */
+- (BOOL) triggerSound:(AudioSoundID)sound atVolume:(float)volume position:(SCNVector3)position;
+
+/**
+ * Play a batch of loaded sounds, see AudioVoicePool triggerSounds:.
+ * @return How many were queued.
+ * THREAD SAFE
+ */
+- (NSUInteger) triggerSounds:(const AudioSoundID*)sounds atVolumes:(const float*)volumes positions:(const GLKVector3*)positions count:(NSUInteger)count;
+
+/**
+ * Start this frame's triggered sounds.
+ * RENDER THREAD ONLY - called once per frame by SceneManager.
+ */
+- (void) updateVoices;
+
 /**
  * Load an audio file and return an audio node.
  * RUN ON MAIN THREAD ONLY
  */
 - (AudioNode*) loadAudioNamed:(NSString*)name;
 
+/**
+ * Decode an audio file on an AssetStreamer worker, then make its node on the main thread.
+ * Completion gets nil if the file is missing.
+ * THREAD SAFE, completion runs on the main thread.
+ */
+- (void) loadAudioNamed:(NSString*)name priority:(AssetPriority)priority completion:(void (^)(AudioNode* audioNode))completion;
+
 /**
  * Take in the Camera node, and update the listener position and orientation.
  * THREAD SAFE
@@ -10,17 +10,31 @@
 
 #import "../Core/Core.h"
 #import "AudioEngine.h"
+#import "SpatialAudioMixerUnit.h"
+#import "AudioAssetManager.h"
 #import "../Utils/SceneKitExtensions.h"
 
+// One-shot voices in the pool.
+#define AUDIO_VOICE_COUNT 24
+
+// Instances of a sound started with playAudio:atVolume:
+#define AUDIO_PLAY_MAX_INSTANCES 4
+
+// Play positional one-shots through the portable SpatialAudioMixer instead of the environment node.
+#define AUDIO_SOFTWARE_MIXER 0
+
 #pragma mark - Internal Forward Declared Interfaces
 
 @interface AudioEngine () {
     NSMutableDictionary<NSString*,AudioNode*> *_nodeDictionary;
-    NSMutableDictionary<NSString*,AVAudioPCMBuffer*> *_bufferDictionary;
 }
 
 @property(nonatomic, strong) AVAudioEngine *engine;
 @property(nonatomic, strong) AVAudioEnvironmentNode *environment;
+@property(nonatomic, strong) AudioVoicePool *voicePool;
+@property(nonatomic) GLKVector3 listenerPosition;
+@property(nonatomic, strong) SpatialAudioMixerUnit *softwareMixer;
+@property(nonatomic) BOOL softwareMixerRequested;
 
 @property(nonatomic, strong) id<NSObject> observeAVEngineConfigurationChange;
 
@@ -34,9 +48,11 @@
 }
 
 @property(nonatomic, strong) AVAudioPCMBuffer *buffer;
+@property(nonatomic, strong) AudioStream *stream;
 @property(nonatomic, weak) AVAudioEngine *engine;
 
 - (instancetype)initWithName:(NSString*)name buffer:(AVAudioPCMBuffer*)buffer engine:(AVAudioEngine*)engine;
+- (instancetype)initWithName:(NSString*)name stream:(AudioStream*)stream engine:(AVAudioEngine*)engine;
 
 - (void) restorWithEngine:(AVAudioEngine*)engine;
 
@@ -63,12 +79,16 @@
 
         //store audioNodes to play in a dictionary
         _nodeDictionary = [[NSMutableDictionary alloc] init];
-        _bufferDictionary = [[NSMutableDictionary alloc] init];
+        _voicePool = [[AudioVoicePool alloc] initWithVoiceCount:AUDIO_VOICE_COUNT];
         
         // Set up the audio category so we always hear the sound.
         [[AVAudioSession sharedInstance] setCategory:AVAudioSessionCategoryPlayback error:nil];
 
         [self startEngine];
+
+#if AUDIO_SOFTWARE_MIXER
+        [self startSoftwareMixer];
+#endif
     }
     return self;
 }
@@ -121,6 +141,9 @@
     [_engine attachNode:_environment];
     [_engine connect:_environment to:[_engine mainMixerNode] format:nil];
 
+    // Pooled one-shot voices play through the environment.
+    [_voicePool attachToEngine:_engine environment:_environment];
+
     NSError *error = nil;
     BOOL audioStartResult = [_engine startAndReturnError:&error];
     if(audioStartResult == NO || error != nil) {
@@ -129,6 +152,15 @@
     } else {
         NSLog(@"Audio Engine Started OK");
     }
+
+    [_voicePool restart];
+
+    // Bring the software mixer over to the new engine.
+    if( _softwareMixerRequested ) {
+        _softwareMixer = nil;
+        [_voicePool playThroughSoftwareMixer:nil];
+        [self startSoftwareMixer];
+    }
         
     // Connect all of the players to the audio environment, and reset the rendering algorithm to match.
     for( NSString *nodeName in _nodeDictionary ) {
@@ -153,6 +185,22 @@
         AudioNode *node = _nodeDictionary[nodeName];
         [node restorWithEngine:_engine];
     }
+    [_voicePool restart];
+}
+
+- (void) startSoftwareMixer {
+    _softwareMixerRequested = YES;
+    if( _softwareMixer ) return;
+
+    __weak AudioEngine *weakSelf = self;
+    AVAudioEngine *engine = _engine;
+    [SpatialAudioMixerUnit attachToEngine:engine completion:^(SpatialAudioMixerUnit *mixerUnit) {
+        AudioEngine *strongSelf = weakSelf;
+        if( strongSelf && strongSelf.engine == engine ) {
+            strongSelf.softwareMixer = mixerUnit;
+            [strongSelf.voicePool playThroughSoftwareMixer:mixerUnit];
+        }
+    }];
 }
 
 
@@ -160,26 +208,7 @@
  * Load and cache sound buffers by name from <resources>/Sounds/<named>
  */
 - (AVAudioPCMBuffer*)bufferForName:(NSString*)named {
-    AVAudioPCMBuffer *aBuff = _bufferDictionary[named];
-    if(aBuff == nil ) {
-        // Attempt loading the audio subfolder.
-        NSString *soundPath = [SceneKit pathForResourceNamed:[@"Sounds" stringByAppendingPathComponent:named]];
-        NSURL *aURL = [NSURL fileURLWithPath:soundPath];
-        
-        AVAudioFile *aFile = [[AVAudioFile alloc] initForReading:aURL error:nil];
-        if( aFile == nil ) {
-            return nil;
-        }
-        
-        //read file to buffer
-        aBuff = [[AVAudioPCMBuffer alloc] initWithPCMFormat:[aFile processingFormat] frameCapacity:(unsigned int)[aFile length]];
-        [aFile readIntoBuffer:aBuff error:nil];
-        
-        // Keep buffers cached.
-        _bufferDictionary[named] = aBuff;
-    }
-    
-    return aBuff;
+    return [[AudioAssetManager main] bufferForName:named];
 }
 
 /**
@@ -200,46 +229,106 @@
  * Single shot audio playback at volume.
  */
 - (void) playAudio:(NSString*)named atVolume:(float)volume {
+    if( ![NSThread isMainThread] ) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self playAudio:named atVolume:volume];
+        });
+        return;
+    }
+
     //occasionally, this can get called if the audio engine is not running.
     if (![_engine isRunning]){
         NSLog(@"AudioEngine: AudioEngine not running, could not play audio: %@", named);
         return;
     }
     
-    AVAudioPCMBuffer  *buffer = [self bufferForName:named];
-    if( buffer==nil ) {
+    AudioSoundID sound = [self loadSoundNamed:named maxInstances:AUDIO_PLAY_MAX_INSTANCES priority:AudioPriorityHigh];
+    if( sound == AUDIO_SOUND_INVALID ) {
         NSLog(@"AudioEngine: Could not play, missing audio: %@", named);
         return;
     }
-    
-    AudioNode *node = [self nodeWithBuffer:buffer named:named];
 
-    //  Schedule the one-shot for immediate playback.
-    [node.player scheduleBuffer:buffer atTime:nil options:AVAudioPlayerNodeBufferInterrupts completionHandler:nil];
-    node.volume = volume;
-    [node play];
+    // Not positional, the voice stays on the listener until it's done.
+    [_voicePool triggerSoundHeadRelative:sound volume:volume];
+}
+
+/**
+ * Load an audio file as a pooled one-shot sound.
+ */
+- (AudioSoundID) loadSoundNamed:(NSString*)named maxInstances:(NSUInteger)maxInstances priority:(AudioPriority)priority {
+    AudioSoundID sound = [_voicePool soundIDForName:named];
+    if( sound != AUDIO_SOUND_INVALID ) {
+        return sound;
+    }
+
+    AVAudioPCMBuffer *buffer = [self bufferForName:named];
+    if( buffer == nil ) {
+        NSLog(@"AudioEngine: Could not load, missing audio: %@", named);
+        return AUDIO_SOUND_INVALID;
+    }
+
+    return [_voicePool addSoundNamed:named buffer:buffer maxInstances:maxInstances priority:priority];
+}
+
+/**
+ * Play a loaded sound once at a world position, on a pooled voice.
+ */
+- (BOOL) triggerSound:(AudioSoundID)sound atVolume:(float)volume position:(SCNVector3)position {
+    return [_voicePool triggerSound:sound volume:volume position:SCNVector3ToGLKVector3(position)];
+}
+
+- (NSUInteger) triggerSounds:(const AudioSoundID*)sounds atVolumes:(const float*)volumes positions:(const GLKVector3*)positions count:(NSUInteger)count {
+    return [_voicePool triggerSounds:sounds volumes:volumes positions:positions count:count];
+}
+
+- (void) updateVoices {
+    [_voicePool update];
 }
 
 /**
  * Load an audio file and return an audio node.
  */
 - (AudioNode*) loadAudioNamed:(NSString*)named {
+    AudioNode *audioNode = _nodeDictionary[named];
+    if( audioNode ) {
+        return audioNode;
+    }
+
+    // Long clips play from a disk stream instead of a fully decoded buffer.
+    if( [[AudioAssetManager main] shouldStreamSoundNamed:named] ) {
+        AudioStream *stream = [[AudioAssetManager main] streamForName:named];
+        if( stream ) {
+            audioNode = [[AudioNode alloc] initWithName:named stream:stream engine:_engine];
+            _nodeDictionary[named] = audioNode;
+            return audioNode;
+        }
+    }
+
     AVAudioPCMBuffer  *buffer = [self bufferForName:named];
     if( buffer==nil ) {
         NSLog(@"AudioEngine: Could not load, missing audio: %@", named);
         return nil;
     }
     
-    AudioNode *audioNode = [self nodeWithBuffer:buffer named:named];
+    audioNode = [self nodeWithBuffer:buffer named:named];
     return audioNode;
 }
 
+- (void) loadAudioNamed:(NSString*)name priority:(AssetPriority)priority completion:(void (^)(AudioNode* audioNode))completion {
+    // The worker leaves the decoded buffer in AudioAssetManager's cache, making the node is then cheap.
+    [[[AssetStreamer main] requestSoundNamed:name priority:priority] whenDoneOnMain:^(id sound, NSError *error) {
+        completion( sound ? [self loadAudioNamed:name] : nil );
+    }];
+}
+
 /**
  * Take in the Camera node, and update the listener position and orientation.
  */
 - (void) updateListenerFromCameraNode:(SCNNode*)cameraNode {
     SCNVector3 sp = cameraNode.position;
     [_environment setListenerPosition:AVAudioMake3DPoint(sp.x, sp.y, sp.z)];
+    _listenerPosition = SCNVector3ToGLKVector3(sp);
+    _voicePool.listenerPosition = _listenerPosition;
 
     SCNQuaternion so = cameraNode.orientation;
     GLKQuaternion go = GLKQuaternionMake( so.x, so.y, so.z, so.w );
@@ -251,6 +340,8 @@
     AVAudio3DVector aup = AVAudioMake3DVector(gup.x, gup.y, gup.z);
 
     [_environment setListenerVectorOrientation:AVAudioMake3DVectorOrientation(afwd, aup)];
+
+    [_softwareMixer updateListenerFromCameraNode:cameraNode];
 }
 
 @end
@@ -274,6 +365,21 @@
     return self;
 }
 
+- (instancetype)initWithName:(NSString*)name stream:(AudioStream*)stream engine:(AVAudioEngine*)engine
+{
+    self = [super init];
+    if (self) {
+        be_assert(stream && engine, "Null on stream or engine");
+        _name = name;
+        _stream = stream;
+        _volume = 1;
+        _player = [[AVAudioPlayerNode alloc] init];
+
+        [self restorWithEngine:engine];
+    }
+    return self;
+}
+
 - (void) setVolume:(float)volume {
     _volume = volume;
     _player.volume = volume;
@@ -287,7 +393,21 @@
     _playing = value;
     
     if( _playing ) {
-        if( _looping ) {
+        if( _stream ) {
+            // Drop whatever is still queued from a previous play, then prime from the start.
+            [_stream stop];
+            [_player stop];
+
+            __weak AudioNode *weakSelf = self;
+            [_stream scheduleOnPlayer:_player looping:_looping completion:^{
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    AudioNode *strongSelf = weakSelf;
+                    if( strongSelf ) {
+                        strongSelf->_playing = NO;
+                    }
+                });
+            }];
+        } else if( _looping ) {
             [_player scheduleBuffer:_buffer atTime:nil options:AVAudioPlayerNodeBufferLoops|AVAudioPlayerNodeBufferInterrupts completionHandler:nil];
         } else {
             __weak AudioNode *weakSelf = self;
@@ -306,11 +426,15 @@
             NSLog(@"AudioEngine is not running, can't play %@", self.name);
         }
     } else {
+        [_stream stop];
         [_player stop];
     }
 }
 
 - (float) duration {
+    if( _stream ) {
+        return _stream.duration;
+    }
     return _buffer.frameLength / _buffer.format.sampleRate;
 }
 
@@ -334,7 +458,7 @@
     [_engine attachNode:_player];
     
     //assign format to node
-    [_engine connect:_player to:[_engine mainMixerNode] format:[_buffer format]];
+    [_engine connect:_player to:[_engine mainMixerNode] format:(_stream ? _stream.format : [_buffer format])];
 
     // Restore playing state, only restart looping audio.
     if( _playing ) {
@@ -0,0 +1,157 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Fixed pool of one-shot voices, owned by the AudioEngine.
+//
+//  Every voice is an AVAudioPlayerNode attached once, routed through the
+//  AVAudioEnvironmentNode, and kept playing; a sound is started by scheduling
+//  its buffer on a voice with AVAudioPlayerNodeBufferInterrupts. Sounds are
+//  converted to the one mono voice format when they're added, so any voice
+//  can play any sound and be positioned in 3D.
+//
+//  Triggers go through a lock-free ring, and don't allocate, so they can be
+//  posted from physics contact callbacks. The ring is drained once per frame
+//  by update, which picks a voice for each trigger:
+//   - A sound already playing maxInstances times restarts its oldest voice.
+//   - Otherwise a free voice is used.
+//   - Otherwise the lowest priority voice is stolen, then the furthest from
+//     the listener, then the oldest; unless every voice outranks the trigger,
+//     in which case it's dropped.
+//
+//  Once a SpatialAudioMixerUnit is set with playThroughSoftwareMixer:,
+//  positional triggers play on it instead, where the oldest voice is stolen
+//  when all are busy; head relative ones stay on the pool's voices.
+//
+
+#import <AVFoundation/AVFoundation.h>
+#import <GLKit/GLKit.h>
+
+@class SpatialAudioMixerUnit;
+
+/// Index of a sound added to the pool.
+typedef uint16_t AudioSoundID;
+
+#define AUDIO_SOUND_INVALID ((AudioSoundID)0xFFFF)
+
+/// Maximum sounds that can be added to a pool.
+#define AUDIO_MAX_SOUNDS 256
+
+typedef NS_ENUM(uint8_t, AudioPriority) {
+    AudioPriorityLow = 0,
+    AudioPriorityNormal = 128,
+    AudioPriorityHigh = 255,
+};
+
+/**
+ * Pool counters, for profiling.
+ */
+typedef struct {
+    uint64_t triggered;         // Triggers posted.
+    uint64_t played;            // Triggers that started a voice.
+    uint64_t stolen;            // Voices cut short by a higher ranked trigger.
+    uint64_t limited;           // Voices restarted by their sound's instance limit.
+    uint64_t dropped;           // Triggers outranked by every voice, or posted while the engine was down.
+    uint64_t overflowed;        // Triggers lost because the ring was full.
+    uint32_t activeVoices;      // Voices playing after the last update.
+    uint32_t highWaterVoices;   // Most voices playing at once.
+} AudioVoicePoolStats;
+
+@interface AudioVoicePool : NSObject
+
+- (instancetype) initWithVoiceCount:(NSUInteger)voiceCount;
+
+@property (nonatomic, readonly) NSUInteger voiceCount;
+
+/// Format every sound is converted to: mono, 44.1kHz float.
+@property (nonatomic, readonly) AVAudioFormat *voiceFormat;
+
+/**
+ * Attach and connect the voices to engine through environment.
+ * Call again with a new engine after a restart; voices move over from the old one.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (void) attachToEngine:(AVAudioEngine *)engine environment:(AVAudioEnvironmentNode *)environment;
+
+/**
+ * Restart the voice players after the engine was stopped by a configuration change.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (void) restart;
+
+/**
+ * Add a sound, converting buffer to the voice format.
+ * Adding a name twice returns the existing sound, with its original settings.
+ * @param maxInstances How many voices the sound may play on at once.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (AudioSoundID) addSoundNamed:(NSString *)name
+                        buffer:(AVAudioPCMBuffer *)buffer
+                  maxInstances:(NSUInteger)maxInstances
+                      priority:(AudioPriority)priority;
+
+/// AUDIO_SOUND_INVALID if the name wasn't added. RUN ON MAIN THREAD ONLY
+- (AudioSoundID) soundIDForName:(NSString *)name;
+
+/**
+ * Play a sound once, at a world position.
+ * Lock-free and allocation-free; the voice is picked on the next update.
+ * @return NO if the ring was full or sound is invalid.
+ * THREAD SAFE
+ */
+- (BOOL) triggerSound:(AudioSoundID)sound volume:(float)volume position:(GLKVector3)position;
+
+/**
+ * Play a sound once, on the listener, following it as it moves. For UI sounds.
+ * Lock-free and allocation-free; the voice is picked on the next update.
+ * @return NO if the ring was full or sound is invalid.
+ * THREAD SAFE
+ */
+- (BOOL) triggerSoundHeadRelative:(AudioSoundID)sound volume:(float)volume;
+
+/**
+ * Play a batch of sounds, claiming their ring slots together.
+ * Invalid sounds are dropped on the next update.
+ * @return How many were queued, fewer than count if the ring filled up.
+ * THREAD SAFE
+ */
+- (NSUInteger) triggerSounds:(const AudioSoundID *)sounds
+                     volumes:(const float *)volumes
+                   positions:(const GLKVector3 *)positions
+                       count:(NSUInteger)count;
+
+/**
+ * Software mixer positional triggers play on, nil when they play on the pool's voices.
+ * THREAD SAFE
+ */
+@property (atomic, readonly) SpatialAudioMixerUnit *softwareMixer;
+
+/**
+ * Play positional triggers on mixerUnit from the next update, adding every sound to it, now and as they're added.
+ * nil goes back to the pool's voices. mixerUnit must have no sounds yet.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (void) playThroughSoftwareMixer:(SpatialAudioMixerUnit *)mixerUnit;
+
+/**
+ * Listener position used to rank voices by distance, and to place head relative voices.
+ * RENDER THREAD ONLY
+ */
+@property (nonatomic) GLKVector3 listenerPosition;
+
+/**
+ * Retire finished voices and start this frame's triggers.
+ * RENDER THREAD ONLY - called once per frame by SceneManager.
+ */
+- (void) update;
+
+/// Snapshot of the pool counters.
+- (AudioVoicePoolStats) stats;
+
+@end
@@ -0,0 +1,476 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "AudioVoicePool.h"
+#import "SpatialAudioMixerUnit.h"
+
+#import <BridgeEngine/BEDebugging.h>
+#import <QuartzCore/QuartzCore.h>
+
+#include <atomic>
+#include <algorithm>
+#include <vector>
+
+#define AUDIO_VOICE_SAMPLE_RATE 44100.0
+
+namespace {
+
+    // Must be a power of two.
+    const size_t kTriggerCapacity = 256;
+    const size_t kTriggerMask = kTriggerCapacity - 1;
+
+    struct AudioTrigger
+    {
+        AudioSoundID sound;
+        float volume;
+        GLKVector3 position;
+        bool headRelative;          // Follows the listener, position is ignored.
+    };
+
+    struct AudioTriggerCell
+    {
+        std::atomic<size_t> sequence;
+        AudioTrigger trigger;
+    };
+
+    /**
+     * Immutable once published by bumping the pool's sound count.
+     */
+    struct AudioSound
+    {
+        AVAudioPCMBuffer *buffer = nil;
+        double duration = 0;
+        uint8_t maxInstances = 1;
+        AudioPriority priority = AudioPriorityNormal;
+    };
+
+    struct AudioVoice
+    {
+        AVAudioPlayerNode *player = nil;
+        AudioSoundID sound = AUDIO_SOUND_INVALID;   // Invalid when free.
+        AudioPriority priority = AudioPriorityLow;
+        float distance = 0;
+        bool headRelative = false;
+        double startTime = 0;
+        double endTime = 0;
+    };
+
+    /**
+     * Convert buffer to format, down mixing to mono and resampling as needed.
+     */
+    AVAudioPCMBuffer *convertBuffer( AVAudioPCMBuffer *buffer, AVAudioFormat *format ) {
+        if( [buffer.format isEqual:format] ) {
+            return buffer;
+        }
+
+        AVAudioConverter *converter = [[AVAudioConverter alloc] initFromFormat:buffer.format toFormat:format];
+        if( converter == nil ) {
+            return nil;
+        }
+        converter.downmix = YES;
+
+        double ratio = format.sampleRate / buffer.format.sampleRate;
+        AVAudioFrameCount capacity = (AVAudioFrameCount)ceil(buffer.frameLength * ratio) + 1;
+        AVAudioPCMBuffer *converted = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:capacity];
+
+        __block BOOL consumed = NO;
+        NSError *error = nil;
+        AVAudioConverterOutputStatus status = [converter convertToBuffer:converted error:&error withInputFromBlock:^AVAudioBuffer *(AVAudioPacketCount inNumberOfPackets, AVAudioConverterInputStatus *outStatus) {
+            if( consumed ) {
+                *outStatus = AVAudioConverterInputStatus_EndOfStream;
+                return nil;
+            }
+            consumed = YES;
+            *outStatus = AVAudioConverterInputStatus_HaveData;
+            return buffer;
+        }];
+
+        if( status == AVAudioConverterOutputStatus_Error || error != nil ) {
+            NSLog(@"AudioVoicePool: === Error === Could not convert sound: %@", error.localizedDescription);
+            return nil;
+        }
+        return converted;
+    }
+
+} // anonymous
+
+@interface AudioVoicePool ()
+@property (atomic, readwrite, strong) SpatialAudioMixerUnit *softwareMixer;
+@end
+
+@implementation AudioVoicePool
+{
+    std::vector<AudioVoice> _voices;
+
+    AudioSound _sounds[AUDIO_MAX_SOUNDS];
+    std::atomic<uint32_t> _soundCount;
+    NSMutableDictionary<NSString *, NSNumber *> *_soundIDsByName;
+
+    __weak AVAudioEngine *_engine;
+
+    // Producers claim slots by advancing _enqueuePos, update is the only consumer.
+    AudioTriggerCell *_cells;
+    std::atomic<size_t> _enqueuePos;
+    std::atomic<size_t> _dequeuePos;
+
+    std::atomic<uint64_t> _triggered;
+    std::atomic<uint64_t> _overflowed;
+
+    // Only written by the render thread in update.
+    uint64_t _played;
+    uint64_t _stolen;
+    uint64_t _limited;
+    uint64_t _dropped;
+    uint32_t _activeVoices;
+    uint32_t _highWaterVoices;
+}
+
+- (instancetype) initWithVoiceCount:(NSUInteger)voiceCount {
+    self = [super init];
+    if( self ) {
+        be_assert( voiceCount > 0, "Voice pool needs at least one voice" );
+        _voiceCount = voiceCount;
+        _voiceFormat = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:AUDIO_VOICE_SAMPLE_RATE channels:1];
+
+        _voices.resize(voiceCount);
+        for( AudioVoice &voice : _voices ) {
+            voice.player = [[AVAudioPlayerNode alloc] init];
+            voice.player.renderingAlgorithm = AVAudio3DMixingRenderingAlgorithmSphericalHead;
+        }
+
+        _soundCount.store(0, std::memory_order_relaxed);
+        _soundIDsByName = [[NSMutableDictionary alloc] init];
+
+        _cells = new AudioTriggerCell[kTriggerCapacity];
+        for( size_t i=0; i<kTriggerCapacity; i++ ) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _enqueuePos.store(0, std::memory_order_relaxed);
+        _dequeuePos.store(0, std::memory_order_relaxed);
+        _triggered.store(0, std::memory_order_relaxed);
+        _overflowed.store(0, std::memory_order_relaxed);
+    }
+    return self;
+}
+
+- (void) dealloc {
+    delete [] _cells;
+}
+
+#pragma mark - Engine
+
+- (void) attachToEngine:(AVAudioEngine *)engine environment:(AVAudioEnvironmentNode *)environment {
+    AVAudioEngine *previousEngine = _engine;
+    for( AudioVoice &voice : _voices ) {
+        if( previousEngine ) {
+            [previousEngine detachNode:voice.player];
+        }
+        [engine attachNode:voice.player];
+        [engine connect:voice.player to:environment format:_voiceFormat];
+        voice.sound = AUDIO_SOUND_INVALID;
+    }
+    _engine = engine;
+
+    [self restart];
+}
+
+- (void) restart {
+    AVAudioEngine *engine = _engine;
+    if( ![engine isRunning] ) return;
+
+    // Voices are kept playing, and started by scheduling a buffer on them.
+    for( AudioVoice &voice : _voices ) {
+        [voice.player play];
+    }
+}
+
+#pragma mark - Sounds
+
+- (AudioSoundID) addSoundNamed:(NSString *)name
+                        buffer:(AVAudioPCMBuffer *)buffer
+                  maxInstances:(NSUInteger)maxInstances
+                      priority:(AudioPriority)priority
+{
+    AudioSoundID existing = [self soundIDForName:name];
+    if( existing != AUDIO_SOUND_INVALID ) return existing;
+
+    uint32_t count = _soundCount.load(std::memory_order_relaxed);
+    if( count >= AUDIO_MAX_SOUNDS ) {
+        NSLog(@"AudioVoicePool: === Error === Out of sound slots, can't add: %@", name);
+        return AUDIO_SOUND_INVALID;
+    }
+
+    AVAudioPCMBuffer *converted = convertBuffer(buffer, _voiceFormat);
+    if( converted == nil ) {
+        NSLog(@"AudioVoicePool: === Error === Unsupported format for sound: %@", name);
+        return AUDIO_SOUND_INVALID;
+    }
+
+    AudioSound &sound = _sounds[count];
+    sound.buffer = converted;
+    sound.duration = converted.frameLength / _voiceFormat.sampleRate;
+    sound.maxInstances = (uint8_t)std::max<NSUInteger>(1, std::min<NSUInteger>(maxInstances, 255));
+    sound.priority = priority;
+
+    // Publish the sound to the render thread.
+    _soundCount.store(count + 1, std::memory_order_release);
+
+    AudioSoundID soundID = (AudioSoundID)count;
+    _soundIDsByName[name] = @(soundID);
+
+    // The mixer numbers its sounds like the pool, as long as none fails to add.
+    SpatialAudioMixerUnit *mixerUnit = self.softwareMixer;
+    if( mixerUnit && [mixerUnit addSoundWithBuffer:converted] != soundID ) {
+        NSLog(@"AudioVoicePool: === Error === Software mixer couldn't add sound: %@, back to the voices", name);
+        self.softwareMixer = nil;
+    }
+    return soundID;
+}
+
+- (void) playThroughSoftwareMixer:(SpatialAudioMixerUnit *)mixerUnit {
+    if( mixerUnit ) {
+        uint32_t count = _soundCount.load(std::memory_order_relaxed);
+        for( uint32_t s=0; s<count; s++ ) {
+            if( [mixerUnit addSoundWithBuffer:_sounds[s].buffer] != (int)s ) {
+                NSLog(@"AudioVoicePool: === Error === Software mixer couldn't add sound %u, staying on the voices", s);
+                mixerUnit = nil;
+                break;
+            }
+        }
+    }
+    self.softwareMixer = mixerUnit;
+}
+
+- (AudioSoundID) soundIDForName:(NSString *)name {
+    NSNumber *soundID = _soundIDsByName[name];
+    return soundID ? (AudioSoundID)soundID.unsignedShortValue : AUDIO_SOUND_INVALID;
+}
+
+#pragma mark - Triggers
+
+- (BOOL) triggerSound:(AudioSoundID)sound volume:(float)volume position:(GLKVector3)position {
+    AudioTrigger trigger = { sound, volume, position, false };
+    return [self enqueueTrigger:trigger];
+}
+
+- (BOOL) triggerSoundHeadRelative:(AudioSoundID)sound volume:(float)volume {
+    AudioTrigger trigger = { sound, volume, GLKVector3Make(0, 0, 0), true };
+    return [self enqueueTrigger:trigger];
+}
+
+- (BOOL) enqueueTrigger:(AudioTrigger)trigger {
+    if( trigger.sound >= _soundCount.load(std::memory_order_acquire) ) return NO;
+
+    _triggered.fetch_add(1, std::memory_order_relaxed);
+
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    for(;;) {
+        AudioTriggerCell &cell = _cells[pos & kTriggerMask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if( diff == 0 ) {
+            if( _enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) ) {
+                cell.trigger = trigger;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return YES;
+            }
+        } else if( diff < 0 ) {
+            // Full. More triggers than voices in one frame, so nothing audible is lost.
+            _overflowed.fetch_add(1, std::memory_order_relaxed);
+            return NO;
+        } else {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+- (NSUInteger) triggerSounds:(const AudioSoundID *)sounds
+                     volumes:(const float *)volumes
+                   positions:(const GLKVector3 *)positions
+                       count:(NSUInteger)count
+{
+    if( count == 0 ) return 0;
+    if( count > kTriggerCapacity ) count = kTriggerCapacity;
+
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    for(;;) {
+        // update frees cells in order, so if the last cell of the run is free they all are.
+        size_t last = pos + count - 1;
+        size_t sequence = _cells[last & kTriggerMask].sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)last;
+        if( diff == 0 ) {
+            if( _enqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed) ) {
+                break;
+            }
+        } else if( diff < 0 ) {
+            // Not enough room for the whole run, queue what fits one at a time.
+            NSUInteger queued = 0;
+            for( NSUInteger i=0; i<count; i++ ) {
+                if( [self triggerSound:sounds[i] volume:volumes[i] position:positions[i]] ) queued++;
+            }
+            return queued;
+        } else {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    _triggered.fetch_add(count, std::memory_order_relaxed);
+    for( NSUInteger i=0; i<count; i++ ) {
+        AudioTriggerCell &cell = _cells[(pos + i) & kTriggerMask];
+        cell.trigger = { sounds[i], volumes[i], positions[i], false };
+        cell.sequence.store(pos + i + 1, std::memory_order_release);
+    }
+    return count;
+}
+
+#pragma mark - Update
+
+/**
+ * Pick the voice to play a trigger on, or -1 to drop it.
+ */
+- (NSInteger) voiceForSound:(AudioSoundID)soundID sound:(const AudioSound &)sound distance:(float)distance {
+    NSInteger oldestSame = -1;
+    NSInteger freeVoice = -1;
+    NSInteger victim = -1;
+    NSUInteger sameCount = 0;
+
+    for( NSInteger i=0; i<(NSInteger)_voices.size(); i++ ) {
+        const AudioVoice &voice = _voices[i];
+        if( voice.sound == AUDIO_SOUND_INVALID ) {
+            if( freeVoice < 0 ) freeVoice = i;
+            continue;
+        }
+
+        if( voice.sound == soundID ) {
+            sameCount++;
+            if( oldestSame < 0 || voice.startTime < _voices[oldestSame].startTime ) oldestSame = i;
+        }
+
+        // Lowest priority, then furthest, then oldest.
+        if( victim < 0 ) {
+            victim = i;
+        } else {
+            const AudioVoice &best = _voices[victim];
+            if( voice.priority != best.priority ) {
+                if( voice.priority < best.priority ) victim = i;
+            } else if( voice.distance != best.distance ) {
+                if( voice.distance > best.distance ) victim = i;
+            } else if( voice.startTime < best.startTime ) {
+                victim = i;
+            }
+        }
+    }
+
+    if( sameCount >= sound.maxInstances ) {
+        _limited++;
+        return oldestSame;
+    }
+
+    if( freeVoice >= 0 ) {
+        return freeVoice;
+    }
+
+    const AudioVoice &candidate = _voices[victim];
+    if( candidate.priority < sound.priority || (candidate.priority == sound.priority && candidate.distance >= distance) ) {
+        _stolen++;
+        return victim;
+    }
+
+    return -1;
+}
+
+- (void) update {
+    double now = CACurrentMediaTime();
+
+    // Retire finished voices, and keep head relative ones on the listener.
+    AVAudio3DPoint listener = AVAudioMake3DPoint(_listenerPosition.x, _listenerPosition.y, _listenerPosition.z);
+    uint32_t active = 0;
+    for( AudioVoice &voice : _voices ) {
+        if( voice.sound != AUDIO_SOUND_INVALID && now >= voice.endTime ) {
+            voice.sound = AUDIO_SOUND_INVALID;
+        }
+        if( voice.sound == AUDIO_SOUND_INVALID ) continue;
+
+        active++;
+        if( voice.headRelative ) voice.player.position = listener;
+    }
+
+    AVAudioEngine *engine = _engine;
+    BOOL running = [engine isRunning];
+    uint32_t soundCount = _soundCount.load(std::memory_order_acquire);
+    SpatialAudioMixerUnit *mixerUnit = self.softwareMixer;
+
+    size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+    size_t end = _enqueuePos.load(std::memory_order_acquire);
+    for( ; pos != end; pos++ ) {
+        AudioTriggerCell &cell = _cells[pos & kTriggerMask];
+        if( cell.sequence.load(std::memory_order_acquire) != pos + 1 ) {
+            break; // Claimed but not yet written, pick it up next frame.
+        }
+
+        AudioTrigger trigger = cell.trigger;
+        cell.sequence.store(pos + kTriggerCapacity, std::memory_order_release);
+
+        if( !running || trigger.sound >= soundCount ) {
+            _dropped++;
+            continue;
+        }
+
+        // A sound the mixer doesn't have yet falls back to the voices.
+        if( mixerUnit && !trigger.headRelative &&
+            [mixerUnit playSound:trigger.sound volume:trigger.volume position:trigger.position] ) {
+            _played++;
+            continue;
+        }
+
+        const AudioSound &sound = _sounds[trigger.sound];
+        if( trigger.headRelative ) trigger.position = _listenerPosition;
+        float distance = GLKVector3Distance(trigger.position, _listenerPosition);
+        NSInteger index = [self voiceForSound:trigger.sound sound:sound distance:distance];
+        if( index < 0 ) {
+            _dropped++;
+            continue;
+        }
+
+        AudioVoice &voice = _voices[index];
+        if( voice.sound == AUDIO_SOUND_INVALID ) active++;
+        voice.sound = trigger.sound;
+        voice.priority = sound.priority;
+        voice.distance = distance;
+        voice.headRelative = trigger.headRelative;
+        voice.startTime = now;
+        voice.endTime = now + sound.duration;
+
+        AVAudioPlayerNode *player = voice.player;
+        player.volume = trigger.volume;
+        player.position = AVAudioMake3DPoint(trigger.position.x, trigger.position.y, trigger.position.z);
+        [player scheduleBuffer:sound.buffer atTime:nil options:AVAudioPlayerNodeBufferInterrupts completionHandler:nil];
+        if( !player.isPlaying ) {
+            [player play];
+        }
+        _played++;
+    }
+    _dequeuePos.store(pos, std::memory_order_relaxed);
+
+    _activeVoices = active;
+    _highWaterVoices = std::max(_highWaterVoices, active);
+}
+
+- (AudioVoicePoolStats) stats {
+    AudioVoicePoolStats stats = {};
+    stats.triggered = _triggered.load(std::memory_order_relaxed);
+    stats.played = _played;
+    stats.stolen = _stolen;
+    stats.limited = _limited;
+    stats.dropped = _dropped;
+    stats.overflowed = _overflowed.load(std::memory_order_relaxed);
+    stats.activeVoices = _activeVoices;
+    stats.highWaterVoices = _highWaterVoices;
+    return stats;
+}
+
+@end
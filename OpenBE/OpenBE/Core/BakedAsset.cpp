@@ -0,0 +1,220 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#include "BakedAsset.hpp"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    bool fail (std::string* error, const char* reason)
+    {
+        if (error) *error = reason;
+        return false;
+    }
+
+} // anonymous
+
+namespace BE
+{
+
+#pragma mark - Source hash
+
+    uint64_t bakedSourceHash (const void* data, size_t size, uint64_t seed)
+    {
+        // FNV-1a over 8 byte words, with a shift to fold the high bits back down.
+        const uint64_t prime = 0x100000001B3ull;
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t hash = (seed ^ size) * prime;
+
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * prime;
+        }
+        return hash ^ (hash >> 32);
+    }
+
+#pragma mark - BakedAssetView
+
+    bool BakedAssetView::validString (uint32_t offset) const
+    {
+        if (offset >= _size) return false;
+        return memchr(_data + offset, 0, _size - offset) != nullptr;
+    }
+
+    bool BakedAssetView::validFloats (uint32_t offset, uint64_t count) const
+    {
+        return (offset % sizeof(float)) == 0 && offset + count * sizeof(float) <= _size;
+    }
+
+    bool BakedAssetView::open (const void* data, size_t size, std::string* error)
+    {
+        *this = BakedAssetView();
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        if (bytes == nullptr || (reinterpret_cast<uintptr_t>(bytes) % kBakedAssetAlignment) != 0)
+            return fail(error, "data is missing or misaligned");
+
+        if (size < sizeof(BakedAssetHeader))
+            return fail(error, "truncated header");
+
+        const BakedAssetHeader* header = reinterpret_cast<const BakedAssetHeader*>(bytes);
+        if (header->magic != kBakedAssetMagic)
+            return fail(error, "not a baked asset");
+        if (header->version != kBakedAssetVersion)
+            return fail(error, "baked with another format version, re-run the AssetBaker");
+        if (header->fileSize != size)
+            return fail(error, "file size doesn't match the header");
+
+        uint64_t tableEnd = sizeof(BakedAssetHeader) + (uint64_t)header->sectionCount * sizeof(BakedSection);
+        if (tableEnd > size)
+            return fail(error, "truncated section table");
+
+        _data = bytes;
+        _size = size;
+
+        const BakedSection* sections = reinterpret_cast<const BakedSection*>(bytes + sizeof(BakedAssetHeader));
+        for (uint32_t s = 0; s < header->sectionCount; ++s)
+        {
+            const BakedSection& section = sections[s];
+            if ((section.offset % kBakedAssetAlignment) != 0
+                || section.offset + (uint64_t)section.count * section.recordSize > size)
+            {
+                *this = BakedAssetView();
+                return fail(error, "section out of bounds");
+            }
+
+            const uint8_t* records = bytes + section.offset;
+            switch (section.type)
+            {
+                case BakedSectionNodes:
+                    if (section.recordSize != sizeof(BakedNode)) break;
+                    _nodes = reinterpret_cast<const BakedNode*>(records);
+                    _nodeCount = section.count;
+                    break;
+
+                case BakedSectionChannels:
+                    if (section.recordSize != sizeof(BakedChannel)) break;
+                    _channels = reinterpret_cast<const BakedChannel*>(records);
+                    _channelCount = section.count;
+                    break;
+
+                case BakedSectionShaders:
+                    if (section.recordSize != sizeof(BakedShader)) break;
+                    _shaders = reinterpret_cast<const BakedShader*>(records);
+                    _shaderCount = section.count;
+                    break;
+
+                default:
+                    break; // Unknown sections are skipped, they may be added without a version bump.
+            }
+        }
+
+        // Check every reference once, so the accessors don't have to.
+        bool valid = true;
+        for (uint32_t i = 0; valid && i < _nodeCount; ++i)
+        {
+            valid = validString(_nodes[i].name) && _nodes[i].parent < (int32_t)i;
+        }
+        for (uint32_t i = 0; valid && i < _channelCount; ++i)
+        {
+            const BakedChannel& channel = _channels[i];
+            valid = validString(channel.target) && channel.keyCount > 0
+                && validFloats(channel.times, channel.keyCount)
+                && validFloats(channel.values, (uint64_t)channel.keyCount * 16);
+        }
+        for (uint32_t i = 0; valid && i < _shaderCount; ++i)
+        {
+            const BakedShader& shader = _shaders[i];
+            valid = validString(shader.name)
+                && validString(shader.vertex) && shader.vertex + (uint64_t)shader.vertexLength < size
+                && validString(shader.fragment) && shader.fragment + (uint64_t)shader.fragmentLength < size;
+        }
+
+        if (!valid)
+        {
+            *this = BakedAssetView();
+            return fail(error, "record references out of bounds");
+        }
+
+        return true;
+    }
+
+    float BakedAssetView::duration () const
+    {
+        float longest = 0.f;
+        for (uint32_t i = 0; i < _channelCount; ++i)
+        {
+            const BakedChannel& channel = _channels[i];
+            float last = channelTimes(channel)[channel.keyCount - 1];
+            if (longest < last) longest = last;
+        }
+        return longest;
+    }
+
+#pragma mark - BakedAssetFile
+
+    BakedAssetFile::~BakedAssetFile ()
+    {
+        unmap();
+    }
+
+    bool BakedAssetFile::map (const char* path, std::string* error)
+    {
+        unmap();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return fail(error, "can't open file");
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            ::close(fd);
+            return fail(error, "can't stat file");
+        }
+
+        size_t size = (size_t)info.st_size;
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) return fail(error, "mmap failed");
+
+        if (!_view.open(mapping, size, error))
+        {
+            munmap(mapping, size);
+            return false;
+        }
+
+        _mapping = mapping;
+        _mappingSize = size;
+        return true;
+    }
+
+    void BakedAssetFile::unmap ()
+    {
+        if (_mapping)
+        {
+            munmap(_mapping, _mappingSize);
+            _mapping = nullptr;
+            _mappingSize = 0;
+        }
+        _view = BakedAssetView();
+    }
+
+} // BE
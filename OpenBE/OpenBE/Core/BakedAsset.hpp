@@ -0,0 +1,179 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Binary format for assets baked offline by Tools/AssetBaker: keyframed
+//  transform animations and node hierarchies from the COLLADA scenes, and
+//  preprocessed GLSL shader sources.
+//
+//  A baked file is meant to be memory mapped and read in place. It starts with
+//  a header and a section table; every section is an array of fixed size,
+//  16 byte aligned records whose strings and float arrays are referenced by
+//  byte offsets from the start of the file. Matrices are stored in SCNMatrix4
+//  order, so they can be handed to SceneKit without conversion.
+//
+//  BakedAssetView validates a mapping once when opened; after that every
+//  accessor is a plain pointer into the mapping, nothing is copied or parsed.
+//
+//  Every file keeps a hash of the sources it was baked from, and every shader
+//  one of its own pair, so a baked file that's older than its source is caught
+//  by the baker, which re-bakes it, and by the runtime, which ignores it.
+//
+//  Plain C++ with no Apple dependencies, shared by the baker and the runtime.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace BE
+{
+
+    const uint32_t kBakedAssetMagic = 0x4B424542;   // "BEBK", little-endian.
+    const uint32_t kBakedAssetVersion = 2;          // Bump on any layout change, old files are rejected.
+    const uint32_t kBakedAssetAlignment = 16;
+
+    enum BakedSectionType : uint32_t
+    {
+        BakedSectionNodes = 1,
+        BakedSectionChannels = 2,
+        BakedSectionShaders = 3,
+    };
+
+    struct BakedAssetHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t fileSize;
+        uint32_t sectionCount;
+        uint64_t sourceHash;            // bakedSourceHash of the source file, or of every shader pair in order.
+    };
+
+    struct BakedSection
+    {
+        uint32_t type;                  // BakedSectionType
+        uint32_t offset;                // Of the first record.
+        uint32_t count;                 // Records.
+        uint32_t recordSize;            // Checked against sizeof, in case a record grows without a version bump.
+    };
+
+    /// One node of a scene hierarchy, parents always come before their children.
+    struct BakedNode
+    {
+        uint32_t name;                  // String offset.
+        int32_t parent;                 // Node index, -1 for roots.
+        uint32_t reserved[2];
+        float transform[16];            // Local transform, SCNMatrix4 order.
+    };
+
+    /// Keyframed transform of one node, linearly interpolated.
+    struct BakedChannel
+    {
+        uint32_t target;                // String offset of the target node's name.
+        uint32_t keyCount;
+        uint32_t times;                 // Offset of keyCount floats, seconds.
+        uint32_t values;                // Offset of keyCount * 16 floats, SCNMatrix4 order.
+    };
+
+    /// Preprocessed vertex and fragment shader pair.
+    struct BakedShader
+    {
+        uint32_t name;                  // String offset.
+        uint32_t vertex;                // String offset, zero terminated.
+        uint32_t vertexLength;          // Bytes, not counting the terminator.
+        uint32_t fragment;
+        uint32_t fragmentLength;
+        uint32_t reserved;
+        uint64_t sourceHash;            // Of the .vsh then the .fsh file, #included files aren't covered.
+    };
+
+    const uint64_t kBakedSourceHashSeed = 0xCBF29CE484222325ull;
+
+    /// Fast non-cryptographic hash of a source file's bytes, chained from seed.
+    uint64_t bakedSourceHash (const void* data, size_t size, uint64_t seed = kBakedSourceHashSeed);
+
+    class BakedAssetView
+    {
+    public:
+        BakedAssetView () = default;
+
+        /**
+         * Validate the header, section table and every offset in data.
+         * data must stay valid, and 16 byte aligned, while the view is used.
+         * @return false with a reason in error if the file is corrupt, truncated or another version.
+         */
+        bool open (const void* data, size_t size, std::string* error = nullptr);
+
+        bool isOpen () const { return _data != nullptr; }
+        size_t size () const { return _size; }
+
+        uint64_t sourceHash () const { return reinterpret_cast<const BakedAssetHeader*>(_data)->sourceHash; }
+
+        uint32_t nodeCount () const { return _nodeCount; }
+        const BakedNode& node (uint32_t index) const { return _nodes[index]; }
+
+        uint32_t channelCount () const { return _channelCount; }
+        const BakedChannel& channel (uint32_t index) const { return _channels[index]; }
+        const float* channelTimes (const BakedChannel& channel) const { return floats(channel.times); }
+        const float* channelValues (const BakedChannel& channel) const { return floats(channel.values); }
+
+        /// Longest channel, in seconds.
+        float duration () const;
+
+        uint32_t shaderCount () const { return _shaderCount; }
+        const BakedShader& shader (uint32_t index) const { return _shaders[index]; }
+
+        /// Zero terminated string at offset.
+        const char* string (uint32_t offset) const { return reinterpret_cast<const char*>(_data + offset); }
+
+    private:
+        const float* floats (uint32_t offset) const { return reinterpret_cast<const float*>(_data + offset); }
+
+        bool validString (uint32_t offset) const;
+        bool validFloats (uint32_t offset, uint64_t count) const;
+
+        const uint8_t* _data = nullptr;
+        size_t _size = 0;
+
+        const BakedNode* _nodes = nullptr;
+        uint32_t _nodeCount = 0;
+        const BakedChannel* _channels = nullptr;
+        uint32_t _channelCount = 0;
+        const BakedShader* _shaders = nullptr;
+        uint32_t _shaderCount = 0;
+    };
+
+    /**
+     * Read-only memory mapping of a baked file, with its view.
+     * Pages are only read in when touched.
+     */
+    class BakedAssetFile
+    {
+    public:
+        BakedAssetFile () = default;
+        ~BakedAssetFile ();
+
+        BakedAssetFile (const BakedAssetFile&) = delete;
+        BakedAssetFile& operator= (const BakedAssetFile&) = delete;
+
+        /// Map and validate path. Any previous mapping is released first.
+        bool map (const char* path, std::string* error = nullptr);
+        void unmap ();
+
+        const BakedAssetView& view () const { return _view; }
+
+    private:
+        void* _mapping = nullptr;
+        size_t _mappingSize = 0;
+        BakedAssetView _view;
+    };
+
+} // BE
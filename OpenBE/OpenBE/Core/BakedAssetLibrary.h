@@ -0,0 +1,66 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Runtime side of Tools/AssetBaker. Looks for baked files under Baked/ in the
+//  resource bundles, memory maps them on first use and keeps them mapped.
+//
+//  Animations come back as the same CAAnimation / CAAnimationGroup shape that
+//  AnimationComponent builds from SCNSceneSource, one transform keyframe
+//  animation per node. Shader sources are NSStrings over the mapping, no copy.
+//
+//  Every lookup returns nil when there's no baked file, or it was baked from an
+//  older source, so callers fall back to loading the source asset. Shaders are
+//  hashed against their bundled sources; scenes too, unless Xcode compiled them,
+//  in which case the Bake Assets build phase already checked them.
+//
+
+#import <SceneKit/SceneKit.h>
+
+#ifdef __cplusplus
+#include "BakedAsset.hpp"
+#endif
+
+@interface BakedAssetLibrary : NSObject
+
+/// Singleton.
++ (BakedAssetLibrary *) main;
+
+/**
+ * Animation baked from the scene at path, like "Models/Animations/Robot_Unboxing.dae".
+ * Fade in and out are set like AnimationComponent's.
+ * THREAD SAFE
+ */
+- (CAAnimation *) animationWithSceneNamed:(NSString *)path;
+
+/**
+ * Named, transformed but empty nodes of the scene at path. nil if not baked.
+ * THREAD SAFE
+ */
+- (SCNNode *) nodeHierarchyWithSceneNamed:(NSString *)path;
+
+/**
+ * Preprocessed sources of a shader pair, named like programWithGLShader: takes them.
+ * @return NO if the shader wasn't baked.
+ * THREAD SAFE
+ */
+- (BOOL) shaderNamed:(NSString *)name vertexSource:(NSString **)vertexSource fragmentSource:(NSString **)fragmentSource;
+
+@end
+
+@interface BakedAssetLibrary (Benchmark)
+
+/**
+ * Time loading scenes' animations and shaders from their sources, against from baked files.
+ * Run it at startup, before either was loaded, to compare cold loads.
+ * @return Report, also logged.
+ */
++ (NSString *) benchmarkStartupWithScenes:(NSArray<NSString *> *)scenePaths shaders:(NSArray<NSString *> *)shaderNames;
+
+@end
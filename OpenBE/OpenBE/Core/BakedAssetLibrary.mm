@@ -0,0 +1,278 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "BakedAssetLibrary.h"
+#import "../Utils/SceneKitExtensions.h"
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static_assert(sizeof(SCNMatrix4) == 16 * sizeof(float), "Baked matrices are float SCNMatrix4s");
+
+// Where the AssetBaker output is copied in the resource bundles.
+#define BAKED_ASSET_FOLDER @"Baked"
+#define BAKED_ASSET_EXTENSION @"bebk"
+#define BAKED_SHADERS_FILE @"Shaders"
+
+// Same as AnimationComponent.
+#define BAKED_ANIMATION_FADE_DURATION 0.3
+
+namespace {
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    NSData *resourceData( NSString *name, NSString *extension ) {
+        NSString *path = [SceneKit pathForResourceNamed:name withExtension:extension];
+        return path ? [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil] : nil;
+    }
+
+    /**
+     * Was the scene baked from its source in the bundle. Xcode compiles the scenes in .scnassets
+     * into binary archives, which can't be hashed against the COLLADA they came from; the
+     * Bake Assets build phase checked those against their sources, in the same build.
+     */
+    bool sceneMatchesSource( NSString *scenePath, uint64_t sourceHash ) {
+        NSData *source = resourceData(scenePath, nil);
+        if( source == nil ) return true;
+        if( source.length >= 6 && memcmp(source.bytes, "bplist", 6) == 0 ) return true;
+        return BE::bakedSourceHash(source.bytes, source.length) == sourceHash;
+    }
+
+    /// Was the shader baked from the .vsh and .fsh in the bundle, which are copied as they are.
+    bool shaderMatchesSources( NSString *name, uint64_t sourceHash ) {
+        NSData *vertex = resourceData(name, @"vsh");
+        NSData *fragment = resourceData(name, @"fsh");
+        if( vertex == nil || fragment == nil ) return true;
+        return BE::bakedSourceHash(fragment.bytes, fragment.length, BE::bakedSourceHash(vertex.bytes, vertex.length)) == sourceHash;
+    }
+
+} // anonymous
+
+@implementation BakedAssetLibrary
+{
+    std::mutex _mutex;
+
+    // Mapped files by resource path, nullptr when there's no baked file. Never unmapped,
+    // strings handed out point into the mappings.
+    std::unordered_map<std::string, std::unique_ptr<BE::BakedAssetFile>> _files;
+
+    // Index of each baked shader in the shaders file.
+    std::unordered_map<std::string, uint32_t> _shaderIndices;
+    BOOL _shadersIndexed;
+}
+
++ (BakedAssetLibrary *) main {
+    static BakedAssetLibrary *mainLibrary = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainLibrary = [[BakedAssetLibrary alloc] init];
+    });
+
+    return mainLibrary;
+}
+
+/**
+ * Mapped view of Baked/<path>.bebk, or nullptr. Scenes are checked against their source once,
+ * when mapped. Call with _mutex held.
+ */
+- (const BE::BakedAssetView *) viewForPath:(NSString *)path {
+    std::string key = path.UTF8String;
+    auto found = _files.find(key);
+    if( found != _files.end() ) {
+        return found->second ? &found->second->view() : nullptr;
+    }
+
+    std::unique_ptr<BE::BakedAssetFile> file;
+    NSString *bakedPath = [SceneKit pathForResourceNamed:[BAKED_ASSET_FOLDER stringByAppendingPathComponent:path] withExtension:BAKED_ASSET_EXTENSION];
+    if( bakedPath ) {
+        file.reset(new BE::BakedAssetFile());
+
+        std::string error;
+        if( !file->map(bakedPath.fileSystemRepresentation, &error) ) {
+            NSLog(@"BakedAssetLibrary: === Error === Ignoring %@: %s", bakedPath, error.c_str());
+            file.reset();
+        } else if( ![path isEqualToString:BAKED_SHADERS_FILE] && !sceneMatchesSource(path, file->view().sourceHash()) ) {
+            NSLog(@"BakedAssetLibrary: === Error === Ignoring %@, its source changed since it was baked, re-run the AssetBaker", bakedPath);
+            file.reset();
+        }
+    }
+
+    const BE::BakedAssetView *view = file ? &file->view() : nullptr;
+    _files[key] = std::move(file);
+    return view;
+}
+
+#pragma mark - Animations
+
+- (CAAnimation *) animationWithSceneNamed:(NSString *)path {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const BE::BakedAssetView *view = [self viewForPath:path];
+    if( view == nullptr || view->channelCount() == 0 ) return nil;
+
+    const float duration = view->duration();
+    NSMutableArray<CAAnimation *> *animations = [NSMutableArray arrayWithCapacity:view->channelCount()];
+    for( uint32_t c=0; c<view->channelCount(); c++ ) {
+        const BE::BakedChannel &channel = view->channel(c);
+        const float *times = view->channelTimes(channel);
+        const SCNMatrix4 *matrices = reinterpret_cast<const SCNMatrix4 *>(view->channelValues(channel));
+
+        NSMutableArray<NSValue *> *values = [NSMutableArray arrayWithCapacity:channel.keyCount];
+        NSMutableArray<NSNumber *> *keyTimes = [NSMutableArray arrayWithCapacity:channel.keyCount];
+        for( uint32_t k=0; k<channel.keyCount; k++ ) {
+            [values addObject:[NSValue valueWithSCNMatrix4:matrices[k]]];
+            [keyTimes addObject:@(duration > 0 ? times[k] / duration : 0)];
+        }
+
+        // Child nodes of the node the animation is added to are addressed by name.
+        CAKeyframeAnimation *animation = [CAKeyframeAnimation animationWithKeyPath:[NSString stringWithFormat:@"/%s.transform", view->string(channel.target)]];
+        animation.values = values;
+        animation.keyTimes = keyTimes;
+        animation.duration = duration;
+        animation.calculationMode = kCAAnimationLinear;
+        animation.usesSceneTimeBase = NO;
+        [animations addObject:animation];
+    }
+
+    if( animations.count == 1 ) {
+        CAAnimation *animation = animations.firstObject;
+        animation.fadeInDuration = BAKED_ANIMATION_FADE_DURATION;
+        animation.fadeOutDuration = BAKED_ANIMATION_FADE_DURATION;
+        return animation;
+    }
+
+    CAAnimationGroup *group = [[CAAnimationGroup alloc] init];
+    group.fadeInDuration = BAKED_ANIMATION_FADE_DURATION;
+    group.fadeOutDuration = BAKED_ANIMATION_FADE_DURATION;
+    group.duration = duration;
+    group.animations = animations;
+    return group;
+}
+
+#pragma mark - Nodes
+
+- (SCNNode *) nodeHierarchyWithSceneNamed:(NSString *)path {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const BE::BakedAssetView *view = [self viewForPath:path];
+    if( view == nullptr || view->nodeCount() == 0 ) return nil;
+
+    SCNNode *root = [SCNNode node];
+    std::vector<SCNNode *> nodes(view->nodeCount());
+    for( uint32_t i=0; i<view->nodeCount(); i++ ) {
+        const BE::BakedNode &baked = view->node(i);
+
+        SCNNode *node = [SCNNode node];
+        node.name = @(view->string(baked.name));
+        node.transform = *reinterpret_cast<const SCNMatrix4 *>(baked.transform);
+        nodes[i] = node;
+
+        // Parents always come first.
+        [(baked.parent < 0 ? root : nodes[baked.parent]) addChildNode:node];
+    }
+    return root;
+}
+
+#pragma mark - Shaders
+
+- (BOOL) shaderNamed:(NSString *)name vertexSource:(NSString **)vertexSource fragmentSource:(NSString **)fragmentSource {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const BE::BakedAssetView *view = [self viewForPath:BAKED_SHADERS_FILE];
+    if( view == nullptr ) return NO;
+
+    // Shaders whose sources changed since they were baked are left out, and load from the sources.
+    if( !_shadersIndexed ) {
+        for( uint32_t i=0; i<view->shaderCount(); i++ ) {
+            const BE::BakedShader &shader = view->shader(i);
+            if( !shaderMatchesSources(@(view->string(shader.name)), shader.sourceHash) ) {
+                NSLog(@"BakedAssetLibrary: === Error === Ignoring baked shader %s, its sources changed since it was baked, re-run the AssetBaker", view->string(shader.name));
+                continue;
+            }
+            _shaderIndices[view->string(shader.name)] = i;
+        }
+        _shadersIndexed = YES;
+    }
+
+    auto found = _shaderIndices.find(name.UTF8String);
+    if( found == _shaderIndices.end() ) return NO;
+
+    // The mapping outlives the strings, so they can wrap it without copying.
+    const BE::BakedShader &shader = view->shader(found->second);
+    if( vertexSource ) {
+        *vertexSource = [[NSString alloc] initWithBytesNoCopy:(void *)view->string(shader.vertex) length:shader.vertexLength
+                                                     encoding:NSUTF8StringEncoding freeWhenDone:NO];
+    }
+    if( fragmentSource ) {
+        *fragmentSource = [[NSString alloc] initWithBytesNoCopy:(void *)view->string(shader.fragment) length:shader.fragmentLength
+                                                       encoding:NSUTF8StringEncoding freeWhenDone:NO];
+    }
+    return YES;
+}
+
+@end
+
+#pragma mark - Benchmark
+
+@implementation BakedAssetLibrary (Benchmark)
+
++ (NSString *) benchmarkStartupWithScenes:(NSArray<NSString *> *)scenePaths shaders:(NSArray<NSString *> *)shaderNames {
+    // Sources, the way AnimationComponent and programWithGLShader: load them.
+    uint64_t start = mach_absolute_time();
+    NSUInteger sourceAnimations = 0;
+    for( NSString *path in scenePaths ) {
+        NSURL *sceneURL = [SceneKit URLForResource:path withExtension:nil];
+        if( sceneURL == nil ) continue;
+
+        NSDictionary *options = @{SCNSceneSourceAnimationImportPolicyKey:SCNSceneSourceAnimationImportPolicyPlayUsingSceneTimeBase};
+        SCNSceneSource *sceneSource = [SCNSceneSource sceneSourceWithURL:sceneURL options:options];
+        for( NSString *animID in [sceneSource identifiersOfEntriesWithClass:[CAAnimation class]] ) {
+            if( [sceneSource entryWithIdentifier:animID withClass:[CAAnimation class]] ) sourceAnimations++;
+        }
+    }
+    for( NSString *name in shaderNames ) {
+        for( NSString *extension in @[@"vsh", @"fsh"] ) {
+            NSURL *url = [SceneKit URLForResource:name withExtension:extension];
+            if( url ) [[NSString alloc] initWithContentsOfURL:url encoding:NSUTF8StringEncoding error:NULL];
+        }
+    }
+    double sourceMs = machTicksToMs(mach_absolute_time() - start);
+
+    // Baked.
+    BakedAssetLibrary *library = [BakedAssetLibrary main];
+    start = mach_absolute_time();
+    NSUInteger bakedAnimations = 0, bakedShaders = 0;
+    for( NSString *path in scenePaths ) {
+        if( [library animationWithSceneNamed:path] ) bakedAnimations++;
+    }
+    for( NSString *name in shaderNames ) {
+        NSString *vertex = nil, *fragment = nil;
+        if( [library shaderNamed:name vertexSource:&vertex fragmentSource:&fragment] ) bakedShaders++;
+    }
+    double bakedMs = machTicksToMs(mach_absolute_time() - start);
+
+    NSString *report = [NSString stringWithFormat:
+        @"BakedAssetLibrary startup: sources %0.2f ms (%lu animation entries), baked %0.2f ms (%lu/%lu scenes, %lu/%lu shaders), %0.1fx",
+        sourceMs, (unsigned long)sourceAnimations,
+        bakedMs, (unsigned long)bakedAnimations, (unsigned long)scenePaths.count, (unsigned long)bakedShaders, (unsigned long)shaderNames.count,
+        bakedMs > 0 ? sourceMs / bakedMs : 0.0];
+    NSLog(@"%@", report);
+    return report;
+}
+
+@end
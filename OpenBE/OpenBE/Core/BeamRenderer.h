@@ -0,0 +1,79 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Procedural scan beams, for any number of beams at once.
+//
+//  A beam is BEAM_RENDERER_TRIANGLES jagged triangles from its start to its
+//  end position. Nothing about its shape is kept on the CPU: the vertex shader
+//  makes each corner from the vertex ID, and displaces it by a hash of its
+//  triangle and the beam's seed.
+//
+//  With Metal, every visible beam is drawn in one instanced draw through the
+//  StereoRenderer, without vertex buffers. Each beam is one packed instance:
+//  its node's world transform, start and end, width and height, active and
+//  seed, all written to one UniformBlock once a frame.
+//
+//  GLES 2 has neither vertex IDs nor instancing, so each beam's node draws
+//  one shared geometry of corners and triangle numbers, made once, through the
+//  combined shader. One binding packs the beam's parameters into its "beam"
+//  uniform array.
+//
+//  Updated by the SceneManager after the components.
+//  RENDER THREAD ONLY
+//
+
+#import <SceneKit/SceneKit.h>
+#import <GLKit/GLKit.h>
+
+#define BEAM_RENDERER_TRIANGLES 10
+
+// Beams drawn at once with Metal, the rest are dropped.
+#define BEAM_RENDERER_MAX_BEAMS 32
+
+typedef struct {
+    NSUInteger beams;               // Added.
+    NSUInteger drawn;               // Of those, drawn last frame.
+    NSUInteger dropped;             // Visible beams over BEAM_RENDERER_MAX_BEAMS last frame.
+} BeamRendererStats;
+
+/// One beam, drawn in its node's space while the node is visible and the beam active.
+@interface BeamInstance : NSObject
+
+@property (nonatomic, readonly, weak) SCNNode *node;
+
+@property (atomic) GLKVector3 startPos;
+@property (atomic) GLKVector3 endPos;
+@property (atomic) float width;     // Max beam displacement width.
+@property (atomic) float height;    // Max beam displacement height.
+@property (atomic) float active;    // How bright and active is the beam, not drawn when 0 or less.
+
+/// Offsets the hash, so beams added one after the other don't look the same.
+@property (nonatomic, readonly) float seed;
+
+@end
+
+@interface BeamRenderer : NSObject
+
+/// Singleton.
++ (BeamRenderer *) main;
+
+/**
+ * Draw a beam in node's space. With GL, gives node the shared beam geometry.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (BeamInstance *) addBeamForNode:(SCNNode *)node;
+- (void) removeBeam:(BeamInstance *)beam;
+
+/// Pack the visible beams for this frame's draw.
+- (void) update;
+
+- (BeamRendererStats) stats;
+
+@end
@@ -0,0 +1,273 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "BeamRenderer.h"
+#import "Core.h"
+#import "../Utils/SceneKitExtensions.h"
+
+#import <BridgeEngine/BridgeEngine.h>
+#import <BridgeEngine/BEDebugging.h>
+#import <simd/simd.h>
+
+#include <OpenGLES/ES2/gl.h>
+
+/// Matches OBEBeamInstance in OpenBE.metal.
+typedef struct {
+    matrix_float4x4 modelTransform;
+    vector_float4 start;    // xyz: start, w: width
+    vector_float4 end;      // xyz: end, w: height
+    vector_float4 params;   // x: active, y: seed
+} OBEBeamInstance;
+
+namespace {
+
+    // combinedShader's shaderType for the scan beam.
+    const float BeamShaderType = 0.f;
+
+    matrix_float4x4 toSimd( SCNMatrix4 m ) {
+        GLKMatrix4 g = SCNMatrix4ToGLKMatrix4(m);
+        matrix_float4x4 result;
+        memcpy(&result, g.m, sizeof(result));
+        return result;
+    }
+
+    // Hidden, or not in the scene.
+    bool nodeHidden( SCNNode *node, SCNNode *sceneRoot ) {
+        SCNNode *top = nil;
+        for( SCNNode *n = node; n; n = n.parentNode ) {
+            if( n.hidden ) return true;
+            top = n;
+        }
+        return top != sceneRoot;
+    }
+
+} // anonymous
+
+#pragma mark - BeamInstance
+
+@interface BeamInstance ()
+@property (nonatomic, readwrite, weak) SCNNode *node;
+@property (nonatomic, readwrite) float seed;
+@end
+
+@implementation BeamInstance
+@end
+
+#pragma mark - BeamRenderer
+
+@implementation BeamRenderer
+{
+    NSMutableArray<BeamInstance *> *_beams;
+    NSUInteger _beamsAdded;
+
+    // Metal: one node drawing every beam.
+    SCNNode *_drawNode;
+    StereoDraw *_draw;
+    UniformBlock *_instanceBlock;
+    OBEBeamInstance _instances[BEAM_RENDERER_MAX_BEAMS];
+
+    // GL: one geometry shared by every beam's node.
+    SCNGeometry *_geometry;
+    NSMapTable<SCNNode *, BeamInstance *> *_beamsByNode;
+
+    BeamRendererStats _stats;
+}
+
++ (BeamRenderer *) main {
+    static BeamRenderer *mainBeamRenderer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainBeamRenderer = [[BeamRenderer alloc] init];
+    });
+
+    return mainBeamRenderer;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _beams = [NSMutableArray array];
+        _beamsByNode = [NSMapTable weakToWeakObjectsMapTable];
+        _stats = BeamRendererStats();
+    }
+    return self;
+}
+
+- (BOOL) usesMetal {
+    return [SceneManager main].renderingAPI == BEViewRenderingAPIMetal;
+}
+
+#pragma mark - Beams
+
+- (BeamInstance *) addBeamForNode:(SCNNode *)node {
+    be_assert(node != nil);
+
+    BeamInstance *beam = [[BeamInstance alloc] init];
+    beam.node = node;
+    // Triangles hash from 0 to BEAM_RENDERER_TRIANGLES, so each beam starts past the last one's.
+    beam.seed = (float)(_beamsAdded * BEAM_RENDERER_TRIANGLES);
+    _beamsAdded++;
+
+    [_beams addObject:beam];
+    _stats.beams = _beams.count;
+
+    node.categoryBitMask |= RAYCAST_IGNORE_BIT;
+    [node setCastsShadowRecursively:NO];
+
+    if( [self usesMetal] ) {
+        [self prepareDrawNode];
+    } else {
+        node.geometry = [self sharedGeometry];
+        node.renderingOrder = TRANSPARENCY_RENDERING_ORDER + 90;
+        [_beamsByNode setObject:beam forKey:node];
+    }
+    return beam;
+}
+
+- (void) removeBeam:(BeamInstance *)beam {
+    if( beam == nil ) return;
+
+    SCNNode *node = beam.node;
+    if( node && [_beamsByNode objectForKey:node] == beam ) {
+        [_beamsByNode removeObjectForKey:node];
+        node.geometry = nil;
+    }
+    [_beams removeObject:beam];
+    _stats.beams = _beams.count;
+}
+
+#pragma mark - Metal
+
+- (void) prepareDrawNode {
+    if( _draw ) return;
+
+    SCNNode *sceneRoot = [Scene main].scene.rootNode;
+    if( sceneRoot == nil ) return;  // Tried again next update.
+
+    _drawNode = [SCNNode node];
+    _drawNode.name = @"ScanBeams";
+    _drawNode.categoryBitMask |= RAYCAST_IGNORE_BIT;
+    _drawNode.renderingOrder = TRANSPARENCY_RENDERING_ORDER + 90;
+    [sceneRoot addChildNode:_drawNode];
+
+    _instanceBlock = [[UniformRing main] reserveBlockWithLength:sizeof(_instances)];
+    _draw = [[StereoRenderer main] drawProceduralNode:_drawNode
+                                          vertexCount:BEAM_RENDERER_TRIANGLES * 3
+                                   vertexFunctionName:@"OBEBeamVertex"
+                                 fragmentFunctionName:@"OBEBeamFragment"
+                                            blendMode:SCNBlendModeAdd
+                                     readsDepthBuffer:YES
+                                    writesDepthBuffer:YES];
+    if( _draw == nil ) {
+        NSLog(@"BeamRenderer: === Error === Can't draw beams, OpenBE.metal has no OBEBeamVertexInstanced");
+        return;
+    }
+    _draw.properties = _instanceBlock;
+    _draw.instanceCount = 0;
+}
+
+- (void) update {
+    _stats.drawn = 0;
+    _stats.dropped = 0;
+
+    // Beams whose node went away.
+    for( NSInteger i=(NSInteger)_beams.count-1; i>=0; i-- ) {
+        if( _beams[i].node == nil ) [_beams removeObjectAtIndex:i];
+    }
+    _stats.beams = _beams.count;
+
+    if( ![self usesMetal] || _beams.count == 0 ) {
+        _draw.instanceCount = 0;
+        return;
+    }
+
+    [self prepareDrawNode];
+    if( _draw == nil ) return;
+
+    SCNNode *sceneRoot = _drawNode.parentNode;
+    NSUInteger count = 0;
+    for( BeamInstance *beam in _beams ) {
+        float active = beam.active;
+        SCNNode *node = beam.node;
+        if( active <= 0.f || nodeHidden(node, sceneRoot) ) continue;
+
+        if( count == BEAM_RENDERER_MAX_BEAMS ) {
+            _stats.dropped++;
+            continue;
+        }
+
+        GLKVector3 start = beam.startPos;
+        GLKVector3 end = beam.endPos;
+        OBEBeamInstance &instance = _instances[count++];
+        instance.modelTransform = toSimd(node.worldTransform);
+        instance.start = simd_make_float4(start.x, start.y, start.z, beam.width);
+        instance.end = simd_make_float4(end.x, end.y, end.z, beam.height);
+        instance.params = simd_make_float4(active, beam.seed, 0, 0);
+    }
+
+    // Only the beams drawn are read, the rest of the block can be stale.
+    if( count > 0 ) [_instanceBlock update:_instances];
+    _draw.instanceCount = count;
+    _stats.drawn = count;
+}
+
+#pragma mark - GL
+
+- (SCNGeometry *) sharedGeometry {
+    if( _geometry ) return _geometry;
+
+    // Each triangle's corners, with its number in z for the hash. The same for every beam.
+    SCNVector3 positions[BEAM_RENDERER_TRIANGLES*3];
+    uint16_t indices[BEAM_RENDERER_TRIANGLES*3];
+    for( int i=0; i<BEAM_RENDERER_TRIANGLES; i++ ) {
+        positions[i*3+0] = SCNVector3Make(0, 0, i);
+        positions[i*3+1] = SCNVector3Make(1, 1, i);
+        positions[i*3+2] = SCNVector3Make(1, 0, i);
+    }
+    for( int i=0; i<BEAM_RENDERER_TRIANGLES*3; i++ ) indices[i] = (uint16_t)i;
+
+    SCNGeometrySource *vertexSource = [SCNGeometrySource geometrySourceWithVertices:positions count:(BEAM_RENDERER_TRIANGLES*3)];
+    SCNGeometryElement *element = [SCNGeometryElement geometryElementWithData:[NSData dataWithBytes:indices length:sizeof(indices)]
+                                                                primitiveType:SCNGeometryPrimitiveTypeTriangles
+                                                               primitiveCount:BEAM_RENDERER_TRIANGLES
+                                                                bytesPerIndex:sizeof(uint16_t)];
+    _geometry = [SCNGeometry geometryWithSources:@[vertexSource] elements:@[element]];
+
+    SCNMaterial *material = [SCNMaterial material];
+    material.doubleSided = YES;
+    material.program = [[ShaderCache main] glProgramNamed:@"Shaders/CombinedShader/combinedShader" variant:ShaderVariantTransparent];
+    material.blendMode = SCNBlendModeAdd;
+
+    // Every beam's parameters in one uniform array, looked up by the node drawn.
+    __weak NSMapTable<SCNNode *, BeamInstance *> *beamsByNode = _beamsByNode;
+    [material handleBindingOfSymbol:@"beam" usingBlock:^(unsigned int programID, unsigned int location, SCNNode *renderedNode, SCNRenderer *renderer) {
+        BeamInstance *beam = [beamsByNode objectForKey:renderedNode];
+        if( beam == nil ) return;
+
+        GLKVector3 start = beam.startPos;
+        GLKVector3 end = beam.endPos;
+        GLfloat packed[12] = {
+            start.x, start.y, start.z, beam.width,
+            end.x, end.y, end.z, beam.height,
+            beam.active, beam.seed, 0, 0,
+        };
+        glUniform4fv(location, 3, packed);
+    }];
+
+    [material handleBindingOfSymbol:@"shaderType" usingBlock:^(unsigned int programID, unsigned int location, SCNNode *renderedNode, SCNRenderer *renderer) {
+        glUniform1f(location, BeamShaderType);
+    }];
+
+    _geometry.materials = @[material];
+    return _geometry;
+}
+
+- (BeamRendererStats) stats {
+    return _stats;
+}
+
+@end
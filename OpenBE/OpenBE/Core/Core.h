@@ -25,6 +25,9 @@
 
 // #define ENABLE_COMPONENT_PROFILING 1
 
+// Color the scan from the color camera, and keep it colored out of view. Metal only.
+// #define ENABLE_ENVIRONMENT_TEXTURING 1
+
 /**
  * Transaprency and world rendering is put at specific render order levels,
  * relative to the background rendering
@@ -49,3 +52,16 @@
 #import "GeometryComponent.h"
 #import "SceneManager.h"
 #import "EventManager.h"
+#import "RenderCommandQueue.h"
+#import "FrameReplay.h"
+#import "EntityRegistry.h"
+#import "SpatialIndex.h"
+#import "LineOfSight.h"
+#import "PhysicsManager.h"
+#import "UniformRing.h"
+#import "MaterialParameters.h"
+#import "ShaderCache.h"
+#import "PortalRenderer.h"
+#import "StereoRenderer.h"
+#import "BeamRenderer.h"
+#import "EnvironmentTexturer.h"
@@ -0,0 +1,128 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Entity registry owned by the SceneManager.
+//
+//  Every entity gets a stable integer EntityID. Entities are kept in one dense
+//  array, and every component class has its own dense component array plus a
+//  sparse entity -> component index, so adding or removing an entity or a
+//  component, and looking up an entity's component by class, are all O(1).
+//  A removed entity leaves a hole in the dense entity array, closed in one
+//  pass the next time entities are walked by index, so the others keep their
+//  insertion order, which is their update order.
+//
+//  Queries over several component classes walk the smallest matching dense
+//  array and test the others through their sparse index, rather than scanning
+//  every entity's component list.
+//
+//  Class lookups match subclasses too, the same as ComponentUtils (isKindOfClass:).
+//
+//  Not thread safe, mutate from one thread at a time like SceneManager.entities.
+//
+
+#import <GameplayKit/GameplayKit.h>
+#import <SceneKit/SceneKit.h>
+
+/// Stable entity handle.
+/// Slot index in the low 20 bits and a generation in the high 12 bits, so the ID
+/// of a removed entity doesn't resolve to a later entity that reuses its slot.
+typedef uint32_t EntityID;
+
+#define ENTITY_ID_INVALID ((EntityID)0xFFFFFFFF)
+
+@class EntityRegistry;
+
+/**
+ * Entity created by the SceneManager.
+ * Keeps its registry's component index up to date as components are added and removed.
+ */
+@interface Entity : GKEntity
+
+/// ENTITY_ID_INVALID until added to a registry.
+@property (nonatomic, readonly) EntityID entityID;
+
+@end
+
+@interface EntityRegistry : NSObject
+
+/// Number of registered entities.
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ * Register an entity and index its components.
+ * Components added later are only tracked for Entity instances.
+ * @return The entity's ID, the existing one if it was already registered.
+ */
+- (EntityID) addEntity:(GKEntity *)entity;
+
+/// Unregister an entity, dropping its components from the index. The ID becomes stale.
+- (void) removeEntity:(GKEntity *)entity;
+
+- (BOOL) containsEntity:(GKEntity *)entity;
+
+/// ENTITY_ID_INVALID if not registered.
+- (EntityID) idForEntity:(GKEntity *)entity;
+
+/// nil if the ID is stale.
+- (GKEntity *) entityForID:(EntityID)entityID;
+
+/**
+ * Dense access, for iterating every entity without a copy.
+ * Order is insertion order, removals included. A removal shifts the later entities down an index,
+ * so don't remove entities while walking them by index.
+ */
+- (GKEntity *) entityAtIndex:(NSUInteger)index;
+
+/// Snapshot of all entities.
+- (NSArray<GKEntity *> *) allEntities;
+
+#pragma mark - Components
+
+/// The entity's component of class aClass, or a subclass of it. nil if none.
+- (GKComponent *) componentOfClass:(Class)aClass forEntity:(GKEntity *)entity;
+
+/// All the entity's components of class aClass, or subclasses of it.
+- (NSMutableArray *) componentsOfClass:(Class)aClass forEntity:(GKEntity *)entity;
+
+/// All registered components of class aClass, or subclasses of it.
+- (NSArray *) allComponentsOfClass:(Class)aClass;
+
+/**
+ * Visit every entity that has a component of each of the classes.
+ * Don't add or remove entities or components from inside the block.
+ */
+- (void) enumerateEntitiesWithComponentClasses:(NSArray<Class> *)classes
+                                    usingBlock:(void (^)(GKEntity *entity, BOOL *stop))block;
+
+- (NSArray<GKEntity *> *) entitiesWithComponentClasses:(NSArray<Class> *)classes;
+
+#pragma mark - Nodes
+
+/**
+ * Map a scene node to the entity it belongs to.
+ * Done automatically for GeometryComponent nodes. Both sides are held weakly.
+ */
+- (void) setEntity:(GKEntity *)entity forNode:(SCNNode *)node;
+
+/// Entity of the node, or of its closest mapped parent. nil if none.
+- (GKEntity *) entityForNode:(SCNNode *)node;
+
+@end
+
+@interface EntityRegistry (Benchmark)
+
+/**
+ * Compare the registry against linear ComponentUtils scans over an entity array,
+ * with entityCount entities. Logs and returns the results.
+ * RUN ON MAIN THREAD ONLY
+ */
++ (NSString *) benchmarkWithEntityCount:(NSUInteger)entityCount;
+
+@end
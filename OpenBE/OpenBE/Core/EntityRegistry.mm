@@ -0,0 +1,601 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "EntityRegistry.h"
+#import "GeometryComponent.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    const uint32_t kSlotBits = 20;
+    const uint32_t kSlotMask = (1u << kSlotBits) - 1;
+    const uint32_t kGenerationMask = (1u << (32 - kSlotBits)) - 1;
+    const uint32_t kInvalidIndex = 0xFFFFFFFF;
+
+    inline uint32_t slotOfID( EntityID entityID ) { return entityID & kSlotMask; }
+    inline uint32_t generationOfID( EntityID entityID ) { return entityID >> kSlotBits; }
+    inline EntityID makeID( uint32_t slot, uint32_t generation ) { return ((generation & kGenerationMask) << kSlotBits) | slot; }
+
+    inline uintptr_t keyOf( __unsafe_unretained id object ) { return (uintptr_t)(__bridge void *)object; }
+
+    struct EntitySlot
+    {
+        uint32_t generation = 0;
+        uint32_t dense = kInvalidIndex;  // Index into the dense entity arrays, or kInvalidIndex if free.
+    };
+
+    /**
+     * Dense components of one exact class, with a sparse index by entity slot.
+     * GameplayKit allows one component per class per entity, so each slot maps to at most one entry.
+     */
+    struct ComponentPool
+    {
+        Class componentClass;
+        std::vector<uint32_t> sparse;       // Entity slot -> dense index.
+        std::vector<uint32_t> ownerSlots;   // Dense.
+        std::vector<GKComponent *> components; // Dense, strong.
+
+        explicit ComponentPool( Class cls ) : componentClass(cls) {}
+
+        size_t size() const { return components.size(); }
+
+        GKComponent *get( uint32_t slot ) const {
+            if( slot >= sparse.size() || sparse[slot] == kInvalidIndex ) return nil;
+            return components[sparse[slot]];
+        }
+
+        bool has( uint32_t slot ) const {
+            return slot < sparse.size() && sparse[slot] != kInvalidIndex;
+        }
+
+        void set( uint32_t slot, GKComponent *component ) {
+            if( slot >= sparse.size() ) sparse.resize(slot + 1, kInvalidIndex);
+            if( sparse[slot] != kInvalidIndex ) {
+                components[sparse[slot]] = component;
+                return;
+            }
+            sparse[slot] = (uint32_t)components.size();
+            ownerSlots.push_back(slot);
+            components.push_back(component);
+        }
+
+        void remove( uint32_t slot ) {
+            if( !has(slot) ) return;
+            uint32_t index = sparse[slot];
+            uint32_t last = (uint32_t)components.size() - 1;
+            if( index != last ) {
+                components[index] = components[last];
+                ownerSlots[index] = ownerSlots[last];
+                sparse[ownerSlots[index]] = index;
+            }
+            components.pop_back();
+            ownerSlots.pop_back();
+            sparse[slot] = kInvalidIndex;
+        }
+    };
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+} // anonymous
+
+#pragma mark - Entity
+
+@interface Entity ()
+@property (nonatomic, readwrite) EntityID entityID;
+@property (nonatomic, weak) EntityRegistry *registry;
+@end
+
+@interface EntityRegistry ()
+- (void) entity:(Entity *)entity didAddComponent:(GKComponent *)component;
+- (void) entity:(Entity *)entity willRemoveComponent:(GKComponent *)component;
+@end
+
+@implementation Entity
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _entityID = ENTITY_ID_INVALID;
+    }
+    return self;
+}
+
+- (void) addComponent:(GKComponent *)component {
+    // Adding a component replaces any existing component of the same class.
+    GKComponent *replaced = [self componentForClass:[component class]];
+    if( replaced && replaced != component ) {
+        [self.registry entity:self willRemoveComponent:replaced];
+    }
+
+    [super addComponent:component];
+    [self.registry entity:self didAddComponent:component];
+}
+
+- (void) removeComponentForClass:(Class)componentClass {
+    GKComponent *component = [self componentForClass:componentClass];
+    if( component ) {
+        [self.registry entity:self willRemoveComponent:component];
+    }
+
+    [super removeComponentForClass:componentClass];
+}
+
+@end
+
+#pragma mark - EntityRegistry
+
+@implementation EntityRegistry
+{
+    std::vector<EntitySlot> _slots;
+    std::vector<uint32_t> _freeSlots;
+
+    // Dense, in step with each other, in insertion order.
+    // A removed entity leaves a nil hole, closed by compactEntities.
+    std::vector<GKEntity *> _entities;
+    std::vector<uint32_t> _entitySlots;
+    size_t _holes;
+
+    // Entity pointer -> ID, for entities that aren't an Entity.
+    std::unordered_map<uintptr_t, EntityID> _foreignIDs;
+
+    std::vector<std::unique_ptr<ComponentPool>> _pools;
+    std::unordered_map<uintptr_t, size_t> _poolForClass;
+
+    // Query class -> pools of that class and its subclasses. Reset when a pool is added.
+    std::unordered_map<uintptr_t, std::vector<ComponentPool *>> _kindPools;
+
+    NSMapTable<SCNNode *, GKEntity *> *_nodeEntities;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _nodeEntities = [NSMapTable weakToWeakObjectsMapTable];
+    }
+    return self;
+}
+
+- (NSUInteger) count {
+    return _entities.size() - _holes;
+}
+
+#pragma mark - Entities
+
+- (uint32_t) slotForEntity:(GKEntity *)entity {
+    if( entity == nil ) return kInvalidIndex;
+
+    EntityID entityID = [self idForEntity:entity];
+    return entityID == ENTITY_ID_INVALID ? kInvalidIndex : slotOfID(entityID);
+}
+
+- (EntityID) idForEntity:(GKEntity *)entity {
+    if( [entity isKindOfClass:[Entity class]] ) {
+        Entity *ownEntity = (Entity *)entity;
+        return ownEntity.registry == self ? ownEntity.entityID : ENTITY_ID_INVALID;
+    }
+
+    auto found = _foreignIDs.find(keyOf(entity));
+    return found == _foreignIDs.end() ? ENTITY_ID_INVALID : found->second;
+}
+
+- (BOOL) containsEntity:(GKEntity *)entity {
+    return [self idForEntity:entity] != ENTITY_ID_INVALID;
+}
+
+- (EntityID) addEntity:(GKEntity *)entity {
+    if( entity == nil ) return ENTITY_ID_INVALID;
+
+    EntityID existing = [self idForEntity:entity];
+    if( existing != ENTITY_ID_INVALID ) return existing;
+
+    uint32_t slot;
+    if( !_freeSlots.empty() ) {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    } else {
+        slot = (uint32_t)_slots.size();
+        if( slot > kSlotMask ) {
+            NSLog(@"EntityRegistry: === Error === Out of entity slots.");
+            return ENTITY_ID_INVALID;
+        }
+        _slots.push_back(EntitySlot());
+    }
+
+    EntitySlot &entitySlot = _slots[slot];
+    entitySlot.dense = (uint32_t)_entities.size();
+    _entities.push_back(entity);
+    _entitySlots.push_back(slot);
+
+    EntityID entityID = makeID(slot, entitySlot.generation);
+    if( [entity isKindOfClass:[Entity class]] ) {
+        Entity *ownEntity = (Entity *)entity;
+        ownEntity.entityID = entityID;
+        ownEntity.registry = self;
+    } else {
+        _foreignIDs[keyOf(entity)] = entityID;
+    }
+
+    for( GKComponent *component in entity.components ) {
+        [self indexComponent:component slot:slot entity:entity];
+    }
+
+    return entityID;
+}
+
+- (void) removeEntity:(GKEntity *)entity {
+    uint32_t slot = [self slotForEntity:entity];
+    if( slot == kInvalidIndex ) return;
+
+    for( GKComponent *component in entity.components ) {
+        [self unindexComponent:component slot:slot];
+    }
+
+    // Leave a hole rather than moving another entity into it, so the others keep their update order.
+    EntitySlot &entitySlot = _slots[slot];
+    _entities[entitySlot.dense] = nil;
+    _entitySlots[entitySlot.dense] = kInvalidIndex;
+    _holes++;
+
+    entitySlot.dense = kInvalidIndex;
+    entitySlot.generation = (entitySlot.generation + 1) & kGenerationMask;
+    _freeSlots.push_back(slot);
+
+    if( [entity isKindOfClass:[Entity class]] ) {
+        Entity *ownEntity = (Entity *)entity;
+        ownEntity.entityID = ENTITY_ID_INVALID;
+        ownEntity.registry = nil;
+    } else {
+        _foreignIDs.erase(keyOf(entity));
+    }
+}
+
+- (GKEntity *) entityForID:(EntityID)entityID {
+    uint32_t slot = slotOfID(entityID);
+    if( entityID == ENTITY_ID_INVALID || slot >= _slots.size() ) return nil;
+
+    const EntitySlot &entitySlot = _slots[slot];
+    if( entitySlot.dense == kInvalidIndex || entitySlot.generation != generationOfID(entityID) ) return nil;
+
+    return _entities[entitySlot.dense];
+}
+
+/// Close the holes removals left, keeping the order. One pass however many entities were removed.
+- (void) compactEntities {
+    if( _holes == 0 ) return;
+
+    uint32_t kept = 0;
+    for( uint32_t index = 0; index < _entities.size(); index++ ) {
+        uint32_t slot = _entitySlots[index];
+        if( slot == kInvalidIndex ) continue;
+
+        _entities[kept] = _entities[index];
+        _entitySlots[kept] = slot;
+        _slots[slot].dense = kept;
+        kept++;
+    }
+    _entities.resize(kept);
+    _entitySlots.resize(kept);
+    _holes = 0;
+}
+
+- (GKEntity *) entityAtIndex:(NSUInteger)index {
+    [self compactEntities];
+    return index < _entities.size() ? _entities[index] : nil;
+}
+
+- (NSArray<GKEntity *> *) allEntities {
+    [self compactEntities];
+    NSMutableArray<GKEntity *> *entities = [NSMutableArray arrayWithCapacity:_entities.size()];
+    for( GKEntity *entity : _entities ) {
+        [entities addObject:entity];
+    }
+    return entities;
+}
+
+#pragma mark - Component Index
+
+- (ComponentPool *) poolForExactClass:(Class)cls create:(BOOL)create {
+    auto found = _poolForClass.find(keyOf(cls));
+    if( found != _poolForClass.end() ) return _pools[found->second].get();
+    if( !create ) return nullptr;
+
+    _poolForClass[keyOf(cls)] = _pools.size();
+    _pools.emplace_back(new ComponentPool(cls));
+    _kindPools.clear();
+    return _pools.back().get();
+}
+
+- (const std::vector<ComponentPool *> &) poolsOfKind:(Class)cls {
+    auto found = _kindPools.find(keyOf(cls));
+    if( found != _kindPools.end() ) return found->second;
+
+    std::vector<ComponentPool *> &pools = _kindPools[keyOf(cls)];
+    for( const std::unique_ptr<ComponentPool> &pool : _pools ) {
+        if( [pool->componentClass isSubclassOfClass:cls] ) {
+            pools.push_back(pool.get());
+        }
+    }
+    return pools;
+}
+
+- (void) indexComponent:(GKComponent *)component slot:(uint32_t)slot entity:(GKEntity *)entity {
+    [self poolForExactClass:[component class] create:YES]->set(slot, component);
+
+    if( [component isKindOfClass:[GeometryComponent class]] ) {
+        SCNNode *node = ((GeometryComponent *)component).node;
+        if( node ) [_nodeEntities setObject:entity forKey:node];
+    }
+}
+
+- (void) unindexComponent:(GKComponent *)component slot:(uint32_t)slot {
+    ComponentPool *pool = [self poolForExactClass:[component class] create:NO];
+    if( pool ) pool->remove(slot);
+
+    if( [component isKindOfClass:[GeometryComponent class]] ) {
+        SCNNode *node = ((GeometryComponent *)component).node;
+        if( node ) [_nodeEntities removeObjectForKey:node];
+    }
+}
+
+- (void) entity:(Entity *)entity didAddComponent:(GKComponent *)component {
+    uint32_t slot = [self slotForEntity:entity];
+    if( slot != kInvalidIndex ) [self indexComponent:component slot:slot entity:entity];
+}
+
+- (void) entity:(Entity *)entity willRemoveComponent:(GKComponent *)component {
+    uint32_t slot = [self slotForEntity:entity];
+    if( slot != kInvalidIndex ) [self unindexComponent:component slot:slot];
+}
+
+#pragma mark - Components
+
+- (GKComponent *) componentOfClass:(Class)aClass forEntity:(GKEntity *)entity {
+    uint32_t slot = [self slotForEntity:entity];
+    if( slot == kInvalidIndex ) return nil;
+
+    GKComponent *ret = nil;
+    int counter = 0;
+    for( ComponentPool *pool : [self poolsOfKind:aClass] ) {
+        GKComponent *component = pool->get(slot);
+        if( component ) {
+            ret = component;
+            counter++;
+        }
+    }
+
+    if( counter > 1 ) {
+        NSLog(@"Error, more then one component of class %@", aClass);
+    }
+    return ret;
+}
+
+- (NSMutableArray *) componentsOfClass:(Class)aClass forEntity:(GKEntity *)entity {
+    NSMutableArray *ret = [[NSMutableArray alloc] initWithCapacity:8];
+
+    uint32_t slot = [self slotForEntity:entity];
+    if( slot == kInvalidIndex ) return ret;
+
+    for( ComponentPool *pool : [self poolsOfKind:aClass] ) {
+        GKComponent *component = pool->get(slot);
+        if( component ) [ret addObject:component];
+    }
+    return ret;
+}
+
+- (NSArray *) allComponentsOfClass:(Class)aClass {
+    NSMutableArray *ret = [NSMutableArray array];
+    for( ComponentPool *pool : [self poolsOfKind:aClass] ) {
+        for( GKComponent *component : pool->components ) {
+            [ret addObject:component];
+        }
+    }
+    return ret;
+}
+
+- (void) enumerateEntitiesWithComponentClasses:(NSArray<Class> *)classes
+                                    usingBlock:(void (^)(GKEntity *entity, BOOL *stop))block
+{
+    if( classes.count == 0 ) return;
+
+    // Resolve each class to its pools, and drive the walk from the smallest set.
+    std::vector<const std::vector<ComponentPool *> *> kinds;
+    size_t driver = 0;
+    size_t driverSize = SIZE_MAX;
+    for( Class cls in classes ) {
+        const std::vector<ComponentPool *> &pools = [self poolsOfKind:cls];
+        size_t size = 0;
+        for( ComponentPool *pool : pools ) size += pool->size();
+        if( size == 0 ) return;
+
+        if( size < driverSize ) {
+            driver = kinds.size();
+            driverSize = size;
+        }
+        kinds.push_back(&pools);
+    }
+
+    // Copy the driving slots first, so the block can't invalidate the walk.
+    std::vector<uint32_t> slots;
+    slots.reserve(driverSize);
+    for( ComponentPool *pool : *kinds[driver] ) {
+        slots.insert(slots.end(), pool->ownerSlots.begin(), pool->ownerSlots.end());
+    }
+
+    BOOL stop = NO;
+    for( uint32_t slot : slots ) {
+        bool matches = true;
+        for( size_t k = 0; k < kinds.size() && matches; k++ ) {
+            if( k == driver ) continue;
+
+            bool found = false;
+            for( ComponentPool *pool : *kinds[k] ) {
+                if( pool->has(slot) ) { found = true; break; }
+            }
+            matches = found;
+        }
+        if( !matches ) continue;
+
+        uint32_t dense = _slots[slot].dense;
+        if( dense == kInvalidIndex ) continue;
+
+        block(_entities[dense], &stop);
+        if( stop ) break;
+    }
+}
+
+- (NSArray<GKEntity *> *) entitiesWithComponentClasses:(NSArray<Class> *)classes {
+    NSMutableArray<GKEntity *> *ret = [NSMutableArray array];
+    [self enumerateEntitiesWithComponentClasses:classes usingBlock:^(GKEntity *entity, BOOL *stop) {
+        [ret addObject:entity];
+    }];
+    return ret;
+}
+
+#pragma mark - Nodes
+
+- (void) setEntity:(GKEntity *)entity forNode:(SCNNode *)node {
+    if( node == nil ) return;
+
+    if( entity ) {
+        [_nodeEntities setObject:entity forKey:node];
+    } else {
+        [_nodeEntities removeObjectForKey:node];
+    }
+}
+
+- (GKEntity *) entityForNode:(SCNNode *)node {
+    while( node ) {
+        GKEntity *entity = [_nodeEntities objectForKey:node];
+        if( entity ) return entity;
+        node = node.parentNode;
+    }
+    return nil;
+}
+
+@end
+
+#pragma mark - Benchmark
+
+@interface EntityRegistryBenchmarkComponentA : GKComponent
+@end
+@implementation EntityRegistryBenchmarkComponentA
+@end
+
+@interface EntityRegistryBenchmarkComponentB : GKComponent
+@end
+@implementation EntityRegistryBenchmarkComponentB
+@end
+
+@interface EntityRegistryBenchmarkComponentC : GKComponent
+@end
+@implementation EntityRegistryBenchmarkComponentC
+@end
+
+@implementation EntityRegistry (Benchmark)
+
++ (NSString *) benchmarkWithEntityCount:(NSUInteger)entityCount {
+    EntityRegistry *registry = [[EntityRegistry alloc] init];
+    NSMutableArray<GKEntity *> *entities = [NSMutableArray arrayWithCapacity:entityCount];
+
+    Class classA = [EntityRegistryBenchmarkComponentA class];
+    Class classB = [EntityRegistryBenchmarkComponentB class];
+    Class classC = [EntityRegistryBenchmarkComponentC class];
+
+    // Every entity has an A, every other one a B, and every third one a C.
+    uint64_t start = mach_absolute_time();
+    for( NSUInteger i=0; i<entityCount; i++ ) {
+        Entity *entity = [[Entity alloc] init];
+        [registry addEntity:entity];
+        [entity addComponent:[[EntityRegistryBenchmarkComponentA alloc] init]];
+        if( i % 2 == 0 ) [entity addComponent:[[EntityRegistryBenchmarkComponentB alloc] init]];
+        if( i % 3 == 0 ) [entity addComponent:[[EntityRegistryBenchmarkComponentC alloc] init]];
+        [entities addObject:entity];
+    }
+    double addMs = machTicksToMs(mach_absolute_time() - start);
+
+    // Query: entities with both B and C.
+    __block NSUInteger registryMatches = 0;
+    start = mach_absolute_time();
+    [registry enumerateEntitiesWithComponentClasses:@[classB, classC] usingBlock:^(GKEntity *entity, BOOL *stop) {
+        registryMatches++;
+    }];
+    double registryQueryMs = machTicksToMs(mach_absolute_time() - start);
+
+    NSUInteger linearMatches = 0;
+    start = mach_absolute_time();
+    for( GKEntity *entity in entities ) {
+        BOOL hasB = NO, hasC = NO;
+        for( GKComponent *component in entity.components ) {
+            if( [component isKindOfClass:classB] ) hasB = YES;
+            if( [component isKindOfClass:classC] ) hasC = YES;
+        }
+        if( hasB && hasC ) linearMatches++;
+    }
+    double linearQueryMs = machTicksToMs(mach_absolute_time() - start);
+
+    // Lookup: one sibling component per entity.
+    NSUInteger found = 0;
+    start = mach_absolute_time();
+    for( GKEntity *entity in entities ) {
+        if( [registry componentOfClass:classC forEntity:entity] ) found++;
+    }
+    double registryLookupMs = machTicksToMs(mach_absolute_time() - start);
+
+    start = mach_absolute_time();
+    for( GKEntity *entity in entities ) {
+        for( GKComponent *component in entity.components ) {
+            if( [component isKindOfClass:classC] ) { found++; break; }
+        }
+    }
+    double linearLookupMs = machTicksToMs(mach_absolute_time() - start);
+
+    // Remove every entity, in order, the worst case for an array.
+    start = mach_absolute_time();
+    for( GKEntity *entity in entities ) {
+        [registry removeEntity:entity];
+    }
+    double registryRemoveMs = machTicksToMs(mach_absolute_time() - start);
+
+    NSMutableArray<GKEntity *> *array = [entities mutableCopy];
+    start = mach_absolute_time();
+    for( GKEntity *entity in entities ) {
+        [array removeObject:entity];
+    }
+    double arrayRemoveMs = machTicksToMs(mach_absolute_time() - start);
+
+    be_assert( registryMatches == linearMatches, "Registry query mismatch %lu != %lu", (unsigned long)registryMatches, (unsigned long)linearMatches );
+    be_assert( registry.count == 0, "Registry not empty after removal" );
+
+    NSString *report = [NSString stringWithFormat:
+        @"EntityRegistry benchmark, %lu entities (%lu matches, %lu lookups)\n"
+         "  add:    %0.3f (ms)\n"
+         "  query:  %0.3f (ms) registry, %0.3f (ms) linear\n"
+         "  lookup: %0.3f (ms) registry, %0.3f (ms) linear\n"
+         "  remove: %0.3f (ms) registry, %0.3f (ms) array",
+        (unsigned long)entityCount, (unsigned long)registryMatches, (unsigned long)found / 2,
+        addMs,
+        registryQueryMs, linearQueryMs,
+        registryLookupMs, linearLookupMs,
+        registryRemoveMs, arrayRemoveMs];
+    NSLog(@"%@", report);
+    return report;
+}
+
+@end
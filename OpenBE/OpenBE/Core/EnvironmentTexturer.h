@@ -0,0 +1,75 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Colors the scanned environment mesh from the color camera, on the GPU,
+//  and keeps it colored where the camera isn't looking.
+//
+//  Every triangle of the scene mesh gets a few texels, two triangles to a
+//  square cell, in one GPU buffer. When the color camera has moved far
+//  enough, its next frame is fetched off the render thread, as that waits on
+//  the camera, and becomes a keyframe on a later frame: the pixel buffer is
+//  wrapped as a Metal texture without copying, the mesh's depth is rendered
+//  from the frame's pose, and a compute pass projects every texel into the
+//  frame with colorFrameGLProjection, blending in the ones it sees
+//  unoccluded, weighted by how squarely. Weights are capped, so recent keyframes keep refreshing
+//  what older ones saw.
+//
+//  The mesh is drawn from its texels by the StereoRenderer, over Bridge
+//  Engine's own pass, fading out where the color camera sees it this frame
+//  so the live image shows there.
+//
+//  Metal only. Started by the SceneManager with ENABLE_ENVIRONMENT_TEXTURING,
+//  and updated after the components.
+//  RENDER THREAD ONLY, unless noted.
+//
+
+#import <BridgeEngine/BridgeEngine.h>
+
+// Texels on a side of a cell, two triangles' worth. Matches OBEEnvironmentCellSize in OpenBE.metal.
+#define ENVIRONMENT_TEXTURER_CELL_SIZE 6
+
+// Triangles textured, the rest of the mesh is left out.
+#define ENVIRONMENT_TEXTURER_MAX_TRIANGLES (1 << 17)
+
+// A keyframe is taken once the color camera has moved or turned this far from the last one, and this long after it.
+#define ENVIRONMENT_TEXTURER_KEYFRAME_DISTANCE 0.15f
+#define ENVIRONMENT_TEXTURER_KEYFRAME_DEGREES 15.f
+#define ENVIRONMENT_TEXTURER_KEYFRAME_INTERVAL 0.5
+
+typedef struct {
+    NSUInteger triangles;           // Textured.
+    NSUInteger keyframes;           // Accumulated since start.
+    NSUInteger skippedKeyframes;    // Due, but without a color frame, or the last one still being fetched or on the GPU.
+    NSUInteger texelBytes;
+} EnvironmentTexturerStats;
+
+@interface EnvironmentTexturer : NSObject
+
+/// Singleton.
++ (EnvironmentTexturer *) main;
+
+@property (nonatomic, readonly) BOOL running;
+
+/**
+ * Copy the scene mesh to the GPU, and start taking keyframes and drawing it.
+ * Does nothing when not rendering with Metal.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (void) startWithMixedRealityMode:(BEMixedRealityMode *)mixedRealityMode;
+
+/// Stop drawing, and let go of the mesh and its texels. RUN ON MAIN THREAD ONLY
+- (void) stop;
+
+/// Follow the color camera, and take a keyframe when due.
+- (void) update;
+
+- (EnvironmentTexturerStats) stats;
+
+@end
@@ -0,0 +1,500 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "EnvironmentTexturer.h"
+#import "Core.h"
+
+#import <BridgeEngine/BEDebugging.h>
+#import <CoreVideo/CoreVideo.h>
+#import <GLKit/GLKit.h>
+#import <Metal/Metal.h>
+#import <QuartzCore/QuartzCore.h>
+
+#include <atomic>
+#include <cmath>
+
+// Cells accumulated by one threadgroup, each cell's texels in a row.
+#define ENVIRONMENT_TEXTURER_CELLS_PER_GROUP 4
+
+// Keyframe depth is rendered at this fraction of the color frame's size.
+#define ENVIRONMENT_TEXTURER_DEPTH_DOWNSAMPLE 4
+
+// Depth, in NDC, a texel can be behind the keyframe's depth and still be seen.
+#define ENVIRONMENT_TEXTURER_DEPTH_BIAS 0.002f
+
+// Accumulated weight a texel stops at. One squarely seen keyframe adds 1.
+#define ENVIRONMENT_TEXTURER_MAX_WEIGHT 4.f
+
+// NDC from the color frame's edge over which the live image fades into the texels.
+#define ENVIRONMENT_TEXTURER_LIVE_MARGIN 0.15f
+
+/// Matches OBEEnvironmentKeyframe in OpenBE.metal.
+typedef struct {
+    matrix_float4x4 viewProjection;
+    vector_float4 cameraPosition;
+    uint32_t triangleCount;
+    float maxWeight;
+    float depthBias;
+} OBEEnvironmentKeyframe;
+
+/// Matches OBEEnvironmentUniforms in OpenBE.metal.
+typedef struct {
+    matrix_float4x4 liveViewProjection;
+    float liveMargin;
+    float coverageScale;
+} OBEEnvironmentUniforms;
+
+namespace {
+
+    matrix_float4x4 toSimd( GLKMatrix4 m ) {
+        matrix_float4x4 result;
+        memcpy(&result, m.m, sizeof(result));
+        return result;
+    }
+
+    /// GL clip z runs from -w to w, Metal's from 0 to w.
+    GLKMatrix4 metalProjection( GLKMatrix4 glProjection ) {
+        const GLKMatrix4 glToMetal = GLKMatrix4Make(1, 0, 0, 0,
+                                                    0, 1, 0, 0,
+                                                    0, 0, 0.5f, 0,
+                                                    0, 0, 0.5f, 1);
+        return GLKMatrix4Multiply(glToMetal, glProjection);
+    }
+
+    MTLPixelFormat metalPixelFormat( OSType pixelFormat ) {
+        switch( pixelFormat ) {
+            case kCVPixelFormatType_32BGRA: return MTLPixelFormatBGRA8Unorm;
+            case kCVPixelFormatType_32RGBA: return MTLPixelFormatRGBA8Unorm;
+            default: return MTLPixelFormatInvalid;
+        }
+    }
+
+} // anonymous
+
+@implementation EnvironmentTexturer
+{
+    __weak BEMixedRealityMode *_mixedRealityMode;
+
+    id<MTLDevice> _device;
+    id<MTLCommandQueue> _commandQueue;
+    id<MTLRenderPipelineState> _depthPipeline;
+    id<MTLDepthStencilState> _depthState;
+    id<MTLComputePipelineState> _accumulatePipeline;
+    CVMetalTextureCacheRef _textureCache;
+
+    // The scene mesh, and its texels: rgb, and accumulated weight in a.
+    id<MTLBuffer> _positions;
+    id<MTLBuffer> _indices;
+    id<MTLBuffer> _texels;
+    NSUInteger _triangleCount;
+    BOOL _texelsCleared;
+
+    id<MTLTexture> _depthTexture;
+
+    SCNNode *_drawNode;
+    StereoDraw *_draw;
+    UniformBlock *_uniformBlock;
+    OBEEnvironmentUniforms _uniforms;
+
+    // Last keyframe, and the color camera relative to the device node, as last predicted.
+    BOOL _hasKeyframe;
+    GLKMatrix4 _keyframeDevicePose;
+    CFTimeInterval _keyframeTime;
+    GLKMatrix4 _deviceToColor;
+    GLKMatrix4 _colorProjection;
+
+    // Color frames are fetched on here, they wait on the camera.
+    dispatch_queue_t _colorFrameQueue;
+
+    // From asking for a color frame until its keyframe is off the GPU.
+    std::atomic<bool> _keyframeInFlight;
+
+    EnvironmentTexturerStats _stats;
+}
+
++ (EnvironmentTexturer *) main {
+    static EnvironmentTexturer *mainEnvironmentTexturer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainEnvironmentTexturer = [[EnvironmentTexturer alloc] init];
+    });
+
+    return mainEnvironmentTexturer;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _keyframeInFlight = false;
+        _colorFrameQueue = dispatch_queue_create("OpenBE.EnvironmentTexturer.colorFrames", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INITIATED, 0));
+        _stats = EnvironmentTexturerStats();
+    }
+    return self;
+}
+
+- (void) dealloc {
+    if( _textureCache ) CFRelease(_textureCache);
+}
+
+#pragma mark - Start and Stop
+
+- (void) startWithMixedRealityMode:(BEMixedRealityMode *)mixedRealityMode {
+    if( _running ) return;
+    if( [SceneManager main].renderingAPI != BEViewRenderingAPIMetal ) {
+        NSLog(@"EnvironmentTexturer: Needs Metal, not started");
+        return;
+    }
+
+    _mixedRealityMode = mixedRealityMode;
+    _device = mixedRealityMode.sceneKitRenderer.device ?: MTLCreateSystemDefaultDevice();
+    if( _device == nil || ![self preparePipelines] || ![self copySceneMesh] ) return;
+
+    if( _commandQueue == nil ) _commandQueue = [_device newCommandQueue];
+    if( _textureCache == NULL && CVMetalTextureCacheCreate(kCFAllocatorDefault, nil, _device, nil, &_textureCache) != kCVReturnSuccess ) {
+        NSLog(@"EnvironmentTexturer: === Error === Can't make a texture cache for color frames");
+        return;
+    }
+
+    if( _uniformBlock == nil ) _uniformBlock = [[UniformRing main] reserveBlockWithLength:sizeof(OBEEnvironmentUniforms)];
+    _uniforms = OBEEnvironmentUniforms();
+    _uniforms.liveMargin = ENVIRONMENT_TEXTURER_LIVE_MARGIN;
+    _uniforms.coverageScale = ENVIRONMENT_TEXTURER_MAX_WEIGHT;    // Shown in full from one keyframe's weight.
+    [_uniformBlock update:&_uniforms];
+
+    // Drawn with the environment's shadows, over Bridge Engine's pass of the mesh.
+    _drawNode = [SCNNode node];
+    _drawNode.name = @"TexturedEnvironment";
+    _drawNode.categoryBitMask |= RAYCAST_IGNORE_BIT;
+    _drawNode.castsShadow = NO;
+    _drawNode.renderingOrder = BEEnvironmentScanRenderingOrder + 1;
+    [mixedRealityMode.sceneKitScene.rootNode addChildNode:_drawNode];
+
+    _draw = [[StereoRenderer main] drawProceduralNode:_drawNode
+                                          vertexCount:_triangleCount * 3
+                                   vertexFunctionName:@"OBEEnvironmentVertex"
+                                 fragmentFunctionName:@"OBEEnvironmentFragment"
+                                            blendMode:SCNBlendModeAlpha
+                                     readsDepthBuffer:YES
+                                    writesDepthBuffer:NO];
+    if( _draw == nil ) {
+        NSLog(@"EnvironmentTexturer: === Error === Can't draw the environment, OpenBE.metal has no OBEEnvironmentVertexInstanced");
+        [self stop];
+        return;
+    }
+    _draw.properties = _uniformBlock;
+    _draw.buffers = @[_positions, _indices, _texels];
+
+    _hasKeyframe = NO;
+    _running = YES;
+}
+
+- (void) stop {
+    _running = NO;
+
+    [[StereoRenderer main] removeDraw:_draw];
+    [_drawNode removeFromParentNode];
+    _draw = nil;
+    _drawNode = nil;
+
+    // A keyframe still on the GPU holds on to its own references.
+    _positions = nil;
+    _indices = nil;
+    _texels = nil;
+    _depthTexture = nil;
+    _triangleCount = 0;
+    _stats.triangles = 0;
+    _stats.texelBytes = 0;
+}
+
+- (BOOL) preparePipelines {
+    if( _depthPipeline && _accumulatePipeline ) return YES;
+
+    id<MTLFunction> depthVertex = [[ShaderCache main] metalFunctionNamed:@"OBEEnvironmentDepthVertex"];
+    id<MTLFunction> accumulate = [[ShaderCache main] metalFunctionNamed:@"OBEEnvironmentAccumulate"];
+    if( depthVertex == nil || accumulate == nil ) {
+        NSLog(@"EnvironmentTexturer: === Error === OpenBE.metal has no OBEEnvironmentDepthVertex or OBEEnvironmentAccumulate");
+        return NO;
+    }
+
+    // Depth only, no fragment function or color.
+    MTLRenderPipelineDescriptor *descriptor = [[MTLRenderPipelineDescriptor alloc] init];
+    descriptor.label = @"EnvironmentTexturer depth";
+    descriptor.vertexFunction = depthVertex;
+    descriptor.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
+
+    NSError *error = nil;
+    _depthPipeline = [_device newRenderPipelineStateWithDescriptor:descriptor error:&error];
+    if( _depthPipeline == nil ) {
+        NSLog(@"EnvironmentTexturer: === Error === Can't build depth pipeline: %@", error);
+        return NO;
+    }
+
+    _accumulatePipeline = [_device newComputePipelineStateWithFunction:accumulate error:&error];
+    if( _accumulatePipeline == nil ) {
+        NSLog(@"EnvironmentTexturer: === Error === Can't build accumulate pipeline: %@", error);
+        return NO;
+    }
+
+    MTLDepthStencilDescriptor *depthDescriptor = [[MTLDepthStencilDescriptor alloc] init];
+    depthDescriptor.depthCompareFunction = MTLCompareFunctionLess;
+    depthDescriptor.depthWriteEnabled = YES;
+    _depthState = [_device newDepthStencilStateWithDescriptor:depthDescriptor];
+    return YES;
+}
+
+/// All submeshes into one position and one index buffer, in the scene's space.
+- (BOOL) copySceneMesh {
+    BEMixedRealityMode *mixedRealityMode = _mixedRealityMode;
+    BEMesh *mesh = [mixedRealityMode lockAndGetSceneMesh];
+
+    NSUInteger vertexCount = 0;
+    NSUInteger triangleCount = 0;
+    int meshCount = [mesh numberOfMeshes];
+    for( int m=0; m<meshCount; m++ ) {
+        vertexCount += [mesh numberOfMeshVertices:m];
+        triangleCount += [mesh numberOfMeshFaces:m];
+    }
+    if( triangleCount > ENVIRONMENT_TEXTURER_MAX_TRIANGLES ) {
+        NSLog(@"EnvironmentTexturer: Scene mesh has %lu triangles, texturing the first %d",
+              (unsigned long)triangleCount, ENVIRONMENT_TEXTURER_MAX_TRIANGLES);
+        triangleCount = ENVIRONMENT_TEXTURER_MAX_TRIANGLES;
+    }
+    if( triangleCount == 0 ) {
+        [mixedRealityMode unlockSceneMesh];
+        NSLog(@"EnvironmentTexturer: === Error === No scene mesh to texture");
+        return NO;
+    }
+
+    // Packed float3 positions, 32 bit indices, offset by each submesh's first vertex.
+    _positions = [_device newBufferWithLength:vertexCount * sizeof(float) * 3 options:MTLResourceCPUCacheModeWriteCombined];
+    _indices = [_device newBufferWithLength:triangleCount * sizeof(uint32_t) * 3 options:MTLResourceCPUCacheModeWriteCombined];
+    float *positions = (float *)_positions.contents;
+    uint32_t *indices = (uint32_t *)_indices.contents;
+
+    NSUInteger firstVertex = 0;
+    NSUInteger trianglesLeft = triangleCount;
+    for( int m=0; m<meshCount; m++ ) {
+        int meshVertices = [mesh numberOfMeshVertices:m];
+        GLKVector3 *vertices = [mesh meshVertices:m];
+        for( int v=0; v<meshVertices; v++ ) {
+            *positions++ = vertices[v].x;
+            *positions++ = vertices[v].y;
+            *positions++ = vertices[v].z;
+        }
+
+        NSUInteger meshTriangles = MIN((NSUInteger)[mesh numberOfMeshFaces:m], trianglesLeft);
+        unsigned int *faces = [mesh meshFaces:m];
+        for( NSUInteger i=0; i<meshTriangles*3; i++ ) {
+            *indices++ = (uint32_t)(faces[i] + firstVertex);
+        }
+        trianglesLeft -= meshTriangles;
+        firstVertex += meshVertices;
+    }
+    [mixedRealityMode unlockSceneMesh];
+
+    NSUInteger cells = (triangleCount + 1) / 2;
+    NSUInteger texelBytes = cells * ENVIRONMENT_TEXTURER_CELL_SIZE * ENVIRONMENT_TEXTURER_CELL_SIZE * sizeof(uint32_t);
+    _texels = [_device newBufferWithLength:texelBytes options:MTLResourceStorageModePrivate];
+    _texelsCleared = NO;
+
+    _triangleCount = triangleCount;
+    _stats.triangles = triangleCount;
+    _stats.texelBytes = texelBytes;
+    return YES;
+}
+
+#pragma mark - Update
+
+- (void) update {
+    if( !_running ) return;
+
+    SCNNode *deviceNode = _mixedRealityMode.localDeviceNode;
+    if( deviceNode == nil ) return;
+    GLKMatrix4 devicePose = SCNMatrix4ToGLKMatrix4(deviceNode.worldTransform);
+
+    // The live color camera, carried by the device node since the last prediction.
+    if( _hasKeyframe ) {
+        GLKMatrix4 colorView = GLKMatrix4Invert(GLKMatrix4Multiply(devicePose, _deviceToColor), NULL);
+        _uniforms.liveViewProjection = toSimd(GLKMatrix4Multiply(_colorProjection, colorView));
+    }
+    [_uniformBlock update:&_uniforms];
+
+    CFTimeInterval now = CACurrentMediaTime();
+    if( [self keyframeDueForPose:devicePose atTime:now] ) {
+        [self requestKeyframeWithDevicePose:devicePose atTime:now];
+    }
+}
+
+- (BOOL) keyframeDueForPose:(GLKMatrix4)devicePose atTime:(CFTimeInterval)now {
+    if( !_hasKeyframe ) return YES;
+    if( now - _keyframeTime < ENVIRONMENT_TEXTURER_KEYFRAME_INTERVAL ) return NO;
+
+    GLKVector3 position = GLKVector3Make(devicePose.m30, devicePose.m31, devicePose.m32);
+    GLKVector3 keyframePosition = GLKVector3Make(_keyframeDevicePose.m30, _keyframeDevicePose.m31, _keyframeDevicePose.m32);
+    if( GLKVector3Distance(position, keyframePosition) > ENVIRONMENT_TEXTURER_KEYFRAME_DISTANCE ) return YES;
+
+    // Cameras look down -z.
+    GLKVector3 forward = GLKVector3Normalize(GLKVector3Make(devicePose.m20, devicePose.m21, devicePose.m22));
+    GLKVector3 keyframeForward = GLKVector3Normalize(GLKVector3Make(_keyframeDevicePose.m20, _keyframeDevicePose.m21, _keyframeDevicePose.m22));
+    return GLKVector3DotProduct(forward, keyframeForward) < cosf(GLKMathDegreesToRadians(ENVIRONMENT_TEXTURER_KEYFRAME_DEGREES));
+}
+
+- (void) requestKeyframeWithDevicePose:(GLKMatrix4)devicePose atTime:(CFTimeInterval)now {
+    // One keyframe fetched or on the GPU at a time, the next one waits for a later frame.
+    if( _keyframeInFlight ) {
+        _stats.skippedKeyframes++;
+        return;
+    }
+    _keyframeInFlight = true;
+
+    // Waiting for the color frame blocks until the camera delivers one, so it's
+    // done off the render thread, and the keyframe taken on a later frame.
+    BEMixedRealityMode *mixedRealityMode = _mixedRealityMode;
+    dispatch_async(_colorFrameQueue, ^{
+        BEMixedRealityPrediction *prediction = [mixedRealityMode predictColorCameraPoseForDisplayLinkStart:now];
+        BEMixedRealityRenderData *renderData = prediction.couldPredict
+            ? [mixedRealityMode renderDataForPrediction:prediction requiresTexture:YES] : nil;
+
+        [[RenderCommandQueue main] postBlock:^{
+            [self takeKeyframeWithPrediction:prediction renderData:renderData devicePose:devicePose atTime:now];
+        }];
+    });
+}
+
+/// On the render thread, once the color frame asked for at now is in. Lets go of _keyframeInFlight if nothing is committed.
+- (void) takeKeyframeWithPrediction:(BEMixedRealityPrediction *)prediction
+                         renderData:(BEMixedRealityRenderData *)renderData
+                         devicePose:(GLKMatrix4)devicePose
+                             atTime:(CFTimeInterval)now {
+    CVPixelBufferRef pixelBuffer = renderData.mixedRealityRgbaTextureBuffer;
+    if( !_running || pixelBuffer == NULL ) {
+        if( _running ) _stats.skippedKeyframes++;
+        _keyframeInFlight = false;
+        return;
+    }
+
+    MTLPixelFormat pixelFormat = metalPixelFormat(CVPixelBufferGetPixelFormatType(pixelBuffer));
+    if( pixelFormat == MTLPixelFormatInvalid ) {
+        NSLog(@"EnvironmentTexturer: === Error === Color frames in unknown pixel format, stopping");
+        dispatch_async(dispatch_get_main_queue(), ^{ [self stop]; });
+        _running = NO;
+        _keyframeInFlight = false;
+        return;
+    }
+
+    // The frame's pixels, as they are, for the GPU.
+    size_t width = CVPixelBufferGetWidth(pixelBuffer);
+    size_t height = CVPixelBufferGetHeight(pixelBuffer);
+    CVMetalTextureRef colorTextureRef = NULL;
+    if( CVMetalTextureCacheCreateTextureFromImage(kCFAllocatorDefault, _textureCache, pixelBuffer, nil,
+                                                  pixelFormat, width, height, 0, &colorTextureRef) != kCVReturnSuccess ) {
+        _stats.skippedKeyframes++;
+        _keyframeInFlight = false;
+        return;
+    }
+    id<MTLTexture> colorTexture = CVMetalTextureGetTexture(colorTextureRef);
+
+    // The color camera moves with the device, keep where it sits to follow it between keyframes.
+    _deviceToColor = GLKMatrix4Multiply(GLKMatrix4Invert(devicePose, NULL), prediction.predictedColorCameraPose);
+    _colorProjection = metalProjection(prediction.colorFrameGLProjection);
+    _keyframeDevicePose = devicePose;
+    _keyframeTime = now;
+    _hasKeyframe = YES;
+
+    GLKMatrix4 framePose = prediction.associatedColorFramePose;
+    OBEEnvironmentKeyframe keyframe;
+    keyframe.viewProjection = toSimd(GLKMatrix4Multiply(_colorProjection, GLKMatrix4Invert(framePose, NULL)));
+    keyframe.cameraPosition = simd_make_float4(framePose.m30, framePose.m31, framePose.m32, 1);
+    keyframe.triangleCount = (uint32_t)_triangleCount;
+    keyframe.maxWeight = ENVIRONMENT_TEXTURER_MAX_WEIGHT;
+    keyframe.depthBias = ENVIRONMENT_TEXTURER_DEPTH_BIAS;
+
+    id<MTLCommandBuffer> commands = [_commandQueue commandBuffer];
+    commands.label = @"EnvironmentTexturer keyframe";
+
+    if( !_texelsCleared ) {
+        id<MTLBlitCommandEncoder> blit = [commands blitCommandEncoder];
+        [blit fillBuffer:_texels range:NSMakeRange(0, _texels.length) value:0];
+        [blit endEncoding];
+        _texelsCleared = YES;
+    }
+
+    [self encodeDepthWithCommands:commands keyframe:keyframe width:width height:height];
+    [self encodeAccumulateWithCommands:commands keyframe:keyframe colorTexture:colorTexture];
+
+    [commands addCompletedHandler:^(id<MTLCommandBuffer> buffer) {
+        CFRelease(colorTextureRef);
+        self->_keyframeInFlight = false;
+    }];
+    [commands commit];
+    _stats.keyframes++;
+}
+
+- (void) encodeDepthWithCommands:(id<MTLCommandBuffer>)commands
+                        keyframe:(const OBEEnvironmentKeyframe &)keyframe
+                           width:(size_t)width
+                          height:(size_t)height {
+    NSUInteger depthWidth = MAX(width / ENVIRONMENT_TEXTURER_DEPTH_DOWNSAMPLE, (size_t)1);
+    NSUInteger depthHeight = MAX(height / ENVIRONMENT_TEXTURER_DEPTH_DOWNSAMPLE, (size_t)1);
+    if( _depthTexture.width != depthWidth || _depthTexture.height != depthHeight ) {
+        MTLTextureDescriptor *descriptor = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatDepth32Float
+                                                                                              width:depthWidth
+                                                                                             height:depthHeight
+                                                                                          mipmapped:NO];
+        descriptor.usage = MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead;
+        descriptor.storageMode = MTLStorageModePrivate;
+        _depthTexture = [_device newTextureWithDescriptor:descriptor];
+    }
+
+    MTLRenderPassDescriptor *pass = [MTLRenderPassDescriptor renderPassDescriptor];
+    pass.depthAttachment.texture = _depthTexture;
+    pass.depthAttachment.loadAction = MTLLoadActionClear;
+    pass.depthAttachment.storeAction = MTLStoreActionStore;
+    pass.depthAttachment.clearDepth = 1.0;
+
+    id<MTLRenderCommandEncoder> encoder = [commands renderCommandEncoderWithDescriptor:pass];
+    encoder.label = @"EnvironmentTexturer depth";
+    [encoder setRenderPipelineState:_depthPipeline];
+    [encoder setDepthStencilState:_depthState];
+    [encoder setCullMode:MTLCullModeNone];
+    [encoder setVertexBuffer:_positions offset:0 atIndex:0];
+    [encoder setVertexBytes:&keyframe length:sizeof(keyframe) atIndex:1];
+    [encoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                        indexCount:_triangleCount * 3
+                         indexType:MTLIndexTypeUInt32
+                       indexBuffer:_indices
+                 indexBufferOffset:0];
+    [encoder endEncoding];
+}
+
+- (void) encodeAccumulateWithCommands:(id<MTLCommandBuffer>)commands
+                             keyframe:(const OBEEnvironmentKeyframe &)keyframe
+                         colorTexture:(id<MTLTexture>)colorTexture {
+    // One thread per texel: x runs through a cell's texels, y through the cells.
+    NSUInteger cells = (_triangleCount + 1) / 2;
+    MTLSize threadsPerGroup = MTLSizeMake(ENVIRONMENT_TEXTURER_CELL_SIZE * ENVIRONMENT_TEXTURER_CELL_SIZE,
+                                          ENVIRONMENT_TEXTURER_CELLS_PER_GROUP, 1);
+    MTLSize groups = MTLSizeMake(1, (cells + ENVIRONMENT_TEXTURER_CELLS_PER_GROUP - 1) / ENVIRONMENT_TEXTURER_CELLS_PER_GROUP, 1);
+
+    id<MTLComputeCommandEncoder> encoder = [commands computeCommandEncoder];
+    encoder.label = @"EnvironmentTexturer accumulate";
+    [encoder setComputePipelineState:_accumulatePipeline];
+    [encoder setBuffer:_positions offset:0 atIndex:0];
+    [encoder setBuffer:_indices offset:0 atIndex:1];
+    [encoder setBuffer:_texels offset:0 atIndex:2];
+    [encoder setBytes:&keyframe length:sizeof(keyframe) atIndex:3];
+    [encoder setTexture:colorTexture atIndex:0];
+    [encoder setTexture:_depthTexture atIndex:1];
+    [encoder dispatchThreadgroups:groups threadsPerThreadgroup:threadsPerGroup];
+    [encoder endEncoding];
+}
+
+- (EnvironmentTexturerStats) stats {
+    return _stats;
+}
+
+@end
@@ -188,6 +188,8 @@
 
 - (void) controllerButtonDown
 {
+    [[FrameReplay main] recordEvent:FrameReplayEventControllerButtonDown];
+    
     bool currentUseReticleAsTouchLocation = self.useReticleAsTouchLocation;
     self.useReticleAsTouchLocation = YES;
     
@@ -201,6 +203,8 @@
 
 - (void) controllerButtonUp
 {
+    [[FrameReplay main] recordEvent:FrameReplayEventControllerButtonUp];
+    
     bool currentUseReticleAsTouchLocation = self.useReticleAsTouchLocation;
     self.useReticleAsTouchLocation = YES;
     
@@ -249,13 +253,7 @@
             // conforming to EventComponentProtocol, only use these components as
             // possible responders. Otherwise: loop through global event components
             
-            GKEntity * entity = [hit.node valueForKey:@"entity"];
-            SCNNode * node = hit.node;
-            
-            while( !entity && node.parentNode ) {
-                node = node.parentNode;
-                entity = [node valueForKey:@"entity"];
-            }
+            GKEntity * entity = [[SceneManager main].registry entityForNode:hit.node];
             
             if( entity ) {
                 NSMutableArray * possibleEventComponents = [[NSMutableArray alloc] initWithCapacity:8];
@@ -312,9 +310,9 @@
         
         for( GKComponent * component in touchEventRepsonders.eventComponents ) {
             be_NSDbg(@"Touch Began on component: %@, button: %d", NSStringFromClass(component.class), button);
-            [_mixedRealityMode runBlockInRenderThread:^(void) {
-                [(GKComponent <EventComponentProtocol> * )component touchBeganButton:button forward:forward hit:hit];
-            }];
+            [[RenderCommandQueue main] postTouch:RenderCommandTypeTouchBegan
+                                     toComponent:(GKComponent <EventComponentProtocol> * )component
+                                          button:button forward:forward hit:hit];
         }
     }
 }
@@ -345,11 +343,12 @@
 	        } else {
 	            button = 0;
 	        }
+            GLKVector3 forward = [self getTouchForward:touch];
             for( GKComponent * component in touchEventResponder.eventComponents ) {
                 be_NSDbg(@"Touch End on component: %@", NSStringFromClass(component.class));
-                [_mixedRealityMode runBlockInRenderThread:^(void) {
-                    [(GKComponent <EventComponentProtocol> * )component  touchEndedButton:button forward:[self getTouchForward:touch] hit:hit];
-                }];
+                [[RenderCommandQueue main] postTouch:RenderCommandTypeTouchEnded
+                                         toComponent:(GKComponent <EventComponentProtocol> * )component
+                                              button:button forward:forward hit:hit];
             }
             // no first responder after touch ended
             [self.touchEventResponders removeObject:touchEventResponder];
@@ -384,14 +383,15 @@
 	            button = 0;
 	        }
 
+            GLKVector3 forward = [self getTouchForward:touch];
             for( GKComponent * component in touchEventResponder.eventComponents ) {
                 if( [component respondsToSelector:@selector(touchCancelledButton:forward:hit:)] == NO ) {
                     be_NSDbg(@"Unhandled @selector(touchCancelledButton:forward:hit:) with object class: %@", NSStringFromClass(component.class));
                 } else {
                     be_NSDbg(@"Touch Cancelled on component: %@", NSStringFromClass(component.class));
-                    [_mixedRealityMode runBlockInRenderThread:^(void) {
-                        [(GKComponent <EventComponentProtocol> * )component touchCancelledButton:button forward:[self getTouchForward:touch] hit:hit];
-                    }];
+                    [[RenderCommandQueue main] postTouch:RenderCommandTypeTouchCancelled
+                                             toComponent:(GKComponent <EventComponentProtocol> * )component
+                                                  button:button forward:forward hit:hit];
                 }
             }
             
@@ -428,11 +428,12 @@
 	            button = 0;
 	        }
 
+            GLKVector3 forward = [self getTouchForward:touch];
             for( GKComponent * component in touchEventResponder.eventComponents ) {
 //                be_NSDbg(@"Touch Moved with button %d on component: %@", button, NSStringFromClass(component.class));
-                [_mixedRealityMode runBlockInRenderThread:^(void) {
-                    [(GKComponent <EventComponentProtocol> * )component touchMovedButton:button forward:[self getTouchForward:touch] hit:hit];
-                }];
+                [[RenderCommandQueue main] postTouch:RenderCommandTypeTouchMoved
+                                         toComponent:(GKComponent <EventComponentProtocol> * )component
+                                              button:button forward:forward hit:hit];
             }
         }
     }
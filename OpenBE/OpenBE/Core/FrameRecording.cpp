@@ -0,0 +1,106 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#include "FrameRecording.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+    using namespace BE;
+
+    const char kRecordingMagic[4] = {'O','B','F','R'};
+    const uint32_t kRecordingVersion = 1;
+
+    struct FrameRecordingHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t frameCount;
+        uint32_t eventCount;
+    };
+
+    static_assert(sizeof(FrameRecordingHeader) == 16, "Recording header must be packed");
+    static_assert(sizeof(FrameRecordingFrame) == 48, "Recording frames must be packed");
+    static_assert(sizeof(FrameRecordingEvent) == 8, "Recording events must be packed");
+
+    bool fail (std::string* error, const char* reason)
+    {
+        if (error) *error = reason;
+        return false;
+    }
+
+} // anonymous
+
+namespace BE
+{
+
+    std::vector<uint8_t> serializeFrameRecording (const FrameRecording& recording)
+    {
+        FrameRecordingHeader header = {};
+        memcpy(header.magic, kRecordingMagic, sizeof(kRecordingMagic));
+        header.version = kRecordingVersion;
+        header.frameCount = (uint32_t)recording.frames.size();
+        header.eventCount = (uint32_t)recording.events.size();
+
+        const size_t framesSize = recording.frames.size() * sizeof(FrameRecordingFrame);
+        const size_t eventsSize = recording.events.size() * sizeof(FrameRecordingEvent);
+
+        std::vector<uint8_t> bytes(sizeof(header) + framesSize + eventsSize);
+        memcpy(bytes.data(), &header, sizeof(header));
+        if (framesSize) memcpy(bytes.data() + sizeof(header), recording.frames.data(), framesSize);
+        if (eventsSize) memcpy(bytes.data() + sizeof(header) + framesSize, recording.events.data(), eventsSize);
+        return bytes;
+    }
+
+    bool parseFrameRecording (const uint8_t* bytes, size_t length, FrameRecording& recording, std::string* error)
+    {
+        FrameRecordingHeader header;
+        if (length < sizeof(header)) return fail(error, "too short for a header");
+        memcpy(&header, bytes, sizeof(header));
+
+        if (memcmp(header.magic, kRecordingMagic, sizeof(kRecordingMagic)) != 0) return fail(error, "not a frame recording");
+        if (header.version != kRecordingVersion) return fail(error, "unsupported version");
+
+        const size_t framesSize = (size_t)header.frameCount * sizeof(FrameRecordingFrame);
+        const size_t eventsSize = (size_t)header.eventCount * sizeof(FrameRecordingEvent);
+        if (length != sizeof(header) + framesSize + eventsSize) return fail(error, "length doesn't match the header");
+
+        bytes += sizeof(header);
+        recording.frames.resize(header.frameCount);
+        if (framesSize) memcpy(recording.frames.data(), bytes, framesSize);
+        recording.events.resize(header.eventCount);
+        if (eventsSize) memcpy(recording.events.data(), bytes + framesSize, eventsSize);
+
+        std::stable_sort(recording.events.begin(), recording.events.end(), [](const FrameRecordingEvent& a, const FrameRecordingEvent& b) {
+            return a.frame < b.frame;
+        });
+        return true;
+    }
+
+    bool readFrameRecording (const char* path, FrameRecording& recording, std::string* error)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return fail(error, "can't open the file");
+
+        const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return parseFrameRecording(bytes.data(), bytes.size(), recording, error);
+    }
+
+    bool writeFrameRecording (const char* path, const FrameRecording& recording)
+    {
+        const std::vector<uint8_t> bytes = serializeFrameRecording(recording);
+
+        std::ofstream file(path, std::ios::binary);
+        file.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+        return (bool)file;
+    }
+
+} // BE
@@ -0,0 +1,74 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  The file FrameReplay records the per-frame input stream to: each frame's
+//  delta time, device pose and reticle forward, and the controller button
+//  transitions stamped with the frame they arrived on.
+//
+//  Little endian and tightly packed: a header, the frames, then the events.
+//  Poses are in world space, y down, as Camera reports them.
+//
+//  Plain C++ with no Apple dependencies, shared by the app and Tools/FrameReplayBench.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace BE
+{
+
+    /// Matches FrameReplayEvent in FrameReplay.h.
+    enum FrameRecordingEventType : uint8_t
+    {
+        FrameRecordingControllerButtonDown = 0,
+        FrameRecordingControllerButtonUp,
+    };
+
+    struct FrameRecordingFrame
+    {
+        double deltaTime;
+        float position[3];
+        float forward[3];
+        float reticleForward[3];
+    };
+
+    struct FrameRecordingEvent
+    {
+        uint32_t frame;
+        uint8_t event;          // FrameRecordingEventType.
+        uint8_t reserved[3];
+    };
+
+    struct FrameRecording
+    {
+        std::vector<FrameRecordingFrame> frames;
+        std::vector<FrameRecordingEvent> events;   // By frame, in arrival order within a frame.
+    };
+
+    /// The file's bytes.
+    std::vector<uint8_t> serializeFrameRecording (const FrameRecording& recording);
+
+    /**
+     * Parse a recording's bytes, with its events sorted by frame.
+     * @return false with a reason in error if the magic, version or length is wrong.
+     */
+    bool parseFrameRecording (const uint8_t* bytes, size_t length, FrameRecording& recording, std::string* error = nullptr);
+
+    /// Read and parse a recording file.
+    bool readFrameRecording (const char* path, FrameRecording& recording, std::string* error = nullptr);
+
+    /// Serialize and write a recording file.
+    bool writeFrameRecording (const char* path, const FrameRecording& recording);
+
+} // BE
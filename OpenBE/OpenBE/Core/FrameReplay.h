@@ -0,0 +1,114 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Record and replay of the per-frame input stream that drives OpenBE, for
+//  repeatable end-to-end frame benchmarks.
+//
+//  While recording, every SceneManager frame stores its delta time, the device
+//  pose and the reticle forward, and controller button transitions are stamped
+//  with the frame they arrived on.
+//
+//  While replaying, SceneManager uses the recorded delta times instead of the
+//  wall clock, and button transitions are re-injected into the EventManager at
+//  the top of the same frame index, so behaviour components see the same input
+//  sequence every run. Pair this with BECaptureReplayModeDeterministic so the
+//  engine replays the matching OCC capture; the recorded pose is only used to
+//  report how far the replayed tracking drifted from the recording.
+//
+//  With profileComponents on, SceneManager times every component update and a
+//  per-component CPU report is written when the replay runs out of frames.
+//
+//  The file format is FrameRecording.hpp's, which Tools/FrameReplayBench also
+//  reads to replay a recording through the portable systems off device.
+//
+
+#import <BridgeEngine/BridgeEngine.h>
+
+typedef NS_ENUM(NSInteger, FrameReplayMode) {
+    FrameReplayModeOff = 0,
+    FrameReplayModeRecording,
+    FrameReplayModeReplaying,
+};
+
+typedef NS_ENUM(uint8_t, FrameReplayEvent) {
+    FrameReplayEventControllerButtonDown = 0,
+    FrameReplayEventControllerButtonUp,
+};
+
+/// Posted on the main queue once a replay has used up all its frames and the report is written.
+extern NSString * const FrameReplayDidFinishNotification;
+
+@interface FrameReplay : NSObject
+
+/// Singleton.
++ (FrameReplay *) main;
+
+@property (nonatomic, readonly) FrameReplayMode mode;
+
+/// Time each component update separately. Also enabled by startReplayFromPath:reportPath:.
+@property (atomic) BOOL profileComponents;
+
+/// Frames seen since recording or replay started.
+@property (atomic, readonly) NSUInteger frameIndex;
+
+/// Number of frames in the loaded replay.
+@property (nonatomic, readonly) NSUInteger frameCount;
+
+/**
+ * Start capturing frames and input events.
+ * The recording is written to path on stopRecording, or when the app goes to the background.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (void) startRecordingToPath:(NSString *)path;
+
+/**
+ * Stop capturing and write the recording out.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (BOOL) stopRecording;
+
+/**
+ * Load a recording and start driving SceneManager from it.
+ * When the last frame has been replayed, the component report is written to reportPath (CSV) and logged.
+ * @return NO if the recording could not be loaded.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (BOOL) startReplayFromPath:(NSString *)path reportPath:(NSString *)reportPath;
+
+/**
+ * Record an input event against the current frame.  Ignored unless recording.
+ * THREAD SAFE
+ */
+- (void) recordEvent:(FrameReplayEvent)event;
+
+#pragma mark - SceneManager hooks
+// RENDER THREAD ONLY
+
+/// Recorded delta time when replaying, otherwise returns seconds.
+- (NSTimeInterval) deltaTimeForFrame:(NSTimeInterval)seconds;
+
+/// Capture or re-inject this frame's input. Called before any component updates.
+- (void) beginFrameWithDeltaTime:(NSTimeInterval)seconds;
+
+/// Add CPU time (mach_absolute_time ticks) spent in one update of a component, or a singleton, of this class.
+- (void) addSampleForClass:(Class)cls ticks:(uint64_t)ticks;
+
+/// Close the frame, and finish the replay when out of frames.
+- (void) endFrame;
+
+#pragma mark - Report
+
+/**
+ * Per-component CPU time summary since profiling started, most expensive first.
+ * THREAD SAFE
+ */
+- (NSString *) report;
+
+@end
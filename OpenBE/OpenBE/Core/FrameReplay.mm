@@ -0,0 +1,365 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "FrameReplay.h"
+#import "Core.h"
+#include "FrameRecording.hpp"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+NSString * const FrameReplayDidFinishNotification = @"FrameReplayDidFinishNotification";
+
+namespace {
+
+    static_assert((uint8_t)FrameReplayEventControllerButtonDown == BE::FrameRecordingControllerButtonDown
+                  && (uint8_t)FrameReplayEventControllerButtonUp == BE::FrameRecordingControllerButtonUp,
+                  "FrameReplayEvent must match the recording's event types");
+
+    struct ComponentTiming
+    {
+        NSString *name;
+        uint64_t frameTicks = 0;    // Accumulated over all instances during the current frame.
+        uint64_t totalTicks = 0;
+        uint64_t maxFrameTicks = 0;
+        uint32_t frames = 0;        // Frames this class was updated in.
+    };
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    void copyVector( float out[3], GLKVector3 v ) {
+        out[0] = v.x; out[1] = v.y; out[2] = v.z;
+    }
+
+} // anonymous
+
+@interface FrameReplay ()
+@property (nonatomic, readwrite) FrameReplayMode mode;
+@property (atomic, readwrite) NSUInteger frameIndex;
+@property (nonatomic, strong) NSString *recordingPath;
+@property (nonatomic, strong) NSString *reportPath;
+@end
+
+@implementation FrameReplay
+{
+    // Frames are written on the render thread and events on the main thread
+    // while recording, both guarded by _recordMutex.
+    std::vector<BE::FrameRecordingFrame> _frames;
+    std::vector<BE::FrameRecordingEvent> _events;
+    std::mutex _recordMutex;
+    size_t _nextEvent;
+    NSTimeInterval _frameDeltaTime;
+
+    // Profiling, guarded by _statsMutex.
+    std::mutex _statsMutex;
+    std::unordered_map<uintptr_t, size_t> _timingIndex;
+    std::vector<ComponentTiming> _timings;
+    std::vector<float> _frameMs;
+    double _maxPoseDrift;
+}
+
++ (FrameReplay *) main {
+    static FrameReplay *mainReplay = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainReplay = [[FrameReplay alloc] init];
+    });
+
+    return mainReplay;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _mode = FrameReplayModeOff;
+        _nextEvent = 0;
+        _maxPoseDrift = 0;
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationDidEnterBackground:)
+                                                     name:UIApplicationDidEnterBackgroundNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (NSUInteger) frameCount {
+    return _frames.size();
+}
+
+- (void) applicationDidEnterBackground:(NSNotification *)notification {
+    if( self.mode == FrameReplayModeRecording ) {
+        [self stopRecording];
+    }
+}
+
+#pragma mark - Recording
+
+- (void) startRecordingToPath:(NSString *)path {
+    be_assert( self.mode == FrameReplayModeOff, "FrameReplay already active" );
+
+    self.recordingPath = path;
+    {
+        std::lock_guard<std::mutex> lock(_recordMutex);
+        _frames.clear();
+        _frames.reserve(60 * 60 * 5);  // Five minutes at 60fps.
+        _events.clear();
+    }
+    self.frameIndex = 0;
+    self.mode = FrameReplayModeRecording;
+
+    NSLog(@"FrameReplay: Recording to %@", path);
+}
+
+- (BOOL) stopRecording {
+    if( self.mode != FrameReplayModeRecording ) return NO;
+    self.mode = FrameReplayModeOff;
+
+    BE::FrameRecording recording;
+    {
+        std::lock_guard<std::mutex> lock(_recordMutex);
+        recording.frames.swap(_frames);
+        recording.events.swap(_events);
+    }
+
+    const std::vector<uint8_t> bytes = BE::serializeFrameRecording(recording);
+    NSData *data = [NSData dataWithBytes:bytes.data() length:bytes.size()];
+
+    [[NSFileManager defaultManager] createDirectoryAtPath:[self.recordingPath stringByDeletingLastPathComponent]
+                              withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSError *error = nil;
+    if( [data writeToFile:self.recordingPath options:NSDataWritingAtomic error:&error] == NO ) {
+        NSLog(@"FrameReplay: === Error === Could not write recording %@: %@", self.recordingPath, error);
+        return NO;
+    }
+
+    NSLog(@"FrameReplay: Recorded %zu frames, %zu events to %@", recording.frames.size(), recording.events.size(), self.recordingPath);
+    return YES;
+}
+
+- (void) recordEvent:(FrameReplayEvent)event {
+    if( self.mode != FrameReplayModeRecording ) return;
+
+    BE::FrameRecordingEvent record = {};
+    record.frame = (uint32_t)self.frameIndex;
+    record.event = event;
+
+    std::lock_guard<std::mutex> lock(_recordMutex);
+    _events.push_back(record);
+}
+
+#pragma mark - Replay
+
+- (BOOL) startReplayFromPath:(NSString *)path reportPath:(NSString *)reportPath {
+    be_assert( self.mode == FrameReplayModeOff, "FrameReplay already active" );
+
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    if( data == nil ) {
+        NSLog(@"FrameReplay: === Error === Could not load recording %@", path);
+        return NO;
+    }
+
+    BE::FrameRecording recording;
+    std::string error;
+    if( BE::parseFrameRecording((const uint8_t *)data.bytes, data.length, recording, &error) == false ) {
+        NSLog(@"FrameReplay: === Error === Invalid recording %@: %s", path, error.c_str());
+        return NO;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_recordMutex);
+        _frames.swap(recording.frames);
+        _events.swap(recording.events);
+    }
+
+    [self resetStats];
+    _nextEvent = 0;
+    self.reportPath = reportPath;
+    self.frameIndex = 0;
+    self.profileComponents = YES;
+    self.mode = FrameReplayModeReplaying;
+
+    NSLog(@"FrameReplay: Replaying %zu frames, %zu events from %@", _frames.size(), _events.size(), path);
+    return YES;
+}
+
+- (void) finishReplay {
+    self.mode = FrameReplayModeOff;
+    self.profileComponents = NO;
+
+    NSString *report = [self report];
+    NSLog(@"FrameReplay: Replay finished\n%@", report);
+
+    if( self.reportPath ) {
+        NSError *error = nil;
+        if( [report writeToFile:self.reportPath atomically:YES encoding:NSUTF8StringEncoding error:&error] == NO ) {
+            NSLog(@"FrameReplay: === Error === Could not write report %@: %@", self.reportPath, error);
+        }
+    }
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:FrameReplayDidFinishNotification object:self];
+    });
+}
+
+#pragma mark - SceneManager hooks
+
+- (NSTimeInterval) deltaTimeForFrame:(NSTimeInterval)seconds {
+    NSUInteger index = self.frameIndex;
+    if( self.mode == FrameReplayModeReplaying && index < _frames.size() ) {
+        return _frames[index].deltaTime;
+    }
+    return seconds;
+}
+
+- (void) beginFrameWithDeltaTime:(NSTimeInterval)seconds {
+    _frameDeltaTime = seconds;
+    if( self.mode != FrameReplayModeReplaying ) return;
+
+    // Re-inject this frame's input, in recorded order.
+    NSUInteger index = self.frameIndex;
+    while( _nextEvent < _events.size() && _events[_nextEvent].frame <= index ) {
+        switch( (FrameReplayEvent)_events[_nextEvent].event ) {
+            case FrameReplayEventControllerButtonDown:
+                [[EventManager main] controllerButtonDown];
+                break;
+            case FrameReplayEventControllerButtonUp:
+                [[EventManager main] controllerButtonUp];
+                break;
+        }
+        _nextEvent++;
+    }
+}
+
+- (void) addSampleForClass:(Class)cls ticks:(uint64_t)ticks {
+    std::lock_guard<std::mutex> lock(_statsMutex);
+
+    uintptr_t key = (uintptr_t)(__bridge void *)cls;
+    auto found = _timingIndex.find(key);
+    size_t index;
+    if( found == _timingIndex.end() ) {
+        index = _timings.size();
+        _timingIndex[key] = index;
+        ComponentTiming timing;
+        timing.name = NSStringFromClass(cls);
+        _timings.push_back(timing);
+    } else {
+        index = found->second;
+    }
+
+    _timings[index].frameTicks += ticks;
+}
+
+- (void) endFrame {
+    FrameReplayMode mode = self.mode;
+    NSUInteger index = self.frameIndex;
+
+    Camera *camera = [Camera main];
+    if( mode == FrameReplayModeRecording ) {
+        BE::FrameRecordingFrame frame = {};
+        frame.deltaTime = _frameDeltaTime;
+        copyVector(frame.position, camera.position);
+        copyVector(frame.forward, camera.forward);
+        copyVector(frame.reticleForward, camera.reticleForward);
+
+        std::lock_guard<std::mutex> lock(_recordMutex);
+        _frames.push_back(frame);
+    }
+
+    if( self.profileComponents ) {
+        std::lock_guard<std::mutex> lock(_statsMutex);
+
+        uint64_t frameTicks = 0;
+        for( ComponentTiming &timing : _timings ) {
+            if( timing.frameTicks == 0 ) continue;
+            timing.totalTicks += timing.frameTicks;
+            timing.maxFrameTicks = std::max(timing.maxFrameTicks, timing.frameTicks);
+            timing.frames++;
+            frameTicks += timing.frameTicks;
+            timing.frameTicks = 0;
+        }
+        _frameMs.push_back((float)machTicksToMs(frameTicks));
+
+        if( mode == FrameReplayModeReplaying && index < _frames.size() ) {
+            const BE::FrameRecordingFrame &recorded = _frames[index];
+            GLKVector3 recordedPosition = GLKVector3Make(recorded.position[0], recorded.position[1], recorded.position[2]);
+            _maxPoseDrift = std::max(_maxPoseDrift, (double)GLKVector3Distance(recordedPosition, camera.position));
+        }
+    }
+
+    self.frameIndex = index + 1;
+
+    if( mode == FrameReplayModeReplaying && index + 1 >= _frames.size() ) {
+        [self finishReplay];
+    }
+}
+
+#pragma mark - Report
+
+- (void) resetStats {
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    _timingIndex.clear();
+    _timings.clear();
+    _frameMs.clear();
+    _maxPoseDrift = 0;
+}
+
+- (NSString *) report {
+    std::lock_guard<std::mutex> lock(_statsMutex);
+
+    NSMutableString *report = [NSMutableString string];
+
+    size_t frameCount = _frameMs.size();
+    std::vector<float> sortedFrameMs = _frameMs;
+    std::sort(sortedFrameMs.begin(), sortedFrameMs.end());
+    double meanFrameMs = 0;
+    for( float ms : sortedFrameMs ) meanFrameMs += ms;
+    if( frameCount ) meanFrameMs /= frameCount;
+    double p95FrameMs = frameCount ? sortedFrameMs[std::min(frameCount - 1, (size_t)(frameCount * 0.95))] : 0;
+    double maxFrameMs = frameCount ? sortedFrameMs.back() : 0;
+
+    [report appendFormat:@"# frames,%zu\n", frameCount];
+    [report appendFormat:@"# frame_mean_ms,%0.4f\n# frame_p95_ms,%0.4f\n# frame_max_ms,%0.4f\n", meanFrameMs, p95FrameMs, maxFrameMs];
+    [report appendFormat:@"# pose_drift_max_m,%0.4f\n", _maxPoseDrift];
+    [report appendString:@"component,frames,mean_ms,max_ms,total_ms\n"];
+
+    std::vector<const ComponentTiming *> sorted;
+    for( const ComponentTiming &timing : _timings ) sorted.push_back(&timing);
+    std::sort(sorted.begin(), sorted.end(), [](const ComponentTiming *a, const ComponentTiming *b) {
+        return a->totalTicks > b->totalTicks;
+    });
+
+    for( const ComponentTiming *timing : sorted ) {
+        double totalMs = machTicksToMs(timing->totalTicks);
+        [report appendFormat:@"%@,%u,%0.4f,%0.4f,%0.4f\n",
+            timing->name,
+            timing->frames,
+            frameCount ? totalMs / frameCount : 0.0,
+            machTicksToMs(timing->maxFrameTicks),
+            totalMs];
+    }
+
+    return report;
+}
+
+@end
@@ -18,6 +18,8 @@
 #import "Component.h"
 #import <JavascriptCore/JavascriptCore.h>
 
+@class NodeSet;
+
 @protocol GeometryComponentJSExports <JSExport>
 @property (strong) SCNNode * node;
 @end
@@ -26,6 +28,12 @@
 
 @property (strong) SCNNode * node;
 
+/// node and every node below it, for setting a property on all of them. Everyone setting one on node's subtree shares it.
+@property (nonatomic, readonly) NodeSet * nodeSet;
+
+/// Capture nodeSet again, if it was, after adding or removing nodes below node.
+- (void) refreshNodeSet;
+
 - (id) initWithNode:(SCNNode *) node;
 
 - (void) start;
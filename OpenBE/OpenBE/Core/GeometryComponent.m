@@ -7,9 +7,12 @@
 
 #import "GeometryComponent.h"
 #import "Core.h"
+#import "../Utils/NodeSet.h"
 
 @implementation GeometryComponent
-
+{
+    NodeSet * _nodeSet;
+}
 
 - (id) initWithNode:(SCNNode *) node
 {
@@ -33,12 +36,28 @@
 - (void) registerNodeToEntity:(SCNNode *) node {
     self.node = node;
     [node setValue:self.entity forKey:@"entity"];
+    if( self.entity ) {
+        [[SceneManager main].registry setEntity:self.entity forNode:node];
+    }
     
     if( !self.node.parentNode ) {
         [[Scene main].rootNode addChildNode:self.node];
     }
 }
 
+- (NodeSet *) nodeSet {
+    // Captured on first use, and again if node was replaced since.
+    SCNNode *node = self.node;
+    if( _nodeSet == nil || _nodeSet.root != node ) {
+        _nodeSet = node ? [NodeSet nodeSetWithRoot:node] : nil;
+    }
+    return _nodeSet;
+}
+
+- (void) refreshNodeSet {
+    [_nodeSet refresh];
+}
+
 - (SCNNode *) createSceneNode {
     self.node = [SCNNode node];
     [[Scene main].rootNode addChildNode:self.node];
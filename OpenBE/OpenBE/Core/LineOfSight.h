@@ -0,0 +1,97 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Occlusion aware line of sight between things in the scanned room, like a
+//  robot's sensor and the camera, or a robot and what it's looking for.
+//
+//  Sight lines are tested against an OcclusionGrid, a 2.5D height map built
+//  once at start from the scan's occupancy grid and the scene mesh. The
+//  occupancy grid lays it out and marks its obstacles; the mesh's triangles
+//  between the floor and the ceiling raise each cell to the tallest thing in
+//  it, so walls and furniture block, and lines over a low table don't.
+//
+//  Standing queries join two SpatialIndex items, or an item and the Camera.
+//  They are all resolved together once per frame in update (called by the
+//  SceneManager after the SpatialIndex), from the positions it indexed, and
+//  the answer is cached for every component asking that frame. Lines can
+//  also be tested immediately, in a batch.
+//
+//  Until the grid is built, or without a scan, every line is visible.
+//
+//  RENDER THREAD ONLY, unless noted.
+//
+
+#import <SceneKit/SceneKit.h>
+#import <GLKit/GLKit.h>
+#import <BridgeEngine/BridgeEngine.h>
+
+#import "SpatialIndex.h"
+
+typedef uint16_t LineOfSightQuery;
+
+/// Maximum number of standing queries.
+#define LINE_OF_SIGHT_MAX_QUERIES 64
+
+/// Stands for the Camera at either end of a standing query.
+#define LINE_OF_SIGHT_CAMERA ((SpatialHandle)0xFFFFFFFE)
+
+typedef struct {
+    int width;                      // Occlusion grid cells.
+    int height;
+    NSUInteger triangles;           // Scene mesh triangles added to it.
+    double buildMs;
+    NSUInteger queries;             // Standing queries resolved on the last update.
+    NSUInteger visible;             // Of those, not blocked.
+    double updateMs;                // Resolving them.
+} LineOfSightStats;
+
+@interface LineOfSight : NSObject
+
+/// Singleton, updated by the SceneManager.
++ (LineOfSight *) main;
+
+@property (nonatomic, readonly) BOOL running;
+
+/**
+ * Build the occlusion grid from the saved occupancy grid and the scene mesh.
+ * Without an occupancy grid, it's laid out over the mesh alone.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (void) startWithMixedRealityMode:(BEMixedRealityMode *)mixedRealityMode;
+
+/// Resolve every standing query against this frame's indexed positions.
+- (void) update;
+
+#pragma mark - Standing Queries
+
+/**
+ * Register a line from one indexed item to another, resolved every update.
+ * Either end can be LINE_OF_SIGHT_CAMERA. Lines to items no longer indexed are blocked.
+ */
+- (LineOfSightQuery) addQueryFrom:(SpatialHandle)from to:(SpatialHandle)to;
+- (void) setQuery:(LineOfSightQuery)query from:(SpatialHandle)from to:(SpatialHandle)to;
+
+/// Stop resolving the query. Its index is handed out again by a later addQueryFrom:to:.
+- (void) removeQuery:(LineOfSightQuery)query;
+
+/// Was the line clear on the last update. YES until it's first resolved, NO once removed.
+- (BOOL) queryIsVisible:(LineOfSightQuery)query;
+
+#pragma mark - Immediate
+
+/// Is nothing in the way between two world positions.
+- (BOOL) isVisibleFrom:(GLKVector3)from to:(GLKVector3)to;
+
+/// Test count lines from from[i] to to[i], in world positions, writing whether each is clear.
+- (void) testLinesFrom:(const GLKVector3 *)from to:(const GLKVector3 *)to count:(NSUInteger)count visible:(BOOL *)visible;
+
+- (LineOfSightStats) stats;
+
+@end
@@ -0,0 +1,300 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "LineOfSight.h"
+#import "Camera.h"
+#import "OccupancyGridLoader.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "OcclusionGrid.hpp"
+
+// Scene mesh this close to the floor is the floor, and doesn't block.
+#define LINE_OF_SIGHT_FLOOR_HEIGHT 0.05f
+
+// Mesh above this is clamped down to it, and triangles wholly above it are the ceiling, which doesn't block.
+#define LINE_OF_SIGHT_CEILING_HEIGHT 2.2f
+
+// Height an occupancy Obstacle pixel is sure to hold something to. The mesh raises it to the real height.
+#define LINE_OF_SIGHT_OBSTACLE_HEIGHT 0.05f
+
+// Cell size when there's no occupancy grid to lay the cells out, like the scanner's.
+#define LINE_OF_SIGHT_METERS_PER_CELL 0.04f
+
+// Cells on a side, at most, when laid out over the mesh.
+#define LINE_OF_SIGHT_MAX_CELLS 1024
+
+namespace {
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    /// World y points down, the grid's heights point up.
+    BE::OcclusionPoint occlusionPoint( GLKVector3 position ) {
+        BE::OcclusionPoint point;
+        point.x = position.x;
+        point.z = position.z;
+        point.height = -position.y;
+        return point;
+    }
+
+    struct StandingQuery {
+        SpatialHandle from;
+        SpatialHandle to;
+        bool active;
+    };
+
+} // anonymous
+
+@implementation LineOfSight
+{
+    BE::OcclusionGrid _grid;
+
+    std::vector<StandingQuery> _queries;
+    std::vector<LineOfSightQuery> _freeQueries;     // Removed, to be reused.
+    std::vector<LineOfSightQuery> _lineQueries;     // Query of each line, this update.
+    std::vector<BE::SightLine> _lines;      // Of the active standing queries, this update.
+    std::vector<uint8_t> _found;            // Whether both ends of each line were indexed.
+    std::vector<uint8_t> _resolved;         // Whether each line is clear.
+    std::vector<uint8_t> _visible;          // Cached per query, found and clear.
+
+    LineOfSightStats _stats;
+}
+
++ (LineOfSight *) main {
+    static LineOfSight *mainLineOfSight = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainLineOfSight = [[LineOfSight alloc] init];
+    });
+
+    return mainLineOfSight;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _stats = LineOfSightStats();
+    }
+    return self;
+}
+
+#pragma mark - Building
+
+- (void) startWithMixedRealityMode:(BEMixedRealityMode *)mixedRealityMode {
+    if( _running ) return;
+    uint64_t start = mach_absolute_time();
+
+    // Laid out like the occupancy grid, with its obstacles, when the scan saved one.
+    BE::OcclusionGrid *grid = &_grid;
+    BOOL hasOccupancy = NO;
+    NSString *gridPath = [OccupancyGridLoader defaultGridPath];
+    if( [[NSFileManager defaultManager] fileExistsAtPath:gridPath] ) {
+        hasOccupancy = [OccupancyGridLoader readGridAtPath:gridPath
+                                              metadataPath:[OccupancyGridLoader defaultMetadataPath]
+                                                     block:^(const BE::OccupancyGridView &occupancy) {
+            grid->reset(occupancy.metadata, occupancy.width, occupancy.height,
+                        LINE_OF_SIGHT_FLOOR_HEIGHT, LINE_OF_SIGHT_CEILING_HEIGHT);
+            grid->addOccupancy(occupancy, BE::OccupancyObstacle, LINE_OF_SIGHT_OBSTACLE_HEIGHT);
+        }];
+    }
+
+    BEMesh *mesh = [mixedRealityMode lockAndGetSceneMesh];
+    if( !hasOccupancy ) {
+        [self layOutOverMesh:mesh];
+    }
+
+    NSUInteger triangles = 0;
+    int meshCount = [mesh numberOfMeshes];
+    for( int m=0; m<meshCount && !_grid.empty(); m++ ) {
+        GLKVector3 *vertices = [mesh meshVertices:m];
+        unsigned int *faces = [mesh meshFaces:m];
+        int faceCount = [mesh numberOfMeshFaces:m];
+        for( int f=0; f<faceCount; f++ ) {
+            _grid.addTriangle(occlusionPoint(vertices[faces[f*3 + 0]]),
+                              occlusionPoint(vertices[faces[f*3 + 1]]),
+                              occlusionPoint(vertices[faces[f*3 + 2]]));
+        }
+        triangles += faceCount;
+    }
+    [mixedRealityMode unlockSceneMesh];
+
+    if( _grid.empty() ) {
+        NSLog(@"LineOfSight: No occupancy grid or scene mesh, every line is visible");
+        return;
+    }
+
+    _stats.width = _grid.width();
+    _stats.height = _grid.height();
+    _stats.triangles = triangles;
+    _stats.buildMs = machTicksToMs(mach_absolute_time() - start);
+    _running = YES;
+
+    be_NSDbg(@"LineOfSight: %dx%d cells, %lu triangles, built in %.1f ms",
+             _stats.width, _stats.height, (unsigned long)triangles, _stats.buildMs);
+}
+
+/// Cells over the mesh's extent across the floor, for scans without an occupancy grid.
+- (void) layOutOverMesh:(BEMesh *)mesh {
+    float minX = MAXFLOAT, minZ = MAXFLOAT, maxX = -MAXFLOAT, maxZ = -MAXFLOAT;
+    int meshCount = [mesh numberOfMeshes];
+    for( int m=0; m<meshCount; m++ ) {
+        GLKVector3 *vertices = [mesh meshVertices:m];
+        int vertexCount = [mesh numberOfMeshVertices:m];
+        for( int v=0; v<vertexCount; v++ ) {
+            minX = MIN(minX, vertices[v].x);
+            maxX = MAX(maxX, vertices[v].x);
+            minZ = MIN(minZ, vertices[v].z);
+            maxZ = MAX(maxZ, vertices[v].z);
+        }
+    }
+    if( minX > maxX ) return;
+
+    BE::OccupancyGridMetadata metadata;
+    metadata.originX = minX;
+    metadata.originY = minZ;
+    metadata.metersPerPixel = LINE_OF_SIGHT_METERS_PER_CELL;
+
+    int width = (int)ceilf((maxX - minX) / LINE_OF_SIGHT_METERS_PER_CELL) + 1;
+    int height = (int)ceilf((maxZ - minZ) / LINE_OF_SIGHT_METERS_PER_CELL) + 1;
+    if( width > LINE_OF_SIGHT_MAX_CELLS || height > LINE_OF_SIGHT_MAX_CELLS ) {
+        NSLog(@"LineOfSight: === Error === Scene mesh is %dx%d cells across, not building an occlusion grid", width, height);
+        return;
+    }
+
+    _grid.reset(metadata, width, height, LINE_OF_SIGHT_FLOOR_HEIGHT, LINE_OF_SIGHT_CEILING_HEIGHT);
+}
+
+#pragma mark - Standing Queries
+
+- (LineOfSightQuery) addQueryFrom:(SpatialHandle)from to:(SpatialHandle)to {
+    if( !_freeQueries.empty() ) {
+        LineOfSightQuery query = _freeQueries.back();
+        _freeQueries.pop_back();
+        _queries[query] = { from, to, true };
+        _visible[query] = 1;
+        return query;
+    }
+
+    be_assert( _queries.size() < LINE_OF_SIGHT_MAX_QUERIES, "Too many standing line of sight queries" );
+    _queries.push_back({ from, to, true });
+    _visible.push_back(1);
+    return (LineOfSightQuery)(_queries.size() - 1);
+}
+
+- (void) setQuery:(LineOfSightQuery)query from:(SpatialHandle)from to:(SpatialHandle)to {
+    if( query < _queries.size() && _queries[query].active ) {
+        _queries[query].from = from;
+        _queries[query].to = to;
+    }
+}
+
+- (void) removeQuery:(LineOfSightQuery)query {
+    if( query >= _queries.size() || !_queries[query].active ) return;
+
+    _queries[query].active = false;
+    _visible[query] = 0;
+    _freeQueries.push_back(query);
+}
+
+- (BOOL) queryIsVisible:(LineOfSightQuery)query {
+    return query < _visible.size() && _visible[query] != 0;
+}
+
+/// Where an end of a standing query was indexed this frame. NO if it's no longer indexed.
+- (BOOL) position:(GLKVector3 *)position ofEnd:(SpatialHandle)end cameraPosition:(GLKVector3)cameraPosition {
+    if( end == LINE_OF_SIGHT_CAMERA ) {
+        *position = cameraPosition;
+        return YES;
+    }
+
+    SpatialIndex *spatialIndex = [SpatialIndex main];
+    if( [spatialIndex nodeForHandle:end] == nil ) return NO;
+
+    *position = [spatialIndex positionForHandle:end];
+    return YES;
+}
+
+- (void) update {
+    size_t count = _queries.size() - _freeQueries.size();
+    if( count == 0 ) return;
+    uint64_t start = mach_absolute_time();
+
+    GLKVector3 cameraPosition = [Camera main].position;
+    _lineQueries.resize(count);
+    _lines.resize(count);
+    _found.resize(count);
+    _resolved.resize(count);
+
+    // Lines with a missing end are resolved too, from the origin, then blocked.
+    size_t line = 0;
+    for( size_t q=0; q<_queries.size(); q++ ) {
+        if( !_queries[q].active ) continue;
+
+        GLKVector3 from = GLKVector3Make(0, 0, 0), to = GLKVector3Make(0, 0, 0);
+        BOOL hasFrom = [self position:&from ofEnd:_queries[q].from cameraPosition:cameraPosition];
+        BOOL hasTo = [self position:&to ofEnd:_queries[q].to cameraPosition:cameraPosition];
+        _found[line] = hasFrom && hasTo;
+
+        _lineQueries[line] = (LineOfSightQuery)q;
+        _lines[line].from = occlusionPoint(from);
+        _lines[line].to = occlusionPoint(to);
+        line++;
+    }
+
+    _grid.resolve(_lines.data(), count, _resolved.data());
+
+    NSUInteger visible = 0;
+    for( size_t l=0; l<count; l++ ) {
+        uint8_t clear = _found[l] && _resolved[l];
+        _visible[_lineQueries[l]] = clear;
+        visible += clear;
+    }
+
+    _stats.queries = count;
+    _stats.visible = visible;
+    _stats.updateMs = machTicksToMs(mach_absolute_time() - start);
+}
+
+#pragma mark - Immediate
+
+- (BOOL) isVisibleFrom:(GLKVector3)from to:(GLKVector3)to {
+    BE::SightLine line;
+    line.from = occlusionPoint(from);
+    line.to = occlusionPoint(to);
+    return _grid.visible(line);
+}
+
+- (void) testLinesFrom:(const GLKVector3 *)from to:(const GLKVector3 *)to count:(NSUInteger)count visible:(BOOL *)visible {
+    std::vector<BE::SightLine> lines(count);
+    for( NSUInteger i=0; i<count; i++ ) {
+        lines[i].from = occlusionPoint(from[i]);
+        lines[i].to = occlusionPoint(to[i]);
+    }
+
+    std::vector<uint8_t> resolved(count);
+    _grid.resolve(lines.data(), count, resolved.data());
+    for( NSUInteger i=0; i<count; i++ ) {
+        visible[i] = resolved[i] != 0;
+    }
+}
+
+- (LineOfSightStats) stats {
+    return _stats;
+}
+
+@end
@@ -0,0 +1,72 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Shader modifier uniforms shared by many materials, like the VR world's.
+//
+//  Materials are tagged once, at load time, with the parameters their shader
+//  modifiers read. Setting a parameter then costs the same however many
+//  materials read it:
+//
+//  With GL, every tagged material binds the parameter's uniform to the one
+//  shared value, read when drawn, so nothing is pushed at all.
+//
+//  With Metal, SceneKit only takes uniforms from each material, so a changed
+//  parameter is pushed once in update, to the flat list of materials tagged
+//  with it. Float changes too small to see are held back until they add up.
+//
+//  Updated by the SceneManager after the components and renderers.
+//  RENDER THREAD ONLY
+//
+
+#import <SceneKit/SceneKit.h>
+
+typedef NS_ENUM(NSUInteger, MaterialParameter) {
+    MaterialParameterGrayness = 0,  // float grayAmount: 1 for gray, as tracking feedback. Defaults to 0.
+    MaterialParameterLightLevel,    // float lightLevel: diffuse scale. Defaults to 1.
+    MaterialParameterPortals,       // PortalRenderer's clip uniforms, Metal only.
+    MaterialParameterCount
+};
+
+typedef NS_OPTIONS(NSUInteger, MaterialParameterMask) {
+    MaterialParameterMaskGrayness   = 1 << MaterialParameterGrayness,
+    MaterialParameterMaskLightLevel = 1 << MaterialParameterLightLevel,
+    MaterialParameterMaskPortals    = 1 << MaterialParameterPortals,
+};
+
+typedef struct {
+    NSUInteger materials;           // Tagged, counted once per parameter.
+    NSUInteger changes;             // Parameters pushed this frame, Metal only.
+    NSUInteger pushes;              // Material values set since start, Metal only.
+} MaterialParametersStats;
+
+@interface MaterialParameters : NSObject
+
+/// Singleton.
++ (MaterialParameters *) main;
+
+/// Uniform name of a float parameter, nil for groups like MaterialParameterPortals.
++ (NSString *) uniformNameForParameter:(MaterialParameter)parameter;
+
+/// Tag material as reading parameters, given its current values. Its shader modifiers declare the uniforms.
+- (void) addMaterial:(SCNMaterial *)material parameters:(MaterialParameterMask)parameters;
+- (void) removeMaterial:(SCNMaterial *)material;
+
+- (float) floatForParameter:(MaterialParameter)parameter;
+- (void) setFloat:(float)value forParameter:(MaterialParameter)parameter;
+
+/// Uniforms of a group parameter, by name. Only the ones given change.
+- (void) setUniforms:(NSDictionary<NSString *, id> *)uniforms forParameter:(MaterialParameter)parameter;
+
+/// Push this frame's changes to Metal materials.
+- (void) update;
+
+- (MaterialParametersStats) stats;
+
+@end
@@ -0,0 +1,189 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "MaterialParameters.h"
+#import "SceneManager.h"
+
+#import <BridgeEngine/BridgeEngine.h>
+#import <BridgeEngine/BEDebugging.h>
+
+#include <OpenGLES/ES2/gl.h>
+#include <cmath>
+
+// Float changes held back, under what 8 bit color shows.
+#define MATERIAL_PARAMETER_EPSILON (1.f/512.f)
+
+namespace {
+
+    struct MaterialParameterInfo {
+        const char *uniform;        // nullptr for groups.
+        float defaultValue;
+    };
+
+    const MaterialParameterInfo MaterialParameterInfos[MaterialParameterCount] = {
+        { "grayAmount", 0.f },      // MaterialParameterGrayness
+        { "lightLevel", 1.f },      // MaterialParameterLightLevel
+        { nullptr, 0.f },           // MaterialParameterPortals
+    };
+
+} // anonymous
+
+@implementation MaterialParameters
+{
+    NSHashTable<SCNMaterial *> *_materials[MaterialParameterCount];
+
+    // Floats: current, as of last frame, and as last pushed to Metal materials.
+    float _values[MaterialParameterCount];
+    float _lastFrameValues[MaterialParameterCount];
+    float _pushedValues[MaterialParameterCount];
+
+    // Groups: all their uniforms, and the ones changed since the last push.
+    NSMutableDictionary<NSString *, id> *_uniforms[MaterialParameterCount];
+    NSMutableDictionary<NSString *, id> *_changedUniforms[MaterialParameterCount];
+
+    MaterialParametersStats _stats;
+}
+
++ (MaterialParameters *) main {
+    static MaterialParameters *mainMaterialParameters = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainMaterialParameters = [[MaterialParameters alloc] init];
+    });
+
+    return mainMaterialParameters;
+}
+
++ (NSString *) uniformNameForParameter:(MaterialParameter)parameter {
+    be_assert(parameter < MaterialParameterCount);
+    const char *uniform = MaterialParameterInfos[parameter].uniform;
+    return uniform ? @(uniform) : nil;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        for( NSUInteger p=0; p<MaterialParameterCount; p++ ) {
+            _materials[p] = [NSHashTable weakObjectsHashTable];
+            _values[p] = _lastFrameValues[p] = _pushedValues[p] = MaterialParameterInfos[p].defaultValue;
+            _uniforms[p] = [NSMutableDictionary dictionary];
+            _changedUniforms[p] = [NSMutableDictionary dictionary];
+        }
+        _stats = MaterialParametersStats();
+    }
+    return self;
+}
+
+- (BOOL) usesMetal {
+    return [SceneManager main].renderingAPI == BEViewRenderingAPIMetal;
+}
+
+#pragma mark - Materials
+
+- (void) addMaterial:(SCNMaterial *)material parameters:(MaterialParameterMask)parameters {
+    if( material == nil ) return;
+    BOOL metal = [self usesMetal];
+
+    for( NSUInteger p=0; p<MaterialParameterCount; p++ ) {
+        if( (parameters & (1 << p)) == 0 || [_materials[p] containsObject:material] ) continue;
+        [_materials[p] addObject:material];
+
+        NSString *name = [MaterialParameters uniformNameForParameter:(MaterialParameter)p];
+        if( metal ) {
+            // Start from the last pushed values, like the rest.
+            if( name ) {
+                [material setValue:@(_pushedValues[p]) forKey:name];
+            } else {
+                [_uniforms[p] enumerateKeysAndObjectsUsingBlock:^(NSString *key, id value, BOOL *stop) {
+                    [material setValue:value forKey:key];
+                }];
+            }
+        } else if( name ) {
+            // The singleton lives for good, its value can be read in place when drawn.
+            const float *value = &_values[p];
+            [material handleBindingOfSymbol:name usingBlock:^(unsigned int programID, unsigned int location, SCNNode *renderedNode, SCNRenderer *renderer) {
+                glUniform1f(location, *value);
+            }];
+        }
+    }
+}
+
+- (void) removeMaterial:(SCNMaterial *)material {
+    for( NSUInteger p=0; p<MaterialParameterCount; p++ ) {
+        if( ![_materials[p] containsObject:material] ) continue;
+        [_materials[p] removeObject:material];
+
+        NSString *name = [MaterialParameters uniformNameForParameter:(MaterialParameter)p];
+        if( name && ![self usesMetal] ) [material handleBindingOfSymbol:name usingBlock:nil];
+    }
+}
+
+#pragma mark - Values
+
+- (float) floatForParameter:(MaterialParameter)parameter {
+    be_assert(parameter < MaterialParameterCount && MaterialParameterInfos[parameter].uniform);
+    return _values[parameter];
+}
+
+- (void) setFloat:(float)value forParameter:(MaterialParameter)parameter {
+    be_assert(parameter < MaterialParameterCount && MaterialParameterInfos[parameter].uniform);
+    _values[parameter] = value;
+}
+
+- (void) setUniforms:(NSDictionary<NSString *, id> *)uniforms forParameter:(MaterialParameter)parameter {
+    be_assert(parameter < MaterialParameterCount && MaterialParameterInfos[parameter].uniform == nullptr);
+    [_uniforms[parameter] addEntriesFromDictionary:uniforms];
+    [_changedUniforms[parameter] addEntriesFromDictionary:uniforms];
+}
+
+- (void) update {
+    _stats.changes = 0;
+    if( ![self usesMetal] ) return;     // GL materials read the values when drawn.
+
+    for( NSUInteger p=0; p<MaterialParameterCount; p++ ) {
+        NSHashTable<SCNMaterial *> *materials = _materials[p];
+        NSString *name = [MaterialParameters uniformNameForParameter:(MaterialParameter)p];
+
+        if( name ) {
+            float value = _values[p];
+            BOOL settled = value == _lastFrameValues[p];
+            _lastFrameValues[p] = value;
+
+            // Small steps wait until they add up, or the value stops moving.
+            if( value == _pushedValues[p] ) continue;
+            if( fabsf(value - _pushedValues[p]) < MATERIAL_PARAMETER_EPSILON && !settled ) continue;
+            _pushedValues[p] = value;
+
+            NSNumber *number = @(value);
+            for( SCNMaterial *material in materials ) {
+                [material setValue:number forKey:name];
+            }
+            _stats.pushes += materials.count;
+        } else {
+            NSDictionary<NSString *, id> *changed = _changedUniforms[p];
+            if( changed.count == 0 ) continue;
+
+            for( SCNMaterial *material in materials ) {
+                [changed enumerateKeysAndObjectsUsingBlock:^(NSString *key, id value, BOOL *stop) {
+                    [material setValue:value forKey:key];
+                }];
+            }
+            _stats.pushes += materials.count * changed.count;
+            [_changedUniforms[p] removeAllObjects];
+        }
+        _stats.changes++;
+    }
+}
+
+- (MaterialParametersStats) stats {
+    // Materials go away on their own.
+    _stats.materials = 0;
+    for( NSUInteger p=0; p<MaterialParameterCount; p++ ) _stats.materials += _materials[p].count;
+    return _stats;
+}
+
+@end
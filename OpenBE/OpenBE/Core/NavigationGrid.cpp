@@ -0,0 +1,275 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#include "NavigationGrid.hpp"
+
+#include <climits>
+
+namespace {
+
+    struct SetNode
+    {
+        int parent;                     // Node index, itself for roots.
+        uint8_t label;
+    };
+
+    /// Root of node's set, pointing everything on the way straight at it.
+    int findRoot (std::vector<SetNode>& nodes, int node)
+    {
+        int root = node;
+        while (nodes[root].parent != root) root = nodes[root].parent;
+
+        while (node != root)
+        {
+            int next = nodes[node].parent;
+            nodes[node].parent = root;
+            nodes[node].label = nodes[root].label;
+            node = next;
+        }
+        return root;
+    }
+
+    /// Join the sets of a and b under the root with the smaller label.
+    int unionSets (std::vector<SetNode>& nodes, int a, int b)
+    {
+        int aRoot = findRoot(nodes, a);
+        int bRoot = findRoot(nodes, b);
+
+        if (nodes[aRoot].label < nodes[bRoot].label)
+        {
+            nodes[bRoot].parent = aRoot;
+            return aRoot;
+        }
+        nodes[aRoot].parent = bRoot;
+        return bRoot;
+    }
+
+} // anonymous
+
+namespace BE
+{
+
+    OccupancyGridView NavigationGrid::view (const std::vector<uint8_t>& map) const
+    {
+        OccupancyGridView view;
+        view.pixels = map.empty() ? nullptr : map.data();
+        view.rowStride = _width;
+        view.width = _width;
+        view.height = _height;
+        view.metadata = _metadata;
+        return view;
+    }
+
+    void NavigationGrid::build (const OccupancyGridView& obstacles, int robotRadiusInPixels)
+    {
+        _width = obstacles.empty() ? 0 : obstacles.width;
+        _height = obstacles.empty() ? 0 : obstacles.height;
+        _metadata = obstacles.metadata;
+
+        dilate(obstacles, robotRadiusInPixels);
+        buildTopology(robotRadiusInPixels * 2);
+        labelComponents();
+    }
+
+#pragma mark - Dilation
+
+    void NavigationGrid::dilate (const OccupancyGridView& obstacles, int radius)
+    {
+        _dilated.resize((size_t)_width * _height);
+        for (int y = 0; y < _height; ++y)
+        {
+            const uint8_t* in = obstacles.row(y);
+            uint8_t* out = &_dilated[index(0, y)];
+            for (int x = 0; x < _width; ++x) out[x] = in[x * obstacles.pixelStride];
+        }
+
+        // A pixel within radius of an obstacle is one, so obstacles stamp their disc.
+        std::vector<int> halfWidths;
+        for (int dy = -radius; dy <= radius; ++dy)
+        {
+            int halfWidth = -1;
+            while ((halfWidth + 1) * (halfWidth + 1) + dy * dy <= radius * radius) ++halfWidth;
+            halfWidths.push_back(halfWidth);
+        }
+
+        for (int y = 0; y < _height; ++y)
+        {
+            const uint8_t* in = obstacles.row(y);
+            for (int x = 0; x < _width; ++x)
+            {
+                if (in[x * obstacles.pixelStride] != 255) continue;
+
+                for (int dy = -radius; dy <= radius; ++dy)
+                {
+                    const int py = y + dy;
+                    if (py < 0 || py >= _height) continue;
+
+                    const int halfWidth = halfWidths[dy + radius];
+                    const int begin = x - halfWidth < 0 ? 0 : x - halfWidth;
+                    const int end = x + halfWidth >= _width ? _width - 1 : x + halfWidth;
+                    uint8_t* out = &_dilated[index(0, py)];
+                    for (int px = begin; px <= end; ++px) out[px] = 255;
+                }
+            }
+        }
+    }
+
+#pragma mark - Topology
+
+    void NavigationGrid::buildTopology (int accumulateSize)
+    {
+        _topology.resize(_dilated.size());
+        const int side = accumulateSize * 2 + 1;
+
+        // Each offset's term for a wall (255) and a not quite wall (254), divided once here.
+        std::vector<float> wallTerms(side * side), nearWallTerms(side * side);
+        for (int dy = -accumulateSize; dy <= accumulateSize; ++dy)
+        {
+            for (int dx = -accumulateSize; dx <= accumulateSize; ++dx)
+            {
+                const int term = (dy + accumulateSize) * side + dx + accumulateSize;
+                const int distanceSquared = dx * dx + dy * dy;
+                wallTerms[term] = distanceSquared ? 255.0f / distanceSquared : 0.f;
+                nearWallTerms[term] = distanceSquared ? 254.0f / distanceSquared : 0.f;
+            }
+        }
+
+        // Walls in every rectangle, so windows without any can be skipped.
+        const int stride = _width + 1;
+        std::vector<int> walls((size_t)stride * (_height + 1), 0);
+        for (int y = 0; y < _height; ++y)
+        {
+            int rowWalls = 0;
+            for (int x = 0; x < _width; ++x)
+            {
+                rowWalls += _dilated[index(x, y)] >= 254;
+                walls[(size_t)(y + 1) * stride + x + 1] = walls[(size_t)y * stride + x + 1] + rowWalls;
+            }
+        }
+
+        for (int y = 0; y < _height; ++y)
+        {
+            for (int x = 0; x < _width; ++x)
+            {
+                const uint8_t center = _dilated[index(x, y)];
+
+                const int x0 = x - accumulateSize, y0 = y - accumulateSize;
+                const int x1 = x + accumulateSize + 1, y1 = y + accumulateSize + 1;
+                if (x0 >= 0 && y0 >= 0 && x1 <= _width && y1 <= _height)
+                {
+                    const int windowWalls = walls[(size_t)y1 * stride + x1] - walls[(size_t)y0 * stride + x1]
+                                          - walls[(size_t)y1 * stride + x0] + walls[(size_t)y0 * stride + x0];
+                    if (windowWalls == 0)
+                    {
+                        // Nothing near, the sum below would be zero.
+                        _topology[index(x, y)] = center;
+                        continue;
+                    }
+                }
+
+                // Same terms, in the same order, as they've always been summed.
+                float accumulator = 0;
+                for (int dy = -accumulateSize; dy <= accumulateSize; ++dy)
+                {
+                    const int py = y + dy;
+                    const bool rowInside = py >= 0 && py < _height;
+                    const uint8_t* row = rowInside ? &_dilated[index(0, py)] : nullptr;
+                    const int terms = (dy + accumulateSize) * side + accumulateSize;
+
+                    for (int dx = -accumulateSize; dx <= accumulateSize; ++dx)
+                    {
+                        if (dx == 0 && dy == 0) continue;
+
+                        const int px = x + dx;
+                        if (!rowInside || px < 0 || px >= _width)
+                        {
+                            // The world ends in a wall.
+                            accumulator += wallTerms[terms + dx];
+                            continue;
+                        }
+
+                        if (row[px] == 255) accumulator += wallTerms[terms + dx];
+                        else if (row[px] == 254) accumulator += nearWallTerms[terms + dx];
+                    }
+                }
+
+                accumulator = accumulator / (accumulateSize / 1.414);
+                accumulator += center;
+                if (accumulator > 254) accumulator = 255;
+                _topology[index(x, y)] = (uint8_t)accumulator;
+            }
+        }
+    }
+
+#pragma mark - Connected components
+
+    void NavigationGrid::labelComponents ()
+    {
+        // Two-pass connected component algorithm.
+        // Areas are considered "connected" if they are not separated by an impassible obstacle.
+        std::vector<SetNode> nodes;
+        std::vector<int> pixelNodes(_dilated.size(), -1);  // Node of each free pixel.
+        std::vector<int> linked;                           // Indexed by label, the root node of each linked set.
+        linked.push_back(-1);                              // Because the first valid label is 1.
+        uint8_t nextLabel = 1;
+
+        // Pass 1: Generate labels.
+        for (int y = 0; y < _height; ++y)
+        {
+            for (int x = 0; x < _width; ++x)
+            {
+                if (_dilated[index(x, y)] == 255) continue;
+
+                // Free neighbors that were labelled already: NW, N, NE, W.
+                int neighbors[4];
+                int neighborCount = 0;
+                int smallestLabel = INT_MAX;
+                for (int dy = -1; dy <= 0; ++dy)
+                {
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        if (dy >= 0 && dx >= 0) continue;
+
+                        const int px = x + dx;
+                        const int py = y + dy;
+                        if (!contains(px, py) || _dilated[index(px, py)] == 255) continue;
+
+                        const int neighbor = pixelNodes[index(px, py)];
+                        neighbors[neighborCount++] = neighbor;
+                        if (nodes[neighbor].label < smallestLabel) smallestLabel = nodes[neighbor].label;
+                    }
+                }
+
+                if (neighborCount == 0)
+                {
+                    // A new label, which might later turn out to be equivalent to an older one.
+                    const int node = (int)nodes.size();
+                    nodes.push_back({ node, nextLabel });
+                    pixelNodes[index(x, y)] = node;
+                    linked.push_back(node);
+                    nextLabel++;
+                }
+                else
+                {
+                    // Join this point and all its neighbors into the smallest label's set.
+                    pixelNodes[index(x, y)] = linked[smallestLabel];
+                    for (int i = 0; i < neighborCount; ++i)
+                        linked[smallestLabel] = unionSets(nodes, linked[smallestLabel], neighbors[i]);
+                }
+            }
+        }
+
+        // Pass 2: Replace equivalent labels with their set's.
+        _components.resize(_dilated.size());
+        for (size_t i = 0; i < _components.size(); ++i)
+        {
+            const int node = pixelNodes[i];
+            _components[i] = node < 0 ? 0 : nodes[findRoot(nodes, node)].label;
+        }
+    }
+
+} // BE
@@ -0,0 +1,78 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  The maps PathFinding plans on, built from an obstacle grid view.
+//
+//  - Dilated: the obstacles grown by the robot's radius, 255 where it can't
+//    stand. Obstacle pixels stamp a disc, instead of every pixel searching one.
+//  - Topology: 1/r^2 nearness to obstacles and the grid's edges, 255 at worst.
+//  - Components: connected free areas, labelled 1 and up in two passes over
+//    a flat union-find, 0 on obstacles. Labels are 8 bit and wrap around on
+//    grids with more than 255 separate areas, as they always have.
+//
+//  Maps are flat, row major, one byte a pixel, and can be viewed as
+//  OccupancyGridViews for overlays and tools.
+//
+//  Plain C++ with no Apple dependencies, shared by the app and Tools/NavigationBench.
+//
+
+#pragma once
+
+#include "OccupancyGrid.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace BE
+{
+
+    class NavigationGrid
+    {
+    public:
+        NavigationGrid () = default;
+
+        /**
+         * Build every map from obstacles, where 255 is an obstacle.
+         * obstacles is only read during the call, its metadata is kept.
+         */
+        void build (const OccupancyGridView& obstacles, int robotRadiusInPixels);
+
+        int width () const { return _width; }
+        int height () const { return _height; }
+        const OccupancyGridMetadata& metadata () const { return _metadata; }
+
+        bool contains (int x, int y) const { return x >= 0 && y >= 0 && x < _width && y < _height; }
+
+        uint8_t dilated (int x, int y) const { return _dilated[index(x, y)]; }
+        uint8_t topology (int x, int y) const { return _topology[index(x, y)]; }
+        uint8_t component (int x, int y) const { return _components[index(x, y)]; }
+
+        /// Valid until the next build.
+        OccupancyGridView dilatedView () const { return view(_dilated); }
+        OccupancyGridView topologyView () const { return view(_topology); }
+        OccupancyGridView componentView () const { return view(_components); }
+
+    private:
+        size_t index (int x, int y) const { return (size_t)y * _width + x; }
+        OccupancyGridView view (const std::vector<uint8_t>& map) const;
+
+        void dilate (const OccupancyGridView& obstacles, int radius);
+        void buildTopology (int accumulateSize);
+        void labelComponents ();
+
+        std::vector<uint8_t> _dilated;
+        std::vector<uint8_t> _topology;
+        std::vector<uint8_t> _components;
+        int _width = 0;
+        int _height = 0;
+        OccupancyGridMetadata _metadata;
+    };
+
+} // BE
@@ -0,0 +1,130 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Pools of reusable objects, so spawning and transient visuals don't allocate
+//  SceneKit objects mid-frame.
+//
+//  A pool is filled up front, ideally with prewarmInBackground: while loading,
+//  hands objects out with acquire, and runs its reset block on every object
+//  given back, so the next acquire gets it clean. What happens when it runs dry
+//  is up to the growth policy. Stats keep the high-water mark, the number to
+//  size the pool with.
+//
+//  Factories cover nodes, geometries, physics bodies and components.
+//
+//  Acquire and release are THREAD SAFE, but SceneKit objects should only be
+//  acquired and released on the thread that updates the scene.
+//
+
+#import <Foundation/Foundation.h>
+#import <SceneKit/SceneKit.h>
+
+@class Component;
+
+typedef NS_ENUM(NSInteger, ObjectPoolGrowth) {
+    ObjectPoolGrowthFixed = 0,      // Never allocates after pre-warming, acquire returns nil when empty.
+    ObjectPoolGrowthRecycle,        // When empty, take back the object acquired longest ago.
+    ObjectPoolGrowthDouble,         // When empty, allocate as many again, up to maxCapacity.
+};
+
+typedef struct {
+    NSUInteger capacity;            // Objects allocated.
+    NSUInteger inUse;
+    NSUInteger highWater;           // Most in use at once.
+    NSUInteger acquires;
+    NSUInteger grown;               // Objects allocated after pre-warming, each one a mid-frame allocation.
+    NSUInteger recycled;            // Taken back while still in use.
+    NSUInteger exhausted;           // Acquires that returned nil.
+} ObjectPoolStats;
+
+@interface ObjectPool<ObjectType> : NSObject
+
+@property (nonatomic, readonly) NSString *name;
+@property (nonatomic, readonly) ObjectPoolGrowth growth;
+
+/// Hard limit for ObjectPoolGrowthDouble. Defaults to 8 times the initial capacity.
+@property (nonatomic) NSUInteger maxCapacity;
+
+/**
+ * @param capacity Objects made when pre-warming.
+ * @param create Makes one new object. May run on a background queue when pre-warming in the background.
+ * @param reset Puts an object back to its freshly made state, on release or recycle. May be nil.
+ */
+- (instancetype) initWithName:(NSString *)name
+                     capacity:(NSUInteger)capacity
+                       growth:(ObjectPoolGrowth)growth
+                       create:(ObjectType (^)(void))create
+                        reset:(void (^)(ObjectType object))reset;
+
+/// Allocate up to capacity now.
+- (void) prewarm;
+
+/**
+ * Allocate up to capacity on a utility queue, then call completion on the main queue.
+ * Acquires meanwhile still work, allocating if they must.
+ */
+- (void) prewarmInBackground:(void (^)(void))completion;
+
+/// A free object, or one the growth policy made available. nil only for a fixed pool that's empty.
+- (ObjectType) acquire;
+
+/// Reset object and make it available again. Objects that aren't in use are ignored.
+- (void) releaseObject:(ObjectType)object;
+
+/// Release every object in use.
+- (void) releaseAll;
+
+/// Objects in use, oldest first.
+- (NSArray<ObjectType> *) objectsInUse;
+
+- (ObjectPoolStats) stats;
+
+@end
+
+@interface ObjectPool (SceneKit)
+
+/**
+ * Clones of prototype, sharing its geometry.
+ * @param parent When set, nodes are added to it as soon as they're made and only hidden on release.
+ *  SceneKit physics misbehaves when bodies are added to a running world, so nodes with bodies want this.
+ *  When nil, released nodes are taken out of the scene.
+ */
++ (ObjectPool<SCNNode *> *) nodePoolWithName:(NSString *)name
+                                    capacity:(NSUInteger)capacity
+                                      growth:(ObjectPoolGrowth)growth
+                                   prototype:(SCNNode *)prototype
+                                      parent:(SCNNode *)parent;
+
+/// Copies of prototype. Copies share geometry sources and elements, materials are copied so each can be tinted.
++ (ObjectPool<SCNGeometry *> *) geometryPoolWithName:(NSString *)name
+                                            capacity:(NSUInteger)capacity
+                                              growth:(ObjectPoolGrowth)growth
+                                           prototype:(SCNGeometry *)prototype;
+
+/// Bodies made by create, with their motion cleared on release.
++ (ObjectPool<SCNPhysicsBody *> *) physicsBodyPoolWithName:(NSString *)name
+                                                  capacity:(NSUInteger)capacity
+                                                    growth:(ObjectPoolGrowth)growth
+                                                    create:(SCNPhysicsBody * (^)(void))create;
+
+/// Components made by create, disabled and taken off their entity on release.
++ (ObjectPool<Component *> *) componentPoolWithName:(NSString *)name
+                                           capacity:(NSUInteger)capacity
+                                             growth:(ObjectPoolGrowth)growth
+                                             create:(Component * (^)(void))create;
+
+@end
+
+@interface ObjectPool (Stats)
+
+/// One line of stats per live pool, for logging.
++ (NSString *) statsReport;
+
+@end
@@ -0,0 +1,311 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "ObjectPool.h"
+#import "Component.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <mutex>
+
+// Default maxCapacity, as a multiple of the initial capacity.
+#define OBJECT_POOL_DEFAULT_MAX_CAPACITY_FACTOR 8
+
+@implementation ObjectPool
+{
+    std::mutex _mutex;
+
+    id (^_create)(void);
+    void (^_reset)(id object);
+    NSUInteger _capacity;
+
+    // Guarded by _mutex.
+    NSMutableArray *_free;              // Most recently released last, it's the warmest.
+    NSMutableOrderedSet *_inUse;        // Oldest acquire first.
+    NSUInteger _allocated;              // Including objects being made by a pre-warm.
+    BOOL _prewarmed;
+    ObjectPoolStats _stats;
+}
+
++ (NSHashTable<ObjectPool *> *) livePools {
+    static NSHashTable<ObjectPool *> *pools = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pools = [NSHashTable weakObjectsHashTable];
+    });
+    return pools;
+}
+
+- (instancetype) initWithName:(NSString *)name
+                     capacity:(NSUInteger)capacity
+                       growth:(ObjectPoolGrowth)growth
+                       create:(id (^)(void))create
+                        reset:(void (^)(id object))reset {
+    be_assert(create);
+
+    self = [super init];
+    if( self ) {
+        _name = [name copy];
+        _growth = growth;
+        _capacity = MAX((NSUInteger)1, capacity);
+        _maxCapacity = _capacity * OBJECT_POOL_DEFAULT_MAX_CAPACITY_FACTOR;
+        _create = [create copy];
+        _reset = [reset copy];
+        _free = [NSMutableArray arrayWithCapacity:_capacity];
+        _inUse = [NSMutableOrderedSet orderedSetWithCapacity:_capacity];
+        _stats = ObjectPoolStats();
+
+        NSHashTable *pools = [ObjectPool livePools];
+        @synchronized (pools) {
+            [pools addObject:self];
+        }
+    }
+    return self;
+}
+
+#pragma mark - Pre-warming
+
+- (void) prewarm {
+    // Objects are made outside the lock, so acquires don't wait on a long pre-warm.
+    for( ;; ) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if( _allocated >= _capacity ) {
+                _prewarmed = YES;
+                return;
+            }
+            _allocated++;
+        }
+
+        id object = _create();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( object == nil ) {
+            NSLog(@"ObjectPool: === Error === %@ create returned nil, pre-warm stopped at %lu", _name, (unsigned long)_allocated - 1);
+            _allocated--;
+            _prewarmed = YES;
+            return;
+        }
+        [_free addObject:object];
+        _stats.capacity = _allocated;
+    }
+}
+
+- (void) prewarmInBackground:(void (^)(void))completion {
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self prewarm];
+        if( completion ) {
+            dispatch_async(dispatch_get_main_queue(), completion);
+        }
+    });
+}
+
+#pragma mark - Acquire and Release
+
+- (id) acquire {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.acquires++;
+
+    id object = _free.lastObject;
+    if( object ) {
+        [_free removeLastObject];
+    } else if( !_prewarmed && _allocated < _capacity ) {
+        // Asked for before pre-warming got to it.
+        object = [self growLockedTo:_allocated + 1];
+    } else if( _growth == ObjectPoolGrowthRecycle && _inUse.count > 0 ) {
+        object = _inUse.firstObject;
+        [_inUse removeObjectAtIndex:0];
+        if( _reset ) _reset(object);
+        _stats.recycled++;
+    } else if( _growth == ObjectPoolGrowthDouble ) {
+        NSUInteger target = MIN(_allocated * 2, _maxCapacity);
+        be_dbg("ObjectPool: %s grows from %lu to %lu mid-frame, consider a larger capacity",
+               _name.UTF8String, (unsigned long)_allocated, (unsigned long)target);
+        object = [self growLockedTo:target];
+    }
+
+    if( object == nil ) {
+        _stats.exhausted++;
+        return nil;
+    }
+
+    [_inUse addObject:object];
+    _stats.highWater = MAX(_stats.highWater, _inUse.count);
+    return object;
+}
+
+/**
+ * Make objects up to target, one to return now and the rest for later.
+ * Call with _mutex held.
+ */
+- (id) growLockedTo:(NSUInteger)target {
+    id object = nil;
+    while( _allocated < target ) {
+        id made = _create();
+        if( made == nil ) break;
+
+        _allocated++;
+        if( _prewarmed ) _stats.grown++;
+        if( object == nil ) object = made;
+        else [_free addObject:made];
+    }
+    _stats.capacity = _allocated;
+    return object;
+}
+
+- (void) releaseObject:(id)object {
+    if( object == nil ) return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Already released or recycled.
+    if( ![_inUse containsObject:object] ) return;
+
+    [_inUse removeObject:object];
+    if( _reset ) _reset(object);
+    [_free addObject:object];
+}
+
+- (void) releaseAll {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for( id object in _inUse ) {
+        if( _reset ) _reset(object);
+        [_free addObject:object];
+    }
+    [_inUse removeAllObjects];
+}
+
+- (NSArray *) objectsInUse {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inUse.array;
+}
+
+- (ObjectPoolStats) stats {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    ObjectPoolStats stats = _stats;
+    stats.capacity = _allocated;
+    stats.inUse = _inUse.count;
+    return stats;
+}
+
+@end
+
+#pragma mark - SceneKit
+
+@implementation ObjectPool (SceneKit)
+
++ (ObjectPool<SCNNode *> *) nodePoolWithName:(NSString *)name
+                                    capacity:(NSUInteger)capacity
+                                      growth:(ObjectPoolGrowth)growth
+                                   prototype:(SCNNode *)prototype
+                                      parent:(SCNNode *)parent {
+    be_assert(prototype);
+
+    SCNMatrix4 transform = prototype.transform;
+    CGFloat opacity = prototype.opacity;
+    BOOL hidden = prototype.hidden;
+    __weak SCNNode *weakParent = parent;
+
+    return [[ObjectPool alloc] initWithName:name capacity:capacity growth:growth create:^id{
+        SCNNode *node = [prototype clone];
+        if( weakParent ) {
+            node.hidden = YES;
+            [weakParent addChildNode:node];
+        }
+        return node;
+    } reset:^(SCNNode *node) {
+        [node removeAllActions];
+        [node removeAllAnimations];
+        node.transform = transform;
+        node.opacity = opacity;
+
+        SCNPhysicsBody *body = node.physicsBody;
+        if( body ) {
+            body.velocity = SCNVector3Zero;
+            body.angularVelocity = SCNVector4Zero;
+            [body clearAllForces];
+            [body resetTransform];
+        }
+
+        if( weakParent ) {
+            node.hidden = YES;
+        } else {
+            [node removeFromParentNode];
+            node.hidden = hidden;
+        }
+    }];
+}
+
++ (ObjectPool<SCNGeometry *> *) geometryPoolWithName:(NSString *)name
+                                            capacity:(NSUInteger)capacity
+                                              growth:(ObjectPoolGrowth)growth
+                                           prototype:(SCNGeometry *)prototype {
+    be_assert(prototype);
+
+    return [[ObjectPool alloc] initWithName:name capacity:capacity growth:growth create:^id{
+        SCNGeometry *geometry = [prototype copy];
+        geometry.materials = [[NSArray alloc] initWithArray:prototype.materials copyItems:YES];
+        return geometry;
+    } reset:^(SCNGeometry *geometry) {
+        // Undo per-use tinting, without allocating new materials.
+        NSArray<SCNMaterial *> *materials = geometry.materials;
+        NSArray<SCNMaterial *> *original = prototype.materials;
+        for( NSUInteger i=0; i<materials.count && i<original.count; i++ ) {
+            materials[i].diffuse.contents = original[i].diffuse.contents;
+            materials[i].emission.contents = original[i].emission.contents;
+            materials[i].transparency = original[i].transparency;
+        }
+    }];
+}
+
++ (ObjectPool<SCNPhysicsBody *> *) physicsBodyPoolWithName:(NSString *)name
+                                                  capacity:(NSUInteger)capacity
+                                                    growth:(ObjectPoolGrowth)growth
+                                                    create:(SCNPhysicsBody * (^)(void))create {
+    return [[ObjectPool alloc] initWithName:name capacity:capacity growth:growth create:create reset:^(SCNPhysicsBody *body) {
+        body.velocity = SCNVector3Zero;
+        body.angularVelocity = SCNVector4Zero;
+        [body clearAllForces];
+    }];
+}
+
++ (ObjectPool<Component *> *) componentPoolWithName:(NSString *)name
+                                           capacity:(NSUInteger)capacity
+                                             growth:(ObjectPoolGrowth)growth
+                                             create:(Component * (^)(void))create {
+    return [[ObjectPool alloc] initWithName:name capacity:capacity growth:growth create:create reset:^(Component *component) {
+        [component setEnabled:NO];
+        [component.entity removeComponentForClass:[component class]];
+    }];
+}
+
+@end
+
+#pragma mark - Stats
+
+@implementation ObjectPool (Stats)
+
++ (NSString *) statsReport {
+    NSArray<ObjectPool *> *pools;
+    NSHashTable *livePools = [ObjectPool livePools];
+    @synchronized (livePools) {
+        pools = livePools.allObjects;
+    }
+
+    NSMutableString *report = [NSMutableString stringWithString:@"ObjectPool stats:"];
+    for( ObjectPool *pool in pools ) {
+        ObjectPoolStats stats = pool.stats;
+        [report appendFormat:@"\n  %@: %lu/%lu in use, high-water %lu, %lu acquires, %lu grown, %lu recycled, %lu exhausted",
+            pool.name, (unsigned long)stats.inUse, (unsigned long)stats.capacity, (unsigned long)stats.highWater,
+            (unsigned long)stats.acquires, (unsigned long)stats.grown, (unsigned long)stats.recycled, (unsigned long)stats.exhausted];
+    }
+    return report;
+}
+
+@end
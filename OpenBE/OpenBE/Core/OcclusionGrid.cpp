@@ -0,0 +1,157 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#include "OcclusionGrid.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+    /// Narrow [tEnter, tExit] to where start + t * delta is within [low, high].
+    bool clipToSlab (float start, float delta, float low, float high, float& tEnter, float& tExit)
+    {
+        if (delta == 0.f) return start >= low && start <= high;
+
+        float t0 = (low - start) / delta;
+        float t1 = (high - start) / delta;
+        if (t0 > t1) std::swap(t0, t1);
+
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+        return tEnter <= tExit;
+    }
+
+} // anonymous
+
+namespace BE
+{
+
+    void OcclusionGrid::reset (const OccupancyGridMetadata& metadata, int width, int height, float floorHeight, float ceilingHeight)
+    {
+        _width = std::max(0, width);
+        _height = std::max(0, height);
+        _metadata = metadata;
+        _pixelsPerMeter = metadata.metersPerPixel > 0.f ? 1.f / metadata.metersPerPixel : 0.f;
+        _floorHeight = floorHeight;
+        _ceilingHeight = ceilingHeight;
+
+        if (_pixelsPerMeter == 0.f) _width = _height = 0;
+        _heights.assign((size_t)_width * _height, -std::numeric_limits<float>::infinity());
+    }
+
+    void OcclusionGrid::addOccupancy (const OccupancyGridView& grid, uint8_t mask, float height)
+    {
+        if (grid.empty()) return;
+
+        const int rows = std::min(grid.height, _height);
+        const int columns = std::min(grid.width, _width);
+        for (int y = 0; y < rows; ++y)
+        {
+            const uint8_t* in = grid.row(y);
+            float* out = &_heights[index(0, y)];
+            for (int x = 0; x < columns; ++x)
+            {
+                if ((in[x * grid.pixelStride] & mask) && height > out[x]) out[x] = height;
+            }
+        }
+    }
+
+    void OcclusionGrid::addTriangle (const OcclusionPoint& a, const OcclusionPoint& b, const OcclusionPoint& c)
+    {
+        if (empty()) return;
+        if (a.height > _ceilingHeight && b.height > _ceilingHeight && c.height > _ceilingHeight) return;
+
+        // Longest edge across the floor, in cells.
+        auto cells = [this] (const OcclusionPoint& p, const OcclusionPoint& q) {
+            return std::max(std::fabs(p.x - q.x), std::fabs(p.z - q.z)) * _pixelsPerMeter;
+        };
+        const float longest = std::max(cells(a, b), std::max(cells(b, c), cells(c, a)));
+        const int steps = std::max(1, (int)std::ceil(longest * 2.f));
+
+        for (int i = 0; i <= steps; ++i)
+        {
+            for (int j = 0; i + j <= steps; ++j)
+            {
+                const float u = (float)i / steps, v = (float)j / steps, w = 1.f - u - v;
+                OcclusionPoint point;
+                point.x = a.x * w + b.x * u + c.x * v;
+                point.z = a.z * w + b.z * u + c.z * v;
+                point.height = a.height * w + b.height * u + c.height * v;
+                addPoint(point);
+            }
+        }
+    }
+
+#pragma mark - Sight lines
+
+    bool OcclusionGrid::visible (const SightLine& line) const
+    {
+        if (empty()) return true;
+
+        const float x0 = gridX(line.from.x), y0 = gridY(line.from.z);
+        const float x1 = gridX(line.to.x), y1 = gridY(line.to.z);
+        const float dx = x1 - x0, dy = y1 - y0;
+
+        // Only the part over the grid can be blocked.
+        float tEnter = 0.f, tExit = 1.f;
+        if (!clipToSlab(x0, dx, 0.f, (float)_width, tEnter, tExit)) return true;
+        if (!clipToSlab(y0, dy, 0.f, (float)_height, tEnter, tExit)) return true;
+
+        const int startX = (int)std::floor(x0), startY = (int)std::floor(y0);
+        const int endX = (int)std::floor(x1), endY = (int)std::floor(y1);
+
+        int x = std::min(std::max((int)std::floor(x0 + dx * tEnter), 0), _width - 1);
+        int y = std::min(std::max((int)std::floor(y0 + dy * tEnter), 0), _height - 1);
+
+        const float infinity = std::numeric_limits<float>::infinity();
+        const int stepX = dx > 0.f ? 1 : (dx < 0.f ? -1 : 0);
+        const int stepY = dy > 0.f ? 1 : (dy < 0.f ? -1 : 0);
+        const float tDeltaX = stepX ? std::fabs(1.f / dx) : infinity;
+        const float tDeltaY = stepY ? std::fabs(1.f / dy) : infinity;
+        float tMaxX = stepX ? ((stepX > 0 ? x + 1 : x) - x0) / dx : infinity;
+        float tMaxY = stepY ? ((stepY > 0 ? y + 1 : y) - y0) / dy : infinity;
+
+        // Heights are linear along the line, so its lowest over a cell is at one of the cell's ends.
+        const float fromHeight = line.from.height;
+        const float rise = line.to.height - line.from.height;
+
+        float t = tEnter;
+        for (;;)
+        {
+            const float tNext = std::min(std::min(tMaxX, tMaxY), tExit);
+            const bool endCell = (x == startX && y == startY) || (x == endX && y == endY);
+            if (!endCell)
+            {
+                const float lowest = fromHeight + rise * (rise > 0.f ? t : tNext);
+                if (lowest < _heights[index(x, y)]) return false;
+            }
+            if (tNext >= tExit) break;
+
+            if (tMaxX < tMaxY)
+            {
+                x += stepX;
+                t = tMaxX;
+                tMaxX += tDeltaX;
+            }
+            else
+            {
+                y += stepY;
+                t = tMaxY;
+                tMaxY += tDeltaY;
+            }
+            if (!contains(x, y)) break;
+        }
+        return true;
+    }
+
+    void OcclusionGrid::resolve (const SightLine* lines, size_t count, uint8_t* visible) const
+    {
+        for (size_t i = 0; i < count; ++i) visible[i] = this->visible(lines[i]) ? 1 : 0;
+    }
+
+} // BE
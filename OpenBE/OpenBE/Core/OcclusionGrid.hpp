@@ -0,0 +1,123 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  A 2.5D occlusion map of the scanned room, for line of sight tests.
+//
+//  The floor is divided into the cells of an occupancy grid, and every cell
+//  keeps the height of the tallest thing in it: the occupancy grid's obstacles
+//  at a given height, and the scan mesh's triangles above the floor, up to the
+//  ceiling. Heights are up from the floor, in meters.
+//
+//  A sight line walks the cells it crosses, a 2D DDA, and is blocked where it
+//  passes below a cell's height. The cells of its two ends are skipped, they
+//  hold whatever is looking and whatever is looked at. Being 2.5D, a cell is
+//  solid all the way down, so nothing is seen under a table.
+//
+//  Plain C++ with no Apple dependencies, shared by the app and Tools/NavigationBench.
+//
+
+#pragma once
+
+#include "OccupancyGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace BE
+{
+
+    /// A point over the grid: x and z as the occupancy grid's x and y, height up from the floor.
+    struct OcclusionPoint
+    {
+        float x = 0.f;
+        float z = 0.f;
+        float height = 0.f;
+    };
+
+    struct SightLine
+    {
+        OcclusionPoint from;
+        OcclusionPoint to;
+    };
+
+    class OcclusionGrid
+    {
+    public:
+        OcclusionGrid () = default;
+
+        /**
+         * Clear to width x height empty cells, laid out like an occupancy grid with metadata.
+         * Scan points below floorHeight don't occlude, and those above ceilingHeight only up to it.
+         */
+        void reset (const OccupancyGridMetadata& metadata, int width, int height, float floorHeight, float ceilingHeight);
+
+        /// Raise the cells of grid with any of mask's bits to height. grid must be laid out like this one.
+        void addOccupancy (const OccupancyGridView& grid, uint8_t mask, float height);
+
+        /**
+         * Raise the cell under point to its height, if above the floor.
+         * Heights above the ceiling are clamped to it, so a tall wall or shelf still blocks.
+         */
+        void addPoint (const OcclusionPoint& point)
+        {
+            if (point.height < _floorHeight) return;
+
+            const int x = cellX(point.x), y = cellY(point.z);
+            if (!contains(x, y)) return;
+
+            const float height = std::min(point.height, _ceilingHeight);
+            float& cell = _heights[index(x, y)];
+            if (height > cell) cell = height;
+        }
+
+        /**
+         * Raise every cell the triangle covers, sampled at least twice a cell so big triangles leave no holes.
+         * Triangles wholly above the ceiling height are the room's ceiling, and are skipped.
+         */
+        void addTriangle (const OcclusionPoint& a, const OcclusionPoint& b, const OcclusionPoint& c);
+
+        int width () const { return _width; }
+        int height () const { return _height; }
+        const OccupancyGridMetadata& metadata () const { return _metadata; }
+        bool empty () const { return _heights.empty(); }
+
+        bool contains (int x, int y) const { return x >= 0 && y >= 0 && x < _width && y < _height; }
+
+        /// Height of the cell, -infinity if nothing is in it.
+        float cellHeight (int x, int y) const { return _heights[index(x, y)]; }
+
+        /// Is nothing in the way. Everything is visible on an empty grid, and off it.
+        bool visible (const SightLine& line) const;
+
+        /// Test count lines, writing 1 for each visible one and 0 for each blocked one.
+        void resolve (const SightLine* lines, size_t count, uint8_t* visible) const;
+
+    private:
+        size_t index (int x, int y) const { return (size_t)y * _width + x; }
+
+        // Pixel centers are at origin + index * metersPerPixel, so a cell spans half a pixel either side.
+        float gridX (float x) const { return (x - _metadata.originX) * _pixelsPerMeter + 0.5f; }
+        float gridY (float z) const { return (z - _metadata.originY) * _pixelsPerMeter + 0.5f; }
+        int cellX (float x) const { return (int)std::floor(gridX(x)); }
+        int cellY (float z) const { return (int)std::floor(gridY(z)); }
+
+        std::vector<float> _heights;
+        int _width = 0;
+        int _height = 0;
+        OccupancyGridMetadata _metadata;
+        float _pixelsPerMeter = 0.f;
+        float _floorHeight = 0.f;
+        float _ceilingHeight = 0.f;
+    };
+
+} // BE
@@ -0,0 +1,162 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#include "OccupancyGrid.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+    bool fail (std::string* error, const char* reason)
+    {
+        if (error) *error = reason;
+        return false;
+    }
+
+    size_t skipSpaces (const std::string& json, size_t at)
+    {
+        while (at < json.size() && isspace((unsigned char)json[at])) ++at;
+        return at;
+    }
+
+    /// Position right after the colon following the quoted key, or npos.
+    size_t findValue (const std::string& json, const char* key)
+    {
+        const std::string quoted = std::string("\"") + key + "\"";
+        for (size_t at = json.find(quoted); at != std::string::npos; at = json.find(quoted, at + 1))
+        {
+            size_t colon = skipSpaces(json, at + quoted.size());
+            if (colon < json.size() && json[colon] == ':') return colon + 1;
+        }
+        return std::string::npos;
+    }
+
+    bool parseNumber (const std::string& json, size_t& at, float& value)
+    {
+        at = skipSpaces(json, at);
+        if (at >= json.size()) return false;
+
+        const char* begin = json.c_str() + at;
+        char* end = nullptr;
+        double number = strtod(begin, &end);
+        if (end == begin) return false;
+
+        value = (float)number;
+        at += end - begin;
+        return true;
+    }
+
+    /// First of keys holding a number.
+    bool findNumber (const std::string& json, std::initializer_list<const char*> keys, float& value)
+    {
+        for (const char* key : keys)
+        {
+            size_t at = findValue(json, key);
+            if (at != std::string::npos && parseNumber(json, at, value)) return true;
+        }
+        return false;
+    }
+
+    /// "origin": [x, y, ...]
+    bool findOriginArray (const std::string& json, float& x, float& y)
+    {
+        size_t at = findValue(json, "origin");
+        if (at == std::string::npos) return false;
+
+        at = skipSpaces(json, at);
+        if (at >= json.size() || json[at] != '[') return false;
+        if (!parseNumber(json, ++at, x)) return false;
+
+        at = skipSpaces(json, at);
+        if (at >= json.size() || json[at] != ',') return false;
+        return parseNumber(json, ++at, y);
+    }
+
+} // anonymous
+
+namespace BE
+{
+
+#pragma mark - OccupancyGridImage
+
+    void OccupancyGridImage::reset (int width, int height, uint8_t value)
+    {
+        _width = width > 0 ? width : 0;
+        _height = height > 0 ? height : 0;
+        _pixels.assign((size_t)_width * _height, value);
+    }
+
+    OccupancyGridView OccupancyGridImage::view () const
+    {
+        OccupancyGridView view;
+        view.pixels = _pixels.empty() ? nullptr : _pixels.data();
+        view.rowStride = _width;
+        view.pixelStride = 1;
+        view.width = _width;
+        view.height = _height;
+        view.metadata = metadata;
+        return view;
+    }
+
+#pragma mark - Conversion
+
+    void convertOccupancyGrid (const OccupancyGridView& grid, uint8_t mask, OccupancyGridImage& output)
+    {
+        output.reset(grid.width, grid.height);
+        output.metadata = grid.metadata;
+        if (grid.empty()) return;
+
+        for (int y = 0; y < grid.height; ++y)
+        {
+            const uint8_t* in = grid.row(y);
+            uint8_t* out = output.row(y);
+
+            if (grid.pixelStride == 1)
+            {
+                for (int x = 0; x < grid.width; ++x) out[x] = (in[x] & mask) ? 255 : 0;
+            }
+            else
+            {
+                for (int x = 0; x < grid.width; ++x) out[x] = (in[x * grid.pixelStride] & mask) ? 255 : 0;
+            }
+        }
+    }
+
+#pragma mark - Metadata
+
+    bool parseOccupancyGridMetadata (const std::string& json, OccupancyGridMetadata& metadata, std::string* error)
+    {
+        OccupancyGridMetadata parsed;
+
+        bool origin = findNumber(json, { "originX", "origin_x" }, parsed.originX)
+                   && findNumber(json, { "originY", "origin_y" }, parsed.originY);
+        if (!origin && !findOriginArray(json, parsed.originX, parsed.originY))
+            return fail(error, "no origin");
+
+        if (!findNumber(json, { "metersPerPixel", "meters_per_pixel", "resolution" }, parsed.metersPerPixel))
+            return fail(error, "no meters per pixel");
+        if (!(parsed.metersPerPixel > 0.f))
+            return fail(error, "meters per pixel isn't positive");
+
+        metadata = parsed;
+        return true;
+    }
+
+    bool readOccupancyGridMetadata (const char* path, OccupancyGridMetadata& metadata, std::string* error)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) return fail(error, "can't open the metadata file");
+
+        std::ostringstream contents;
+        contents << stream.rdbuf();
+        return parseOccupancyGridMetadata(contents.str(), metadata, error);
+    }
+
+} // BE
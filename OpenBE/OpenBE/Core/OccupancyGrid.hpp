@@ -0,0 +1,114 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Occupancy grids as plain pixel memory, for the navigation structures.
+//
+//  OccupancyGridView points at 8 bit grid pixels wherever they already are:
+//  a decoded PNG, a pixel buffer, an OccupancyGridImage. It is a row pointer,
+//  a row stride and a pixel stride, so a channel of a wider image can be read
+//  in place. Nothing is copied or owned, the memory must outlive the view.
+//
+//  Pixels are the BEOccupancy bitmask of occupancy_grid.png, or a converted
+//  grid where 255 marks the pixels of interest, like
+//  BEOccupancyGrid convertToObstacleGrid:outputGrid: makes.
+//
+//  The metadata of occupancy_grid_metadata.json is parsed here too, so the
+//  Linux tools read a scan the same way the app does.
+//
+//  Plain C++ with no Apple dependencies, shared by the app and Tools/NavigationBench.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace BE
+{
+
+    /// Bits of an occupancy_grid.png pixel. Matches BEOccupancy in BEOccupancyGrid.h.
+    enum OccupancyBits : uint8_t
+    {
+        OccupancyUnknown = 0,
+        OccupancyFloor = 1,
+        OccupancyCovered = 1 << 1,
+        OccupancyObstacle = 1 << 2,
+    };
+
+    /// Where the grid lies in the world, like BEOccupancyGrid's accessors.
+    struct OccupancyGridMetadata
+    {
+        float originX = 0.f;            // Of the center of pixel (0, 0), meters.
+        float originY = 0.f;
+        float metersPerPixel = 0.f;
+    };
+
+    struct OccupancyGridView
+    {
+        const uint8_t* pixels = nullptr;    // Pixel (0, 0).
+        ptrdiff_t rowStride = 0;            // Bytes from a row to the next.
+        ptrdiff_t pixelStride = 1;          // Bytes from a pixel to the next.
+        int width = 0;
+        int height = 0;
+        OccupancyGridMetadata metadata;
+
+        bool empty () const { return pixels == nullptr || width <= 0 || height <= 0; }
+        bool contains (int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+        const uint8_t* row (int y) const { return pixels + y * rowStride; }
+        uint8_t at (int x, int y) const { return row(y)[x * pixelStride]; }
+    };
+
+    /// Grid pixels owned in one tightly packed block, rows top to bottom.
+    class OccupancyGridImage
+    {
+    public:
+        OccupancyGridImage () = default;
+
+        /// Resize to width x height, every pixel set to value.
+        void reset (int width, int height, uint8_t value = 0);
+
+        int width () const { return _width; }
+        int height () const { return _height; }
+
+        uint8_t* row (int y) { return _pixels.data() + (size_t)y * _width; }
+        const uint8_t* row (int y) const { return _pixels.data() + (size_t)y * _width; }
+
+        /// Valid until the image is reset or destroyed.
+        OccupancyGridView view () const;
+
+        OccupancyGridMetadata metadata;
+
+    private:
+        std::vector<uint8_t> _pixels;
+        int _width = 0;
+        int _height = 0;
+    };
+
+    /**
+     * Set the pixels of grid with any of mask's bits to 255 in output, the others to 0.
+     * Like BEOccupancyGrid's convertTo...Grid:outputGrid:, for OccupancyObstacle, OccupancyFloor or OccupancyCovered.
+     */
+    void convertOccupancyGrid (const OccupancyGridView& grid, uint8_t mask, OccupancyGridImage& output);
+
+    /**
+     * Parse the contents of occupancy_grid_metadata.json.
+     * Keys are looked up by the names BEOccupancyGrid's accessors use, camel or snake cased
+     * ("originX", "origin_x"), or an "origin" array; and "metersPerPixel" or "resolution".
+     * @return false with a reason in error if the origin or scale is missing.
+     */
+    bool parseOccupancyGridMetadata (const std::string& json, OccupancyGridMetadata& metadata, std::string* error = nullptr);
+
+    /// Read and parse an occupancy_grid_metadata.json file.
+    bool readOccupancyGridMetadata (const char* path, OccupancyGridMetadata& metadata, std::string* error = nullptr);
+
+} // BE
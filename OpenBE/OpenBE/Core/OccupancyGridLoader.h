@@ -0,0 +1,53 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Reads a scan's occupancy_grid.png and occupancy_grid_metadata.json without
+//  going through BEOccupancyGrid a pixel at a time.
+//
+//  The PNG is decoded once by ImageIO, and its pixels are handed out in place
+//  as an OccupancyGridView: a row pointer and strides into the decoded image,
+//  reading the first color channel if it has more than one. The origin and
+//  scale come from BEOccupancyGrid, which knows the scanner's format; they're
+//  also parsed by parseOccupancyGridMetadata, as Tools/NavigationBench reads
+//  them, and a disagreement is logged so the tools can be kept in step.
+//
+//  THREAD SAFE
+//
+
+#import <Foundation/Foundation.h>
+
+#include "OccupancyGrid.hpp"
+
+@interface OccupancyGridLoader : NSObject
+
+/// Documents/BridgeEngineScene/occupancy_grid.png, where the scanner saves it.
++ (NSString *) defaultGridPath;
+
+/// Documents/BridgeEngineScene/occupancy_grid_metadata.json
++ (NSString *) defaultMetadataPath;
+
+/**
+ * Decode the grid, read its metadata, and call block with a view of the pixels.
+ * The view points into the decoded image, and is only valid during the block.
+ * @return NO, with an error logged, if either file can't be read.
+ */
++ (BOOL) readGridAtPath:(NSString *)gridPath
+           metadataPath:(NSString *)metadataPath
+                  block:(void (^)(const BE::OccupancyGridView &grid))block;
+
+/**
+ * Read the grid and keep its obstacles, 255 on obstacles and 0 elsewhere,
+ * like BEOccupancyGrid convertToObstacleGrid:outputGrid:.
+ */
++ (BOOL) loadObstacleGridAtPath:(NSString *)gridPath
+                   metadataPath:(NSString *)metadataPath
+                           into:(BE::OccupancyGridImage &)obstacles;
+
+@end
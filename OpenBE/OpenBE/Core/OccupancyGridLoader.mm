@@ -0,0 +1,135 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "OccupancyGridLoader.h"
+
+#import <BridgeEngine/BEOccupancyGrid.h>
+#import <BridgeEngine/BEDebugging.h>
+#import <ImageIO/ImageIO.h>
+
+#include <cmath>
+#include <string>
+
+namespace {
+
+    /// Byte of the first color channel within a pixel.
+    size_t firstChannelOffset( CGImageRef image, size_t channels ) {
+        CGImageAlphaInfo alpha = CGImageGetAlphaInfo(image);
+        size_t offset = (alpha == kCGImageAlphaFirst
+                         || alpha == kCGImageAlphaPremultipliedFirst
+                         || alpha == kCGImageAlphaNoneSkipFirst) ? 1 : 0;
+
+        CGBitmapInfo byteOrder = CGImageGetBitmapInfo(image) & kCGBitmapByteOrderMask;
+        if( channels == 4 && byteOrder == kCGBitmapByteOrder32Little ) offset = 3 - offset;
+        if( channels == 2 && byteOrder == kCGBitmapByteOrder16Little ) offset = 1 - offset;
+        return offset;
+    }
+
+    /// Do the metadata parsers agree, to a tenth of a millimeter.
+    bool sameMetadata( const BE::OccupancyGridMetadata &a, const BE::OccupancyGridMetadata &b ) {
+        return fabsf(a.originX - b.originX) < 1e-4f
+            && fabsf(a.originY - b.originY) < 1e-4f
+            && fabsf(a.metersPerPixel - b.metersPerPixel) < 1e-7f;
+    }
+
+    BOOL readMetadata( NSString *gridPath, NSString *metadataPath, BE::OccupancyGridMetadata &metadata ) {
+        // BEOccupancyGrid knows the scanner's format for sure, so it places the grid on device.
+        BEOccupancyGrid *grid = [[BEOccupancyGrid alloc] init];
+        if( ![grid loadGridFromFilePath:gridPath metaDataPath:metadataPath] ) {
+            NSLog(@"OccupancyGridLoader: === Error === Can't read metadata %@", metadataPath);
+            return NO;
+        }
+
+        metadata.originX = grid.originX;
+        metadata.originY = grid.originY;
+        metadata.metersPerPixel = grid.metersPerPixel;
+
+        // The portable parser is what the Linux tools go by, so say when it reads a scan differently.
+        BE::OccupancyGridMetadata parsed;
+        std::string error;
+        if( !BE::readOccupancyGridMetadata(metadataPath.fileSystemRepresentation, parsed, &error) ) {
+            NSLog(@"OccupancyGridLoader: parseOccupancyGridMetadata can't read %@: %s", metadataPath, error.c_str());
+        } else if( !sameMetadata(parsed, metadata) ) {
+            NSLog(@"OccupancyGridLoader: parseOccupancyGridMetadata read origin (%f, %f) at %f m/pixel, BEOccupancyGrid (%f, %f) at %f m/pixel",
+                  parsed.originX, parsed.originY, parsed.metersPerPixel,
+                  metadata.originX, metadata.originY, metadata.metersPerPixel);
+        }
+        return YES;
+    }
+
+} // anonymous
+
+@implementation OccupancyGridLoader
+
++ (NSString *) sceneDirectory {
+    NSString *documentsDirectory = NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES).firstObject;
+    return [documentsDirectory stringByAppendingPathComponent:@"BridgeEngineScene"];
+}
+
++ (NSString *) defaultGridPath {
+    return [[self sceneDirectory] stringByAppendingPathComponent:@"occupancy_grid.png"];
+}
+
++ (NSString *) defaultMetadataPath {
+    return [[self sceneDirectory] stringByAppendingPathComponent:@"occupancy_grid_metadata.json"];
+}
+
++ (BOOL) readGridAtPath:(NSString *)gridPath
+           metadataPath:(NSString *)metadataPath
+                  block:(void (^)(const BE::OccupancyGridView &grid))block
+{
+    BE::OccupancyGridView view;
+    if( !readMetadata(gridPath, metadataPath, view.metadata) ) return NO;
+
+    CGImageSourceRef source = CGImageSourceCreateWithURL((__bridge CFURLRef)[NSURL fileURLWithPath:gridPath], NULL);
+    CGImageRef image = source ? CGImageSourceCreateImageAtIndex(source, 0, NULL) : NULL;
+    if( source ) CFRelease(source);
+    if( image == NULL ) {
+        NSLog(@"OccupancyGridLoader: === Error === Can't decode %@", gridPath);
+        return NO;
+    }
+
+    size_t bitsPerComponent = CGImageGetBitsPerComponent(image);
+    size_t channels = CGImageGetBitsPerPixel(image) / 8;
+    if( bitsPerComponent != 8 || channels == 0 ) {
+        NSLog(@"OccupancyGridLoader: === Error === %@ has %zu bit components, only 8 bit grids are read", gridPath, bitsPerComponent);
+        CGImageRelease(image);
+        return NO;
+    }
+
+    // The decoded pixels, read in place.
+    CFDataRef pixels = CGDataProviderCopyData(CGImageGetDataProvider(image));
+    if( pixels == NULL ) {
+        NSLog(@"OccupancyGridLoader: === Error === No pixels in %@", gridPath);
+        CGImageRelease(image);
+        return NO;
+    }
+
+    view.pixels = CFDataGetBytePtr(pixels) + firstChannelOffset(image, channels);
+    view.rowStride = CGImageGetBytesPerRow(image);
+    view.pixelStride = channels;
+    view.width = (int)CGImageGetWidth(image);
+    view.height = (int)CGImageGetHeight(image);
+
+    block(view);
+
+    CFRelease(pixels);
+    CGImageRelease(image);
+    return YES;
+}
+
++ (BOOL) loadObstacleGridAtPath:(NSString *)gridPath
+                   metadataPath:(NSString *)metadataPath
+                           into:(BE::OccupancyGridImage &)obstacles
+{
+    BE::OccupancyGridImage *output = &obstacles;
+    return [self readGridAtPath:gridPath metadataPath:metadataPath block:^(const BE::OccupancyGridView &grid) {
+        BE::convertOccupancyGrid(grid, BE::OccupancyObstacle, *output);
+    }];
+}
+
+@end
@@ -9,6 +9,10 @@
 #import <GLKit/GLKit.h>
 #import <BridgeEngine/BEOccupancyGrid.h>
 
+#ifdef __cplusplus
+#include "NavigationGrid.hpp"
+#endif
+
 @class PathFinding;
 
 @interface PathFindingOperation : NSOperation
@@ -24,9 +28,24 @@
 
 /**
  * Initializer accepts user provided occupancy map
+ * BEOccupancyGrid has no raw pixel access, so this reads it a pixel at a time, once.
  */
 - (instancetype) initWithGrid:(BEOccupancyGrid *) grid;
 
+#ifdef __cplusplus
+/**
+ * Build straight from an obstacle grid's pixels, where 255 is an obstacle.
+ * The view is only read during the call. See OccupancyGridLoader.
+ */
+- (instancetype) initWithGridView:(const BE::OccupancyGridView &)view;
+
+/**
+ * The dilated obstacle, topological and connected component maps planned on.
+ * Built once by the initializer, so they can be read from any thread.
+ */
+- (const BE::NavigationGrid &) navigationGrid;
+#endif
+
 /**
  * Check if the target location is occupied.
  */
@@ -17,35 +17,6 @@
 #include <map>
 #include <vector>
 
-namespace {
-
-    class matrix {
-    public:
-        std::vector< std::vector< unsigned char > > data;
-        int width;
-        int height;
-        
-        void resize( int w, int h ) {
-            data.resize(w);
-            for( int x=0; x<w; x++ ) {
-                data[x].resize(h);
-            }
-            width = w;
-            height = h;
-        }
-        
-        void copy( matrix &source ) {
-            resize( source.width, source.height );
-            for( int x=0; x<width; x++) {
-                for( int y=0; y<height; y++) {
-                    data[x][y] = source.data[x][y];
-                }
-            }
-        }
-    };
-    
-} // anonymous
-
 /**
  * Internal PathFindingOperation category.
  */
@@ -61,10 +32,7 @@ namespace {
 
 @interface PathFinding ()
 {
-    matrix topoMap;
-    matrix convMap;
-    float** scores;
-    matrix connectedComponentMap;
+    BE::NavigationGrid navigation;
     
     int robotRadiusInPixels;
     float pixelSizeInMeters;
@@ -118,160 +86,58 @@ struct DijkstraNode
     return [[UIImage alloc] initWithContentsOfFile:path];
 }
 
-struct setNode
-{
-    setNode* parent;
-    unsigned char label;
-};
-
-- (setNode*) find:(setNode*)x
-{
-    if(x->parent != x)
-    {
-        x->parent = [self find:x->parent];
-        x->label = x->parent->label;
-    }
-    return x->parent;
-}
-
-- (setNode*) unionOf:(setNode*)x andSet:(setNode*) y
-{
-    setNode* xRoot = [self find:x];
-    setNode* yRoot = [self find:y];
-    
-    if(xRoot->label < yRoot->label)
-    {
-        yRoot->parent = xRoot;
-        return xRoot;
-    } else{
-        xRoot->parent = yRoot;
-        return yRoot;
-    }
-}
-
 /**
  * Check pathing from starting point to goal point.
  */
 - (bool) canPathFromStartPointX:(int)sx startPointY:(int)sy goalPointX:(int)gx goalPointY:(int) gy
 {
     // Bail if requested point is out of bounds
-    if(sx < 0 || sx >= connectedComponentMap.width || sy < 0 || sy >= connectedComponentMap.height)
+    if(sx < 0 || sx >= navigation.width() || sy < 0 || sy >= navigation.height())
     {
         NSLog(@"Bad source point (%d, %d)", sx, sy);
         return false;
     }
     
-    if(gx < 0 || gx >= connectedComponentMap.width || gy < 0 || gy >= connectedComponentMap.height)
+    if(gx < 0 || gx >= navigation.width() || gy < 0 || gy >= navigation.height())
     {
         NSLog(@"Bad goal point (%d, %d)", gx, gy);
         return false;
     }
     
-    return connectedComponentMap.data[sx][sy] == connectedComponentMap.data[gx][gy] && connectedComponentMap.data[sx][sy] != 0;
+    return navigation.component(sx, sy) == navigation.component(gx, gy) && navigation.component(sx, sy) != 0;
 }
 
 - (instancetype) initWithGrid:(BEOccupancyGrid*) grid
 {
-    self = [super init];
-    if (self) {
-        robotRadiusInPixels = 5;
-        pixelSizeInMeters = 0.04;
-        worldCenterX = -2.89995;
-        worldCenterY= -2.90582;
-
-        worldCenterX = [grid originX];
-        worldCenterY = [grid originY];
-        pixelSizeInMeters = [grid metersPerPixel];
-        
-        //do initialization
-        matrix map;
-        map.resize([grid width], [grid height]);
-        
-        for (int x = 0; x < [grid width]; x++)
+    BE::OccupancyGridImage image;
+    image.reset([grid width], [grid height]);
+    image.metadata.originX = [grid originX];
+    image.metadata.originY = [grid originY];
+    image.metadata.metersPerPixel = [grid metersPerPixel];
+    
+    for (int y = 0; y < image.height(); y++)
+    {
+        uint8_t *row = image.row(y);
+        for (int x = 0; x < image.width(); x++)
         {
-            for (int y = 0; y < [grid height]; y++)
-            {
-                //TODO: Profile and make sure this is as fast as:
-                // rawData[(bytesPerRow * y) + x * bytesPerPixel];
-                map.data[x][y] = [grid getPixelAtXIndex:x yIndex:y];
-            }
+            row[x] = (uint8_t)[grid getPixelAtXIndex:x yIndex:y];
         }
-        
-        convMap.resize(map.width, map.height);
-        convMap.copy(map);
-
-        // Dialate the occupied regions by the radius
-        for (int y = 0; y < map.height; ++y)
-        for (int x = 0; x < map.width; ++x)
-        {
-            for (int dy = -robotRadiusInPixels; dy <= robotRadiusInPixels; dy++)
-            for (int dx = -robotRadiusInPixels; dx <= robotRadiusInPixels; dx++)
-            {
-                const int py = y + dy;
-                const int px = x + dx;
-
-                if(dy*dy + dx*dx > robotRadiusInPixels*robotRadiusInPixels)
-                    continue;
-
-                if(py < 0 || py >= map.height || px < 0 || px >= map.width) continue;
+    }
+    
+    return [self initWithGridView:image.view()];
+}
 
-                if (map.data[px][py] == 255)
-                    convMap.data[x][y] = 255;
-            }
-        }
-        
-        // ------------ Create 1/r^2 topological map ------------
-        
-        topoMap.resize(convMap.width, convMap.height);
-        topoMap.copy(convMap);
-        
-        int accumulateSize = robotRadiusInPixels*2;
-        
-        for(int y = 0; y < topoMap.height; y++)
-        {
-            for(int x = 0; x < topoMap.width; x++)
-            {
-                float accumulator = 0;
-                for(int dy = -1*accumulateSize; dy <= accumulateSize; dy++)
-                {
-                    for(int dx = -1*accumulateSize; dx <= accumulateSize; dx++)
-                    {
-                        int py = y + dy;
-                        int px = x + dx;
-                        
-                        if(dx == 0 && dy == 0) continue;
-                        
-                        if(py < 0 || py >= convMap.height || px < 0 || px >= convMap.width)
-                        {
-                            accumulator += 255.0f / (dx*dx + dy*dy);
-                            continue;
-                        }
-                        
-                        if(convMap.data[px][py] >= 254)
-                        {
-                            accumulator += ((float)convMap.data[px][py]) / (dx*dx + dy*dy);
-                        }
-                    }
-                }
-                
-                accumulator = accumulator / (accumulateSize/1.414);
-                accumulator += convMap.data[x][y];
-                if(accumulator > 254) accumulator = 255;
-                topoMap.data[x][y] = (unsigned char) accumulator;
-            }
-        }
+- (instancetype) initWithGridView:(const BE::OccupancyGridView &)view
+{
+    self = [super init];
+    if (self) {
+        robotRadiusInPixels = 5;
+        worldCenterX = view.metadata.originX;
+        worldCenterY = view.metadata.originY;
+        pixelSizeInMeters = view.metadata.metersPerPixel;
         
-        // Create a scores map.
-        scores = new float*[topoMap.height];
-        for(int y = 0; y < topoMap.height; y++)
-        {
-            scores[y] = new float[topoMap.width];
-            for(int x = 0; x < topoMap.width; x++)
-            {
-                //oc_dbg("%i %i", y, x);
-                scores[y][x] = -1;
-            }
-        }
+        // Dilated obstacles, 1/r^2 topological map and connected components.
+        navigation.build(view, robotRadiusInPixels);
         
         // Creat a queue for background processing.
         pathQueue = [[NSOperationQueue alloc] init];
@@ -280,134 +146,24 @@ struct setNode
         pathQueue.name = @"PathFinding Queue";
     }
     
-    // ------------ Connected component labelling -----------
-    
-    connectedComponentMap.resize(topoMap.width, topoMap.height);
-    
-    // Two-pass connected component algorithm.
-    // Areas are considered "connected" if they are not separated by an impassible obstacle.
-    
-    struct point
-    {
-        int x,y;
-        unsigned char label;
-    };
-    
-    setNode*** disjointSet = new setNode**[connectedComponentMap.height];
-    for(int i = 0; i < connectedComponentMap.height; i++)
-    {
-        disjointSet[i] = new setNode*[connectedComponentMap.width];
-        for(int j = 0; j < connectedComponentMap.width; j++)
-        {
-            disjointSet[i][j] = nullptr;
-        }
-    }
-    
-    std::vector<setNode*> linked;  // Indexed by label, this should hold the root node of each linked set.
-    linked.push_back(nullptr); // Because the first valid label is 1, we need to offset this a little.
-    unsigned char nextLabel = 1;
-    
-    //Pass 1: Generate labels
-    for(int y = 0; y < convMap.height; y++)
-    {
-        for(int x = 0; x < convMap.width; x++)
-        {
-//            NSLog(@"Labeling at: (%d, %d)\n", x, y);
-            if (convMap.data[x][y] == 255)
-                continue;
-
-            //find neighbors that are not obstacles
-            std::vector<point> neighbors;
-            for(int dy=-1; dy <= 0; dy++)
-            {
-                for(int dx=-1; dx <=1; dx++)
-                {
-                    if(dy >= 0 && dx >= 0) continue; // only concern yourself with points that could have been previously labelled
-                                                     // This looks NW, N, NE, W of the current point
-                    
-                    int px = x+dx;
-                    int py = y+dy;
-                    
-                    if(px < 0 || px >= convMap.width || py < 0 || py >= convMap.height) continue;
-                    
-                    if(convMap.data[px][py] <= 254)
-                    {
-                        point p;
-                        p.x = px;
-                        p.y = py;
-                        p.label = disjointSet[py][px]->label;
-                        
-                        neighbors.push_back(p);
-                    }
-                }
-            }
-            
-            if(neighbors.size() == 0)
-            {
-                // If this point has no neighbors it's deserving of a new label.
-                // This label might eventually be found to be equivalent to an older label, but we'll get to that.
-
-                disjointSet[y][x] = new setNode;
-                disjointSet[y][x]->label = nextLabel;
-                disjointSet[y][x]->parent = disjointSet[y][x];
-                
-                linked.push_back(disjointSet[y][x]);
-                nextLabel++;
-            } else{
-                // If there are a few neighbors, we should include them all in the smallest label's set.
-                int smallestLabel = INT_MAX;
-                for(int i = 0; i < neighbors.size(); i++)
-                {
-                    if(neighbors[i].label < smallestLabel)
-                        smallestLabel = neighbors[i].label;
-                }
-                
-//                    NSLog(@"\t Has %lu neighbors - smallest label: %d\n", neighbors.size(), smallestLabel);
-                
-                // Add the current point to the smallest label set.
-                disjointSet[y][x] = linked[smallestLabel];
-                
-                for(int i=0; i < neighbors.size(); i++)
-                {
-                    linked[smallestLabel] = [self unionOf:linked[smallestLabel] andSet:disjointSet[neighbors[i].y][neighbors[i].x]];
-                }
-            }
-        }
-    }
-    
-    // Pass 2 - find and fix equivalent labels
-    for(int y = 0; y < topoMap.height; y++)
-    {
-        for(int x = 0; x < topoMap.width; x++)
-        {
-            if(disjointSet[y][x] == nullptr)
-                connectedComponentMap.data[x][y] = 0;
-            else
-                connectedComponentMap.data[x][y] = [self find:disjointSet[y][x]]->label;
-        }
-    }
-    
-    // Clean up
-    for(int i = 0; i < connectedComponentMap.height; i++)
-    {
-        delete[] disjointSet[i];
-    }
-    delete[] disjointSet;
-    
     return self;
 }
 
+- (const BE::NavigationGrid &) navigationGrid {
+    return navigation;
+}
+
 - (BOOL) occupied:(GLKVector3)target {
     int posx, posy;
     [self worldCoordToPixCoordWithWx:target.x Wy:target.z Pxp:&posx Pyp:&posy];
     
-    if( posx < 0 || posx >= convMap.width
-        || posy < 0 || posy >= convMap.height )
+    if( posx < 0 || posx >= navigation.width()
+        || posy < 0 || posy >= navigation.height() )
     {
         // Outer world is always occupied.
          return YES;
     } else {
-        return convMap.data[posx][posy] >= 254;
+        return navigation.dilated(posx, posy) >= 254;
     }
 }
 
@@ -449,11 +205,11 @@ struct setNode
 - (NSMutableArray<NSValue*> *) occupiedPoints {
     NSMutableArray<NSValue*> *points = [NSMutableArray arrayWithCapacity:1024];
    
-    for(int y = 0; y < convMap.height; y++)
+    for(int y = 0; y < navigation.height(); y++)
     {
-        for(int x = 0; x < convMap.width; x++)
+        for(int x = 0; x < navigation.width(); x++)
         {
-            if( convMap.data[x][y] >= 254 ) {
+            if( navigation.dilated(x, y) >= 254 ) {
                 float wx, wy;
                 [self pixCoordToWorldXYWithPx:x Py:y Wxp:&wx Wyp:&wy];
                 GLKVector3 p = GLKVector3Make( wx, 0.f,  wy);
@@ -471,13 +227,13 @@ struct setNode
  *     Coordinates x&z in world coordinates, and y being the comonent value.
  */
 - (NSMutableArray<NSValue*> *) connectedComponentPoints {
-    NSMutableArray<NSValue*> *points = [NSMutableArray arrayWithCapacity:connectedComponentMap.width * connectedComponentMap.height];
+    NSMutableArray<NSValue*> *points = [NSMutableArray arrayWithCapacity:navigation.width() * navigation.height()];
    
-    for(int y = 0; y < connectedComponentMap.height; y++)
+    for(int y = 0; y < navigation.height(); y++)
     {
-        for(int x = 0; x < connectedComponentMap.width; x++)
+        for(int x = 0; x < navigation.width(); x++)
         {
-            float componentValue = connectedComponentMap.data[x][y];
+            float componentValue = navigation.component(x, y);
             
             if (componentValue == 0) {
                 continue;
@@ -500,11 +256,11 @@ struct setNode
     // Build histogram of component counts.
     int componentCounts[256];
     bzero(componentCounts, sizeof(componentCounts));
-    for(int y = 0; y < connectedComponentMap.height; y++)
+    for(int y = 0; y < navigation.height(); y++)
     {
-        for(int x = 0; x < connectedComponentMap.width; x++)
+        for(int x = 0; x < navigation.width(); x++)
         {
-            unsigned char componentValue = connectedComponentMap.data[x][y];
+            unsigned char componentValue = navigation.component(x, y);
             componentCounts[componentValue]++;
         }
     }
@@ -537,11 +293,11 @@ struct setNode
     float minDistSq = FLT_MAX;
     
     int bestPointX=0, bestPointY=0;
-    for(int y = 0; y < convMap.height; y++)
+    for(int y = 0; y < navigation.height(); y++)
     {
-        for(int x = 0; x < convMap.width; x++)
+        for(int x = 0; x < navigation.width(); x++)
         {
-            unsigned char component = connectedComponentMap.data[x][y];
+            unsigned char component = navigation.component(x, y);
             if( component == targetComponent )
             {
                 float distSq = (goalPointX - x)*(goalPointX - x) + (goalPointY - y)*(goalPointY - y);
@@ -588,16 +344,16 @@ struct setNode
     [self worldCoordToPixCoordWithWx:sourcePoint.x Wy:sourcePoint.z Pxp:&sourcePointX Pyp:&sourcePointY];
 
     be_NSDbg( @"Getting closest point to map goal: (%d,%d)  from: (%d,%d)", goalPointX, goalPointY, sourcePointX, sourcePointY);
-    if( connectedComponentMap.data[sourcePointX][sourcePointY] == 0 ) {
+    if( navigation.component(sourcePointX, sourcePointY) == 0 ) {
         NSLog(@"Bad Source Point?");
     }
     
     float minDistSq = FLT_MAX;
     
     int bestPointX=0, bestPointY=0;
-    for(int y = 0; y < convMap.height; y++)
+    for(int y = 0; y < navigation.height(); y++)
     {
-        for(int x = 0; x < convMap.width; x++)
+        for(int x = 0; x < navigation.width(); x++)
         {
             if([self canPathFromStartPointX:sourcePointX startPointY:sourcePointY goalPointX:x goalPointY:y])
             {
@@ -613,7 +369,7 @@ struct setNode
     }
     
     if( minDistSq == FLT_MAX ) {
-        be_NSDbg(@"No pathing option from sourcePoint. id: %d", (int)connectedComponentMap.data[sourcePointX][sourcePointY]);
+        be_NSDbg(@"No pathing option from sourcePoint. id: %d", (int)navigation.component(sourcePointX, sourcePointY));
         return NO;
     } else {
         be_NSDbg(@"best: (%d,%d)", bestPointX,bestPointY);
@@ -648,8 +404,8 @@ struct setNode
 
     be_NSDbg(@"Start of run path planning!");
     
-    if(startPosX < 0 || startPosX >= topoMap.width ||
-       startPosY < 0 || startPosY >= topoMap.height)
+    if(startPosX < 0 || startPosX >= navigation.width() ||
+       startPosY < 0 || startPosY >= navigation.height())
     {
         NSLog(@"Something strange happened to startPosX: %d or startPosY: %d\n",
               startPosX,
@@ -693,8 +449,8 @@ struct setNode
     be_NSDbg(@"starting A*");
 
     using GraphLocation = std::pair<int16_t, int16_t>;
-    const int w = topoMap.width;
-    const int h = topoMap.height;
+    const int w = navigation.width();
+    const int h = navigation.height();
 
     // Normal, 2D -> linear array access
     auto hashFcn = [w](const GraphLocation& g) -> size_t
@@ -742,7 +498,7 @@ struct setNode
             std::tie(x, y) = ni;
             GraphLocation neighborCandidate(currentLocation.first + x, currentLocation.second + y);
             if (inRange(neighborCandidate)
-                && (convMap.data[neighborCandidate.first][neighborCandidate.second] < 254))
+                && (navigation.dilated(neighborCandidate.first, neighborCandidate.second) < 254))
                 neighborCandidates.push_back(neighborCandidate);
         }
         return neighborCandidates;
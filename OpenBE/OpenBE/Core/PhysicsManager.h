@@ -0,0 +1,86 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Keeps the physics world down to the bodies that matter this frame.
+//
+//  Managed bodies are in one of three states:
+//   - Awake: simulated as configured.
+//   - Sleeping: resting outside the view frustum. Held still with gravity off,
+//     until they come into view or something knocks them.
+//   - Parked: hidden or back in a pool. Nothing collides with them and they
+//     don't move, but they stay in the world, since SceneKit misbehaves when
+//     bodies are added to a running one.
+//
+//  The scan's coarseMesh is a single concave body covering the whole room.
+//  Managed bodies that collide with it are moved onto convex proxies instead,
+//  one per cell of scan surface, and only the cells near awake bodies are
+//  enabled.
+//
+//  Updated by the SceneManager after the SpatialIndex.
+//  RENDER THREAD ONLY
+//
+
+#import <SceneKit/SceneKit.h>
+
+// Category of the scan proxy shapes, and of the managed bodies colliding with them.
+#define PHYSICS_PROXY_CATEGORY (1 << 10)
+#define PHYSICS_MANAGED_CATEGORY (1 << 11)
+
+typedef struct {
+    NSUInteger managed;             // Bodies registered.
+    NSUInteger active;              // Awake and simulated.
+    NSUInteger sleeping;            // Resting out of view.
+    NSUInteger parked;              // Hidden or pooled.
+    NSUInteger proxies;             // Scan proxy shapes built.
+    NSUInteger proxiesEnabled;      // Near awake bodies this frame.
+    double stepMs;                  // Last physics step, 0 until a renderer is observed.
+    double averageStepMs;
+    double updateMs;                // This manager's own update.
+} PhysicsStats;
+
+@interface PhysicsManager : NSObject
+
+/// Singleton, updated by the SceneManager.
++ (PhysicsManager *) main;
+
+/// Put resting bodies outside the view to sleep. Defaults to YES.
+@property (nonatomic) BOOL sleepOutsideView;
+
+/**
+ * Build convex proxies for the scan's coarseMesh nodes, after their bodies are set up.
+ * Proxies are added as children of each mesh, without geometry, all disabled.
+ * Bodies only collide with them instead of the scan if every mesh got proxies.
+ */
+- (void) buildScanProxiesForNodes:(NSArray<SCNNode *> *)scanMeshNodes;
+
+/// Time physics steps through the renderer's delegate callbacks, forwarding them to the current delegate.
+- (void) observeRenderer:(id<SCNSceneRenderer>)renderer;
+
+#pragma mark - Bodies
+
+/**
+ * Manage the body of node, as it's configured now.
+ * Changes to its masks or gravity made after this are overwritten.
+ */
+- (void) manageNode:(SCNNode *)node;
+- (void) unmanageNode:(SCNNode *)node;
+
+/// Take a managed body out of simulation now, rather than at the next update. Hidden bodies are parked on update anyway.
+- (void) parkNode:(SCNNode *)node;
+
+/// Put a managed body back in simulation now, e.g. right after placing it. Visible bodies are woken on update anyway.
+- (void) wakeNode:(SCNNode *)node;
+
+/// Park hidden bodies, sleep or wake visible ones, and enable the proxies they need.
+- (void) update;
+
+- (PhysicsStats) stats;
+
+@end
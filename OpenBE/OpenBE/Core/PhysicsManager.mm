@@ -0,0 +1,576 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "PhysicsManager.h"
+#import "Camera.h"
+#import "SpatialIndex.h"
+
+#import <BridgeEngine/BridgeEngine.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+// Edge of a scan proxy cell. Smaller cells follow inside corners closer, at more bodies.
+#define PHYSICS_PROXY_CELL_SIZE 0.3f
+
+// Proxy vertices are snapped to this grid and merged, simplifying the hull.
+#define PHYSICS_PROXY_VERTEX_GRID 0.02f
+
+// Proxies within this distance of an awake body are enabled.
+#define PHYSICS_PROXY_ENABLE_RADIUS 0.5f
+
+// Seconds of travel added to the enable radius, so fast bodies don't outrun their proxies.
+#define PHYSICS_PROXY_LOOKAHEAD 0.1f
+
+// A sleeping body moving faster than this was knocked, and wakes up.
+#define PHYSICS_WAKE_SPEED 0.05f
+
+#define PHYSICS_PROXY_NODE_NAME @"coarseMeshProxy"
+
+namespace {
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    enum class BodyState : uint8_t {
+        Awake,
+        Sleeping,
+        Parked,
+    };
+
+    struct ManagedBody {
+        __strong SCNNode *node;
+        SpatialHandle handle;
+
+        // As configured when managed, proxies applied.
+        NSUInteger categoryBitMask;
+        NSUInteger collisionBitMask;
+        NSUInteger contactTestBitMask;
+        BOOL affectedByGravity;
+
+        BodyState state;
+    };
+
+    struct Proxy {
+        __strong SCNNode *node;
+        bool enabled;
+        uint32_t neededFrame;
+    };
+
+    /// Cell key, 21 bits per axis.
+    uint64_t cellKey( int x, int y, int z ) {
+        const uint64_t mask = (1u << 21) - 1;
+        return (((uint64_t)x & mask) << 42) | (((uint64_t)y & mask) << 21) | ((uint64_t)z & mask);
+    }
+
+    int cellCoordinate( float value, float cellSize ) {
+        return (int)floorf(value / cellSize);
+    }
+
+    /**
+     * Vertex positions and triangle indices of a geometry's triangle elements.
+     * @return false if the geometry has no float vertex positions.
+     */
+    bool readTriangles( SCNGeometry *geometry, std::vector<GLKVector3> &vertices, std::vector<uint32_t> &indices ) {
+        SCNGeometrySource *source = [geometry geometrySourcesForSemantic:SCNGeometrySourceSemanticVertex].firstObject;
+        if( source == nil || !source.usesFloatComponents || source.bytesPerComponent != sizeof(float) || source.componentsPerVector < 3 ) {
+            return false;
+        }
+
+        const uint8_t *bytes = (const uint8_t *)source.data.bytes;
+        vertices.resize(source.vectorCount);
+        for( NSInteger v=0; v<source.vectorCount; v++ ) {
+            const float *p = (const float *)(bytes + source.dataOffset + v * source.dataStride);
+            vertices[v] = GLKVector3Make(p[0], p[1], p[2]);
+        }
+
+        for( SCNGeometryElement *element in geometry.geometryElements ) {
+            if( element.primitiveType != SCNGeometryPrimitiveTypeTriangles ) continue;
+
+            const uint8_t *data = (const uint8_t *)element.data.bytes;
+            const NSInteger indexCount = element.primitiveCount * 3;
+            for( NSInteger i=0; i<indexCount; i++ ) {
+                uint32_t index;
+                switch( element.bytesPerIndex ) {
+                    case 1: index = data[i]; break;
+                    case 2: index = ((const uint16_t *)data)[i]; break;
+                    default: index = ((const uint32_t *)data)[i]; break;
+                }
+                indices.push_back(index < vertices.size() ? index : 0);
+            }
+        }
+        return true;
+    }
+
+} // anonymous
+
+@interface PhysicsManager ()
+- (void) stepWillStart;
+- (void) stepDidEnd;
+@end
+
+/**
+ * Stands in as the renderer's delegate, to time the physics step between
+ * didApplyAnimations and didSimulatePhysics. Everything is forwarded to the
+ * delegate it replaced.
+ */
+@interface PhysicsStepTimer : NSProxy <SCNSceneRendererDelegate>
+- (instancetype) initWithTarget:(id<SCNSceneRendererDelegate>)target manager:(PhysicsManager *)manager;
+@end
+
+@implementation PhysicsStepTimer
+{
+    __weak id<SCNSceneRendererDelegate> _target;
+    __weak PhysicsManager *_manager;
+}
+
+- (instancetype) initWithTarget:(id<SCNSceneRendererDelegate>)target manager:(PhysicsManager *)manager {
+    _target = target;
+    _manager = manager;
+    return self;
+}
+
+- (BOOL) respondsToSelector:(SEL)selector {
+    if( selector == @selector(renderer:didApplyAnimationsAtTime:) || selector == @selector(renderer:didSimulatePhysicsAtTime:) ) {
+        return YES;
+    }
+    return [_target respondsToSelector:selector];
+}
+
+- (NSMethodSignature *) methodSignatureForSelector:(SEL)selector {
+    NSMethodSignature *signature = [(NSObject *)_target methodSignatureForSelector:selector];
+    // Target gone, forwardInvocation: drops the call.
+    return signature ?: [NSObject instanceMethodSignatureForSelector:@selector(init)];
+}
+
+- (void) forwardInvocation:(NSInvocation *)invocation {
+    id target = _target;
+    if( [target respondsToSelector:invocation.selector] ) {
+        [invocation invokeWithTarget:target];
+    }
+}
+
+- (void) renderer:(id<SCNSceneRenderer>)renderer didApplyAnimationsAtTime:(NSTimeInterval)time {
+    id<SCNSceneRendererDelegate> target = _target;
+    if( [target respondsToSelector:_cmd] ) {
+        [target renderer:renderer didApplyAnimationsAtTime:time];
+    }
+    [_manager stepWillStart];
+}
+
+- (void) renderer:(id<SCNSceneRenderer>)renderer didSimulatePhysicsAtTime:(NSTimeInterval)time {
+    [_manager stepDidEnd];
+    id<SCNSceneRendererDelegate> target = _target;
+    if( [target respondsToSelector:_cmd] ) {
+        [target renderer:renderer didSimulatePhysicsAtTime:time];
+    }
+}
+
+@end
+
+@implementation PhysicsManager
+{
+    std::vector<ManagedBody> _bodies;
+    std::unordered_map<const void *, size_t> _bodyIndex;    // Node to its entry in _bodies.
+
+    std::vector<Proxy> _proxies;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> _proxyCells;    // World cell to the proxies in it.
+    BOOL _proxiesCoverScan;     // Every scan mesh got its proxies, so they can stand in for it.
+    uint32_t _frame;
+
+    SpatialStandingQuery _frustumQuery;
+    BOOL _hasFrustumQuery;
+
+    PhysicsStepTimer *_stepTimer;
+    uint64_t _stepStart;
+    PhysicsStats _stats;
+}
+
++ (PhysicsManager *) main {
+    static PhysicsManager *mainPhysicsManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainPhysicsManager = [[PhysicsManager alloc] init];
+    });
+
+    return mainPhysicsManager;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _sleepOutsideView = YES;
+        _stats = PhysicsStats();
+    }
+    return self;
+}
+
+#pragma mark - Scan Proxies
+
+- (void) buildScanProxiesForNodes:(NSArray<SCNNode *> *)scanMeshNodes {
+    uint64_t start = mach_absolute_time();
+    NSUInteger triangleCount = 0;
+    BOOL covered = YES;
+
+    for( SCNNode *mesh in scanMeshNodes ) {
+        SCNPhysicsBody *meshBody = mesh.physicsBody;
+
+        std::vector<GLKVector3> vertices;
+        std::vector<uint32_t> indices;
+        if( mesh.geometry == nil || !readTriangles(mesh.geometry, vertices, indices) || indices.empty() ) {
+            NSLog(@"PhysicsManager: === Error === Can't read the triangles of scan mesh %@, it keeps its full collision shape", mesh.name);
+            covered = NO;
+            continue;
+        }
+        size_t firstProxy = _proxies.size();
+        triangleCount += indices.size() / 3;
+
+        // Bin triangles by the world cell their centroid falls in.
+        GLKMatrix4 toWorld = SCNMatrix4ToGLKMatrix4(mesh.worldTransform);
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cellTriangles;
+        for( size_t t=0; t+2<indices.size(); t+=3 ) {
+            GLKVector3 centroid = GLKVector3DivideScalar(GLKVector3Add(GLKVector3Add(vertices[indices[t]], vertices[indices[t+1]]), vertices[indices[t+2]]), 3.f);
+            GLKVector3 world = GLKMatrix4MultiplyVector3WithTranslation(toWorld, centroid);
+            uint64_t key = cellKey(cellCoordinate(world.x, PHYSICS_PROXY_CELL_SIZE),
+                                   cellCoordinate(world.y, PHYSICS_PROXY_CELL_SIZE),
+                                   cellCoordinate(world.z, PHYSICS_PROXY_CELL_SIZE));
+            cellTriangles[key].push_back((uint32_t)t);
+        }
+
+        // Shapes aren't scaled with their node.
+        GLKVector3 scale = GLKVector3Make(GLKVector3Length(GLKVector3Make(toWorld.m00, toWorld.m01, toWorld.m02)),
+                                          GLKVector3Length(GLKVector3Make(toWorld.m10, toWorld.m11, toWorld.m12)),
+                                          GLKVector3Length(GLKVector3Make(toWorld.m20, toWorld.m21, toWorld.m22)));
+        NSDictionary *shapeOptions = @{ SCNPhysicsShapeTypeKey: SCNPhysicsShapeTypeConvexHull,
+                                        SCNPhysicsShapeScaleKey: [NSValue valueWithSCNVector3:SCNVector3FromGLKVector3(scale)] };
+
+        // One convex hull per cell, over the cell's triangles with their vertices snapped and merged.
+        std::vector<SCNVector3> cellVertices;
+        std::vector<int32_t> cellIndices;
+        std::unordered_map<uint64_t, int32_t> snapped;
+        for( auto &cell : cellTriangles ) {
+            cellVertices.clear();
+            cellIndices.clear();
+            snapped.clear();
+
+            for( uint32_t t : cell.second ) {
+                int32_t corners[3];
+                for( int c=0; c<3; c++ ) {
+                    GLKVector3 v = vertices[indices[t + c]];
+                    uint64_t key = cellKey(cellCoordinate(v.x, PHYSICS_PROXY_VERTEX_GRID),
+                                           cellCoordinate(v.y, PHYSICS_PROXY_VERTEX_GRID),
+                                           cellCoordinate(v.z, PHYSICS_PROXY_VERTEX_GRID));
+                    auto found = snapped.find(key);
+                    if( found == snapped.end() ) {
+                        found = snapped.emplace(key, (int32_t)cellVertices.size()).first;
+                        cellVertices.push_back(SCNVector3FromGLKVector3(v));
+                    }
+                    corners[c] = found->second;
+                }
+
+                // Triangles smaller than the grid collapse.
+                if( corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2] ) continue;
+                cellIndices.insert(cellIndices.end(), corners, corners + 3);
+            }
+            if( cellIndices.empty() ) continue;
+
+            SCNGeometrySource *source = [SCNGeometrySource geometrySourceWithVertices:cellVertices.data() count:cellVertices.size()];
+            SCNGeometryElement *element = [SCNGeometryElement geometryElementWithData:[NSData dataWithBytes:cellIndices.data() length:cellIndices.size() * sizeof(int32_t)]
+                                                                        primitiveType:SCNGeometryPrimitiveTypeTriangles
+                                                                       primitiveCount:cellIndices.size() / 3
+                                                                        bytesPerIndex:sizeof(int32_t)];
+            SCNGeometry *hullGeometry = [SCNGeometry geometryWithSources:@[source] elements:@[element]];
+
+            // No geometry on the node, proxies are never drawn.
+            SCNNode *proxyNode = [SCNNode node];
+            proxyNode.name = PHYSICS_PROXY_NODE_NAME;
+            SCNPhysicsBody *body = [SCNPhysicsBody bodyWithType:SCNPhysicsBodyTypeStatic
+                                                          shape:[SCNPhysicsShape shapeWithGeometry:hullGeometry options:shapeOptions]];
+            body.friction = meshBody.friction;
+            body.rollingFriction = meshBody.rollingFriction;
+            body.restitution = meshBody.restitution;
+            body.categoryBitMask = 0;   // Disabled until a body comes near.
+            body.collisionBitMask = PHYSICS_MANAGED_CATEGORY;
+            body.contactTestBitMask = 0;
+            proxyNode.physicsBody = body;
+            [mesh addChildNode:proxyNode];
+
+            _proxyCells[cell.first].push_back((uint32_t)_proxies.size());
+            _proxies.push_back({ proxyNode, false, 0 });
+        }
+        if( _proxies.size() == firstProxy ) covered = NO;
+    }
+
+    // Bodies only trade the scan for its proxies when nothing of the scan is left out.
+    _proxiesCoverScan = covered && !_proxies.empty();
+    if( !covered && !_proxies.empty() ) {
+        NSLog(@"PhysicsManager: Scan proxies don't cover every scan mesh, bodies keep colliding with the full scan");
+    }
+
+    _stats.proxies = _proxies.size();
+    NSLog(@"PhysicsManager: %lu scan triangles in %lu convex proxies, built in %0.2f ms",
+          (unsigned long)triangleCount, (unsigned long)_proxies.size(), machTicksToMs(mach_absolute_time() - start));
+}
+
+- (void) enableProxiesNear:(const std::vector<std::pair<GLKVector3, float>> &)spheres {
+    _frame++;
+
+    for( const auto &sphere : spheres ) {
+        const GLKVector3 &center = sphere.first;
+        const float radius = sphere.second;
+        int minX = cellCoordinate(center.x - radius, PHYSICS_PROXY_CELL_SIZE), maxX = cellCoordinate(center.x + radius, PHYSICS_PROXY_CELL_SIZE);
+        int minY = cellCoordinate(center.y - radius, PHYSICS_PROXY_CELL_SIZE), maxY = cellCoordinate(center.y + radius, PHYSICS_PROXY_CELL_SIZE);
+        int minZ = cellCoordinate(center.z - radius, PHYSICS_PROXY_CELL_SIZE), maxZ = cellCoordinate(center.z + radius, PHYSICS_PROXY_CELL_SIZE);
+
+        for( int x=minX; x<=maxX; x++ ) {
+            for( int y=minY; y<=maxY; y++ ) {
+                for( int z=minZ; z<=maxZ; z++ ) {
+                    auto cell = _proxyCells.find(cellKey(x, y, z));
+                    if( cell == _proxyCells.end() ) continue;
+                    for( uint32_t p : cell->second ) {
+                        _proxies[p].neededFrame = _frame;
+                    }
+                }
+            }
+        }
+    }
+
+    // Only touch the bodies that change.
+    NSUInteger enabled = 0;
+    for( Proxy &proxy : _proxies ) {
+        bool needed = proxy.neededFrame == _frame;
+        if( needed != proxy.enabled ) {
+            proxy.enabled = needed;
+            proxy.node.physicsBody.categoryBitMask = needed ? PHYSICS_PROXY_CATEGORY : 0;
+        }
+        if( needed ) enabled++;
+    }
+    _stats.proxiesEnabled = enabled;
+}
+
+#pragma mark - Step Timing
+
+- (void) observeRenderer:(id<SCNSceneRenderer>)renderer {
+    if( renderer == nil || (_stepTimer && renderer.delegate == (id)_stepTimer) ) return;
+
+    _stepTimer = [[PhysicsStepTimer alloc] initWithTarget:renderer.delegate manager:self];
+    renderer.delegate = _stepTimer;
+}
+
+- (void) stepWillStart {
+    _stepStart = mach_absolute_time();
+}
+
+- (void) stepDidEnd {
+    if( _stepStart == 0 ) return;
+
+    _stats.stepMs = machTicksToMs(mach_absolute_time() - _stepStart);
+    _stats.averageStepMs = _stats.averageStepMs == 0 ? _stats.stepMs : _stats.averageStepMs + (_stats.stepMs - _stats.averageStepMs) * 0.1;
+    _stepStart = 0;
+}
+
+#pragma mark - Bodies
+
+- (void) manageNode:(SCNNode *)node {
+    SCNPhysicsBody *body = node.physicsBody;
+    if( body == nil || body.type != SCNPhysicsBodyTypeDynamic ) return;
+    if( _bodyIndex.count((__bridge const void *)node) ) return;
+
+    ManagedBody managed = {};
+    managed.node = node;
+
+    // Frustum tests go through the spatial index.
+    SpatialIndex *spatialIndex = [SpatialIndex main];
+    managed.handle = [spatialIndex handleForNode:node];
+    if( managed.handle == SPATIAL_HANDLE_INVALID ) {
+        SCNVector3 center;
+        CGFloat radius = 0;
+        [node getBoundingSphereCenter:&center radius:&radius];
+        managed.handle = [spatialIndex addNode:node radius:(float)radius];
+    }
+
+    // Bodies that collide with the scan collide with its proxies instead.
+    managed.categoryBitMask = body.categoryBitMask;
+    managed.collisionBitMask = body.collisionBitMask;
+    managed.contactTestBitMask = body.contactTestBitMask;
+    if( _proxiesCoverScan && (managed.collisionBitMask & BECollisionCategoryRealWorld) ) {
+        managed.categoryBitMask |= PHYSICS_MANAGED_CATEGORY;
+        managed.collisionBitMask = (managed.collisionBitMask & ~(NSUInteger)BECollisionCategoryRealWorld) | PHYSICS_PROXY_CATEGORY;
+    }
+    managed.affectedByGravity = body.affectedByGravity;
+    managed.state = BodyState::Awake;
+
+    body.categoryBitMask = managed.categoryBitMask;
+    body.collisionBitMask = managed.collisionBitMask;
+
+    _bodyIndex[(__bridge const void *)node] = _bodies.size();
+    _bodies.push_back(managed);
+
+    if( node.hidden ) [self park:_bodies.back()];
+}
+
+- (void) unmanageNode:(SCNNode *)node {
+    auto found = _bodyIndex.find((__bridge const void *)node);
+    if( found == _bodyIndex.end() ) return;
+
+    // Back to simulated, then swap-remove.
+    size_t index = found->second;
+    [self wake:_bodies[index]];
+    _bodyIndex.erase(found);
+    if( index != _bodies.size() - 1 ) {
+        _bodies[index] = _bodies.back();
+        _bodyIndex[(__bridge const void *)_bodies[index].node] = index;
+    }
+    _bodies.pop_back();
+}
+
+- (void) parkNode:(SCNNode *)node {
+    auto found = _bodyIndex.find((__bridge const void *)node);
+    if( found != _bodyIndex.end() ) [self park:_bodies[found->second]];
+}
+
+- (void) wakeNode:(SCNNode *)node {
+    auto found = _bodyIndex.find((__bridge const void *)node);
+    if( found != _bodyIndex.end() ) [self wake:_bodies[found->second]];
+}
+
+- (void) park:(ManagedBody &)managed {
+    if( managed.state == BodyState::Parked ) return;
+
+    SCNPhysicsBody *body = managed.node.physicsBody;
+    body.velocity = SCNVector3Zero;
+    body.angularVelocity = SCNVector4Zero;
+    [body clearAllForces];
+    body.affectedByGravity = NO;
+    body.categoryBitMask = 0;
+    body.collisionBitMask = 0;
+    body.contactTestBitMask = 0;
+    managed.state = BodyState::Parked;
+}
+
+- (void) sleep:(ManagedBody &)managed {
+    // Still collidable, so it can be knocked awake.
+    SCNPhysicsBody *body = managed.node.physicsBody;
+    body.velocity = SCNVector3Zero;
+    body.angularVelocity = SCNVector4Zero;
+    [body clearAllForces];
+    body.affectedByGravity = NO;
+    managed.state = BodyState::Sleeping;
+}
+
+- (void) wake:(ManagedBody &)managed {
+    if( managed.state == BodyState::Awake ) return;
+
+    SCNPhysicsBody *body = managed.node.physicsBody;
+    if( managed.state == BodyState::Parked ) {
+        body.categoryBitMask = managed.categoryBitMask;
+        body.collisionBitMask = managed.collisionBitMask;
+        body.contactTestBitMask = managed.contactTestBitMask;
+    }
+    body.affectedByGravity = managed.affectedByGravity;
+    managed.state = BodyState::Awake;
+}
+
+#pragma mark - Update
+
+- (void) updateFrustumQuery {
+    Camera *camera = [Camera main];
+    if( camera.camera == nil || camera.node == nil ) return;
+
+    GLKMatrix4 view = GLKMatrix4Invert(SCNMatrix4ToGLKMatrix4(camera.node.worldTransform), NULL);
+    GLKMatrix4 viewProjection = GLKMatrix4Multiply(SCNMatrix4ToGLKMatrix4(camera.camera.projectionTransform), view);
+
+    // Evaluated by the spatial index on its next update.
+    SpatialIndex *spatialIndex = [SpatialIndex main];
+    if( _hasFrustumQuery ) {
+        [spatialIndex setStandingQuery:_frustumQuery query:SpatialQueryFrustum(viewProjection)];
+    } else {
+        _frustumQuery = [spatialIndex addStandingQuery:SpatialQueryFrustum(viewProjection)];
+        _hasFrustumQuery = YES;
+    }
+}
+
+- (void) update {
+    uint64_t start = mach_absolute_time();
+
+    // Last frame's query was evaluated by this frame's spatial index update.
+    BOOL canTestView = _hasFrustumQuery;
+    [self updateFrustumQuery];
+
+    SpatialIndex *spatialIndex = [SpatialIndex main];
+    std::vector<std::pair<GLKVector3, float>> activeSpheres;
+    NSUInteger active = 0, sleeping = 0, parked = 0;
+
+    for( ManagedBody &managed : _bodies ) {
+        SCNNode *node = managed.node;
+        SCNPhysicsBody *body = node.physicsBody;
+
+        if( node.hidden ) {
+            [self park:managed];
+        } else {
+            BOOL inView = !canTestView || managed.handle == SPATIAL_HANDLE_INVALID
+                || [spatialIndex handle:managed.handle matchesStandingQuery:_frustumQuery];
+
+            switch( managed.state ) {
+                case BodyState::Parked:
+                    [self wake:managed];
+                    break;
+                case BodyState::Awake:
+                    if( _sleepOutsideView && !inView && body.isResting ) [self sleep:managed];
+                    break;
+                case BodyState::Sleeping:
+                    if( !_sleepOutsideView || inView || GLKVector3Length(SCNVector3ToGLKVector3(body.velocity)) > PHYSICS_WAKE_SPEED ) {
+                        [self wake:managed];
+                    }
+                    break;
+            }
+        }
+
+        switch( managed.state ) {
+            case BodyState::Awake: {
+                active++;
+                if( _proxiesCoverScan ) {
+                    // Moving bodies enable proxies around and ahead of them, resting ones only the ones they settled on.
+                    GLKVector3 position = managed.handle != SPATIAL_HANDLE_INVALID
+                        ? [spatialIndex positionForHandle:managed.handle]
+                        : SCNVector3ToGLKVector3([node convertPosition:SCNVector3Zero toNode:nil]);
+                    float radius = PHYSICS_PROXY_CELL_SIZE;
+                    if( !body.isResting ) {
+                        radius = PHYSICS_PROXY_ENABLE_RADIUS + GLKVector3Length(SCNVector3ToGLKVector3(body.velocity)) * PHYSICS_PROXY_LOOKAHEAD;
+                    }
+                    activeSpheres.emplace_back(position, radius);
+                }
+                break;
+            }
+            case BodyState::Sleeping: sleeping++; break;
+            case BodyState::Parked: parked++; break;
+        }
+    }
+
+    if( _proxiesCoverScan ) {
+        [self enableProxiesNear:activeSpheres];
+    }
+
+    _stats.managed = _bodies.size();
+    _stats.active = active;
+    _stats.sleeping = sleeping;
+    _stats.parked = parked;
+    _stats.updateMs = machTicksToMs(mach_absolute_time() - start);
+}
+
+- (PhysicsStats) stats {
+    return _stats;
+}
+
+@end
@@ -0,0 +1,105 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Render state for portals into the VR world.
+//
+//  A portal's stencil and depth passes are driven by custom render nodes, one
+//  per stage, placed around VR_WORLD_RENDERING_ORDER. Each stage node's
+//  delegate carries the stage as an integer tag, indexing a precomputed table
+//  of state blocks, one for inside AR and one for inside VR.
+//
+//  Any number of portals can be open at once. They all write the same stencil
+//  value, so the VR world shows through any of them, and only the first of a
+//  run of same stage nodes applies its block.
+//
+//  With Metal, SceneKit sets its own depth and stencil state for every draw, so
+//  stage nodes can't mask the VR world. Instead, clipped materials test each
+//  fragment's line of sight against the open portals' holes, to the same
+//  effect as the stencil test.
+//
+//  The clip uniforms are shared through MaterialParameters, set only when a
+//  portal moves or the camera crosses over.
+//
+//  Portals whose hole is outside the view frustum are culled: their occluder
+//  nodes are hidden and Metal materials skip them.
+//
+//  Updated by the SceneManager after the components.
+//  RENDER THREAD ONLY
+//
+
+#import <SceneKit/SceneKit.h>
+#import <GLKit/GLKit.h>
+
+// Portals Metal materials clip against at once.
+#define PORTAL_RENDERER_MAX_PORTALS 4
+
+/// Stages of the portal stack, in rendering order. A stage node's tag.
+typedef NS_ENUM(NSUInteger, PortalStage) {
+    PortalStagePrePortal = 0,   // Prepare the stencil for writing, disable color and depth writes.
+    PortalStagePostPortal,      // Enable color and depth, test inside or around the stencil for the VR world.
+    PortalStagePostVRScene,     // Disable stencil and color, write the portal's depth.
+    PortalStageDone,            // Enable color writes again.
+    PortalStageCount
+};
+
+typedef NS_ENUM(NSUInteger, PortalShape) {
+    PortalShapeRectangle = 0,   // Hole in the node's XY plane.
+    PortalShapeCircle,          // Hole in the node's XZ plane, like an SCNCylinder.
+};
+
+typedef struct {
+    NSUInteger portals;             // Enabled.
+    NSUInteger visible;             // Of those, in view.
+    NSUInteger stageCalls;          // Stage node callbacks since start.
+    NSUInteger blocksApplied;       // Of those, applying a state block.
+    NSUInteger clippedMaterials;
+} PortalRendererStats;
+
+/// One portal's hole, and the nodes only needed while it's in view.
+@interface PortalView : NSObject
+
+/// Centered on the hole, see PortalShape.
+@property (nonatomic, weak) SCNNode *holeNode;
+@property (nonatomic) PortalShape shape;
+
+/// Half width and height of a rectangle, radius of a circle, in holeNode's space.
+@property (nonatomic) GLKVector2 halfExtents;
+
+/// Hidden while the portal is culled, and always with Metal.
+@property (nonatomic, copy) NSArray<SCNNode *> *occluderNodes;
+
+@property (nonatomic) BOOL enabled;
+@property (nonatomic, readonly) BOOL visible;
+
+@end
+
+@interface PortalRenderer : NSObject
+
+/// Singleton.
++ (PortalRenderer *) main;
+
+/// Which side of the portals the camera is. Picks the state blocks. Defaults to YES.
+@property (nonatomic) BOOL insideAR;
+
+/// New custom render node for stage, rendering ordered around VR_WORLD_RENDERING_ORDER.
+- (SCNNode *) nodeForStage:(PortalStage)stage;
+
+- (void) addPortal:(PortalView *)portal;
+- (void) removePortal:(PortalView *)portal;
+
+/// Clip material's fragments to the portals when rendering with Metal. Keeps its existing fragment shader modifier.
+- (void) clipMaterial:(SCNMaterial *)material;
+
+/// Cull portals against the view, and update clipped materials.
+- (void) update;
+
+- (PortalRendererStats) stats;
+
+@end
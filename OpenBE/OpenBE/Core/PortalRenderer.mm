@@ -0,0 +1,403 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "PortalRenderer.h"
+#import "Core.h"
+
+#import <BridgeEngine/BridgeEngine.h>
+#import <BridgeEngine/BEDebugging.h>
+
+#include <OpenGLES/ES2/gl.h>
+#include <cmath>
+#include <cstring>
+
+// Added to a portal's bounding radius, since each eye sees a little past the camera's frustum.
+#define PORTAL_CULL_MARGIN 0.1f
+
+namespace {
+
+    // Which parts of the GL state a block sets, the rest is left as it is.
+    enum : uint8_t {
+        PortalSetStencilTest  = 1 << 0,
+        PortalSetStencilFunc  = 1 << 1,
+        PortalSetStencilOp    = 1 << 2,
+        PortalSetStencilMask  = 1 << 3,
+        PortalSetColorMask    = 1 << 4,
+        PortalSetDepthMask    = 1 << 5,
+        PortalClearStencil    = 1 << 6,
+    };
+
+    struct PortalStateBlock {
+        uint8_t fields;
+        GLboolean stencilTest;
+        GLenum stencilFunc;
+        GLuint stencilFuncMask;
+        GLenum stencilPassOp;
+        GLuint stencilWriteMask;
+        GLboolean colorWrite;
+        GLboolean depthWrite;
+    };
+
+    // [stage][insideAR]
+    const PortalStateBlock PortalStateTable[PortalStageCount][2] = {
+        // PrePortal: only write the stencil, starting from a clear one.
+        {
+            { PortalSetStencilTest | PortalSetStencilFunc | PortalSetStencilOp | PortalSetStencilMask | PortalSetColorMask | PortalSetDepthMask | PortalClearStencil,
+              GL_TRUE, GL_ALWAYS, 0xFF, GL_REPLACE, 0xFF, GL_FALSE, GL_FALSE },
+            { PortalSetStencilTest | PortalSetStencilFunc | PortalSetStencilOp | PortalSetStencilMask | PortalSetColorMask | PortalSetDepthMask | PortalClearStencil,
+              GL_TRUE, GL_ALWAYS, 0xFF, GL_REPLACE, 0xFF, GL_FALSE, GL_FALSE },
+        },
+        // PostPortal: the VR world draws around the portals from inside VR, through them from inside AR.
+        {
+            { PortalSetStencilFunc | PortalSetStencilMask | PortalSetColorMask | PortalSetDepthMask,
+              GL_TRUE, GL_NOTEQUAL, PORTAL_STENCIL_VALUE, GL_KEEP, 0x0, GL_TRUE, GL_TRUE },
+            { PortalSetStencilFunc | PortalSetStencilMask | PortalSetColorMask | PortalSetDepthMask,
+              GL_TRUE, GL_EQUAL, 0xFF, GL_KEEP, 0x0, GL_TRUE, GL_TRUE },
+        },
+        // PostVRScene: write the portals' depth only.
+        {
+            { PortalSetStencilTest | PortalSetColorMask,
+              GL_FALSE, GL_ALWAYS, 0xFF, GL_KEEP, 0x0, GL_FALSE, GL_TRUE },
+            { PortalSetStencilTest | PortalSetColorMask,
+              GL_FALSE, GL_ALWAYS, 0xFF, GL_KEEP, 0x0, GL_FALSE, GL_TRUE },
+        },
+        // Done
+        {
+            { PortalSetColorMask, GL_FALSE, GL_ALWAYS, 0xFF, GL_KEEP, 0x0, GL_TRUE, GL_TRUE },
+            { PortalSetColorMask, GL_FALSE, GL_ALWAYS, 0xFF, GL_KEEP, 0x0, GL_TRUE, GL_TRUE },
+        },
+    };
+
+    const int PortalStageRenderingOffset[PortalStageCount] = { -5, -3, +3, +5 };
+    NSString * const PortalStageNames[PortalStageCount] = { @"PrePortal", @"PostPortal", @"PostVRScene", @"portalDone" };
+
+    void applyStateBlock( const PortalStateBlock &block ) {
+        if( block.fields & PortalSetStencilTest ) {
+            if( block.stencilTest ) glEnable(GL_STENCIL_TEST);
+            else glDisable(GL_STENCIL_TEST);
+        }
+        if( block.fields & PortalSetStencilFunc ) glStencilFunc(block.stencilFunc, PORTAL_STENCIL_VALUE, block.stencilFuncMask);
+        if( block.fields & PortalSetStencilOp ) glStencilOp(GL_KEEP, GL_KEEP, block.stencilPassOp);
+        if( block.fields & PortalSetStencilMask ) glStencilMask(block.stencilWriteMask);
+        if( block.fields & PortalSetColorMask ) glColorMask(block.colorWrite, block.colorWrite, block.colorWrite, block.colorWrite);
+        if( block.fields & PortalSetDepthMask ) glDepthMask(block.depthWrite);
+        if( block.fields & PortalClearStencil ) {
+            glClearStencil(0);
+            glClear(GL_STENCIL_BUFFER_BIT);
+        }
+    }
+
+    BOOL sphereInFrustum( const GLKVector4 planes[6], GLKVector3 center, float radius ) {
+        for( int i=0; i<6; i++ ) {
+            const GLKVector4 &plane = planes[i];
+            float length = sqrtf(plane.x*plane.x + plane.y*plane.y + plane.z*plane.z);
+            if( plane.x*center.x + plane.y*center.y + plane.z*center.z + plane.w < -radius * length ) return NO;
+        }
+        return YES;
+    }
+
+    // Clip space planes, pointing in: left, right, bottom, top, near, far.
+    void frustumPlanes( GLKMatrix4 m, GLKVector4 planes[6] ) {
+        GLKVector4 rows[4];
+        for( int i=0; i<4; i++ ) rows[i] = GLKVector4Make(m.m[i], m.m[4+i], m.m[8+i], m.m[12+i]);
+        for( int i=0; i<3; i++ ) {
+            planes[i*2]   = GLKVector4Add(rows[3], rows[i]);
+            planes[i*2+1] = GLKVector4Subtract(rows[3], rows[i]);
+        }
+    }
+
+    // Fragment test for clipped materials: is the line from the eye to this fragment through an open portal.
+    NSString * const PortalClipDeclarations =
+        @"uniform float portalInsideAR;\n"
+        "uniform mat4 portalHole0;\n"
+        "uniform mat4 portalHole1;\n"
+        "uniform mat4 portalHole2;\n"
+        "uniform mat4 portalHole3;\n"
+        "uniform vec4 portalShape0;\n"
+        "uniform vec4 portalShape1;\n"
+        "uniform vec4 portalShape2;\n"
+        "uniform vec4 portalShape3;\n"
+        "float portalThrough(mat4 worldToHole, vec4 shape, vec4 eye, vec4 world) {\n"
+        "    if( shape.w == 0.0 ) return 0.0;\n"
+        "    vec3 from = (worldToHole * eye).xyz;\n"
+        "    vec3 to = (worldToHole * world).xyz;\n"
+        "    if( from.z * to.z > 0.0 ) return 0.0;\n"
+        "    vec2 hit = mix(from.xy, to.xy, from.z / (from.z - to.z)) / shape.xy;\n"
+        "    float inside = shape.z > 0.5 ? dot(hit, hit) : max(abs(hit.x), abs(hit.y));\n"
+        "    return inside <= 1.0 ? 1.0 : 0.0;\n"
+        "}\n";
+
+    NSString * const PortalClipBody =
+        @"vec4 portalEye = u_inverseViewTransform * vec4(0.0, 0.0, 0.0, 1.0);\n"
+        "vec4 portalWorld = u_inverseViewTransform * vec4(_surface.position, 1.0);\n"
+        "float portalSeen = max(max(portalThrough(portalHole0, portalShape0, portalEye, portalWorld),\n"
+        "                           portalThrough(portalHole1, portalShape1, portalEye, portalWorld)),\n"
+        "                       max(portalThrough(portalHole2, portalShape2, portalEye, portalWorld),\n"
+        "                           portalThrough(portalHole3, portalShape3, portalEye, portalWorld)));\n"
+        "if( (portalInsideAR > 0.5) != (portalSeen > 0.5) ) discard;\n";
+
+    // Matches the portal uniforms of PortalClipDeclarations.
+    struct PortalClipUniforms {
+        float insideAR;
+        GLKMatrix4 holes[PORTAL_RENDERER_MAX_PORTALS];
+        GLKVector4 shapes[PORTAL_RENDERER_MAX_PORTALS];
+    };
+
+} // anonymous
+
+#pragma mark - PortalView
+
+@interface PortalView ()
+@property (nonatomic, readwrite) BOOL visible;
+@property (nonatomic) BOOL occludersApplied;    // occluderNodes are hidden as they should be.
+@end
+
+@implementation PortalView
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _enabled = YES;
+        _visible = YES;
+    }
+    return self;
+}
+
+- (void) setOccluderNodes:(NSArray<SCNNode *> *)occluderNodes {
+    _occluderNodes = [occluderNodes copy];
+    _occludersApplied = NO;
+}
+
+@end
+
+#pragma mark - PortalStageDelegate
+
+/// Renderer delegate shared by every portal's node for one stage.
+@interface PortalStageDelegate : NSObject <SCNNodeRendererDelegate>
+@property (nonatomic) PortalStage tag;
+@end
+
+@interface PortalRenderer ()
+- (void) renderStage:(PortalStage)stage passName:(NSString *)passName;
+@end
+
+@implementation PortalStageDelegate
+
+- (void) renderNode:(SCNNode *)node renderer:(SCNRenderer *)renderer arguments:(NSDictionary<NSString *,id> *)arguments {
+    [[PortalRenderer main] renderStage:_tag passName:arguments[@"kRenderPassName"]];
+}
+
+@end
+
+#pragma mark - PortalRenderer
+
+@implementation PortalRenderer
+{
+    PortalStageDelegate *_stageDelegates[PortalStageCount];     // Nodes don't retain their renderer delegate.
+    NSMutableArray<PortalView *> *_portals;
+
+    // Stage last applied. Nodes of the same stage render back to back, only the first applies.
+    NSInteger _appliedStage;
+    BOOL _appliedInsideAR;
+
+    // Pass names come as the same few strings, compared once each.
+    __weak NSString *_lastPassName;
+    BOOL _lastPassIsLight;
+
+    NSHashTable<SCNMaterial *> *_clippedMaterials;
+    NSString *_holeKeys[PORTAL_RENDERER_MAX_PORTALS];
+    NSString *_shapeKeys[PORTAL_RENDERER_MAX_PORTALS];
+    PortalClipUniforms _clipUniforms;
+    BOOL _clipUniformsApplied;
+
+    PortalRendererStats _stats;
+}
+
++ (PortalRenderer *) main {
+    static PortalRenderer *mainPortalRenderer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainPortalRenderer = [[PortalRenderer alloc] init];
+    });
+
+    return mainPortalRenderer;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _insideAR = YES;
+        _portals = [NSMutableArray array];
+        _clippedMaterials = [NSHashTable weakObjectsHashTable];
+        _appliedStage = -1;
+        _stats = PortalRendererStats();
+
+        for( NSUInteger stage=0; stage<PortalStageCount; stage++ ) {
+            _stageDelegates[stage] = [[PortalStageDelegate alloc] init];
+            _stageDelegates[stage].tag = (PortalStage)stage;
+        }
+        for( int i=0; i<PORTAL_RENDERER_MAX_PORTALS; i++ ) {
+            _holeKeys[i] = [NSString stringWithFormat:@"portalHole%d", i];
+            _shapeKeys[i] = [NSString stringWithFormat:@"portalShape%d", i];
+        }
+    }
+    return self;
+}
+
+- (BOOL) usesMetal {
+    return [SceneManager main].renderingAPI == BEViewRenderingAPIMetal;
+}
+
+#pragma mark - Stages
+
+- (SCNNode *) nodeForStage:(PortalStage)stage {
+    be_assert(stage < PortalStageCount);
+
+    SCNNode *node = [SCNNode node];
+    node.name = PortalStageNames[stage];
+    node.renderingOrder = VR_WORLD_RENDERING_ORDER + PortalStageRenderingOffset[stage];
+
+    // Metal draws can't be steered from here, clipped materials do the work instead.
+    if( ![self usesMetal] ) node.rendererDelegate = _stageDelegates[stage];
+    return node;
+}
+
+- (void) renderStage:(PortalStage)stage passName:(NSString *)passName {
+    _stats.stageCalls++;
+
+    // Nothing to do in the shadow pass.
+    // NOTE: in stereo the other stages get called twice, with pass names sceneLeft and sceneRight
+    if( passName != _lastPassName ) {
+        _lastPassName = passName;
+        _lastPassIsLight = [passName isEqualToString:@"SceneKit_renderSceneFromLight"];
+    }
+    if( _lastPassIsLight ) return;
+
+    if( (NSInteger)stage == _appliedStage && _insideAR == _appliedInsideAR ) return;
+    _appliedStage = stage;
+    _appliedInsideAR = _insideAR;
+
+    applyStateBlock(PortalStateTable[stage][_insideAR ? 1 : 0]);
+    _stats.blocksApplied++;
+}
+
+#pragma mark - Portals
+
+- (void) addPortal:(PortalView *)portal {
+    if( portal && ![_portals containsObject:portal] ) [_portals addObject:portal];
+}
+
+- (void) removePortal:(PortalView *)portal {
+    [_portals removeObject:portal];
+}
+
+- (void) clipMaterial:(SCNMaterial *)material {
+    if( material == nil || ![self usesMetal] || [_clippedMaterials containsObject:material] ) return;
+
+    // Declarations go before the existing modifier's body, the clip test ahead of it.
+    NSString *existing = material.shaderModifiers[SCNShaderModifierEntryPointFragment] ?: @"";
+    NSString *declarations = @"";
+    NSString *body = existing;
+    NSRange pragma = [existing rangeOfString:@"#pragma body"];
+    if( pragma.location != NSNotFound ) {
+        declarations = [existing substringToIndex:pragma.location];
+        body = [existing substringFromIndex:NSMaxRange(pragma)];
+    }
+
+    NSMutableDictionary *modifiers = [material.shaderModifiers mutableCopy] ?: [NSMutableDictionary dictionary];
+    modifiers[SCNShaderModifierEntryPointFragment] = [NSString stringWithFormat:@"%@%@#pragma body\n%@%@",
+                                                      declarations, PortalClipDeclarations, PortalClipBody, body];
+    material.shaderModifiers = modifiers;
+
+    [_clippedMaterials addObject:material];
+    _stats.clippedMaterials = _clippedMaterials.count;
+    [[MaterialParameters main] addMaterial:material parameters:MaterialParameterMaskPortals];
+}
+
+- (void) update {
+    BOOL metal = [self usesMetal];
+
+    Camera *camera = [Camera main];
+    BOOL canCull = camera.camera != nil && camera.node != nil;
+    GLKVector4 planes[6];
+    if( canCull ) {
+        GLKMatrix4 view = GLKMatrix4Invert(SCNMatrix4ToGLKMatrix4(camera.node.worldTransform), NULL);
+        frustumPlanes(GLKMatrix4Multiply(SCNMatrix4ToGLKMatrix4(camera.camera.projectionTransform), view), planes);
+    }
+
+    PortalClipUniforms uniforms;
+    memset(&uniforms, 0, sizeof(uniforms));     // Compared whole, padding included.
+    uniforms.insideAR = _insideAR ? 1.f : 0.f;
+    NSUInteger slot = 0;
+    _stats.portals = 0;
+    _stats.visible = 0;
+
+    for( PortalView *portal in _portals ) {
+        SCNNode *holeNode = portal.holeNode;
+        BOOL visible = NO;
+
+        if( portal.enabled && holeNode ) {
+            _stats.portals++;
+
+            GLKMatrix4 world = SCNMatrix4ToGLKMatrix4(holeNode.worldTransform);
+            GLKVector3 center = GLKVector3Make(world.m30, world.m31, world.m32);
+            float scale = fmaxf(GLKVector3Length(GLKVector3Make(world.m00, world.m01, world.m02)),
+                          fmaxf(GLKVector3Length(GLKVector3Make(world.m10, world.m11, world.m12)),
+                                GLKVector3Length(GLKVector3Make(world.m20, world.m21, world.m22))));
+            GLKVector2 extents = portal.halfExtents;
+            float radius = GLKVector2Length(extents) * scale + PORTAL_CULL_MARGIN;
+            visible = !canCull || sphereInFrustum(planes, center, radius);
+
+            bool invertible = false;
+            GLKMatrix4 worldToHole = GLKMatrix4Invert(world, &invertible);
+            if( visible && invertible && slot < PORTAL_RENDERER_MAX_PORTALS ) {
+                if( portal.shape == PortalShapeCircle ) {
+                    // Swap Y and Z, so the hole is in the XY plane like a rectangle's.
+                    GLKMatrix4 swapYZ = GLKMatrix4Make(1, 0, 0, 0,
+                                                       0, 0, 1, 0,
+                                                       0, 1, 0, 0,
+                                                       0, 0, 0, 1);
+                    worldToHole = GLKMatrix4Multiply(swapYZ, worldToHole);
+                    extents.y = extents.x;
+                }
+                uniforms.holes[slot] = worldToHole;
+                uniforms.shapes[slot] = GLKVector4Make(extents.x, extents.y, portal.shape == PortalShapeCircle ? 1.f : 0.f, 1.f);
+                slot++;
+            }
+            if( visible ) _stats.visible++;
+        }
+
+        // Occluders only write the stencil and depth, and only with GL.
+        BOOL hideOccluders = metal || !visible;
+        if( portal.visible != visible || !portal.occludersApplied ) {
+            for( SCNNode *occluder in portal.occluderNodes ) occluder.hidden = hideOccluders;
+            portal.visible = visible;
+            portal.occludersApplied = YES;
+        }
+    }
+
+    if( !metal || _clippedMaterials.count == 0 ) return;
+    if( _clipUniformsApplied && memcmp(&uniforms, &_clipUniforms, sizeof(uniforms)) == 0 ) return;
+
+    _clipUniforms = uniforms;
+    _clipUniformsApplied = YES;
+
+    // Pushed to the clipped materials by MaterialParameters, after the renderers.
+    NSMutableDictionary<NSString *, id> *values = [NSMutableDictionary dictionaryWithCapacity:1 + 2 * PORTAL_RENDERER_MAX_PORTALS];
+    values[@"portalInsideAR"] = @(uniforms.insideAR);
+    for( int i=0; i<PORTAL_RENDERER_MAX_PORTALS; i++ ) {
+        values[_holeKeys[i]] = [NSValue valueWithSCNMatrix4:SCNMatrix4FromGLKMatrix4(uniforms.holes[i])];
+        values[_shapeKeys[i]] = [NSValue valueWithSCNVector4:SCNVector4Make(uniforms.shapes[i].x, uniforms.shapes[i].y, uniforms.shapes[i].z, uniforms.shapes[i].w)];
+    }
+    [[MaterialParameters main] setUniforms:values forParameter:MaterialParameterPortals];
+}
+
+- (PortalRendererStats) stats {
+    return _stats;
+}
+
+@end
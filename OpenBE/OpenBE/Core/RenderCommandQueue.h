@@ -0,0 +1,111 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Lock-free, multiple-producer / single-consumer command ring for posting
+//  work onto the render thread.
+//
+//  Any thread may post. Commands are drained exactly once per frame, by the
+//  SceneManager at the top of updateWithDeltaTime: (before the Camera, the
+//  EventManager and all entities are updated), in the order they were posted.
+//
+//  Typed commands are fixed-size and don't allocate. Posting a block is
+//  supported as a fallback for one-off work that doesn't fit a typed command.
+//  If the ring is ever full, the command is handed over to
+//  BEMixedRealityMode runBlockInRenderThread: instead, and counted as an overflow.
+//
+
+#import <GameplayKit/GameplayKit.h>
+#import <SceneKit/SceneKit.h>
+#import <GLKit/GLKit.h>
+
+#import "ComponentProtocol.h"
+#import "EventComponentProtocol.h"
+
+typedef NS_ENUM(uint8_t, RenderCommandType) {
+    RenderCommandTypeBlock = 0,         // Fallback: run an arbitrary block.
+    RenderCommandTypePerform,           // [target performSelector:selector]
+    RenderCommandTypeAddComponentEntity,// Create an entity, add the component to it, then start the component.
+    RenderCommandTypeTouchBegan,        // EventComponentProtocol touchBeganButton:forward:hit:
+    RenderCommandTypeTouchMoved,        // EventComponentProtocol touchMovedButton:forward:hit:
+    RenderCommandTypeTouchEnded,        // EventComponentProtocol touchEndedButton:forward:hit:
+    RenderCommandTypeTouchCancelled,    // EventComponentProtocol touchCancelledButton:forward:hit:
+};
+
+/**
+ * Queue counters, for profiling.
+ * Latency is measured from post to execution of each command, drain time is the cost of one drain.
+ */
+typedef struct {
+    uint64_t posted;            // Total commands posted.
+    uint64_t drained;           // Total commands executed by drain.
+    uint64_t overflowed;        // Commands that fell back to runBlockInRenderThread: because the ring was full.
+    uint32_t depth;             // Commands currently waiting in the ring.
+    uint32_t highWaterDepth;    // Deepest the ring has been.
+    uint32_t lastDrainCount;    // Commands executed in the last drain.
+    double lastDrainMs;         // Time spent in the last drain.
+    double maxDrainMs;          // Longest drain so far.
+    double lastMaxLatencyMs;    // Oldest command latency in the last drain.
+    double averageLatencyMs;    // Running average of post-to-execute latency.
+} RenderCommandQueueStats;
+
+@interface RenderCommandQueue : NSObject
+
+/// Singleton.
++ (RenderCommandQueue *) main;
+
+/// Number of command slots in the ring.
+@property (nonatomic, readonly) NSUInteger capacity;
+
+/**
+ * Run [target performSelector:selector] on the render thread.
+ * Target is retained until the command runs.
+ * THREAD SAFE
+ */
+- (void) postTarget:(id)target selector:(SEL)selector;
+
+/**
+ * Create a new SceneManager entity, add the component to it, and start the component.
+ * Use this to hook up components from inside another component's start or update,
+ * without mutating the SceneManager entities while they are being iterated.
+ * THREAD SAFE
+ */
+- (void) postAddComponentToNewEntity:(GKComponent<ComponentProtocol> *)component;
+
+/**
+ * Deliver a touch event to an event component.
+ * type must be one of the RenderCommandTypeTouch* values.
+ * THREAD SAFE
+ */
+- (void) postTouch:(RenderCommandType)type
+       toComponent:(GKComponent<EventComponentProtocol> *)component
+            button:(uint8_t)button
+           forward:(GLKVector3)forward
+               hit:(SCNHitTestResult *)hit;
+
+/**
+ * Fallback for work that doesn't fit a typed command.
+ * The block is copied, so prefer typed commands on hot paths.
+ * THREAD SAFE
+ */
+- (void) postBlock:(void (^)(void))block;
+
+/**
+ * Execute all commands posted before this call, in order.
+ * Commands posted while draining run on the next drain.
+ * RENDER THREAD ONLY - called once per frame by SceneManager.
+ */
+- (void) drain;
+
+/**
+ * Snapshot of the queue counters.
+ */
+- (RenderCommandQueueStats) stats;
+
+@end
@@ -0,0 +1,337 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "RenderCommandQueue.h"
+#import "Core.h"
+#import "../Utils/Math.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <atomic>
+#include <algorithm>
+
+namespace {
+
+    // Must be a power of two.
+    const size_t kRenderCommandCapacity = 1024;
+    const size_t kRenderCommandMask = kRenderCommandCapacity - 1;
+
+    /**
+     * Fixed-size command slot.
+     * Objective-C objects are held as +1 retained pointers, so the slot stays POD
+     * and copying it in and out of the ring never touches the reference counts.
+     */
+    struct RenderCommand
+    {
+        RenderCommandType type;
+        uint8_t button;
+        void *target;       // Retained. Component, perform target, or the block itself.
+        void *object;       // Retained, may be NULL. Hit test result for touches.
+        SEL selector;
+        GLKVector3 forward;
+        uint64_t postTime;  // mach_absolute_time
+    };
+
+    struct RenderCommandCell
+    {
+        std::atomic<size_t> sequence;
+        RenderCommand command;
+    };
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    /**
+     * Run the command, and release the objects it was holding.
+     */
+    void executeRenderCommand( const RenderCommand &command ) {
+        id target = (__bridge_transfer id)command.target;
+        id object = (__bridge_transfer id)command.object;
+
+        switch( command.type ) {
+            case RenderCommandTypeBlock: {
+                void (^block)(void) = target;
+                block();
+                break;
+            }
+            case RenderCommandTypePerform: {
+                // Go through the IMP, ARC can't reason about performSelector: with an unknown selector.
+                void (*func)(id, SEL) = (void (*)(id, SEL))[target methodForSelector:command.selector];
+                func(target, command.selector);
+                break;
+            }
+            case RenderCommandTypeAddComponentEntity: {
+                GKComponent<ComponentProtocol> *component = target;
+                [[[SceneManager main] createEntity] addComponent:component];
+                [component start];
+                break;
+            }
+            case RenderCommandTypeTouchBegan:
+                [(GKComponent<EventComponentProtocol> *)target touchBeganButton:command.button forward:command.forward hit:object];
+                break;
+            case RenderCommandTypeTouchMoved:
+                [(GKComponent<EventComponentProtocol> *)target touchMovedButton:command.button forward:command.forward hit:object];
+                break;
+            case RenderCommandTypeTouchEnded:
+                [(GKComponent<EventComponentProtocol> *)target touchEndedButton:command.button forward:command.forward hit:object];
+                break;
+            case RenderCommandTypeTouchCancelled:
+                [(GKComponent<EventComponentProtocol> *)target touchCancelledButton:command.button forward:command.forward hit:object];
+                break;
+        }
+    }
+
+} // anonymous
+
+@implementation RenderCommandQueue
+{
+    RenderCommandCell *_cells;
+
+    // Producers claim slots by advancing _enqueuePos, the render thread is the only consumer.
+    std::atomic<size_t> _enqueuePos;
+    std::atomic<size_t> _dequeuePos;
+
+    std::atomic<uint64_t> _posted;
+    std::atomic<uint64_t> _overflowed;
+    std::atomic<uint32_t> _highWaterDepth;
+
+    // Only written by the render thread in drain.
+    uint64_t _drained;
+    uint32_t _lastDrainCount;
+    double _lastDrainMs;
+    double _maxDrainMs;
+    double _lastMaxLatencyMs;
+    double _averageLatencyMs;
+}
+
++ (RenderCommandQueue *) main {
+    static RenderCommandQueue *mainQueue = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainQueue = [[RenderCommandQueue alloc] init];
+    });
+
+    return mainQueue;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _cells = new RenderCommandCell[kRenderCommandCapacity];
+        for( size_t i=0; i<kRenderCommandCapacity; i++ ) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _enqueuePos.store(0, std::memory_order_relaxed);
+        _dequeuePos.store(0, std::memory_order_relaxed);
+        _posted.store(0, std::memory_order_relaxed);
+        _overflowed.store(0, std::memory_order_relaxed);
+        _highWaterDepth.store(0, std::memory_order_relaxed);
+    }
+    return self;
+}
+
+- (void) dealloc {
+    // Release anything still waiting, without running it.
+    size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+    size_t end = _enqueuePos.load(std::memory_order_acquire);
+    for( ; pos != end; pos++ ) {
+        RenderCommand &command = _cells[pos & kRenderCommandMask].command;
+        if( command.target ) CFRelease(command.target);
+        if( command.object ) CFRelease(command.object);
+    }
+    delete [] _cells;
+}
+
+- (NSUInteger) capacity {
+    return kRenderCommandCapacity;
+}
+
+#pragma mark - Producers
+
+- (BOOL) enqueue:(const RenderCommand &)command {
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    for(;;) {
+        RenderCommandCell &cell = _cells[pos & kRenderCommandMask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if( diff == 0 ) {
+            if( _enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) ) {
+                cell.command = command;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                break;
+            }
+        } else if( diff < 0 ) {
+            return NO; // Full.
+        } else {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    _posted.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t depth = (uint32_t)(pos + 1 - _dequeuePos.load(std::memory_order_relaxed));
+    uint32_t highWater = _highWaterDepth.load(std::memory_order_relaxed);
+    while( depth > highWater && !_highWaterDepth.compare_exchange_weak(highWater, depth, std::memory_order_relaxed) ) {}
+
+    return YES;
+}
+
+- (void) post:(const RenderCommand &)command {
+    if( [self enqueue:command] ) {
+        return;
+    }
+
+    // Ring is full, hand it over to the engine rather than drop it.
+    _posted.fetch_add(1, std::memory_order_relaxed);
+    _overflowed.fetch_add(1, std::memory_order_relaxed);
+
+    BEMixedRealityMode *mixedRealityMode = [SceneManager main].mixedRealityMode;
+    if( mixedRealityMode == nil ) {
+        NSLog(@"RenderCommandQueue: === Warning === Queue full and no mixedRealityMode, dropping command type: %d", (int)command.type);
+        if( command.target ) CFRelease(command.target);
+        if( command.object ) CFRelease(command.object);
+        return;
+    }
+
+    RenderCommand overflowCommand = command;
+    [mixedRealityMode runBlockInRenderThread:^(void) {
+        executeRenderCommand(overflowCommand);
+    }];
+}
+
+- (void) postTarget:(id)target selector:(SEL)selector {
+    if( target == nil ) return;
+
+    RenderCommand command = {};
+    command.type = RenderCommandTypePerform;
+    command.target = (__bridge_retained void *)target;
+    command.selector = selector;
+    command.postTime = mach_absolute_time();
+    [self post:command];
+}
+
+- (void) postAddComponentToNewEntity:(GKComponent<ComponentProtocol> *)component {
+    if( component == nil ) return;
+
+    RenderCommand command = {};
+    command.type = RenderCommandTypeAddComponentEntity;
+    command.target = (__bridge_retained void *)component;
+    command.postTime = mach_absolute_time();
+    [self post:command];
+}
+
+- (void) postTouch:(RenderCommandType)type
+       toComponent:(GKComponent<EventComponentProtocol> *)component
+            button:(uint8_t)button
+           forward:(GLKVector3)forward
+               hit:(SCNHitTestResult *)hit
+{
+    be_assert( type >= RenderCommandTypeTouchBegan && type <= RenderCommandTypeTouchCancelled, "Not a touch command type: %d", (int)type );
+    if( component == nil ) return;
+
+    RenderCommand command = {};
+    command.type = type;
+    command.button = button;
+    command.target = (__bridge_retained void *)component;
+    command.object = (__bridge_retained void *)hit;
+    command.forward = forward;
+    command.postTime = mach_absolute_time();
+    [self post:command];
+}
+
+- (void) postBlock:(void (^)(void))block {
+    if( block == nil ) return;
+
+    RenderCommand command = {};
+    command.type = RenderCommandTypeBlock;
+    command.target = (__bridge_retained void *)[block copy];
+    command.postTime = mach_absolute_time();
+    [self post:command];
+}
+
+#pragma mark - Consumer
+
+- (void) drain {
+    uint64_t start = mach_absolute_time();
+
+    // Only run what was posted before the drain started, so commands posting
+    // further commands can't keep us here.
+    const size_t end = _enqueuePos.load(std::memory_order_acquire);
+    size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+
+    uint32_t count = 0;
+    uint64_t maxLatency = 0;
+    uint64_t totalLatency = 0;
+
+    while( pos != end ) {
+        RenderCommandCell &cell = _cells[pos & kRenderCommandMask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if( (intptr_t)sequence - (intptr_t)(pos + 1) < 0 ) {
+            break; // Slot claimed but not yet written, pick it up next frame.
+        }
+
+        RenderCommand command = cell.command;
+        cell.sequence.store(pos + kRenderCommandCapacity, std::memory_order_release);
+        pos++;
+        _dequeuePos.store(pos, std::memory_order_relaxed);
+
+        uint64_t latency = start - std::min(start, command.postTime);
+        maxLatency = std::max(maxLatency, latency);
+        totalLatency += latency;
+        count++;
+
+        executeRenderCommand(command);
+    }
+
+    double drainMs = machTicksToMs(mach_absolute_time() - start);
+
+    _lastDrainCount = count;
+    _lastDrainMs = drainMs;
+    _maxDrainMs = std::max(_maxDrainMs, drainMs);
+    _lastMaxLatencyMs = machTicksToMs(maxLatency);
+    if( count ) {
+        _drained += count;
+        double averageMs = machTicksToMs(totalLatency) / count;
+        _averageLatencyMs = lerp(_averageLatencyMs, averageMs, 0.1);
+    }
+
+#ifdef ENABLE_COMPONENT_PROFILING
+    // Throttle to 1-report per second.
+    static uint64_t throttleStart = 0;
+    if( machTicksToMs(start - throttleStart) > 1000.0 ) {
+        RenderCommandQueueStats s = [self stats];
+        NSLog(@"Render Cmd: depth %u (max %u), drained %u, drain %0.4f (ms), latency %0.4f (ms), overflow %llu",
+              s.depth, s.highWaterDepth, s.lastDrainCount, s.lastDrainMs, s.averageLatencyMs, s.overflowed);
+        throttleStart = start;
+    }
+#endif // ENABLE_COMPONENT_PROFILING
+}
+
+#pragma mark - Stats
+
+- (RenderCommandQueueStats) stats {
+    RenderCommandQueueStats s = {};
+    s.posted = _posted.load(std::memory_order_relaxed);
+    s.overflowed = _overflowed.load(std::memory_order_relaxed);
+    s.drained = _drained;
+    s.depth = (uint32_t)(_enqueuePos.load(std::memory_order_relaxed) - _dequeuePos.load(std::memory_order_relaxed));
+    s.highWaterDepth = _highWaterDepth.load(std::memory_order_relaxed);
+    s.lastDrainCount = _lastDrainCount;
+    s.lastDrainMs = _lastDrainMs;
+    s.maxDrainMs = _maxDrainMs;
+    s.lastMaxLatencyMs = _lastMaxLatencyMs;
+    s.averageLatencyMs = _averageLatencyMs;
+    return s;
+}
+
+@end
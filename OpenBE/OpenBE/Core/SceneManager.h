@@ -8,10 +8,13 @@
 #import <BridgeEngine/BridgeEngine.h>
 
 @class GKEntity;
+@class EntityRegistry;
 
 @interface SceneManager : NSObject
 
-@property (strong) NSMutableArray * entities;
+/// Snapshot of all entities. Use the registry to iterate or query without copying.
+@property (readonly) NSArray * entities;
+@property (readonly) EntityRegistry * registry;
 @property (weak) BEMixedRealityMode * mixedRealityMode;
 
 + (SceneManager *) main;
@@ -22,6 +25,7 @@
 - (BEViewRenderingAPI)renderingAPI;
 
 - (void) addEntity:(GKEntity *) entity;
+/// During the entity updates, the entity isn't updated again and is removed once they're all done.
 - (void) removeEntity:(GKEntity *)entity;
 
 - (GKEntity *) createEntity;
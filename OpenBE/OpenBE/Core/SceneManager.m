@@ -7,11 +7,12 @@
 
 #import "SceneManager.h"
 #import "Core.h"
+#import "AudioEngine.h"
+#import "../Utils/ResourceIndex.h"
+#import "../Utils/NodeSet.h"
 
-#ifdef ENABLE_COMPONENT_PROFILING
 #include <mach/mach.h>
 #include <mach/mach_time.h>
-#endif
 
 @import GLKit;
 
@@ -23,6 +24,10 @@
 @end
 
 @implementation SceneManager
+{
+    BOOL _updatingEntities;
+    NSMutableArray<GKEntity *> *_pendingRemovals;     // Removed during the entity updates, applied after them.
+}
 
 #pragma mark - Class
 
@@ -47,11 +52,19 @@
 - (id) init {
     self = [super init];
     
-    self.entities = [[NSMutableArray alloc] initWithCapacity:32];
+    _registry = [[EntityRegistry alloc] init];
+    _pendingRemovals = [[NSMutableArray alloc] init];
+
+    // Resource lookups are index hits from then on.
+    [ResourceIndex prepareInBackground];
     
     return self;
 }
 
+- (NSArray *) entities {
+    return [_registry allEntities];
+}
+
 - (void) initWithMixedRealityMode:(BEMixedRealityMode *)mixedRealityMode stereo:(BOOL)stereo {
     self.isStereo = stereo;
     self.mixedRealityMode = mixedRealityMode;
@@ -92,21 +105,42 @@
         [worldBody clearAllForces];
     }
 
+    // Managed bodies collide with convex proxies of the scan, near them only.
+    [[PhysicsManager main] buildScanProxiesForNodes:coarseMeshNodes];
+    [[PhysicsManager main] observeRenderer:mixedRealityMode.sceneKitRenderer];
+
+    // Build every OpenBE program now, in the background, rather than on first use.
+    [[ShaderCache main] warmUpWithRenderer:mixedRealityMode.sceneKitRenderer renderingAPI:self.renderingAPI completion:nil];
+
+    // Occlusion grid for sight lines, from the saved occupancy grid and the scan.
+    [[LineOfSight main] startWithMixedRealityMode:mixedRealityMode];
+
+#ifdef ENABLE_ENVIRONMENT_TEXTURING
+    [[EnvironmentTexturer main] startWithMixedRealityMode:mixedRealityMode];
+#endif
+
     [self updateSingletons:mixedRealityMode withDeltaTime:0.f];
 }
 
 #pragma mark - Components
 
 - (void) addEntity:(GKEntity * ) entity {
-    [self.entities addObject:entity];
+    [_pendingRemovals removeObjectIdenticalTo:entity];
+    [_registry addEntity:entity];
 }
 
 - (void) removeEntity:(GKEntity *)entity {
-    [self.entities removeObject:entity];
+    // Removal shifts the later entities down an index, which the update loop would skip one of.
+    if( _updatingEntities ) {
+        [_pendingRemovals addObject:entity];
+        return;
+    }
+
+    [_registry removeEntity:entity];
 }
 
 - (GKEntity * ) createEntity {
-    GKEntity * entity = [[GKEntity alloc] init];
+    GKEntity * entity = [[Entity alloc] init];
     [self addEntity:entity];
     return entity;
 }
@@ -121,11 +155,49 @@
 }
 
 - (void) updateSingletons:(BEMixedRealityMode *) mixedRealityMode withDeltaTime:(NSTimeInterval)seconds {
+    [self updateSingletons:mixedRealityMode withDeltaTime:seconds profiled:NO];
+}
+
+/**
+ * Run one step of the update. While the FrameReplay profiles components,
+ * the step is timed and reported to it as sampleClass.
+ */
+- (void) runStep:(Class)sampleClass profiled:(BOOL)profiled block:(NS_NOESCAPE void (^)(void))block {
+    if( !profiled ) {
+        block();
+        return;
+    }
+
+    uint64_t start = mach_absolute_time();
+    block();
+    [[FrameReplay main] addSampleForClass:sampleClass ticks:mach_absolute_time() - start];
+}
+
+- (void) updateSingletons:(BEMixedRealityMode *) mixedRealityMode withDeltaTime:(NSTimeInterval)seconds profiled:(BOOL)profiled {
     // update camera
-    [[Camera main] updateWithDeltaTime:seconds andNode:mixedRealityMode.localDeviceNode  andCamera:mixedRealityMode.sceneKitCamera];
+    [self runStep:[Camera class] profiled:profiled block:^{
+        [[Camera main] updateWithDeltaTime:seconds andNode:mixedRealityMode.localDeviceNode  andCamera:mixedRealityMode.sceneKitCamera];
+    }];
+    
+    // spatial queries follow the camera
+    [self runStep:[SpatialIndex class] profiled:profiled block:^{
+        [[SpatialIndex main] update];
+    }];
+
+    // sight lines between what was just indexed
+    [self runStep:[LineOfSight class] profiled:profiled block:^{
+        [[LineOfSight main] update];
+    }];
+
+    // park, sleep and wake bodies against this frame's view
+    [self runStep:[PhysicsManager class] profiled:profiled block:^{
+        [[PhysicsManager main] update];
+    }];
     
     // event system
-    [[EventManager main] updateWithDeltaTime:(NSTimeInterval)seconds];
+    [self runStep:[EventManager class] profiled:profiled block:^{
+        [[EventManager main] updateWithDeltaTime:(NSTimeInterval)seconds];
+    }];
 }
 
 
@@ -163,11 +235,72 @@
     uint64_t start = mach_absolute_time();
 #endif // ENABLE_COMPONENT_PROFILING
 
-    [self updateSingletons:mixedRealityMode withDeltaTime:(NSTimeInterval)seconds];
+    FrameReplay * frameReplay = [FrameReplay main];
+    [frameReplay beginFrameWithDeltaTime:seconds];
 
-    for( GKEntity * entity in self.entities ) {
-        [entity updateWithDeltaTime:seconds];
+    // Uniform blocks move on to their next copy on their first update this frame.
+    [[UniformRing main] advanceFrame];
+
+    // One update order. While profiling, each singleton and component is timed separately.
+    BOOL profiled = frameReplay.profileComponents;
+
+    // Commands posted from other threads, or from last frame's updates.
+    [self runStep:[RenderCommandQueue class] profiled:profiled block:^{
+        [[RenderCommandQueue main] drain];
+    }];
+
+    // Hierarchy-wide changes nobody is waiting on, a few nodes a frame.
+    [self runStep:[NodeSet class] profiled:profiled block:^{
+        [NodeSet applyDeferred];
+    }];
+
+    [self updateSingletons:mixedRealityMode withDeltaTime:(NSTimeInterval)seconds profiled:profiled];
+
+    _updatingEntities = YES;
+    for( NSUInteger i=0; i<_registry.count; i++ ) {
+        GKEntity *entity = [_registry entityAtIndex:i];
+        if( _pendingRemovals.count > 0 && [_pendingRemovals indexOfObjectIdenticalTo:entity] != NSNotFound ) continue;
+
+        if( !profiled ) {
+            [entity updateWithDeltaTime:seconds];
+            continue;
+        }
+
+        for( GKComponent * component in entity.components ) {
+            [self runStep:[component class] profiled:YES block:^{
+                [component updateWithDeltaTime:seconds];
+            }];
+        }
+    }
+    _updatingEntities = NO;
+
+    for( GKEntity *entity in _pendingRemovals ) {
+        [_registry removeEntity:entity];
     }
+    [_pendingRemovals removeAllObjects];
+
+    // Portals were moved and animated by their components.
+    [self runStep:[PortalRenderer class] profiled:profiled block:^{
+        [[PortalRenderer main] update];
+    }];
+    [self runStep:[BeamRenderer class] profiled:profiled block:^{
+        [[BeamRenderer main] update];
+    }];
+    [self runStep:[EnvironmentTexturer class] profiled:profiled block:^{
+        [[EnvironmentTexturer main] update];
+    }];
+
+    // Shared material uniforms set by the components and renderers above.
+    [self runStep:[MaterialParameters class] profiled:profiled block:^{
+        [[MaterialParameters main] update];
+    }];
+
+    // Start the sounds triggered this frame.
+    [self runStep:[AudioVoicePool class] profiled:profiled block:^{
+        [[AudioEngine main] updateVoices];
+    }];
+
+    [frameReplay endFrame];
 
 #ifdef ENABLE_COMPONENT_PROFILING
     uint64_t end = mach_absolute_time();
@@ -196,7 +329,7 @@
 - (void)updateAtTime:(NSTimeInterval)time mixedRealityMode:(BEMixedRealityMode *) mixedRealityMode {
     // update entities
     if(self.previousTimeInterval) {
-        NSTimeInterval timeInterval = time - self.previousTimeInterval;
+        NSTimeInterval timeInterval = [[FrameReplay main] deltaTimeForFrame:time - self.previousTimeInterval];
         [self updateWithDeltaTime:timeInterval mixedRealityMode:mixedRealityMode];
     }
     self.previousTimeInterval = time;
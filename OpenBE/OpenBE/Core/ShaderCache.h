@@ -0,0 +1,80 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Shared shader programs, keyed by shader name and variant.
+//
+//  Every component drawing with the same shader gets the same SCNProgram, so
+//  SceneKit compiles it once rather than once per instance. GL sources are read
+//  once, preferring the baked ones, and Metal functions are looked up once in
+//  OpenBE.metal's library.
+//
+//  warmUpWithRenderer: builds every OpenBE program on a background queue at
+//  startup, along with the StereoRenderer's pipeline states, then has SceneKit
+//  prepare them, so nothing compiles the first time a portal opens or a scan
+//  runs. Each build is timed.
+//
+//  THREAD SAFE
+//
+
+#import <SceneKit/SceneKit.h>
+#import <Metal/Metal.h>
+#import <BridgeEngine/BridgeEngine.h>
+
+typedef NS_ENUM(NSUInteger, ShaderVariant) {
+    ShaderVariantOpaque = 0,
+    ShaderVariantTransparent,       // Program set not opaque, drawn blended.
+};
+
+typedef struct {
+    NSUInteger programs;            // Shared programs built.
+    NSUInteger functions;           // Metal functions looked up.
+    NSUInteger hits;                // Lookups answered from the cache.
+    NSUInteger misses;              // Built on first lookup, since warm-up hadn't got to them.
+    double buildMs;                 // Spent building programs, reading sources and looking up functions.
+    double pipelineMs;              // Spent building StereoRenderer pipelines.
+    double prepareMs;               // SceneKit preparing the warm-up programs, 0 until done.
+    double warmUpMs;                // Start of warm-up to SceneKit done, 0 until done.
+    BOOL warmedUp;
+} ShaderCacheStats;
+
+@interface ShaderCache : NSObject
+
+/// Singleton.
++ (ShaderCache *) main;
+
+/// Shared program for the GL shader pair named like programWithGLShader: takes it.
+- (SCNProgram *) glProgramNamed:(NSString *)shaderName variant:(ShaderVariant)variant;
+
+/// Shared program for a pair of OpenBE.metal functions.
+- (SCNProgram *) metalProgramWithVertexFunctionName:(NSString *)vertexName
+                               fragmentFunctionName:(NSString *)fragmentName
+                                            variant:(ShaderVariant)variant;
+
+/// Source of shaderName with extension "vsh" or "fsh", baked when available, read once.
+- (NSString *) glSourceNamed:(NSString *)shaderName extension:(NSString *)extension;
+
+/// Function from OpenBE.metal, looked up once. nil if there's none.
+- (id<MTLFunction>) metalFunctionNamed:(NSString *)name;
+
+/**
+ * Build all OpenBE programs for renderingAPI on a background queue, then have renderer prepare them.
+ * Only the first call does anything.
+ * @param completion Called on the main queue once SceneKit is done, may be nil.
+ */
+- (void) warmUpWithRenderer:(id<SCNSceneRenderer>)renderer
+               renderingAPI:(BEViewRenderingAPI)renderingAPI
+                 completion:(void (^)(void))completion;
+
+/// Milliseconds each program, source, function or pipeline took to build, by key.
+- (NSDictionary<NSString *, NSNumber *> *) buildTimes;
+
+- (ShaderCacheStats) stats;
+
+@end
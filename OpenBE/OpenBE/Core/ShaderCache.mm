@@ -0,0 +1,309 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "ShaderCache.h"
+#import "StereoRenderer.h"
+#import "BakedAssetLibrary.h"
+#import "../Utils/SceneKitExtensions.h"
+
+#include <mach/mach_time.h>
+#include <mutex>
+
+namespace {
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    // GL programs OpenBE components draw with. Keep in step with the components.
+    struct WarmUpGLProgram {
+        const char *shaderName;
+        ShaderVariant variant;
+        SCNBlendMode blendMode;
+    };
+
+    const WarmUpGLProgram WarmUpGLPrograms[] = {
+        { "Shaders/CombinedShader/combinedShader", ShaderVariantTransparent, SCNBlendModeAlpha },
+        { "Shaders/CombinedShader/combinedShader", ShaderVariantTransparent, SCNBlendModeAdd },
+        { "Shaders/CombinedShader/combinedShader", ShaderVariantTransparent, SCNBlendModeReplace },
+    };
+
+    // How the StereoRenderer draws a Metal program, if at all.
+    enum WarmUpStereo {
+        WarmUpStereoNone = 0,
+        WarmUpStereoGeometry,       // A node's geometry, with its SCNProgram as fallback.
+        WarmUpStereoProcedural,     // Instanced variants only, no SCNProgram.
+    };
+
+    // Metal programs OpenBE components draw with.
+    struct WarmUpMetalProgram {
+        const char *vertexName;
+        const char *fragmentName;
+        ShaderVariant variant;
+        SCNBlendMode blendMode;
+        WarmUpStereo stereo;
+    };
+
+    const WarmUpMetalProgram WarmUpMetalPrograms[] = {
+        { "OBEBeamVertex", "OBEBeamFragment", ShaderVariantTransparent, SCNBlendModeAdd, WarmUpStereoProcedural },
+        { "OBEEnvironmentVertex", "OBEEnvironmentFragment", ShaderVariantTransparent, SCNBlendModeAlpha, WarmUpStereoProcedural },
+        { "OBEFixedSizeReticleVertex", "OBEFixedSizeReticleFragment", ShaderVariantTransparent, SCNBlendModeAlpha, WarmUpStereoGeometry },
+        { "OBEProjectionVertex", "OBEProjectionFragment", ShaderVariantTransparent, SCNBlendModeAlpha, WarmUpStereoNone },
+    };
+
+    // Drawn by Bridge Engine through ScanEnvironmentShader, which only takes the sources and functions.
+    const char *WarmUpEnvironmentShader = "Shaders/ScanEnvironment/scanEnvironmentShader";
+    const char *WarmUpEnvironmentFunctions[] = { "OBEScanEnvironmentVertex", "OBEScanEnvironmentFragment" };
+
+    // Built into pipelines by the EnvironmentTexturer itself.
+    const char *WarmUpEnvironmentTexturingFunctions[] = { "OBEEnvironmentDepthVertex", "OBEEnvironmentAccumulate" };
+
+} // anonymous
+
+@implementation ShaderCache
+{
+    std::mutex _mutex;
+    NSMutableDictionary<NSString *, SCNProgram *> *_programs;
+    NSMutableDictionary<NSString *, NSString *> *_sources;
+    NSMutableDictionary<NSString *, id> *_functions;     // NSNull for names OpenBE.metal doesn't have.
+    NSMutableDictionary<NSString *, NSNumber *> *_buildTimes;
+    BOOL _warmingUp;
+    ShaderCacheStats _stats;
+}
+
++ (ShaderCache *) main {
+    static ShaderCache *mainShaderCache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainShaderCache = [[ShaderCache alloc] init];
+    });
+
+    return mainShaderCache;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _programs = [NSMutableDictionary dictionary];
+        _sources = [NSMutableDictionary dictionary];
+        _functions = [NSMutableDictionary dictionary];
+        _buildTimes = [NSMutableDictionary dictionary];
+        _stats = ShaderCacheStats();
+    }
+    return self;
+}
+
+#pragma mark - Lookups
+
+// Call with _mutex held.
+- (void) recordBuild:(NSString *)key since:(uint64_t)start {
+    double ms = machTicksToMs(mach_absolute_time() - start);
+    _buildTimes[key] = @(ms);
+    _stats.buildMs += ms;
+    if( !_warmingUp ) _stats.misses++;
+}
+
+- (NSString *) glSourceNamed:(NSString *)shaderName extension:(NSString *)extension {
+    NSString *key = [NSString stringWithFormat:@"%@.%@", shaderName, extension];
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    NSString *source = _sources[key];
+    if( source ) {
+        _stats.hits++;
+        return source;
+    }
+
+    uint64_t start = mach_absolute_time();
+
+    NSString *vertexSource = nil, *fragmentSource = nil;
+    if( [[BakedAssetLibrary main] shaderNamed:shaderName vertexSource:&vertexSource fragmentSource:&fragmentSource] ) {
+        _sources[[shaderName stringByAppendingString:@".vsh"]] = vertexSource;
+        _sources[[shaderName stringByAppendingString:@".fsh"]] = fragmentSource;
+        source = _sources[key];
+    } else {
+        NSURL *url = [SceneKit URLForResource:shaderName withExtension:extension];
+        source = url ? [[NSString alloc] initWithContentsOfURL:url encoding:NSUTF8StringEncoding error:NULL] : nil;
+        if( source ) {
+            _sources[key] = source;
+        } else {
+            NSLog(@"ShaderCache: === Error === Can't read shader %@", key);
+        }
+    }
+
+    [self recordBuild:key since:start];
+    return source;
+}
+
+- (id<MTLFunction>) metalFunctionNamed:(NSString *)name {
+    id<MTLLibrary> library = [SCNProgram openbeMetalLibrary];
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    id function = _functions[name];
+    if( function ) {
+        _stats.hits++;
+        return function == [NSNull null] ? nil : function;
+    }
+
+    uint64_t start = mach_absolute_time();
+    function = [library newFunctionWithName:name];
+    _functions[name] = function ?: [NSNull null];
+    _stats.functions = _functions.count;
+    [self recordBuild:name since:start];
+    return function;
+}
+
+- (SCNProgram *) glProgramNamed:(NSString *)shaderName variant:(ShaderVariant)variant {
+    NSString *key = [NSString stringWithFormat:@"gl:%@#%lu", shaderName, (unsigned long)variant];
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        SCNProgram *program = _programs[key];
+        if( program ) {
+            _stats.hits++;
+            return program;
+        }
+    }
+
+    // Sources are cached on their own, outside the lock.
+    uint64_t start = mach_absolute_time();
+    SCNProgram *program = [SCNProgram programWithGLShader:shaderName];
+    [program setOpaque:variant == ShaderVariantOpaque];
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if( _programs[key] ) return _programs[key];     // Built by another thread meanwhile.
+    _programs[key] = program;
+    _stats.programs = _programs.count;
+    [self recordBuild:key since:start];
+    return program;
+}
+
+- (SCNProgram *) metalProgramWithVertexFunctionName:(NSString *)vertexName
+                               fragmentFunctionName:(NSString *)fragmentName
+                                            variant:(ShaderVariant)variant {
+    NSString *key = [NSString stringWithFormat:@"metal:%@:%@#%lu", vertexName, fragmentName, (unsigned long)variant];
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        SCNProgram *program = _programs[key];
+        if( program ) {
+            _stats.hits++;
+            return program;
+        }
+    }
+
+    uint64_t start = mach_absolute_time();
+    SCNProgram *program = [SCNProgram openbeMetalProgramWithVertexFunctionName:vertexName
+                                                          fragmentFunctionName:fragmentName];
+    [program setOpaque:variant == ShaderVariantOpaque];
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if( _programs[key] ) return _programs[key];
+    _programs[key] = program;
+    _stats.programs = _programs.count;
+    [self recordBuild:key since:start];
+    return program;
+}
+
+#pragma mark - Warm-up
+
+- (void) warmUpWithRenderer:(id<SCNSceneRenderer>)renderer
+               renderingAPI:(BEViewRenderingAPI)renderingAPI
+                 completion:(void (^)(void))completion {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( _warmingUp || _stats.warmedUp ) return;
+        _warmingUp = YES;
+    }
+
+    uint64_t start = mach_absolute_time();
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        NSMutableArray<SCNNode *> *nodes = [NSMutableArray array];
+        void (^addNode)(SCNProgram *, SCNBlendMode) = ^(SCNProgram *program, SCNBlendMode blendMode) {
+            SCNMaterial *material = [SCNMaterial material];
+            material.program = program;
+            material.blendMode = blendMode;
+            material.doubleSided = YES;
+
+            SCNGeometry *geometry = [SCNPlane planeWithWidth:0.01 height:0.01];
+            geometry.materials = @[material];
+            [nodes addObject:[SCNNode nodeWithGeometry:geometry]];
+        };
+
+        if( renderingAPI == BEViewRenderingAPIMetal ) {
+            for( const WarmUpMetalProgram &entry : WarmUpMetalPrograms ) {
+                NSString *vertexName = @(entry.vertexName);
+                NSString *fragmentName = @(entry.fragmentName);
+                if( entry.stereo != WarmUpStereoProcedural ) {
+                    addNode([self metalProgramWithVertexFunctionName:vertexName fragmentFunctionName:fragmentName variant:entry.variant],
+                            entry.blendMode);
+                }
+
+                if( entry.stereo != WarmUpStereoNone ) {
+                    uint64_t pipelineStart = mach_absolute_time();
+                    [[StereoRenderer main] warmUpVertexFunctionName:vertexName
+                                               fragmentFunctionName:fragmentName
+                                                          blendMode:entry.blendMode
+                                                         procedural:entry.stereo == WarmUpStereoProcedural
+                                                           renderer:renderer];
+                    double ms = machTicksToMs(mach_absolute_time() - pipelineStart);
+
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _buildTimes[[NSString stringWithFormat:@"stereo:%@:%@", vertexName, fragmentName]] = @(ms);
+                    _stats.pipelineMs += ms;
+                }
+            }
+            for( const char *name : WarmUpEnvironmentFunctions ) {
+                [self metalFunctionNamed:@(name)];
+            }
+            for( const char *name : WarmUpEnvironmentTexturingFunctions ) {
+                [self metalFunctionNamed:@(name)];
+            }
+        } else {
+            for( const WarmUpGLProgram &entry : WarmUpGLPrograms ) {
+                addNode([self glProgramNamed:@(entry.shaderName) variant:entry.variant], entry.blendMode);
+            }
+            [self glSourceNamed:@(WarmUpEnvironmentShader) extension:@"vsh"];
+            [self glSourceNamed:@(WarmUpEnvironmentShader) extension:@"fsh"];
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _warmingUp = NO;
+        }
+
+        // SceneKit compiles the programs for its renderer in its own background work.
+        uint64_t prepareStart = mach_absolute_time();
+        [renderer prepareObjects:nodes withCompletionHandler:^(BOOL success) {
+            uint64_t end = mach_absolute_time();
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stats.prepareMs = machTicksToMs(end - prepareStart);
+                _stats.warmUpMs = machTicksToMs(end - start);
+                _stats.warmedUp = YES;
+            }
+
+            ShaderCacheStats stats = [self stats];
+            NSLog(@"ShaderCache: Warmed up %lu programs, %lu functions in %0.2f ms (build %0.2f ms, pipelines %0.2f ms, SceneKit %0.2f ms)%@",
+                  (unsigned long)stats.programs, (unsigned long)stats.functions, stats.warmUpMs,
+                  stats.buildMs, stats.pipelineMs, stats.prepareMs, success ? @"" : @", SceneKit failed to prepare some");
+
+            if( completion ) dispatch_async(dispatch_get_main_queue(), completion);
+        }];
+    });
+}
+
+- (NSDictionary<NSString *, NSNumber *> *) buildTimes {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return [_buildTimes copy];
+}
+
+- (ShaderCacheStats) stats {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+@end
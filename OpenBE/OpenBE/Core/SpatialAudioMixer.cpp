@@ -0,0 +1,700 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#include "SpatialAudioMixer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define SPATIAL_AUDIO_NEON 1
+#elif defined(__SSE__) || defined(_M_X64)
+#  include <xmmintrin.h>
+#  define SPATIAL_AUDIO_SSE 1
+#endif
+
+namespace {
+
+    // Must be a power of two.
+    const size_t kCommandCapacity = 1024;
+    const size_t kCommandMask = kCommandCapacity - 1;
+
+    // Longest interaural delay, in samples, at up to 96kHz.
+    const int kHistoryFrames = 64;
+
+    // Freeverb tunings at 44.1kHz.
+    const int kCombLengths[4] = { 1116, 1188, 1277, 1356 };
+    const int kAllpassLengths[2] = { 556, 441 };
+    const int kStereoSpread = 23;
+    const float kCombFeedback = 0.84f;
+    const float kCombDamp = 0.2f;
+    const float kAllpassFeedback = 0.5f;
+    const float kReverbInputGain = 0.03f;
+
+    const float kPi = 3.14159265358979f;
+
+    using BE::SpatialAudioVector;
+
+    inline SpatialAudioVector sub (SpatialAudioVector a, SpatialAudioVector b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline float dot (SpatialAudioVector a, SpatialAudioVector b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline SpatialAudioVector cross (SpatialAudioVector a, SpatialAudioVector b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+    inline SpatialAudioVector normalize (SpatialAudioVector a)
+    {
+        float length = std::sqrt(dot(a, a));
+        return length > 0 ? SpatialAudioVector{ a.x / length, a.y / length, a.z / length } : a;
+    }
+
+    /**
+     * dst[i] += src[i] * gain, with gain ramping linearly from g0 to g1 over n samples.
+     */
+    inline void mixRamp (float* dst, const float* src, float g0, float g1, int n)
+    {
+        const float step = (g1 - g0) / n;
+        int i = 0;
+
+#if SPATIAL_AUDIO_NEON
+        float32x4_t gain = { g0, g0 + step, g0 + 2 * step, g0 + 3 * step };
+        const float32x4_t step4 = vdupq_n_f32(4 * step);
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t d = vld1q_f32(dst + i);
+            d = vmlaq_f32(d, vld1q_f32(src + i), gain);
+            vst1q_f32(dst + i, d);
+            gain = vaddq_f32(gain, step4);
+        }
+#elif SPATIAL_AUDIO_SSE
+        __m128 gain = _mm_setr_ps(g0, g0 + step, g0 + 2 * step, g0 + 3 * step);
+        const __m128 step4 = _mm_set1_ps(4 * step);
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 d = _mm_loadu_ps(dst + i);
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(src + i), gain));
+            _mm_storeu_ps(dst + i, d);
+            gain = _mm_add_ps(gain, step4);
+        }
+#endif
+
+        for (; i < n; i++)
+        {
+            dst[i] += src[i] * (g0 + step * i);
+        }
+    }
+
+    /**
+     * dst[i] = a[i] + b[i] * gain.
+     */
+    inline void addScaled (float* dst, const float* a, const float* b, float gain, int n)
+    {
+        int i = 0;
+
+#if SPATIAL_AUDIO_NEON
+        const float32x4_t g = vdupq_n_f32(gain);
+        for (; i + 4 <= n; i += 4)
+        {
+            vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(a + i), vld1q_f32(b + i), g));
+        }
+#elif SPATIAL_AUDIO_SSE
+        const __m128 g = _mm_set1_ps(gain);
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_mul_ps(_mm_loadu_ps(b + i), g)));
+        }
+#endif
+
+        for (; i < n; i++)
+        {
+            dst[i] = a[i] + b[i] * gain;
+        }
+    }
+
+} // anonymous
+
+namespace BE
+{
+
+#pragma mark - SpatialAudioMixer
+
+    SpatialAudioMixer::SpatialAudioMixer (const SpatialAudioSettings& settings)
+    : _settings (settings)
+    , _soundCount (0)
+    , _nextHandle (1)
+    , _enqueuePos (0)
+    , _dequeuePos (0)
+    , _blockRead (0)
+    , _renderedBlocks (0)
+    , _started (0)
+    , _stolen (0)
+    , _overflowed (0)
+    , _activeVoices (0)
+    {
+        _settings.blockFrames = std::max(16, _settings.blockFrames);
+        _settings.maxVoices = std::max(1, _settings.maxVoices);
+
+        const size_t blockFrames = (size_t)_settings.blockFrames;
+
+        _sounds.resize((size_t)std::max(1, _settings.maxSounds));
+        _voices.resize((size_t)_settings.maxVoices);
+        for (Voice& voice : _voices)
+        {
+            voice.dry.assign(kHistoryFrames + blockFrames, 0.f);
+        }
+
+        _commands = new CommandCell[kCommandCapacity];
+        for (size_t i = 0; i < kCommandCapacity; i++)
+        {
+            _commands[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        _blockLeft.assign(blockFrames, 0.f);
+        _blockRight.assign(blockFrames, 0.f);
+        _reverbIn.assign(blockFrames, 0.f);
+        _far.assign(blockFrames, 0.f);
+
+        // Nothing buffered yet, so the first render starts a block.
+        _blockRead = blockFrames;
+
+        const float scale = _settings.sampleRate / 44100.f;
+        for (int channel = 0; channel < 2; channel++)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                _combs[channel][i].buffer.assign((size_t)std::max(1.f, (kCombLengths[i] + channel * kStereoSpread) * scale), 0.f);
+            }
+            for (int i = 0; i < 2; i++)
+            {
+                _allpasses[channel][i].buffer.assign((size_t)std::max(1.f, (kAllpassLengths[i] + channel * kStereoSpread) * scale), 0.f);
+            }
+        }
+    }
+
+    SpatialAudioMixer::~SpatialAudioMixer ()
+    {
+        delete [] _commands;
+    }
+
+    int SpatialAudioMixer::addSound (const float* samples, size_t frameCount, float sampleRate)
+    {
+        int index = _soundCount.load(std::memory_order_relaxed);
+        if (index >= (int)_sounds.size() || samples == nullptr || frameCount == 0 || sampleRate <= 0)
+            return -1;
+
+        Sound& sound = _sounds[(size_t)index];
+        sound.samples.assign(samples, samples + frameCount);
+        sound.rate = sampleRate / _settings.sampleRate;
+
+        // Publish to the render thread.
+        _soundCount.store(index + 1, std::memory_order_release);
+        return index;
+    }
+
+    bool SpatialAudioMixer::post (const Command& command)
+    {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            CommandCell& cell = _commands[pos & kCommandMask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.command = command;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                _overflowed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    uint32_t SpatialAudioMixer::play (int sound, float volume, SpatialAudioVector position, float reverbSend, bool looping)
+    {
+        if (sound < 0 || sound >= _soundCount.load(std::memory_order_acquire))
+            return 0;
+
+        uint32_t handle = _nextHandle.fetch_add(1, std::memory_order_relaxed);
+        if (handle == 0)
+            handle = _nextHandle.fetch_add(1, std::memory_order_relaxed);
+
+        Command command = {};
+        command.type = CommandPlay;
+        command.voice = handle;
+        command.sound = sound;
+        command.volume = volume;
+        command.send = reverbSend;
+        command.looping = looping;
+        command.position = position;
+        return post(command) ? handle : 0;
+    }
+
+    void SpatialAudioMixer::stop (uint32_t voice)
+    {
+        Command command = {};
+        command.type = CommandStop;
+        command.voice = voice;
+        post(command);
+    }
+
+    void SpatialAudioMixer::setVoicePosition (uint32_t voice, SpatialAudioVector position)
+    {
+        Command command = {};
+        command.type = CommandPosition;
+        command.voice = voice;
+        command.position = position;
+        post(command);
+    }
+
+    void SpatialAudioMixer::setListener (SpatialAudioVector position, SpatialAudioVector forward, SpatialAudioVector up)
+    {
+        Command command = {};
+        command.type = CommandListener;
+        command.position = position;
+        command.forward = forward;
+        command.up = up;
+        post(command);
+    }
+
+    SpatialAudioMixer::Voice* SpatialAudioMixer::findVoice (uint32_t handle)
+    {
+        if (handle == 0)
+            return nullptr;
+
+        for (Voice& voice : _voices)
+        {
+            if (voice.handle == handle)
+                return &voice;
+        }
+        return nullptr;
+    }
+
+    void SpatialAudioMixer::drainCommands ()
+    {
+        const uint64_t block = _renderedBlocks.load(std::memory_order_relaxed);
+
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            CommandCell& cell = _commands[pos & kCommandMask];
+            if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+                break;
+
+            Command command = cell.command;
+            cell.sequence.store(pos + kCommandCapacity, std::memory_order_release);
+            pos++;
+
+            switch (command.type)
+            {
+                case CommandPlay:
+                {
+                    // Free voice, or steal the oldest.
+                    Voice* target = nullptr;
+                    for (Voice& voice : _voices)
+                    {
+                        if (voice.handle == 0) { target = &voice; break; }
+                        if (target == nullptr || voice.startBlock < target->startBlock) target = &voice;
+                    }
+                    if (target->handle != 0)
+                        _stolen.fetch_add(1, std::memory_order_relaxed);
+
+                    Voice& voice = *target;
+                    voice.handle = command.voice;
+                    voice.sound = command.sound;
+                    voice.looping = command.looping;
+                    voice.volume = command.volume;
+                    voice.send = command.send;
+                    voice.position = command.position;
+                    voice.readPosition = 0;
+                    voice.startBlock = block;
+                    voice.primed = false;
+                    voice.farState = 0;
+                    std::fill(voice.dry.begin(), voice.dry.begin() + kHistoryFrames, 0.f);
+                    _started.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+                case CommandStop:
+                    if (Voice* voice = findVoice(command.voice))
+                        voice->handle = 0;
+                    break;
+                case CommandPosition:
+                    if (Voice* voice = findVoice(command.voice))
+                        voice->position = command.position;
+                    break;
+                case CommandListener:
+                    _listenerPosition = command.position;
+                    _listenerForward = normalize(command.forward);
+                    _listenerUp = normalize(command.up);
+                    break;
+            }
+        }
+        _dequeuePos.store(pos, std::memory_order_relaxed);
+    }
+
+    void SpatialAudioMixer::render (float* left, float* right, size_t frameCount)
+    {
+        const size_t blockFrames = (size_t)_settings.blockFrames;
+
+        size_t written = 0;
+        while (written < frameCount)
+        {
+            if (_blockRead == blockFrames)
+            {
+                renderBlock();
+                _blockRead = 0;
+            }
+
+            size_t count = std::min(frameCount - written, blockFrames - _blockRead);
+            std::memcpy(left + written, _blockLeft.data() + _blockRead, count * sizeof(float));
+            std::memcpy(right + written, _blockRight.data() + _blockRead, count * sizeof(float));
+            _blockRead += count;
+            written += count;
+        }
+    }
+
+    void SpatialAudioMixer::renderBlock ()
+    {
+        drainCommands();
+
+        std::fill(_blockLeft.begin(), _blockLeft.end(), 0.f);
+        std::fill(_blockRight.begin(), _blockRight.end(), 0.f);
+        std::fill(_reverbIn.begin(), _reverbIn.end(), 0.f);
+
+        uint32_t active = 0;
+        for (Voice& voice : _voices)
+        {
+            if (voice.handle == 0)
+                continue;
+
+            renderVoice(voice);
+            if (voice.handle != 0)
+                active++;
+        }
+
+        renderReverb();
+
+        _activeVoices.store(active, std::memory_order_relaxed);
+        _renderedBlocks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void SpatialAudioMixer::renderVoice (Voice& voice)
+    {
+        const int blockFrames = _settings.blockFrames;
+        const float blockSeconds = blockFrames / _settings.sampleRate;
+        const Sound& sound = _sounds[(size_t)voice.sound];
+        const float* samples = sound.samples.data();
+        const double length = (double)sound.samples.size();
+
+        // Listener space: x right, y up, z forward.
+        SpatialAudioVector relative = sub(voice.position, _listenerPosition);
+        SpatialAudioVector listenerRight = normalize(cross(_listenerForward, _listenerUp));
+        float distance = std::sqrt(dot(relative, relative));
+        float lateral = distance > 1e-4f ? dot(relative, listenerRight) / distance : 0.f;   // sin(azimuth)
+
+        // Inverse distance attenuation.
+        const float reference = _settings.referenceDistance;
+        float clamped = std::min(std::max(distance, reference), _settings.maxDistance);
+        float attenuation = voice.volume * reference / (reference + _settings.rolloffFactor * (clamped - reference));
+
+        // Equal power pan.
+        float pan = (lateral + 1.f) * 0.25f * kPi;
+        float gainLeft = attenuation * std::cos(pan);
+        float gainRight = attenuation * std::sin(pan);
+        float gainSend = attenuation * voice.send;
+
+        // Spherical head: Woodworth interaural delay, and a one pole head shadow on the far ear
+        // closing from 20kHz straight ahead down to about 2kHz at 90 degrees.
+        float azimuth = std::asin(std::min(1.f, std::fabs(lateral)));
+        int delay = std::min(kHistoryFrames - 1, (int)std::lround(_settings.headRadius / _settings.speedOfSound * (azimuth + std::sin(azimuth)) * _settings.sampleRate));
+        float cutoff = 20000.f - 18000.f * std::fabs(lateral);
+        float farCoefficient = 1.f - std::exp(-2.f * kPi * cutoff / _settings.sampleRate);
+
+        // Doppler from the change in distance since last block.
+        float rate = sound.rate;
+        if (voice.primed && _settings.dopplerFactor > 0)
+        {
+            float radialVelocity = (distance - voice.distance) / blockSeconds * _settings.dopplerFactor;
+            float c = _settings.speedOfSound;
+            radialVelocity = std::min(std::max(radialVelocity, -0.5f * c), 0.5f * c);
+            rate *= c / (c + radialVelocity);
+        }
+
+        if (!voice.primed)
+        {
+            voice.gainLeft = gainLeft;
+            voice.gainRight = gainRight;
+            voice.gainSend = gainSend;
+            voice.primed = true;
+        }
+        voice.distance = distance;
+
+        // Resample the source into the dry buffer, after the delay history.
+        float* dry = voice.dry.data() + kHistoryFrames;
+        double read = voice.readPosition;
+        bool finished = false;
+        for (int i = 0; i < blockFrames; i++)
+        {
+            if (read >= length - 1)
+            {
+                if (voice.looping && length > 1)
+                {
+                    read = std::fmod(read, length - 1);
+                }
+                else
+                {
+                    std::fill(dry + i, dry + blockFrames, 0.f);
+                    finished = true;
+                    break;
+                }
+            }
+
+            size_t index = (size_t)read;
+            float fraction = (float)(read - index);
+            dry[i] = samples[index] + (samples[index + 1] - samples[index]) * fraction;
+            read += rate;
+        }
+        voice.readPosition = read;
+
+        // Far ear: delayed, and low passed.
+        float state = voice.farState;
+        const float* delayed = dry - delay;
+        float* far = _far.data();
+        for (int i = 0; i < blockFrames; i++)
+        {
+            state += farCoefficient * (delayed[i] - state);
+            far[i] = state;
+        }
+        voice.farState = state;
+
+        const bool farIsLeft = lateral > 0;
+        mixRamp(_blockLeft.data(), farIsLeft ? far : dry, voice.gainLeft, gainLeft, blockFrames);
+        mixRamp(_blockRight.data(), farIsLeft ? dry : far, voice.gainRight, gainRight, blockFrames);
+        mixRamp(_reverbIn.data(), dry, voice.gainSend, gainSend, blockFrames);
+
+        voice.gainLeft = gainLeft;
+        voice.gainRight = gainRight;
+        voice.gainSend = gainSend;
+
+        // Keep the tail for next block's delay.
+        std::memmove(voice.dry.data(), voice.dry.data() + blockFrames, kHistoryFrames * sizeof(float));
+
+        if (finished)
+            voice.handle = 0;
+    }
+
+    void SpatialAudioMixer::renderReverb ()
+    {
+        const int blockFrames = _settings.blockFrames;
+        const float* in = _reverbIn.data();
+        float* wet = _far.data();
+
+        for (int channel = 0; channel < 2; channel++)
+        {
+            for (int i = 0; i < blockFrames; i++)
+            {
+                float input = in[i] * kReverbInputGain;
+                float out = 0;
+
+                for (DelayLine& comb : _combs[channel])
+                {
+                    float delayed = comb.buffer[comb.index];
+                    comb.state = delayed * (1.f - kCombDamp) + comb.state * kCombDamp;
+                    comb.buffer[comb.index] = input + comb.state * kCombFeedback;
+                    if (++comb.index == comb.buffer.size()) comb.index = 0;
+                    out += delayed;
+                }
+
+                for (DelayLine& allpass : _allpasses[channel])
+                {
+                    float delayed = allpass.buffer[allpass.index];
+                    allpass.buffer[allpass.index] = out + delayed * kAllpassFeedback;
+                    if (++allpass.index == allpass.buffer.size()) allpass.index = 0;
+                    out = delayed - out;
+                }
+
+                wet[i] = out;
+            }
+
+            float* dst = channel == 0 ? _blockLeft.data() : _blockRight.data();
+            addScaled(dst, dst, wet, _settings.reverbBlend, blockFrames);
+        }
+    }
+
+    SpatialAudioStats SpatialAudioMixer::stats () const
+    {
+        SpatialAudioStats stats;
+        stats.renderedBlocks = _renderedBlocks.load(std::memory_order_relaxed);
+        stats.started = _started.load(std::memory_order_relaxed);
+        stats.stolen = _stolen.load(std::memory_order_relaxed);
+        stats.overflowed = _overflowed.load(std::memory_order_relaxed);
+        stats.activeVoices = _activeVoices.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+#pragma mark - SpatialAudioWavWriter
+
+    namespace
+    {
+        void writeLE32 (FILE* file, uint32_t value)
+        {
+            uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+            fwrite(bytes, 1, 4, file);
+        }
+
+        void writeLE16 (FILE* file, uint16_t value)
+        {
+            uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+            fwrite(bytes, 1, 2, file);
+        }
+    }
+
+    bool SpatialAudioWavWriter::open (const char* path, int sampleRate)
+    {
+        close();
+
+        _file = fopen(path, "wb");
+        if (_file == nullptr)
+            return false;
+
+        _frames = 0;
+
+        // Sizes are patched in close.
+        fwrite("RIFF", 1, 4, _file);
+        writeLE32(_file, 0);
+        fwrite("WAVEfmt ", 1, 8, _file);
+        writeLE32(_file, 16);
+        writeLE16(_file, 1);                        // PCM
+        writeLE16(_file, 2);                        // Stereo
+        writeLE32(_file, (uint32_t)sampleRate);
+        writeLE32(_file, (uint32_t)sampleRate * 4); // Byte rate
+        writeLE16(_file, 4);                        // Block align
+        writeLE16(_file, 16);                       // Bits per sample
+        fwrite("data", 1, 4, _file);
+        writeLE32(_file, 0);
+        return true;
+    }
+
+    void SpatialAudioWavWriter::write (const float* left, const float* right, size_t frameCount)
+    {
+        if (_file == nullptr)
+            return;
+
+        _interleaved.resize(frameCount * 2);
+        for (size_t i = 0; i < frameCount; i++)
+        {
+            _interleaved[i * 2 + 0] = (int16_t)std::lround(std::min(1.f, std::max(-1.f, left[i])) * 32767.f);
+            _interleaved[i * 2 + 1] = (int16_t)std::lround(std::min(1.f, std::max(-1.f, right[i])) * 32767.f);
+        }
+
+        // Samples are written little endian, as every platform we build for is.
+        fwrite(_interleaved.data(), sizeof(int16_t), _interleaved.size(), _file);
+        _frames += (uint32_t)frameCount;
+    }
+
+    bool SpatialAudioWavWriter::close ()
+    {
+        if (_file == nullptr)
+            return false;
+
+        uint32_t dataBytes = _frames * 4;
+        fseek(_file, 4, SEEK_SET);
+        writeLE32(_file, 36 + dataBytes);
+        fseek(_file, 40, SEEK_SET);
+        writeLE32(_file, dataBytes);
+
+        bool ok = ferror(_file) == 0;
+        fclose(_file);
+        _file = nullptr;
+        return ok;
+    }
+
+    bool renderSpatialAudioToWav (SpatialAudioMixer& mixer, const char* path, double seconds, size_t hostFrames)
+    {
+        const int sampleRate = (int)mixer.settings().sampleRate;
+
+        SpatialAudioWavWriter writer;
+        if (!writer.open(path, sampleRate))
+            return false;
+
+        std::vector<float> left(hostFrames), right(hostFrames);
+        size_t remaining = (size_t)(seconds * sampleRate);
+        while (remaining > 0)
+        {
+            size_t count = std::min(remaining, hostFrames);
+            mixer.render(left.data(), right.data(), count);
+            writer.write(left.data(), right.data(), count);
+            remaining -= count;
+        }
+
+        return writer.close();
+    }
+
+#pragma mark - Benchmark
+
+    SpatialAudioBenchmarkResult benchmarkSpatialAudioMixer (int voiceCount, double seconds)
+    {
+        SpatialAudioSettings settings;
+        settings.maxVoices = voiceCount;
+        SpatialAudioMixer mixer(settings);
+
+        // A second of a decaying 440Hz tone, looped.
+        std::vector<float> tone((size_t)settings.sampleRate);
+        for (size_t i = 0; i < tone.size(); i++)
+        {
+            float t = i / settings.sampleRate;
+            tone[i] = 0.25f * std::sin(2.f * kPi * 440.f * t) * std::exp(-3.f * t);
+        }
+        int sound = mixer.addSound(tone.data(), tone.size(), settings.sampleRate);
+
+        std::vector<uint32_t> voices((size_t)voiceCount);
+        for (int v = 0; v < voiceCount; v++)
+        {
+            float angle = 2.f * kPi * v / voiceCount;
+            voices[(size_t)v] = mixer.play(sound, 1.f, { 3.f * std::cos(angle), 0.f, 3.f * std::sin(angle) }, 0.5f, true);
+        }
+
+        const size_t hostFrames = 512;
+        std::vector<float> left(hostFrames), right(hostFrames);
+        size_t chunks = (size_t)(seconds * settings.sampleRate / hostFrames);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            // Orbit the voices, so distance, panning and doppler all change.
+            float phase = chunk * hostFrames / settings.sampleRate;
+            for (int v = 0; v < voiceCount; v++)
+            {
+                float angle = 2.f * kPi * v / voiceCount + phase;
+                float radius = 3.f + 2.f * std::sin(phase * 2.f + v);
+                mixer.setVoicePosition(voices[(size_t)v], { radius * std::cos(angle), 0.f, radius * std::sin(angle) });
+            }
+            mixer.render(left.data(), right.data(), hostFrames);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        SpatialAudioBenchmarkResult result;
+        result.voiceCount = voiceCount;
+        result.audioSeconds = chunks * hostFrames / (double)settings.sampleRate;
+        result.renderSeconds = std::chrono::duration<double>(end - start).count();
+        uint64_t blocks = std::max<uint64_t>(1, mixer.stats().renderedBlocks);
+        result.msPerBlock = result.renderSeconds * 1000.0 / blocks;
+        result.realtimeFactor = result.renderSeconds > 0 ? result.audioSeconds / result.renderSeconds : 0;
+        return result;
+    }
+
+} // BE
@@ -0,0 +1,233 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Portable software spatial audio mixer, in plain C++ with no Apple dependencies,
+//  so mixing cost and output can be measured off-device.
+//
+//  Each voice gets inverse distance attenuation, equal power panning plus a
+//  spherical head model (interaural delay and head shadow filter on the far ear),
+//  doppler from its radial velocity, and a send into a shared stereo reverb.
+//
+//  Rendering is done in fixed size blocks, whatever frame count the output asks
+//  for, and is real-time safe: render never allocates, locks or blocks. Control
+//  calls (play, stop, positions, listener) go through a lock-free command ring and
+//  take effect at the start of the next block.
+//
+//  Output backends pull from render: SpatialAudioMixerUnit for AVAudioEngine, and
+//  SpatialAudioWavWriter / renderSpatialAudioToWav for offline rendering.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace BE
+{
+
+    struct SpatialAudioVector
+    {
+        float x, y, z;
+    };
+
+    struct SpatialAudioSettings
+    {
+        float sampleRate = 44100.f;
+        int blockFrames = 256;          // Fixed render block size.
+        int maxVoices = 64;
+        int maxSounds = 256;
+
+        // Inverse distance attenuation, like AVAudioEnvironmentNode's default model.
+        float referenceDistance = 1.f;
+        float maxDistance = 100.f;
+        float rolloffFactor = 1.f;
+
+        float speedOfSound = 343.f;     // m/s, for doppler and interaural delay.
+        float dopplerFactor = 1.f;      // 0 disables doppler.
+        float headRadius = 0.0875f;     // m, spherical head model.
+
+        float reverbBlend = 0.5f;       // Wet level of the shared reverb.
+    };
+
+    struct SpatialAudioStats
+    {
+        uint64_t renderedBlocks;
+        uint64_t started;               // Voices started.
+        uint64_t stolen;                // Voices cut short to start another.
+        uint64_t overflowed;            // Commands lost to a full ring.
+        uint32_t activeVoices;          // Voices playing after the last block.
+    };
+
+    class SpatialAudioMixer
+    {
+    public:
+        explicit SpatialAudioMixer (const SpatialAudioSettings& settings = SpatialAudioSettings());
+        ~SpatialAudioMixer ();
+
+        SpatialAudioMixer (const SpatialAudioMixer&) = delete;
+        SpatialAudioMixer& operator= (const SpatialAudioMixer&) = delete;
+
+        const SpatialAudioSettings& settings () const { return _settings; }
+
+    public: // Control. Any thread, except addSound.
+
+        // Copy in mono samples at sampleRate. Allocates, so call before or between renders
+        // from one thread. Returns the sound index, or -1 when full.
+        int addSound (const float* samples, size_t frameCount, float sampleRate);
+
+        // Start a sound at a world position. Returns the voice handle, or 0 if the ring was full.
+        // When every voice is busy the oldest one is stolen.
+        uint32_t play (int sound, float volume, SpatialAudioVector position, float reverbSend = 1.f, bool looping = false);
+
+        void stop (uint32_t voice);
+        void setVoicePosition (uint32_t voice, SpatialAudioVector position);
+        void setListener (SpatialAudioVector position, SpatialAudioVector forward, SpatialAudioVector up);
+
+    public: // Render thread.
+
+        // Fill frameCount non-interleaved stereo frames.
+        void render (float* left, float* right, size_t frameCount);
+
+        SpatialAudioStats stats () const;
+
+    private:
+        enum CommandType : uint8_t { CommandPlay, CommandStop, CommandPosition, CommandListener };
+
+        struct Command
+        {
+            CommandType type;
+            bool looping;
+            uint32_t voice;
+            int sound;
+            float volume;
+            float send;
+            SpatialAudioVector position;
+            SpatialAudioVector forward;
+            SpatialAudioVector up;
+        };
+
+        struct CommandCell
+        {
+            std::atomic<size_t> sequence;
+            Command command;
+        };
+
+        struct Sound
+        {
+            std::vector<float> samples;
+            float rate;                 // Sound samples per output frame.
+        };
+
+        struct Voice
+        {
+            uint32_t handle = 0;        // 0 when free.
+            int sound = 0;
+            bool looping = false;
+            float volume = 0;
+            float send = 0;
+            SpatialAudioVector position = {0, 0, 0};
+            double readPosition = 0;
+            uint64_t startBlock = 0;
+
+            // Carried between blocks, for ramps and doppler.
+            bool primed = false;
+            float gainLeft = 0, gainRight = 0, gainSend = 0;
+            float distance = 0;
+            float farState = 0;         // Head shadow filter.
+
+            // History for the interaural delay, followed by this block's dry samples.
+            std::vector<float> dry;
+        };
+
+        bool post (const Command& command);
+        void drainCommands ();
+        Voice* findVoice (uint32_t handle);
+        void renderBlock ();
+        void renderVoice (Voice& voice);
+        void renderReverb ();
+
+    private:
+        SpatialAudioSettings _settings;
+
+        std::vector<Sound> _sounds;
+        std::atomic<int> _soundCount;
+
+        std::vector<Voice> _voices;
+        std::atomic<uint32_t> _nextHandle;
+
+        SpatialAudioVector _listenerPosition = {0, 0, 0};
+        SpatialAudioVector _listenerForward = {0, 0, -1};
+        SpatialAudioVector _listenerUp = {0, 1, 0};
+
+        CommandCell* _commands;
+        std::atomic<size_t> _enqueuePos;
+        std::atomic<size_t> _dequeuePos;
+
+        // Block buffers, allocated up front.
+        std::vector<float> _blockLeft, _blockRight;
+        std::vector<float> _reverbIn;
+        std::vector<float> _far;
+        size_t _blockRead;
+
+        // Reverb: parallel damped combs into series allpasses, per channel.
+        struct DelayLine
+        {
+            std::vector<float> buffer;
+            size_t index = 0;
+            float state = 0;
+        };
+        DelayLine _combs[2][4];
+        DelayLine _allpasses[2][2];
+
+        std::atomic<uint64_t> _renderedBlocks;
+        std::atomic<uint64_t> _started;
+        std::atomic<uint64_t> _stolen;
+        std::atomic<uint64_t> _overflowed;
+        std::atomic<uint32_t> _activeVoices;
+    };
+
+    /**
+     * 16-bit stereo PCM WAV file output.
+     */
+    class SpatialAudioWavWriter
+    {
+    public:
+        SpatialAudioWavWriter () {}
+        ~SpatialAudioWavWriter () { close(); }
+
+        bool open (const char* path, int sampleRate);
+        void write (const float* left, const float* right, size_t frameCount);
+        bool close ();
+
+    private:
+        FILE* _file = nullptr;
+        uint32_t _frames = 0;
+        std::vector<int16_t> _interleaved;
+    };
+
+    /// Render seconds of the mixer's output into a WAV file, pulling hostFrames at a time.
+    bool renderSpatialAudioToWav (SpatialAudioMixer& mixer, const char* path, double seconds, size_t hostFrames = 512);
+
+    struct SpatialAudioBenchmarkResult
+    {
+        int voiceCount;
+        double audioSeconds;            // Rendered audio length.
+        double renderSeconds;           // Wall time spent rendering.
+        double msPerBlock;
+        double realtimeFactor;          // audioSeconds / renderSeconds.
+    };
+
+    /// Render voiceCount moving looping voices for seconds of audio, offline.
+    SpatialAudioBenchmarkResult benchmarkSpatialAudioMixer (int voiceCount, double seconds);
+
+} // BE
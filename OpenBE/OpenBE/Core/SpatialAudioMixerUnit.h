@@ -0,0 +1,67 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  AVAudioEngine output backend for the portable SpatialAudioMixer.
+//
+//  An in-process AUAudioUnit generator whose render block pulls stereo from the
+//  mixer. It's connected straight to the engine's mainMixerNode, since the mixer
+//  does its own spatialization instead of the AVAudioEnvironmentNode.
+//
+//  The AudioEngine's voice pool adds its sounds to it and plays positional
+//  triggers on it, once AudioEngine startSoftwareMixer has attached it.
+//
+
+#import <AVFoundation/AVFoundation.h>
+#import <AudioToolbox/AudioToolbox.h>
+#import <SceneKit/SceneKit.h>
+#import <GLKit/GLKit.h>
+
+#ifdef __cplusplus
+#include "SpatialAudioMixer.hpp"
+#endif
+
+@interface SpatialAudioMixerUnit : AUAudioUnit
+
+/**
+ * Instantiate the unit, attach it to engine and connect it to the main mixer.
+ * The completion runs on the main queue, with nil on failure.
+ * RUN ON MAIN THREAD ONLY
+ */
++ (void) attachToEngine:(AVAudioEngine *)engine completion:(void (^)(SpatialAudioMixerUnit *mixerUnit))completion;
+
+/// The node wrapping this unit in the engine.
+@property (nonatomic, weak, readonly) AVAudioUnit *audioUnitNode;
+
+/**
+ * Move the listener to the camera node.
+ * THREAD SAFE
+ */
+- (void) updateListenerFromCameraNode:(SCNNode *)cameraNode;
+
+/**
+ * Copy in a mono float buffer as the mixer's next sound. Sounds are numbered from 0 in the order they're added.
+ * @return The sound's number, or -1 if the mixer is full or the format isn't mono float.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (int) addSoundWithBuffer:(AVAudioPCMBuffer *)buffer;
+
+/**
+ * Play an added sound once at a world position. Lock-free and allocation-free.
+ * @return NO if the sound wasn't added or the mixer's command ring was full.
+ * THREAD SAFE
+ */
+- (BOOL) playSound:(int)sound volume:(float)volume position:(GLKVector3)position;
+
+#ifdef __cplusplus
+/// The mixer being rendered. Control calls on it are thread safe.
+- (BE::SpatialAudioMixer *) mixer;
+#endif
+
+@end
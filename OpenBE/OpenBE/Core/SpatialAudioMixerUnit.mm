@@ -0,0 +1,164 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "SpatialAudioMixerUnit.h"
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+    const AudioComponentDescription kSpatialAudioMixerDescription = {
+        kAudioUnitType_Generator,
+        'sMix',     // Subtype
+        'OcBE',     // Manufacturer
+        0,
+        0
+    };
+
+} // anonymous
+
+@interface SpatialAudioMixerUnit ()
+@property (nonatomic, weak, readwrite) AVAudioUnit *audioUnitNode;
+@end
+
+@implementation SpatialAudioMixerUnit
+{
+    std::unique_ptr<BE::SpatialAudioMixer> _mixer;
+
+    AUAudioUnitBus *_outputBus;
+    AUAudioUnitBusArray *_outputBusArray;
+
+    // Used when the host doesn't provide output buffers.
+    std::vector<float> _scratchLeft;
+    std::vector<float> _scratchRight;
+}
+
++ (void) attachToEngine:(AVAudioEngine *)engine completion:(void (^)(SpatialAudioMixerUnit *mixerUnit))completion {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        [AUAudioUnit registerSubclass:[SpatialAudioMixerUnit class]
+               asComponentDescription:kSpatialAudioMixerDescription
+                                 name:@"OpenBE: Spatial Audio Mixer"
+                              version:1];
+    });
+
+    [AVAudioUnit instantiateWithComponentDescription:kSpatialAudioMixerDescription
+                                             options:kAudioComponentInstantiation_LoadInProcess
+                                   completionHandler:^(AVAudioUnit *audioUnit, NSError *error)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if( audioUnit == nil || error != nil ) {
+                NSLog(@"SpatialAudioMixerUnit: === Error === Could not instantiate: %@", error.localizedDescription);
+                completion(nil);
+                return;
+            }
+
+            SpatialAudioMixerUnit *mixerUnit = (SpatialAudioMixerUnit *)audioUnit.AUAudioUnit;
+            mixerUnit.audioUnitNode = audioUnit;
+
+            [engine attachNode:audioUnit];
+            [engine connect:audioUnit to:[engine mainMixerNode] format:mixerUnit->_outputBus.format];
+            completion(mixerUnit);
+        });
+    }];
+}
+
+- (instancetype) initWithComponentDescription:(AudioComponentDescription)componentDescription
+                                      options:(AudioComponentInstantiationOptions)options
+                                        error:(NSError **)outError
+{
+    self = [super initWithComponentDescription:componentDescription options:options error:outError];
+    if( self ) {
+        _mixer.reset(new BE::SpatialAudioMixer());
+
+        AVAudioFormat *format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:_mixer->settings().sampleRate channels:2];
+        _outputBus = [[AUAudioUnitBus alloc] initWithFormat:format error:outError];
+        if( _outputBus == nil ) {
+            return nil;
+        }
+        _outputBusArray = [[AUAudioUnitBusArray alloc] initWithAudioUnit:self busType:AUAudioUnitBusTypeOutput busses:@[_outputBus]];
+    }
+    return self;
+}
+
+- (BE::SpatialAudioMixer *) mixer {
+    return _mixer.get();
+}
+
+- (AUAudioUnitBusArray *) outputBusses {
+    return _outputBusArray;
+}
+
+- (BOOL) allocateRenderResourcesAndReturnError:(NSError **)outError {
+    if( ![super allocateRenderResourcesAndReturnError:outError] ) {
+        return NO;
+    }
+
+    _scratchLeft.assign(self.maximumFramesToRender, 0.f);
+    _scratchRight.assign(self.maximumFramesToRender, 0.f);
+    return YES;
+}
+
+- (AUInternalRenderBlock) internalRenderBlock {
+    // Capture raw pointers only, the render block must not touch self.
+    BE::SpatialAudioMixer *mixer = _mixer.get();
+    std::vector<float> *scratchLeft = &_scratchLeft;
+    std::vector<float> *scratchRight = &_scratchRight;
+
+    return ^AUAudioUnitStatus(AudioUnitRenderActionFlags *actionFlags,
+                              const AudioTimeStamp *timestamp,
+                              AUAudioFrameCount frameCount,
+                              NSInteger outputBusNumber,
+                              AudioBufferList *outputData,
+                              const AURenderEvent *realtimeEventListHead,
+                              AURenderPullInputBlock pullInputBlock)
+    {
+        if( frameCount > scratchLeft->size() || outputData->mNumberBuffers < 2 ) {
+            return kAudioUnitErr_TooManyFramesToProcess;
+        }
+
+        AudioBuffer &leftBuffer = outputData->mBuffers[0];
+        AudioBuffer &rightBuffer = outputData->mBuffers[1];
+        if( leftBuffer.mData == nullptr ) leftBuffer.mData = scratchLeft->data();
+        if( rightBuffer.mData == nullptr ) rightBuffer.mData = scratchRight->data();
+        leftBuffer.mDataByteSize = frameCount * sizeof(float);
+        rightBuffer.mDataByteSize = frameCount * sizeof(float);
+
+        mixer->render((float *)leftBuffer.mData, (float *)rightBuffer.mData, frameCount);
+        return noErr;
+    };
+}
+
+- (void) updateListenerFromCameraNode:(SCNNode *)cameraNode {
+    SCNVector3 sp = cameraNode.position;
+
+    SCNQuaternion so = cameraNode.orientation;
+    GLKQuaternion go = GLKQuaternionMake( so.x, so.y, so.z, so.w );
+    GLKVector3 gfwd = GLKQuaternionRotateVector3(go, GLKVector3Make(0, 0, -1));
+    GLKVector3 gup = GLKQuaternionRotateVector3(go, GLKVector3Make(0, 1, 0));
+
+    _mixer->setListener({ sp.x, sp.y, sp.z }, { gfwd.x, gfwd.y, gfwd.z }, { gup.x, gup.y, gup.z });
+}
+
+- (int) addSoundWithBuffer:(AVAudioPCMBuffer *)buffer {
+    if( buffer.format.channelCount != 1 || buffer.floatChannelData == nullptr ) {
+        return -1;
+    }
+
+    // An empty sound still takes its number, as a single silent sample.
+    const float silence = 0.f;
+    const float *samples = buffer.frameLength > 0 ? buffer.floatChannelData[0] : &silence;
+    size_t frameCount = buffer.frameLength > 0 ? buffer.frameLength : 1;
+    return _mixer->addSound(samples, frameCount, (float)buffer.format.sampleRate);
+}
+
+- (BOOL) playSound:(int)sound volume:(float)volume position:(GLKVector3)position {
+    return _mixer->play(sound, volume, { position.x, position.y, position.z }) != 0;
+}
+
+@end
@@ -0,0 +1,158 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Broad-phase spatial index over scene nodes, as a hashed grid of world space cells.
+//
+//  Tracked nodes are re-read once per frame in update (called by the SceneManager
+//  after the Camera), and only move between grid buckets when they cross a cell.
+//  Items bigger than a cell are kept aside and tested by every query, like a
+//  loose octree's top level.
+//
+//  Queries take spheres, ground (XZ) circles, cones and view frustums, and can be
+//  run as a batch. Standing queries are registered once, evaluated in batch every
+//  update, and leave a per-item bit that components can test in O(1); camera
+//  relative standing queries follow the Camera each frame.
+//
+//  Hidden nodes are kept in the index but never match.
+//
+//  RENDER THREAD ONLY, unless noted.
+//
+
+#import <SceneKit/SceneKit.h>
+#import <GLKit/GLKit.h>
+
+/// Stable handle to an indexed item.
+typedef uint32_t SpatialHandle;
+
+#define SPATIAL_HANDLE_INVALID ((SpatialHandle)0xFFFFFFFF)
+
+/// Maximum number of standing queries.
+#define SPATIAL_MAX_STANDING_QUERIES 32
+
+/// Queries reaching further than this, in meters, aren't bounded to grid cells and test every item.
+#define SPATIAL_MAX_QUERY_EXTENT 1000.f
+
+typedef NS_ENUM(uint8_t, SpatialQueryShape) {
+    SpatialQueryShapeSphere = 0,    // origin, radius
+    SpatialQueryShapeGroundCircle,  // origin, radius, on the X/Z plane
+    SpatialQueryShapeCone,          // origin (apex), direction, radius (range), cosHalfAngle
+    SpatialQueryShapeFrustum,       // viewProjection
+};
+
+typedef struct {
+    SpatialQueryShape shape;
+    BOOL cameraRelative;            // Standing queries only: origin/direction follow Camera position/forward.
+    GLKVector3 origin;
+    GLKVector3 direction;           // Normalized.
+    float radius;
+    float cosHalfAngle;
+    GLKMatrix4 viewProjection;
+} SpatialQuery;
+
+typedef struct {
+    SpatialHandle handle;
+    uint16_t queryIndex;            // Which query of the batch matched.
+    float distance;                 // Item center to query origin (0 for frustum queries).
+} SpatialQueryResult;
+
+typedef uint16_t SpatialStandingQuery;
+
+/// Query constructors.
+static inline SpatialQuery SpatialQuerySphere( GLKVector3 center, float radius ) {
+    SpatialQuery query = {};
+    query.shape = SpatialQueryShapeSphere;
+    query.origin = center;
+    query.radius = radius;
+    return query;
+}
+
+static inline SpatialQuery SpatialQueryGroundCircle( GLKVector3 center, float radius ) {
+    SpatialQuery query = SpatialQuerySphere(center, radius);
+    query.shape = SpatialQueryShapeGroundCircle;
+    return query;
+}
+
+static inline SpatialQuery SpatialQueryCone( GLKVector3 apex, GLKVector3 direction, float halfAngleRadians, float range ) {
+    SpatialQuery query = SpatialQuerySphere(apex, range);
+    query.shape = SpatialQueryShapeCone;
+    query.direction = GLKVector3Normalize(direction);
+    query.cosHalfAngle = cosf(halfAngleRadians);
+    return query;
+}
+
+static inline SpatialQuery SpatialQueryFrustum( GLKMatrix4 viewProjection ) {
+    SpatialQuery query = {};
+    query.shape = SpatialQueryShapeFrustum;
+    query.viewProjection = viewProjection;
+    return query;
+}
+
+@interface SpatialIndex : NSObject
+
+/// Singleton, updated by the SceneManager.
++ (SpatialIndex *) main;
+
+- (instancetype) initWithCellSize:(float)cellSize;
+
+@property (nonatomic, readonly) float cellSize;
+@property (nonatomic, readonly) NSUInteger count;
+
+#pragma mark - Items
+
+/**
+ * Track a node's world position. radius bounds the node around its origin.
+ * Adding a node twice returns its existing handle.
+ */
+- (SpatialHandle) addNode:(SCNNode *)node radius:(float)radius;
+- (void) removeHandle:(SpatialHandle)handle;
+
+/// SPATIAL_HANDLE_INVALID if the node isn't indexed.
+- (SpatialHandle) handleForNode:(SCNNode *)node;
+- (SCNNode *) nodeForHandle:(SpatialHandle)handle;
+
+/// Last indexed world position.
+- (GLKVector3) positionForHandle:(SpatialHandle)handle;
+
+/// Re-read every tracked node, re-bucket the ones that changed cells, and evaluate standing queries.
+- (void) update;
+
+#pragma mark - Queries
+
+/**
+ * Run count queries against the index.
+ * Writes up to maxResults matches, tagged with their query index.
+ * @return Number of results written.
+ */
+- (NSUInteger) runQueries:(const SpatialQuery *)queries
+                    count:(NSUInteger)count
+                  results:(SpatialQueryResult *)results
+               maxResults:(NSUInteger)maxResults;
+
+#pragma mark - Standing Queries
+
+/// Register a query evaluated every update. Returns its index, used for matching.
+- (SpatialStandingQuery) addStandingQuery:(SpatialQuery)query;
+- (void) setStandingQuery:(SpatialStandingQuery)index query:(SpatialQuery)query;
+
+/// Did the item match the standing query on the last update.
+- (BOOL) handle:(SpatialHandle)handle matchesStandingQuery:(SpatialStandingQuery)index;
+
+@end
+
+@interface SpatialIndex (Benchmark)
+
+/**
+ * Index objectCount nodes scattered over a room-sized volume, move some every frame,
+ * and compare batched queries against a linear distance scan. Logs and returns the results.
+ * RUN ON MAIN THREAD ONLY
+ */
++ (NSString *) benchmarkWithObjectCount:(NSUInteger)objectCount;
+
+@end
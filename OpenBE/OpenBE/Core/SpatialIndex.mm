@@ -0,0 +1,632 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "SpatialIndex.h"
+#import "Camera.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#define SPATIAL_DEFAULT_CELL_SIZE 1.0f
+
+namespace {
+
+    const uint32_t kSlotBits = 20;
+    const uint32_t kSlotMask = (1u << kSlotBits) - 1;
+    const uint32_t kGenerationMask = (1u << (32 - kSlotBits)) - 1;
+    const uint64_t kLargeCell = ~0ull;
+
+    inline uint32_t slotOfHandle( SpatialHandle handle ) { return handle & kSlotMask; }
+    inline uint32_t generationOfHandle( SpatialHandle handle ) { return handle >> kSlotBits; }
+    inline SpatialHandle makeHandle( uint32_t slot, uint32_t generation ) { return ((generation & kGenerationMask) << kSlotBits) | slot; }
+
+    struct SpatialItem
+    {
+        __weak SCNNode *node;
+        GLKVector3 position = {{0, 0, 0}};
+        float radius = 0;
+        uint64_t cell = kLargeCell;
+        uint32_t generation = 0;
+        uint32_t standingMask = 0;
+        bool live = false;
+        bool visible = true;
+    };
+
+    struct CellCoord { int32_t x, y, z; };
+
+    // Cell keys hold 21 bits per axis, so coordinates stay within +-2^20.
+    const int32_t kCellBias = 1 << 20;
+
+    /// Clamped before converting, so far away or infinite positions can't overflow an int.
+    inline int32_t cellCoordOf( float v, float invCellSize ) {
+        float cell = floorf(v * invCellSize);
+        if( !(cell > -kCellBias) ) return -kCellBias;
+        if( cell >= kCellBias - 1 ) return kCellBias - 1;
+        return (int32_t)cell;
+    }
+
+    inline CellCoord cellCoordOf( GLKVector3 p, float invCellSize ) {
+        return { cellCoordOf(p.x, invCellSize), cellCoordOf(p.y, invCellSize), cellCoordOf(p.z, invCellSize) };
+    }
+
+    // 21 bits per axis, biased so negative coordinates pack cleanly.
+    inline uint64_t cellKeyOf( int32_t x, int32_t y, int32_t z ) {
+        return ((uint64_t)((x + kCellBias) & 0x1FFFFF) << 42) | ((uint64_t)((y + kCellBias) & 0x1FFFFF) << 21) | (uint64_t)((z + kCellBias) & 0x1FFFFF);
+    }
+
+    inline CellCoord cellCoordOfKey( uint64_t key ) {
+        return { (int32_t)((key >> 42) & 0x1FFFFF) - kCellBias, (int32_t)((key >> 21) & 0x1FFFFF) - kCellBias, (int32_t)(key & 0x1FFFFF) - kCellBias };
+    }
+
+    /// Finite, and within SPATIAL_MAX_QUERY_EXTENT of the origin on every axis.
+    inline bool withinQueryExtent( GLKVector3 p ) {
+        for( int i=0; i<3; i++ ) {
+            if( !(fabsf(p.v[i]) <= SPATIAL_MAX_QUERY_EXTENT) ) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Query with its derived terms precomputed.
+     */
+    struct PreparedQuery
+    {
+        SpatialQuery query;
+        GLKVector4 planes[6];
+        float sinHalfAngle = 0;
+        GLKVector3 boundsMin = {{0, 0, 0}};
+        GLKVector3 boundsMax = {{0, 0, 0}};
+        bool bounded = true;        // Bounds are usable to pick grid cells.
+        bool boundedY = true;       // Ground circles aren't, they take the occupied cells' heights.
+
+        explicit PreparedQuery( const SpatialQuery &q ) : query(q) {
+            switch( q.shape ) {
+                case SpatialQueryShapeSphere:
+                case SpatialQueryShapeCone: {
+                    GLKVector3 r = GLKVector3Make(q.radius, q.radius, q.radius);
+                    boundsMin = GLKVector3Subtract(q.origin, r);
+                    boundsMax = GLKVector3Add(q.origin, r);
+                    sinHalfAngle = sqrtf(std::max(0.f, 1.f - q.cosHalfAngle * q.cosHalfAngle));
+                    break;
+                }
+                case SpatialQueryShapeGroundCircle: {
+                    GLKVector3 r = GLKVector3Make(q.radius, 0, q.radius);
+                    boundsMin = GLKVector3Subtract(q.origin, r);
+                    boundsMax = GLKVector3Add(q.origin, r);
+                    boundedY = false;
+                    break;
+                }
+                case SpatialQueryShapeFrustum: {
+                    // Gribb/Hartmann plane extraction, GLKMatrix4 is column major.
+                    const float *m = q.viewProjection.m;
+                    GLKVector4 row0 = GLKVector4Make(m[0], m[4], m[8],  m[12]);
+                    GLKVector4 row1 = GLKVector4Make(m[1], m[5], m[9],  m[13]);
+                    GLKVector4 row2 = GLKVector4Make(m[2], m[6], m[10], m[14]);
+                    GLKVector4 row3 = GLKVector4Make(m[3], m[7], m[11], m[15]);
+                    planes[0] = GLKVector4Add(row3, row0);
+                    planes[1] = GLKVector4Subtract(row3, row0);
+                    planes[2] = GLKVector4Add(row3, row1);
+                    planes[3] = GLKVector4Subtract(row3, row1);
+                    planes[4] = GLKVector4Add(row3, row2);
+                    planes[5] = GLKVector4Subtract(row3, row2);
+                    for( GLKVector4 &plane : planes ) {
+                        float length = GLKVector3Length(GLKVector3Make(plane.x, plane.y, plane.z));
+                        if( length > 0 ) plane = GLKVector4DivideScalar(plane, length);
+                    }
+
+                    // World bounds from the unprojected clip space corners.
+                    bool invertible = false;
+                    GLKMatrix4 inverse = GLKMatrix4Invert(q.viewProjection, &invertible);
+                    bounded = invertible;
+                    if( invertible ) {
+                        boundsMin = GLKVector3Make(MAXFLOAT, MAXFLOAT, MAXFLOAT);
+                        boundsMax = GLKVector3Make(-MAXFLOAT, -MAXFLOAT, -MAXFLOAT);
+                        for( int i=0; i<8; i++ ) {
+                            GLKVector4 corner = GLKMatrix4MultiplyVector4(inverse, GLKVector4Make(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1, 1));
+                            if( fabsf(corner.w) < 1e-6f ) { bounded = false; break; }
+                            GLKVector3 p = GLKVector3Make(corner.x / corner.w, corner.y / corner.w, corner.z / corner.w);
+                            boundsMin = GLKVector3Minimum(boundsMin, p);
+                            boundsMax = GLKVector3Maximum(boundsMax, p);
+                        }
+                    }
+                    break;
+                }
+            }
+
+            // MAXFLOAT radii and far planes are finite, but no range of cells covers them.
+            if( bounded ) {
+                bounded = withinQueryExtent(boundsMin) && withinQueryExtent(boundsMax);
+            }
+        }
+
+        /// Does the item's bounding sphere touch the query. distance is set to the center distance.
+        bool test( GLKVector3 p, float r, float &distance ) const {
+            switch( query.shape ) {
+                case SpatialQueryShapeSphere:
+                    distance = GLKVector3Distance(p, query.origin);
+                    return distance <= query.radius + r;
+
+                case SpatialQueryShapeGroundCircle: {
+                    float dx = p.x - query.origin.x;
+                    float dz = p.z - query.origin.z;
+                    distance = sqrtf(dx * dx + dz * dz);
+                    return distance <= query.radius + r;
+                }
+
+                case SpatialQueryShapeCone: {
+                    GLKVector3 v = GLKVector3Subtract(p, query.origin);
+                    float lengthSq = GLKVector3DotProduct(v, v);
+                    distance = sqrtf(lengthSq);
+                    if( distance > query.radius + r ) return false;
+                    if( distance <= r ) return true; // Apex inside the item.
+
+                    float along = GLKVector3DotProduct(v, query.direction);
+                    if( along < -r ) return false;
+
+                    // Signed distance from the cone surface, positive inside.
+                    float across = sqrtf(std::max(0.f, lengthSq - along * along));
+                    return along * sinHalfAngle - across * query.cosHalfAngle >= -r;
+                }
+
+                case SpatialQueryShapeFrustum:
+                    distance = 0;
+                    for( const GLKVector4 &plane : planes ) {
+                        if( plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < -r ) return false;
+                    }
+                    return true;
+            }
+            return false;
+        }
+    };
+
+    /**
+     * Item storage and the hashed grid over it.
+     */
+    struct SpatialGrid
+    {
+        float cellSize = 1;
+        float invCellSize = 1;
+
+        std::vector<SpatialItem> items;
+
+        // Cell key -> slots of the items centered in it.
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+
+        // Items too big for one cell, tested by every query.
+        std::vector<uint32_t> largeItems;
+
+        // Every occupied cell is within these, grown as cells are added and reset once none are left.
+        CellCoord occupiedMin = { 0, 0, 0 };
+        CellCoord occupiedMax = { -1, -1, -1 };
+
+        uint64_t cellFor( GLKVector3 position, float radius ) const {
+            if( radius > 0.5f * cellSize ) return kLargeCell;
+
+            CellCoord c = cellCoordOf(position, invCellSize);
+            return cellKeyOf(c.x, c.y, c.z);
+        }
+
+        void insert( uint32_t slot, uint64_t cell ) {
+            if( cell == kLargeCell ) {
+                largeItems.push_back(slot);
+            } else {
+                std::vector<uint32_t> &bucket = cells[cell];
+                if( bucket.empty() ) occupy(cellCoordOfKey(cell));
+                bucket.push_back(slot);
+            }
+        }
+
+        void occupy( CellCoord c ) {
+            if( occupiedMin.x > occupiedMax.x ) {
+                occupiedMin = occupiedMax = c;
+                return;
+            }
+            occupiedMin = { std::min(occupiedMin.x, c.x), std::min(occupiedMin.y, c.y), std::min(occupiedMin.z, c.z) };
+            occupiedMax = { std::max(occupiedMax.x, c.x), std::max(occupiedMax.y, c.y), std::max(occupiedMax.z, c.z) };
+        }
+
+        void erase( uint32_t slot, uint64_t cell ) {
+            std::vector<uint32_t> *bucket = &largeItems;
+            if( cell != kLargeCell ) {
+                auto found = cells.find(cell);
+                if( found == cells.end() ) return;
+                bucket = &found->second;
+            }
+
+            auto it = std::find(bucket->begin(), bucket->end(), slot);
+            if( it != bucket->end() ) {
+                *it = bucket->back();
+                bucket->pop_back();
+            }
+
+            if( cell != kLargeCell && bucket->empty() ) {
+                cells.erase(cell);
+                if( cells.empty() ) {
+                    occupiedMin = { 0, 0, 0 };
+                    occupiedMax = { -1, -1, -1 };
+                }
+            }
+        }
+
+        /**
+         * Visit every visible item touching the query, calling visitor(slot, distance).
+         */
+        template <typename Visitor>
+        void visit( const PreparedQuery &prepared, Visitor visitor ) const {
+            auto visitBucket = [&]( const std::vector<uint32_t> &bucket ) {
+                for( uint32_t slot : bucket ) {
+                    const SpatialItem &item = items[slot];
+                    float distance;
+                    if( item.visible && prepared.test(item.position, item.radius, distance) ) {
+                        visitor(slot, distance);
+                    }
+                }
+            };
+
+            visitBucket(largeItems);
+            if( cells.empty() ) return;
+
+            // Small items are bucketed by center, and are at most half a cell across.
+            GLKVector3 margin = GLKVector3Make(0.5f * cellSize, 0.5f * cellSize, 0.5f * cellSize);
+            CellCoord lo = cellCoordOf(GLKVector3Subtract(prepared.boundsMin, margin), invCellSize);
+            CellCoord hi = cellCoordOf(GLKVector3Add(prepared.boundsMax, margin), invCellSize);
+
+            // Ground circles reach every height, which is every occupied one.
+            if( !prepared.boundedY ) {
+                lo.y = occupiedMin.y;
+                hi.y = occupiedMax.y;
+            }
+
+            // No cell outside the occupied ones holds anything.
+            lo = { std::max(lo.x, occupiedMin.x), std::max(lo.y, occupiedMin.y), std::max(lo.z, occupiedMin.z) };
+            hi = { std::min(hi.x, occupiedMax.x), std::min(hi.y, occupiedMax.y), std::min(hi.z, occupiedMax.z) };
+            if( prepared.bounded && (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z) ) return;
+
+            double rangeCells = prepared.bounded
+                ? (double)(hi.x - lo.x + 1) * (double)(hi.y - lo.y + 1) * (double)(hi.z - lo.z + 1)
+                : INFINITY;
+
+            if( rangeCells > (double)cells.size() ) {
+                // Cheaper to walk the occupied cells than probe the query's range.
+                for( const auto &cell : cells ) {
+                    visitBucket(cell.second);
+                }
+                return;
+            }
+
+            for( int32_t x = lo.x; x <= hi.x; x++ ) {
+                for( int32_t y = lo.y; y <= hi.y; y++ ) {
+                    for( int32_t z = lo.z; z <= hi.z; z++ ) {
+                        auto found = cells.find(cellKeyOf(x, y, z));
+                        if( found != cells.end() ) {
+                            visitBucket(found->second);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+} // anonymous
+
+#pragma mark - SpatialIndex
+
+@implementation SpatialIndex
+{
+    SpatialGrid _grid;
+    std::vector<uint32_t> _freeSlots;
+    NSUInteger _count;
+
+    std::vector<SpatialQuery> _standingQueries;
+
+    NSMapTable<SCNNode *, NSNumber *> *_handlesByNode;
+}
+
++ (SpatialIndex *) main {
+    static SpatialIndex *mainIndex = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainIndex = [[SpatialIndex alloc] initWithCellSize:SPATIAL_DEFAULT_CELL_SIZE];
+    });
+
+    return mainIndex;
+}
+
+- (instancetype) init {
+    return [self initWithCellSize:SPATIAL_DEFAULT_CELL_SIZE];
+}
+
+- (instancetype) initWithCellSize:(float)cellSize {
+    self = [super init];
+    if( self ) {
+        be_assert( cellSize > 0, "Spatial index cell size must be positive" );
+        _grid.cellSize = cellSize;
+        _grid.invCellSize = 1.f / cellSize;
+        _count = 0;
+        _handlesByNode = [NSMapTable weakToStrongObjectsMapTable];
+    }
+    return self;
+}
+
+- (float) cellSize {
+    return _grid.cellSize;
+}
+
+- (NSUInteger) count {
+    return _count;
+}
+
+#pragma mark - Items
+
+- (SpatialItem *) itemForHandle:(SpatialHandle)handle {
+    uint32_t slot = slotOfHandle(handle);
+    if( handle == SPATIAL_HANDLE_INVALID || slot >= _grid.items.size() ) return nullptr;
+
+    SpatialItem &item = _grid.items[slot];
+    if( !item.live || item.generation != generationOfHandle(handle) ) return nullptr;
+    return &item;
+}
+
+- (GLKVector3) worldPositionOfNode:(SCNNode *)node {
+    // Presentation node, so physics driven nodes report where they are drawn.
+    SCNNode *presentation = node.presentationNode ?: node;
+    return SCNVector3ToGLKVector3([presentation convertPosition:SCNVector3Zero toNode:nil]);
+}
+
+- (SpatialHandle) addNode:(SCNNode *)node radius:(float)radius {
+    if( node == nil ) return SPATIAL_HANDLE_INVALID;
+
+    SpatialHandle existing = [self handleForNode:node];
+    if( existing != SPATIAL_HANDLE_INVALID ) return existing;
+
+    uint32_t slot;
+    if( !_freeSlots.empty() ) {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    } else {
+        slot = (uint32_t)_grid.items.size();
+        if( slot > kSlotMask ) {
+            NSLog(@"SpatialIndex: === Error === Out of item slots.");
+            return SPATIAL_HANDLE_INVALID;
+        }
+        _grid.items.push_back(SpatialItem());
+    }
+
+    SpatialItem &item = _grid.items[slot];
+    item.node = node;
+    item.radius = radius;
+    item.position = [self worldPositionOfNode:node];
+    item.visible = !node.hidden;
+    item.standingMask = 0;
+    item.live = true;
+    item.cell = _grid.cellFor(item.position, radius);
+    _grid.insert(slot, item.cell);
+    _count++;
+
+    SpatialHandle handle = makeHandle(slot, item.generation);
+    [_handlesByNode setObject:@(handle) forKey:node];
+    return handle;
+}
+
+- (void) removeSlot:(uint32_t)slot {
+    SpatialItem &item = _grid.items[slot];
+    _grid.erase(slot, item.cell);
+
+    SCNNode *node = item.node;
+    if( node ) [_handlesByNode removeObjectForKey:node];
+
+    item.node = nil;
+    item.live = false;
+    item.standingMask = 0;
+    item.generation = (item.generation + 1) & kGenerationMask;
+    _freeSlots.push_back(slot);
+    _count--;
+}
+
+- (void) removeHandle:(SpatialHandle)handle {
+    if( [self itemForHandle:handle] == nullptr ) return;
+    [self removeSlot:slotOfHandle(handle)];
+}
+
+- (SpatialHandle) handleForNode:(SCNNode *)node {
+    if( node == nil ) return SPATIAL_HANDLE_INVALID;
+
+    NSNumber *handle = [_handlesByNode objectForKey:node];
+    return handle ? (SpatialHandle)handle.unsignedIntValue : SPATIAL_HANDLE_INVALID;
+}
+
+- (SCNNode *) nodeForHandle:(SpatialHandle)handle {
+    SpatialItem *item = [self itemForHandle:handle];
+    return item ? item->node : nil;
+}
+
+- (GLKVector3) positionForHandle:(SpatialHandle)handle {
+    SpatialItem *item = [self itemForHandle:handle];
+    return item ? item->position : GLKVector3Make(0, 0, 0);
+}
+
+- (void) update {
+    for( uint32_t slot=0; slot<_grid.items.size(); slot++ ) {
+        SpatialItem &item = _grid.items[slot];
+        if( !item.live ) continue;
+
+        SCNNode *node = item.node;
+        if( node == nil ) {
+            // Node went away without being removed.
+            [self removeSlot:slot];
+            continue;
+        }
+
+        item.visible = !node.hidden;
+        item.position = [self worldPositionOfNode:node];
+
+        uint64_t cell = _grid.cellFor(item.position, item.radius);
+        if( cell != item.cell ) {
+            _grid.erase(slot, item.cell);
+            _grid.insert(slot, cell);
+            item.cell = cell;
+        }
+    }
+
+    [self evaluateStandingQueries];
+}
+
+#pragma mark - Queries
+
+- (NSUInteger) runQueries:(const SpatialQuery *)queries
+                    count:(NSUInteger)count
+                  results:(SpatialQueryResult *)results
+               maxResults:(NSUInteger)maxResults
+{
+    NSUInteger written = 0;
+    for( NSUInteger q=0; q<count && written<maxResults; q++ ) {
+        _grid.visit(PreparedQuery(queries[q]), [&]( uint32_t slot, float distance ) {
+            if( written >= maxResults ) return;
+            SpatialQueryResult &result = results[written++];
+            result.handle = makeHandle(slot, _grid.items[slot].generation);
+            result.queryIndex = (uint16_t)q;
+            result.distance = distance;
+        });
+    }
+    return written;
+}
+
+#pragma mark - Standing Queries
+
+- (SpatialStandingQuery) addStandingQuery:(SpatialQuery)query {
+    be_assert( _standingQueries.size() < SPATIAL_MAX_STANDING_QUERIES, "Too many standing spatial queries" );
+    _standingQueries.push_back(query);
+    return (SpatialStandingQuery)(_standingQueries.size() - 1);
+}
+
+- (void) setStandingQuery:(SpatialStandingQuery)index query:(SpatialQuery)query {
+    if( index < _standingQueries.size() ) {
+        _standingQueries[index] = query;
+    }
+}
+
+- (BOOL) handle:(SpatialHandle)handle matchesStandingQuery:(SpatialStandingQuery)index {
+    SpatialItem *item = [self itemForHandle:handle];
+    return item && (item->standingMask & (1u << index)) != 0;
+}
+
+- (void) evaluateStandingQueries {
+    for( SpatialItem &item : _grid.items ) {
+        item.standingMask = 0;
+    }
+
+    GLKVector3 cameraPosition = [Camera main].position;
+    GLKVector3 cameraForward = [Camera main].forward;
+
+    for( size_t q=0; q<_standingQueries.size(); q++ ) {
+        SpatialQuery query = _standingQueries[q];
+        if( query.cameraRelative ) {
+            query.origin = cameraPosition;
+            query.direction = cameraForward;
+        }
+
+        uint32_t bit = 1u << q;
+        std::vector<SpatialItem> &items = _grid.items;
+        _grid.visit(PreparedQuery(query), [&]( uint32_t slot, float distance ) {
+            items[slot].standingMask |= bit;
+        });
+    }
+}
+
+@end
+
+#pragma mark - Benchmark
+
+@implementation SpatialIndex (Benchmark)
+
++ (NSString *) benchmarkWithObjectCount:(NSUInteger)objectCount {
+    const int frames = 100;
+    const float roomSize = 8.f;
+    const float objectRadius = 0.25f;
+
+    srand48(42);
+
+    SpatialIndex *index = [[SpatialIndex alloc] initWithCellSize:SPATIAL_DEFAULT_CELL_SIZE];
+    NSMutableArray<SCNNode *> *nodes = [NSMutableArray arrayWithCapacity:objectCount];
+    for( NSUInteger i=0; i<objectCount; i++ ) {
+        SCNNode *node = [SCNNode node];
+        node.position = SCNVector3Make((drand48() - 0.5) * roomSize, drand48() * 2.5, (drand48() - 0.5) * roomSize);
+        [nodes addObject:node];
+        [index addNode:node radius:objectRadius];
+    }
+
+    GLKVector3 eye = GLKVector3Make(0, 1.6f, 0);
+    GLKVector3 forward = GLKVector3Make(0, 0, -1);
+    GLKMatrix4 viewProjection = GLKMatrix4Multiply(GLKMatrix4MakePerspective(GLKMathDegreesToRadians(60), 16.f/9.f, 0.05f, 20.f),
+                                                   GLKMatrix4MakeLookAt(eye.x, eye.y, eye.z, eye.x + forward.x, eye.y + forward.y, eye.z + forward.z, 0, 1, 0));
+
+    SpatialQuery queries[3] = {
+        SpatialQuerySphere(eye, 2.f),                                  // proximity
+        SpatialQueryCone(eye, forward, GLKMathDegreesToRadians(15), 6.f), // gaze
+        SpatialQueryFrustum(viewProjection),                            // visibility / audio culling
+    };
+
+    std::vector<PreparedQuery> linearQueries(queries, queries + 3);
+    std::vector<SpatialQueryResult> results(objectCount * 3);
+    uint64_t updateTicks = 0, queryTicks = 0, linearTicks = 0;
+    NSUInteger indexMatches = 0, linearMatches = 0;
+
+    for( int frame=0; frame<frames; frame++ ) {
+        // Move a tenth of the objects a little, like settling physics bodies.
+        for( NSUInteger i=frame % 10; i<objectCount; i+=10 ) {
+            SCNVector3 p = nodes[i].position;
+            nodes[i].position = SCNVector3Make(p.x + (drand48() - 0.5) * 0.2, p.y, p.z + (drand48() - 0.5) * 0.2);
+        }
+
+        uint64_t start = mach_absolute_time();
+        [index update];
+        updateTicks += mach_absolute_time() - start;
+
+        start = mach_absolute_time();
+        indexMatches += [index runQueries:queries count:3 results:results.data() maxResults:results.size()];
+        queryTicks += mach_absolute_time() - start;
+
+        // Linear baseline: the same three tests against every node.
+        start = mach_absolute_time();
+        for( SCNNode *node in nodes ) {
+            GLKVector3 p = SCNVector3ToGLKVector3([node convertPosition:SCNVector3Zero toNode:nil]);
+            for( const PreparedQuery &query : linearQueries ) {
+                float distance;
+                if( query.test(p, objectRadius, distance) ) linearMatches++;
+            }
+        }
+        linearTicks += mach_absolute_time() - start;
+    }
+
+    be_assert( indexMatches == linearMatches, "Spatial index mismatch %lu != %lu", (unsigned long)indexMatches, (unsigned long)linearMatches );
+
+    NSString *report = [NSString stringWithFormat:
+        @"SpatialIndex benchmark, %lu objects, %d frames (%lu matches)\n"
+         "  update: %0.4f (ms/frame)\n"
+         "  query:  %0.4f (ms/frame) index, %0.4f (ms/frame) linear",
+        (unsigned long)objectCount, frames, (unsigned long)indexMatches,
+        machTicksToMs(updateTicks) / frames,
+        machTicksToMs(queryTicks) / frames,
+        machTicksToMs(linearTicks) / frames];
+    NSLog(@"%@", report);
+    return report;
+}
+
+@end
@@ -0,0 +1,116 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Single-pass stereo for OpenBE-owned Metal draws.
+//
+//  In stereo, SceneKit renders the scene once per eye, in passes named
+//  sceneLeft and sceneRight, so every node is set up and drawn twice.
+//  A node handed to the StereoRenderer is drawn by it instead of by SceneKit:
+//  the left pass skips it, and the right pass draws it as two instances of
+//  one draw, the instance ID picking the eye from one uniform block holding
+//  both eyes' view-projections. The right pass is the last, so nothing
+//  SceneKit renders after draws over either eye.
+//
+//  The left eye's pose is the one its pass saw this frame. Single pass is
+//  only used once both eyes are known to render side by side into the same
+//  target; until then, and in mono, each pass draws one instance with its
+//  own matrices. It's off by default, until verified on device.
+//
+//  A node is only taken over if OpenBE.metal has "Instanced" variants of its
+//  vertex and fragment functions, otherwise its SCNProgram keeps drawing it.
+//
+//  Procedural draws have no geometry: the vertex function makes its vertices
+//  from the vertex ID. A draw can also repeat itself, each instance drawing
+//  both eyes, for many copies of a node from one block of properties.
+//
+//  RENDER THREAD ONLY, unless noted.
+//
+
+#import <SceneKit/SceneKit.h>
+#import <Metal/Metal.h>
+
+#import "UniformRing.h"
+
+typedef struct {
+    NSUInteger draws;               // Draw calls encoded since start.
+    NSUInteger singlePassDraws;     // Of those, drawing both eyes. Each one saved a draw in the left pass.
+    NSUInteger pipelines;           // Pipeline states built.
+} StereoRendererStats;
+
+/// One node drawn by the StereoRenderer.
+@interface StereoDraw : NSObject <SCNNodeRendererDelegate>
+
+@property (nonatomic, readonly, weak) SCNNode *node;
+
+/// Bound at buffer(2) of both functions, its current copy when drawn.
+@property (nonatomic, strong) UniformBlock *properties;
+
+/// Copies drawn, each for every eye: the instance ID is copy * eyeCount + eye. Defaults to 1, 0 draws nothing.
+@property (nonatomic) NSUInteger instanceCount;
+
+/// Bound from buffer(4) of both functions, in order. For data too big for properties, like a mesh read by a procedural draw.
+@property (nonatomic, copy) NSArray<id<MTLBuffer>> *buffers;
+
+@end
+
+@interface StereoRenderer : NSObject
+
+/// Singleton.
++ (StereoRenderer *) main;
+
+/// Draw both eyes in one pass when possible. Defaults to NO.
+@property (nonatomic) BOOL singlePassEnabled;
+
+/// Did the last left eye pass leave its draws to the right one, to draw both eyes.
+@property (nonatomic, readonly) BOOL singlePassActive;
+
+/**
+ * Draw node's geometry with the Instanced variants of the given functions, instead of its SCNProgram.
+ * Uses the geometry's vertex positions and first element, read when first drawn.
+ * @return nil when the Instanced variants aren't in OpenBE.metal or not rendering with Metal; the node is left as it is.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (StereoDraw *) drawNode:(SCNNode *)node
+       vertexFunctionName:(NSString *)vertexName
+     fragmentFunctionName:(NSString *)fragmentName
+                blendMode:(SCNBlendMode)blendMode
+         readsDepthBuffer:(BOOL)readsDepth
+        writesDepthBuffer:(BOOL)writesDepth;
+
+/**
+ * Draw vertexCount triangle vertices with the Instanced variants of the given functions, for a node without geometry.
+ * @return nil when the Instanced variants aren't in OpenBE.metal or not rendering with Metal.
+ * RUN ON MAIN THREAD ONLY
+ */
+- (StereoDraw *) drawProceduralNode:(SCNNode *)node
+                        vertexCount:(NSUInteger)vertexCount
+                 vertexFunctionName:(NSString *)vertexName
+               fragmentFunctionName:(NSString *)fragmentName
+                          blendMode:(SCNBlendMode)blendMode
+                   readsDepthBuffer:(BOOL)readsDepth
+                  writesDepthBuffer:(BOOL)writesDepth;
+
+/**
+ * Build the pipeline a draw of those functions will need, ahead of its first draw.
+ * For positions laid out like geometrySourceWithVertices:, or no vertex buffer when procedural, in renderer's formats.
+ * THREAD SAFE
+ */
+- (void) warmUpVertexFunctionName:(NSString *)vertexName
+             fragmentFunctionName:(NSString *)fragmentName
+                        blendMode:(SCNBlendMode)blendMode
+                       procedural:(BOOL)procedural
+                         renderer:(id<SCNSceneRenderer>)renderer;
+
+/// Hand node back to SceneKit.
+- (void) removeDraw:(StereoDraw *)draw;
+
+- (StereoRendererStats) stats;
+
+@end
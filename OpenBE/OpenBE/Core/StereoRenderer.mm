@@ -0,0 +1,531 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "StereoRenderer.h"
+#import "SceneManager.h"
+#import "ShaderCache.h"
+#import "../Utils/SceneKitExtensions.h"
+
+#import <BridgeEngine/BridgeEngine.h>
+#import <BridgeEngine/BEDebugging.h>
+#import <GLKit/GLKit.h>
+#import <Metal/Metal.h>
+
+#include <mutex>
+
+// Appended to a SceneKit program's function names for their instanced stereo variants.
+#define STEREO_FUNCTION_SUFFIX @"Instanced"
+
+// Buffer indices shared with OpenBE.metal.
+#define STEREO_VERTEX_BUFFER_INDEX 0
+#define STEREO_NODE_BUFFER_INDEX 1
+#define STEREO_PROPERTIES_BUFFER_INDEX 2
+#define STEREO_UNIFORMS_BUFFER_INDEX 3
+#define STEREO_FIRST_EXTRA_BUFFER_INDEX 4
+
+// Position attribute index, SCNVertexSemanticPosition in scn_metal.
+#define STEREO_POSITION_ATTRIBUTE 0
+
+/// Matches OBEStereoUniforms in OpenBE.metal.
+typedef struct {
+    matrix_float4x4 viewProjection[2];
+    matrix_float4x4 projection[2];
+    vector_float4 clipScaleOffset[2];
+    float splitX;
+    uint32_t eyeCount;
+} OBEStereoUniforms;
+
+/// Matches OBEStereoNodeBuffer in OpenBE.metal.
+typedef struct {
+    matrix_float4x4 modelTransform;
+} OBEStereoNodeBuffer;
+
+namespace {
+
+    matrix_float4x4 toSimd( GLKMatrix4 m ) {
+        matrix_float4x4 result;
+        memcpy(&result, m.m, sizeof(result));
+        return result;
+    }
+
+    GLKMatrix4 matrixArgument( NSDictionary *arguments, NSString *key ) {
+        NSValue *value = arguments[key];
+        return value ? SCNMatrix4ToGLKMatrix4(value.SCNMatrix4Value) : GLKMatrix4Identity;
+    }
+
+} // anonymous
+
+@interface StereoRenderer ()
+
+/**
+ * Fill uniforms for this pass.
+ * @return Instances to draw: 2 for both eyes, 1 for this pass's eye, 0 when the right pass will draw both.
+ */
+- (NSUInteger) prepareUniforms:(OBEStereoUniforms *)uniforms
+                      renderer:(SCNRenderer *)renderer
+                     arguments:(NSDictionary *)arguments
+                   skippedLeft:(BOOL *)skippedLeft
+                sharedViewport:(MTLViewport *)sharedViewport
+                   eyeViewport:(MTLViewport *)eyeViewport;
+
+- (id<MTLRenderPipelineState>) pipelineForDraw:(StereoDraw *)draw renderer:(SCNRenderer *)renderer;
+- (id<MTLRenderPipelineState>) pipelineWithVertexFunction:(id<MTLFunction>)vertexFunction
+                                         fragmentFunction:(id<MTLFunction>)fragmentFunction
+                                             vertexStride:(NSUInteger)vertexStride
+                                             vertexOffset:(NSUInteger)vertexOffset
+                                                blendMode:(SCNBlendMode)blendMode
+                                                 renderer:(id<SCNSceneRenderer>)renderer
+                                              sampleCount:(NSUInteger)sampleCount;
+- (id<MTLDepthStencilState>) depthStateForDraw:(StereoDraw *)draw renderer:(SCNRenderer *)renderer;
+- (void) countDraw:(BOOL)singlePass;
+
+@end
+
+#pragma mark - StereoDraw
+
+@interface StereoDraw ()
+@property (nonatomic, readwrite, weak) SCNNode *node;
+@property (nonatomic) id<MTLFunction> vertexFunction;
+@property (nonatomic) id<MTLFunction> fragmentFunction;
+@property (nonatomic) SCNBlendMode blendMode;
+@property (nonatomic) BOOL readsDepth;
+@property (nonatomic) BOOL writesDepth;
+@property (nonatomic) NSUInteger vertexCount;     // Procedural when not 0, no geometry read.
+- (NSUInteger) vertexStride;
+- (NSUInteger) vertexOffset;
+@end
+
+@implementation StereoDraw
+{
+    // Made from the geometry on first draw.
+    id<MTLBuffer> _vertexBuffer;
+    id<MTLBuffer> _indexBuffer;
+    NSUInteger _vertexStride;
+    NSUInteger _vertexOffset;
+    NSUInteger _indexCount;
+    MTLIndexType _indexType;
+    MTLPrimitiveType _primitiveType;
+    BOOL _geometryFailed;
+
+    BOOL _skippedLeft;  // The left pass left this one to the right pass, to draw both eyes.
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _instanceCount = 1;
+    }
+    return self;
+}
+
+- (NSUInteger) vertexStride { return _vertexStride; }
+- (NSUInteger) vertexOffset { return _vertexOffset; }
+
+- (BOOL) prepareGeometryWithDevice:(id<MTLDevice>)device {
+    if( _vertexBuffer ) return YES;
+    if( _geometryFailed ) return NO;
+
+    SCNGeometry *geometry = self.node.geometry;
+    SCNGeometrySource *source = [geometry geometrySourcesForSemantic:SCNGeometrySourceSemanticVertex].firstObject;
+    SCNGeometryElement *element = geometry.geometryElements.firstObject;
+
+    _geometryFailed = source == nil || element == nil || !source.usesFloatComponents || source.componentsPerVector != 3
+        || (element.bytesPerIndex != 2 && element.bytesPerIndex != 4)
+        || (element.primitiveType != SCNGeometryPrimitiveTypeTriangles && element.primitiveType != SCNGeometryPrimitiveTypeTriangleStrip);
+    if( _geometryFailed ) {
+        NSLog(@"StereoRenderer: === Error === %@ needs float3 positions and 16 or 32 bit triangle indices", self.node.name);
+        return NO;
+    }
+
+    _vertexBuffer = [device newBufferWithBytes:source.data.bytes length:source.data.length options:MTLResourceCPUCacheModeWriteCombined];
+    _vertexStride = source.dataStride;
+    _vertexOffset = source.dataOffset;
+
+    _indexBuffer = [device newBufferWithBytes:element.data.bytes length:element.data.length options:MTLResourceCPUCacheModeWriteCombined];
+    _indexType = element.bytesPerIndex == 2 ? MTLIndexTypeUInt16 : MTLIndexTypeUInt32;
+    if( element.primitiveType == SCNGeometryPrimitiveTypeTriangles ) {
+        _primitiveType = MTLPrimitiveTypeTriangle;
+        _indexCount = element.primitiveCount * 3;
+    } else {
+        _primitiveType = MTLPrimitiveTypeTriangleStrip;
+        _indexCount = element.primitiveCount + 2;
+    }
+    return YES;
+}
+
+#pragma mark SCNNodeRendererDelegate
+
+- (void) renderNode:(SCNNode *)node renderer:(SCNRenderer *)renderer arguments:(NSDictionary<NSString *,id> *)arguments {
+    NSString *passName = arguments[@"kRenderPassName"];
+    if( [passName isEqualToString:@"SceneKit_renderSceneFromLight"] ) return;
+
+    id<MTLRenderCommandEncoder> encoder = renderer.currentRenderCommandEncoder;
+    BOOL procedural = _vertexCount > 0;
+    if( encoder == nil || (!procedural && ![self prepareGeometryWithDevice:renderer.device]) ) return;
+
+    StereoRenderer *stereoRenderer = [StereoRenderer main];
+    OBEStereoUniforms uniforms;
+    MTLViewport sharedViewport, eyeViewport;
+    NSUInteger instances = [stereoRenderer prepareUniforms:&uniforms renderer:renderer arguments:arguments
+                                               skippedLeft:&_skippedLeft sharedViewport:&sharedViewport eyeViewport:&eyeViewport];
+    if( instances == 0 || _instanceCount == 0 ) return;
+
+    id<MTLRenderPipelineState> pipeline = [stereoRenderer pipelineForDraw:self renderer:renderer];
+    if( pipeline == nil ) return;
+
+    UniformBlock *properties = self.properties;
+
+    OBEStereoNodeBuffer nodeBuffer;
+    nodeBuffer.modelTransform = toSimd(matrixArgument(arguments, SCNModelTransform));
+
+    [encoder pushDebugGroup:node.name ?: @"StereoDraw"];
+    [encoder setRenderPipelineState:pipeline];
+    [encoder setDepthStencilState:[stereoRenderer depthStateForDraw:self renderer:renderer]];
+    [encoder setCullMode:MTLCullModeNone];
+
+    if( !procedural ) [encoder setVertexBuffer:_vertexBuffer offset:0 atIndex:STEREO_VERTEX_BUFFER_INDEX];
+    [encoder setVertexBytes:&nodeBuffer length:sizeof(nodeBuffer) atIndex:STEREO_NODE_BUFFER_INDEX];
+    if( properties ) {
+        [encoder setVertexBuffer:properties.buffer offset:properties.offset atIndex:STEREO_PROPERTIES_BUFFER_INDEX];
+        [encoder setFragmentBuffer:properties.buffer offset:properties.offset atIndex:STEREO_PROPERTIES_BUFFER_INDEX];
+    }
+    [encoder setVertexBytes:&uniforms length:sizeof(uniforms) atIndex:STEREO_UNIFORMS_BUFFER_INDEX];
+    [encoder setFragmentBytes:&uniforms length:sizeof(uniforms) atIndex:STEREO_UNIFORMS_BUFFER_INDEX];
+    NSUInteger bufferIndex = STEREO_FIRST_EXTRA_BUFFER_INDEX;
+    for( id<MTLBuffer> buffer in _buffers ) {
+        [encoder setVertexBuffer:buffer offset:0 atIndex:bufferIndex];
+        [encoder setFragmentBuffer:buffer offset:0 atIndex:bufferIndex];
+        bufferIndex++;
+    }
+
+    // Both eyes are drawn across the viewport they share, then SceneKit's right eye viewport is put back.
+    if( instances > 1 ) [encoder setViewport:sharedViewport];
+    if( procedural ) {
+        [encoder drawPrimitives:MTLPrimitiveTypeTriangle
+                    vertexStart:0
+                    vertexCount:_vertexCount
+                  instanceCount:instances * _instanceCount];
+    } else {
+        [encoder drawIndexedPrimitives:_primitiveType
+                            indexCount:_indexCount
+                             indexType:_indexType
+                           indexBuffer:_indexBuffer
+                     indexBufferOffset:0
+                         instanceCount:instances * _instanceCount];
+    }
+    if( instances > 1 ) [encoder setViewport:eyeViewport];
+    [encoder popDebugGroup];
+
+    [stereoRenderer countDraw:instances > 1];
+}
+
+@end
+
+#pragma mark - StereoRenderer
+
+@implementation StereoRenderer
+{
+    NSMutableArray<StereoDraw *> *_draws;       // SCNNode doesn't retain its renderer delegate.
+
+    std::mutex _pipelinesMutex;     // Pipelines are also built by warm-up, off the render thread.
+    NSMutableDictionary<NSString *, id<MTLRenderPipelineState>> *_pipelines;
+    id<MTLDepthStencilState> _depthStates[2][2][2]; // [reverseZ][reads][writes]
+
+    // This frame's left eye.
+    GLKMatrix4 _leftView;
+    GLKMatrix4 _leftProjection;
+    CGRect _leftViewport;
+    __weak id<MTLTexture> _leftTarget;
+
+    // From the last right eye pass.
+    BOOL _calibrated;
+    BOOL _sideBySide;
+
+    StereoRendererStats _stats;
+}
+
++ (StereoRenderer *) main {
+    static StereoRenderer *mainStereoRenderer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainStereoRenderer = [[StereoRenderer alloc] init];
+    });
+
+    return mainStereoRenderer;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if( self ) {
+        _singlePassEnabled = NO;     // Until it's verified on device.
+        _draws = [NSMutableArray array];
+        _pipelines = [NSMutableDictionary dictionary];
+        _stats = StereoRendererStats();
+    }
+    return self;
+}
+
+- (StereoDraw *) drawNode:(SCNNode *)node
+       vertexFunctionName:(NSString *)vertexName
+     fragmentFunctionName:(NSString *)fragmentName
+                blendMode:(SCNBlendMode)blendMode
+         readsDepthBuffer:(BOOL)readsDepth
+        writesDepthBuffer:(BOOL)writesDepth {
+    if( node == nil || [SceneManager main].renderingAPI != BEViewRenderingAPIMetal ) return nil;
+
+    id<MTLFunction> vertexFunction = [[ShaderCache main] metalFunctionNamed:[vertexName stringByAppendingString:STEREO_FUNCTION_SUFFIX]];
+    id<MTLFunction> fragmentFunction = [[ShaderCache main] metalFunctionNamed:[fragmentName stringByAppendingString:STEREO_FUNCTION_SUFFIX]];
+    if( vertexFunction == nil || fragmentFunction == nil ) return nil;
+
+    StereoDraw *draw = [[StereoDraw alloc] init];
+    draw.node = node;
+    draw.vertexFunction = vertexFunction;
+    draw.fragmentFunction = fragmentFunction;
+    draw.blendMode = blendMode;
+    draw.readsDepth = readsDepth;
+    draw.writesDepth = writesDepth;
+
+    [_draws addObject:draw];
+    node.rendererDelegate = draw;
+    return draw;
+}
+
+- (StereoDraw *) drawProceduralNode:(SCNNode *)node
+                        vertexCount:(NSUInteger)vertexCount
+                 vertexFunctionName:(NSString *)vertexName
+               fragmentFunctionName:(NSString *)fragmentName
+                          blendMode:(SCNBlendMode)blendMode
+                   readsDepthBuffer:(BOOL)readsDepth
+                  writesDepthBuffer:(BOOL)writesDepth {
+    be_assert(vertexCount > 0 && vertexCount % 3 == 0);
+
+    StereoDraw *draw = [self drawNode:node
+                   vertexFunctionName:vertexName
+                 fragmentFunctionName:fragmentName
+                            blendMode:blendMode
+                     readsDepthBuffer:readsDepth
+                    writesDepthBuffer:writesDepth];
+    draw.vertexCount = vertexCount;
+    return draw;
+}
+
+- (void) removeDraw:(StereoDraw *)draw {
+    if( draw == nil ) return;
+
+    SCNNode *node = draw.node;
+    if( node.rendererDelegate == draw ) node.rendererDelegate = nil;
+    [_draws removeObject:draw];
+}
+
+#pragma mark - Eyes
+
+- (NSUInteger) prepareUniforms:(OBEStereoUniforms *)uniforms
+                      renderer:(SCNRenderer *)renderer
+                     arguments:(NSDictionary *)arguments
+                   skippedLeft:(BOOL *)skippedLeft
+                sharedViewport:(MTLViewport *)sharedViewport
+                   eyeViewport:(MTLViewport *)eyeViewport {
+    NSString *passName = arguments[@"kRenderPassName"];
+    BOOL isLeft = [passName isEqualToString:@"sceneLeft"];
+    BOOL isRight = [passName isEqualToString:@"sceneRight"];
+
+    GLKMatrix4 view = matrixArgument(arguments, SCNViewTransform);
+    GLKMatrix4 projection = matrixArgument(arguments, SCNProjectionTransform);
+
+    // The viewport is needed to share it between eyes, only reported from iOS 11.
+    BOOL hasViewport = [renderer respondsToSelector:@selector(currentViewport)];
+    CGRect viewport = hasViewport ? renderer.currentViewport : CGRectZero;
+    id<MTLTexture> target = renderer.currentRenderPassDescriptor.colorAttachments[0].texture;
+
+    uniforms->viewProjection[0] = toSimd(GLKMatrix4Multiply(projection, view));
+    uniforms->projection[0] = toSimd(projection);
+    uniforms->clipScaleOffset[0] = simd_make_float4(1, 0, 0, 0);
+    uniforms->splitX = 0;
+    uniforms->eyeCount = 1;
+
+    if( isLeft ) {
+        _leftView = view;
+        _leftProjection = projection;
+        _leftViewport = viewport;
+        _leftTarget = target;
+
+        // Both eyes are drawn in the right pass, the last one, so SceneKit draws nothing over the left eye's image after.
+        _singlePassActive = _singlePassEnabled && _calibrated && _sideBySide;
+        *skippedLeft = _singlePassActive;
+        return _singlePassActive ? 0 : 1;
+    }
+    if( !isRight ) {
+        _singlePassActive = NO;
+        *skippedLeft = NO;
+        return 1;
+    }
+
+    _sideBySide = hasViewport && target != nil && target == _leftTarget
+        && CGRectGetMinY(viewport) == CGRectGetMinY(_leftViewport)
+        && CGRectGetHeight(viewport) == CGRectGetHeight(_leftViewport)
+        && fabs(CGRectGetMinX(viewport) - CGRectGetMaxX(_leftViewport)) < 0.5;
+    _calibrated = YES;
+
+    // Only the right eye if the left pass drew it, or the eyes stopped sharing a target; then the left eye misses this frame.
+    BOOL singlePass = *skippedLeft && _sideBySide;
+    *skippedLeft = NO;
+    if( !singlePass ) return 1;
+
+    // The left eye as it was drawn this frame, then ours.
+    uniforms->viewProjection[0] = toSimd(GLKMatrix4Multiply(_leftProjection, _leftView));
+    uniforms->projection[0] = toSimd(_leftProjection);
+    uniforms->viewProjection[1] = toSimd(GLKMatrix4Multiply(projection, view));
+    uniforms->projection[1] = toSimd(projection);
+
+    // Each eye's NDC x, squeezed into its side of the shared viewport.
+    CGRect shared = CGRectUnion(_leftViewport, viewport);
+    CGFloat halfWidth = CGRectGetWidth(shared) * 0.5;
+    CGRect eyes[2] = { _leftViewport, viewport };
+    for( int eye=0; eye<2; eye++ ) {
+        uniforms->clipScaleOffset[eye] = simd_make_float4((float)(CGRectGetWidth(eyes[eye]) / CGRectGetWidth(shared)),
+                                                          (float)((CGRectGetMidX(eyes[eye]) - CGRectGetMidX(shared)) / halfWidth),
+                                                          0, 0);
+    }
+    uniforms->splitX = (float)CGRectGetMinX(viewport);
+    uniforms->eyeCount = 2;
+
+    *sharedViewport = (MTLViewport){ shared.origin.x, shared.origin.y, shared.size.width, shared.size.height, 0, 1 };
+    *eyeViewport = (MTLViewport){ viewport.origin.x, viewport.origin.y, viewport.size.width, viewport.size.height, 0, 1 };
+    return 2;
+}
+
+#pragma mark - Pipelines
+
+- (void) warmUpVertexFunctionName:(NSString *)vertexName
+             fragmentFunctionName:(NSString *)fragmentName
+                        blendMode:(SCNBlendMode)blendMode
+                       procedural:(BOOL)procedural
+                         renderer:(id<SCNSceneRenderer>)renderer {
+    id<MTLFunction> vertexFunction = [[ShaderCache main] metalFunctionNamed:[vertexName stringByAppendingString:STEREO_FUNCTION_SUFFIX]];
+    id<MTLFunction> fragmentFunction = [[ShaderCache main] metalFunctionNamed:[fragmentName stringByAppendingString:STEREO_FUNCTION_SUFFIX]];
+    if( vertexFunction == nil || fragmentFunction == nil || renderer.device == nil ) return;
+
+    // Positions as geometrySourceWithVertices: lays them out, into SceneKit's single sampled eye targets.
+    [self pipelineWithVertexFunction:vertexFunction
+                    fragmentFunction:fragmentFunction
+                        vertexStride:procedural ? 0 : sizeof(SCNVector3)
+                        vertexOffset:0
+                           blendMode:blendMode
+                            renderer:renderer
+                         sampleCount:1];
+}
+
+- (id<MTLRenderPipelineState>) pipelineForDraw:(StereoDraw *)draw renderer:(SCNRenderer *)renderer {
+    id<MTLTexture> target = renderer.currentRenderPassDescriptor.colorAttachments[0].texture;
+    return [self pipelineWithVertexFunction:draw.vertexFunction
+                           fragmentFunction:draw.fragmentFunction
+                               vertexStride:draw.vertexStride
+                               vertexOffset:draw.vertexOffset
+                                  blendMode:draw.blendMode
+                                   renderer:renderer
+                                sampleCount:target ? target.sampleCount : 1];
+}
+
+- (id<MTLRenderPipelineState>) pipelineWithVertexFunction:(id<MTLFunction>)vertexFunction
+                                         fragmentFunction:(id<MTLFunction>)fragmentFunction
+                                             vertexStride:(NSUInteger)vertexStride
+                                             vertexOffset:(NSUInteger)vertexOffset
+                                                blendMode:(SCNBlendMode)blendMode
+                                                 renderer:(id<SCNSceneRenderer>)renderer
+                                              sampleCount:(NSUInteger)sampleCount {
+    NSString *key = [NSString stringWithFormat:@"%@|%@|%lu|%lu|%ld|%lu|%lu|%lu|%lu",
+                     vertexFunction.name, fragmentFunction.name,
+                     (unsigned long)vertexStride, (unsigned long)vertexOffset, (long)blendMode,
+                     (unsigned long)renderer.colorPixelFormat, (unsigned long)renderer.depthPixelFormat,
+                     (unsigned long)renderer.stencilPixelFormat, (unsigned long)sampleCount];
+    {
+        std::lock_guard<std::mutex> lock(_pipelinesMutex);
+        id<MTLRenderPipelineState> pipeline = _pipelines[key];
+        if( pipeline ) return pipeline;
+    }
+
+    MTLRenderPipelineDescriptor *descriptor = [[MTLRenderPipelineDescriptor alloc] init];
+    descriptor.label = key;
+    descriptor.vertexFunction = vertexFunction;
+    descriptor.fragmentFunction = fragmentFunction;
+
+    // Procedural draws, with a 0 stride, read no vertex attributes.
+    if( vertexStride > 0 ) {
+        MTLVertexDescriptor *vertexDescriptor = [MTLVertexDescriptor vertexDescriptor];
+        vertexDescriptor.attributes[STEREO_POSITION_ATTRIBUTE].format = MTLVertexFormatFloat3;
+        vertexDescriptor.attributes[STEREO_POSITION_ATTRIBUTE].offset = vertexOffset;
+        vertexDescriptor.attributes[STEREO_POSITION_ATTRIBUTE].bufferIndex = STEREO_VERTEX_BUFFER_INDEX;
+        vertexDescriptor.layouts[STEREO_VERTEX_BUFFER_INDEX].stride = vertexStride;
+        descriptor.vertexDescriptor = vertexDescriptor;
+    }
+    descriptor.sampleCount = sampleCount;
+    descriptor.depthAttachmentPixelFormat = renderer.depthPixelFormat;
+    descriptor.stencilAttachmentPixelFormat = renderer.stencilPixelFormat;
+
+    MTLRenderPipelineColorAttachmentDescriptor *color = descriptor.colorAttachments[0];
+    color.pixelFormat = renderer.colorPixelFormat;
+    switch( blendMode ) {
+        case SCNBlendModeAlpha:
+            color.blendingEnabled = YES;
+            color.sourceRGBBlendFactor = MTLBlendFactorSourceAlpha;
+            color.destinationRGBBlendFactor = MTLBlendFactorOneMinusSourceAlpha;
+            color.sourceAlphaBlendFactor = MTLBlendFactorOne;
+            color.destinationAlphaBlendFactor = MTLBlendFactorOneMinusSourceAlpha;
+            break;
+        case SCNBlendModeAdd:
+            color.blendingEnabled = YES;
+            color.sourceRGBBlendFactor = MTLBlendFactorSourceAlpha;
+            color.destinationRGBBlendFactor = MTLBlendFactorOne;
+            color.sourceAlphaBlendFactor = MTLBlendFactorSourceAlpha;
+            color.destinationAlphaBlendFactor = MTLBlendFactorOne;
+            break;
+        default:
+            color.blendingEnabled = NO;
+            break;
+    }
+
+    NSError *error = nil;
+    id<MTLRenderPipelineState> pipeline = [renderer.device newRenderPipelineStateWithDescriptor:descriptor error:&error];
+    if( pipeline == nil ) {
+        NSLog(@"StereoRenderer: === Error === Can't build pipeline %@: %@", key, error);
+        return nil;
+    }
+
+    std::lock_guard<std::mutex> lock(_pipelinesMutex);
+    _pipelines[key] = pipeline;
+    _stats.pipelines = _pipelines.count;
+    return pipeline;
+}
+
+- (id<MTLDepthStencilState>) depthStateForDraw:(StereoDraw *)draw renderer:(SCNRenderer *)renderer {
+    // SceneKit reverses depth by default from iOS 13, nearer is then greater.
+    BOOL reverseZ = NO;
+    if( @available(iOS 13.0, *) ) reverseZ = renderer.usesReverseZ;
+
+    id<MTLDepthStencilState> __strong &state = _depthStates[reverseZ ? 1 : 0][draw.readsDepth ? 1 : 0][draw.writesDepth ? 1 : 0];
+    if( state == nil ) {
+        MTLDepthStencilDescriptor *descriptor = [[MTLDepthStencilDescriptor alloc] init];
+        MTLCompareFunction nearer = reverseZ ? MTLCompareFunctionGreaterEqual : MTLCompareFunctionLessEqual;
+        descriptor.depthCompareFunction = draw.readsDepth ? nearer : MTLCompareFunctionAlways;
+        descriptor.depthWriteEnabled = draw.writesDepth;
+        state = [renderer.device newDepthStencilStateWithDescriptor:descriptor];
+    }
+    return state;
+}
+
+#pragma mark - Stats
+
+- (void) countDraw:(BOOL)singlePass {
+    _stats.draws++;
+    if( singlePass ) _stats.singlePassDraws++;
+}
+
+- (StereoRendererStats) stats {
+    return _stats;
+}
+
+@end
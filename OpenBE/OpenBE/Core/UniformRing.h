@@ -0,0 +1,72 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Persistent uniform storage for OpenBE's Metal shaders.
+//
+//  Blocks are reserved once, in shared Metal buffers that stay mapped, and
+//  hold UNIFORM_RING_FRAMES copies of their uniforms. The first update of a
+//  frame writes the next copy, so the GPU can still be reading the previous
+//  frames' while the CPU writes this one. Frames are counted by the ring,
+//  advanced once per frame by the SceneManager; later updates in the same
+//  frame write the same copy again, however many draws or eyes ask for it.
+//
+//  Every copy is wrapped in an NSData made when the block is reserved, for
+//  APIs that take uniforms as NSData (SCNMaterial values, BridgeEngine custom
+//  uniforms), so updating uniforms never allocates.
+//
+//  Reserving is THREAD SAFE. A block is updated and drawn from the render thread.
+//
+
+#import <Foundation/Foundation.h>
+#import <Metal/Metal.h>
+
+// Copies per block, frames the GPU may be behind the CPU.
+#define UNIFORM_RING_FRAMES 3
+
+@interface UniformBlock : NSObject
+
+@property (nonatomic, readonly) NSUInteger length;
+
+/**
+ * Copy bytes, length of them, into this frame's copy, the next one on the first update of a frame.
+ * Returns its NSData, made once. Draws of a frame share its copy, so they all see its last update.
+ */
+- (NSData *) update:(const void *)bytes;
+
+/// The current copy, for binding to an encoder.
+@property (nonatomic, readonly) id<MTLBuffer> buffer;
+@property (nonatomic, readonly) NSUInteger offset;
+@property (nonatomic, readonly) NSData *data;
+
+@end
+
+@interface UniformRing : NSObject
+
+/// Singleton, on the system default device.
++ (UniformRing *) main;
+
+- (instancetype) initWithDevice:(id<MTLDevice>)device;
+
+/// Reserve a block of uniforms for good. Starts zeroed.
+- (UniformBlock *) reserveBlockWithLength:(NSUInteger)length;
+
+/**
+ * Start a new frame, so each block's next update moves on to its next copy.
+ * RENDER THREAD ONLY - called once per frame by SceneManager.
+ */
+- (void) advanceFrame;
+
+/// Frames advanced so far.
+@property (nonatomic, readonly) NSUInteger frame;
+
+/// Bytes reserved, including every copy and alignment.
+@property (nonatomic, readonly) NSUInteger reservedBytes;
+
+@end
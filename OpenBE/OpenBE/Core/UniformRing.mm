@@ -0,0 +1,143 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "UniformRing.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+#include <cstring>
+#include <mutex>
+
+// Size of each shared Metal buffer blocks are reserved from.
+#define UNIFORM_RING_CHUNK_SIZE (16 * 1024)
+
+// Buffer offsets bound for constant data must be aligned to this, on every GPU family.
+#define UNIFORM_RING_ALIGNMENT 256
+
+namespace {
+
+    NSUInteger alignUp( NSUInteger value, NSUInteger alignment ) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+} // anonymous
+
+@interface UniformBlock ()
+- (instancetype) initWithRing:(UniformRing *)ring buffer:(id<MTLBuffer>)buffer offset:(NSUInteger)offset stride:(NSUInteger)stride length:(NSUInteger)length;
+@end
+
+@implementation UniformBlock
+{
+    UniformRing *_ring;
+    id<MTLBuffer> _buffer;
+    NSUInteger _offsets[UNIFORM_RING_FRAMES];
+    NSData *_copies[UNIFORM_RING_FRAMES];
+    NSUInteger _current;
+    NSUInteger _currentFrame;   // Ring frame _current was moved to.
+}
+
+- (instancetype) initWithRing:(UniformRing *)ring buffer:(id<MTLBuffer>)buffer offset:(NSUInteger)offset stride:(NSUInteger)stride length:(NSUInteger)length {
+    self = [super init];
+    if( self ) {
+        _ring = ring;
+        _buffer = buffer;
+        _length = length;
+        _currentFrame = NSUIntegerMax;
+
+        uint8_t *contents = (uint8_t *)buffer.contents;
+        for( NSUInteger i=0; i<UNIFORM_RING_FRAMES; i++ ) {
+            _offsets[i] = offset + i * stride;
+            memset(contents + _offsets[i], 0, length);
+            _copies[i] = [NSData dataWithBytesNoCopy:contents + _offsets[i] length:length freeWhenDone:NO];
+        }
+    }
+    return self;
+}
+
+- (NSData *) update:(const void *)bytes {
+    NSUInteger frame = _ring.frame;
+    if( frame != _currentFrame ) {
+        _current = (_current + 1) % UNIFORM_RING_FRAMES;
+        _currentFrame = frame;
+    }
+    memcpy((uint8_t *)_buffer.contents + _offsets[_current], bytes, _length);
+    return _copies[_current];
+}
+
+- (id<MTLBuffer>) buffer {
+    return _buffer;
+}
+
+- (NSUInteger) offset {
+    return _offsets[_current];
+}
+
+- (NSData *) data {
+    return _copies[_current];
+}
+
+@end
+
+@implementation UniformRing
+{
+    std::mutex _mutex;
+    id<MTLDevice> _device;
+    id<MTLBuffer> _chunk;       // Blocks are reserved from here, until it's full.
+    NSUInteger _chunkUsed;
+}
+
++ (UniformRing *) main {
+    static UniformRing *mainRing = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainRing = [[UniformRing alloc] initWithDevice:MTLCreateSystemDefaultDevice()];
+    });
+
+    return mainRing;
+}
+
+- (instancetype) initWithDevice:(id<MTLDevice>)device {
+    self = [super init];
+    if( self ) {
+        _device = device;
+    }
+    return self;
+}
+
+- (UniformBlock *) reserveBlockWithLength:(NSUInteger)length {
+    be_assert(length > 0);
+    if( _device == nil ) return nil;
+
+    const NSUInteger stride = alignUp(length, UNIFORM_RING_ALIGNMENT);
+    const NSUInteger size = stride * UNIFORM_RING_FRAMES;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Too big to share a chunk, it gets a buffer of its own.
+    if( size > UNIFORM_RING_CHUNK_SIZE ) {
+        id<MTLBuffer> buffer = [_device newBufferWithLength:size options:MTLResourceStorageModeShared];
+        _reservedBytes += size;
+        return [[UniformBlock alloc] initWithRing:self buffer:buffer offset:0 stride:stride length:length];
+    }
+
+    if( _chunk == nil || _chunkUsed + size > UNIFORM_RING_CHUNK_SIZE ) {
+        _chunk = [_device newBufferWithLength:UNIFORM_RING_CHUNK_SIZE options:MTLResourceStorageModeShared];
+        _chunk.label = @"OpenBE Uniforms";
+        _chunkUsed = 0;
+    }
+
+    UniformBlock *block = [[UniformBlock alloc] initWithRing:self buffer:_chunk offset:_chunkUsed stride:stride length:length];
+    _chunkUsed += size;
+    _reservedBytes += size;
+    return block;
+}
+
+- (void) advanceFrame {
+    _frame++;
+}
+
+@end
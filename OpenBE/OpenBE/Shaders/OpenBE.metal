@@ -24,71 +24,125 @@ float2 hash21(float p)
     return fract(float2((p3.x + p3.y)*p3.z, (p3.x+p3.z)*p3.y));
 }
 
-#pragma mark - Scan Beam Shader
-
-struct OBEScanBeamVertexIn {
-    float3 position [[ attribute(SCNVertexSemanticPosition) ]];
+#pragma mark - Instanced Stereo
+
+/// Both eyes, drawn by StereoRenderer as two instances of one draw. Matches OBEStereoUniforms in StereoRenderer.mm.
+struct OBEStereoUniforms {
+    float4x4 viewProjection[2];
+    float4x4 projection[2];
+    float4 clipScaleOffset[2];  // x: scale, y: offset of each eye's NDC x in the shared viewport.
+    float splitX;               // Window x between the eyes, in pixels.
+    uint eyeCount;              // 1 in mono, or when each eye is drawn in its own pass.
 };
 
-struct OBEScanBeamVertexOut {
-    float4 position [[ position ]];
-    float2 uv [[ attribute(SCNVertexSemanticTexcoord0) ]];
+struct OBEStereoNodeBuffer {
+    float4x4 modelTransform;
 };
 
-struct OBEScanBeamNodeBuffer {
-    float4x4 modelViewProjectionTransform;
-};
+/// Instance IDs run through every eye of each copy the draw repeats.
+uint obeStereoEye(uint instanceID, constant OBEStereoUniforms& stereo)
+{
+    return instanceID % stereo.eyeCount;
+}
+
+/// Which copy, for draws repeated with StereoDraw's instanceCount.
+uint obeStereoInstance(uint instanceID, constant OBEStereoUniforms& stereo)
+{
+    return instanceID / stereo.eyeCount;
+}
 
-struct OBEScanBeamProperties {
-    float3 startPos;// Starting beam position
-    float3 endPos;  // End beam position
-    float width;    // Max beam displacement width
-    float height;   // Max beam displacement height
-    float active;   // How bright and active is the beam
+/// Squeeze an eye's clip position into its side of the viewport shared by both eyes.
+float4 obeStereoPlaceInEye(float4 position, uint eye, constant OBEStereoUniforms& stereo)
+{
+    float4 scaleOffset = stereo.clipScaleOffset[eye];
+    position.x = position.x * scaleOffset.x + scaleOffset.y * position.w;
+    return position;
+}
+
+/// Primitives squeezed into one eye can spill over into the other, drop those fragments.
+bool obeStereoOutsideEye(float4 fragPosition, uint eye, constant OBEStereoUniforms& stereo)
+{
+    return stereo.eyeCount > 1 && ((fragPosition.x < stereo.splitX) != (eye == 0));
+}
+
+#pragma mark - Scan Beam Shader
+
+/// One beam, packed. Matches OBEBeamInstance in BeamRenderer.mm.
+struct OBEBeamInstance {
+    float4x4 modelTransform;    // Beam node's world transform.
+    float4 start;               // xyz: starting beam position, w: max beam displacement width.
+    float4 end;                 // xyz: end beam position, w: max beam displacement height.
+    float4 params;              // x: how bright and active is the beam, y: hash seed.
 };
 
-vertex OBEScanBeamVertexOut OBEScanBeamVertex(
-    OBEScanBeamVertexIn in [[ stage_in ]],
-//    constant SCNSceneBuffer& scn_frame [[buffer(0)]],
-    constant OBEScanBeamNodeBuffer& scn_node [[buffer(1)]],
-    constant OBEScanBeamProperties& beam [[buffer(2)]] )
+/// Clip position of a beam vertex, jagged along the line from start to end.
+/// corner.x runs along the beam, corner.y and the triangle pick its displacement.
+float4 obeScanBeamPosition(float2 corner, uint triangle, float4x4 modelViewProjectionTransform, OBEBeamInstance beam)
 {
-    OBEScanBeamVertexOut out;
+    float4 startPosScreen = modelViewProjectionTransform * float4(beam.start.xyz, 1.0);
     
-    float4 startPosScreen = scn_node.modelViewProjectionTransform * float4(beam.startPos, 1.0);
-    
-    float3 pos = beam.endPos;
+    float3 pos = beam.end.xyz;
 
     // Calculate our perpendiculars to our beam line.
-    float3 forward = normalize(beam.endPos-beam.startPos);
+    float3 forward = normalize(beam.end.xyz-beam.start.xyz);
     float3 up = normalize( cross( forward, float3(0,1,0) ) );
     float3 right = normalize( cross( up, forward ));
     up = normalize( cross( forward, right ) );
 
     /// Use a hashing function to create jagged displacements along the beam line.
-    float2 h = 2.*(hash21(in.position.z + in.position.y)-.5);
-    pos += up * (beam.width * h.x) + right * (beam.height * h.y);
-    
-    float4 endPosScreen = scn_node.modelViewProjectionTransform * float4(pos, 1.0);
+    float2 h = 2.*(hash21(float(triangle) + corner.y + beam.params.y)-.5);
+    pos += up * (beam.start.w * h.x) + right * (beam.end.w * h.y);
     
+    float4 endPosScreen = modelViewProjectionTransform * float4(pos, 1.0);
     
-    out.position = mix( startPosScreen, endPosScreen, in.position.x );
+    return mix( startPosScreen, endPosScreen, corner.x );
+}
+
+half4 obeScanBeamColor(float2 uv, float active)
+{
+    float2 alpha  = smoothstep( float2(0.), float2(.1,.4), uv) * smoothstep( float2(1.), float2(.8, .6), uv);
+    float lum = smoothstep( 0., .2, active) * smoothstep( 1., .5, active);
     
-    //   out.position.z = 0.001;
+    return half4( .5, .7, 1., .5 ) * (alpha.x * alpha.y * lum);
+}
+
+struct OBEBeamInstancedVertexOut {
+    float4 position [[ position ]];
+    float2 uv;
+    float active [[ flat ]];
+    uint eye [[ flat ]];
+};
+
+/// Every beam the BeamRenderer draws, in one draw without vertex buffers.
+/// Each triangle's corners are (0,0), (1,1), (1,0), picked by the vertex ID.
+vertex OBEBeamInstancedVertexOut OBEBeamVertexInstanced(
+    constant OBEStereoNodeBuffer& node [[buffer(1)]],
+    constant OBEBeamInstance* beams [[buffer(2)]],
+    constant OBEStereoUniforms& stereo [[buffer(3)]],
+    uint vid [[ vertex_id ]],
+    uint iid [[ instance_id ]] )
+{
+    OBEBeamInstancedVertexOut out;
     
-    out.uv = in.position.xy;
+    OBEBeamInstance beam = beams[obeStereoInstance(iid, stereo)];
+    uint corner = vid % 3;
+    float2 position = float2(corner == 0 ? 0. : 1., corner == 1 ? 1. : 0.);
+
+    out.eye = obeStereoEye(iid, stereo);
+    float4x4 modelViewProjection = stereo.viewProjection[out.eye] * node.modelTransform * beam.modelTransform;
+    out.position = obeStereoPlaceInEye(obeScanBeamPosition(position, vid / 3, modelViewProjection, beam), out.eye, stereo);
+    out.uv = position;
+    out.active = beam.params.x;
 
     return out;
 }
 
-fragment half4 OBEScanBeamFragment(
-   OBEScanBeamVertexOut in [[ stage_in ]],
-   constant OBEScanBeamProperties& beam [[buffer(2)]] )
+fragment half4 OBEBeamFragmentInstanced(
+   OBEBeamInstancedVertexOut in [[ stage_in ]],
+   constant OBEStereoUniforms& stereo [[buffer(3)]] )
 {
-    float2 alpha  = smoothstep( float2(0.), float2(.1,.4), in.uv) * smoothstep( float2(1.), float2(.8, .6), in.uv);
-    float lum = smoothstep( 0., .2, beam.active) * smoothstep( 1., .5, beam.active);
-    
-    return half4( .5, .7, 1., .5 ) * (alpha.x * alpha.y * lum);
+    if( obeStereoOutsideEye(in.position, in.eye, stereo) ) discard_fragment();
+    return obeScanBeamColor(in.uv, in.active);
 }
 
 //struct
@@ -112,38 +166,28 @@ struct OBEFixedSizeReticleProperties {
     float active;
 };
 
-vertex OBEFixedSizeReticleVertexOut OBEFixedSizeReticleVertex(
-      OBEFixedSizeReticleVertexIn in [[ stage_in ]],
-      constant SCNSceneBuffer& scn_frame [[buffer(0)]],
-      constant OBEFixedSizeReticleNodeBuffer& scn_node [[buffer(1)]] )
+/// Clip position of a reticle corner, a fixed size on screen around the node's origin.
+float4 obeFixedSizeReticlePosition(float3 position, float4x4 modelViewProjectionTransform, float4x4 projection)
 {
-    OBEFixedSizeReticleVertexOut out;
-    
     // Start at dead-center, but get the clip space projection.
-    out.position = scn_node.modelViewProjectionTransform * float4(0,0,0,1);
+    float4 out = modelViewProjectionTransform * float4(0,0,0,1);
     
-    float4x4 projection = scn_frame.projectionTransform;
-    float2 offset = in.position.xy;
+    float2 offset = position.xy;
     // Account for render target aspect ratio
     offset.y *= fabs( projection[1].y / projection[0].x);
     
     // Apply clip-space projection to the screen offset
-    out.position.xy += offset * out.position.w;
+    out.xy += offset * out.w;
 
     // Nearest z, but it's really not needed.
-    out.position.z = 0;
-
-    // Get the normalized 4-corners of the quad by using the sign of each vertex position.
-    out.uv = sign(in.position.xy);
+    out.z = 0;
     
     return out;
 }
 
-fragment half4 OBEFixedSizeReticleFragment(
-    OBEFixedSizeReticleVertexOut in [[ stage_in ]],
-    constant OBEFixedSizeReticleProperties& reticle_properties [[buffer(2)]] )
+half4 obeFixedSizeReticleColor(float2 uv, constant OBEFixedSizeReticleProperties& reticle_properties)
 {
-    float r = length(in.uv);
+    float r = length(uv);
     
     // Light Green when active, white when inactive.
     float3 activeBlend = reticle_properties.active>.5 ? float3( .7,1.,.7):float3(1.);
@@ -158,6 +202,59 @@ fragment half4 OBEFixedSizeReticleFragment(
     return half4(col.x, col.y, col.z, alpha);
 }
 
+vertex OBEFixedSizeReticleVertexOut OBEFixedSizeReticleVertex(
+      OBEFixedSizeReticleVertexIn in [[ stage_in ]],
+      constant SCNSceneBuffer& scn_frame [[buffer(0)]],
+      constant OBEFixedSizeReticleNodeBuffer& scn_node [[buffer(1)]] )
+{
+    OBEFixedSizeReticleVertexOut out;
+    
+    out.position = obeFixedSizeReticlePosition(in.position, scn_node.modelViewProjectionTransform, scn_frame.projectionTransform);
+
+    // Get the normalized 4-corners of the quad by using the sign of each vertex position.
+    out.uv = sign(in.position.xy);
+    
+    return out;
+}
+
+fragment half4 OBEFixedSizeReticleFragment(
+    OBEFixedSizeReticleVertexOut in [[ stage_in ]],
+    constant OBEFixedSizeReticleProperties& reticle_properties [[buffer(2)]] )
+{
+    return obeFixedSizeReticleColor(in.uv, reticle_properties);
+}
+
+struct OBEFixedSizeReticleInstancedVertexOut {
+    float4 position [[ position ]];
+    float2 uv;
+    uint eye [[ flat ]];
+};
+
+vertex OBEFixedSizeReticleInstancedVertexOut OBEFixedSizeReticleVertexInstanced(
+      OBEFixedSizeReticleVertexIn in [[ stage_in ]],
+      constant OBEStereoNodeBuffer& node [[buffer(1)]],
+      constant OBEStereoUniforms& stereo [[buffer(3)]],
+      uint iid [[ instance_id ]] )
+{
+    OBEFixedSizeReticleInstancedVertexOut out;
+    
+    out.eye = obeStereoEye(iid, stereo);
+    float4 position = obeFixedSizeReticlePosition(in.position, stereo.viewProjection[out.eye] * node.modelTransform, stereo.projection[out.eye]);
+    out.position = obeStereoPlaceInEye(position, out.eye, stereo);
+    out.uv = sign(in.position.xy);
+    
+    return out;
+}
+
+fragment half4 OBEFixedSizeReticleFragmentInstanced(
+    OBEFixedSizeReticleInstancedVertexOut in [[ stage_in ]],
+    constant OBEFixedSizeReticleProperties& reticle_properties [[buffer(2)]],
+    constant OBEStereoUniforms& stereo [[buffer(3)]] )
+{
+    if( obeStereoOutsideEye(in.position, in.eye, stereo) ) discard_fragment();
+    return obeFixedSizeReticleColor(in.uv, reticle_properties);
+}
+
 #pragma mark - Projection Shader
 // This shader is used to make an object look like a projection.
 
@@ -214,20 +311,17 @@ struct BECustomEnvironmentShaderUniforms
     matrix_float4x4 modelViewMatrix;
 };
 
+// Bridge Engine only binds customUniforms to the vertex stage, so the vertex hands the fragment
+// one flat value and the fragment's position relative to the scan, instead of a copy of the uniforms.
 struct OBEScanEnvironmentOut {
     float4 position [[position]];
-    float3 worldPosition;
-    
-    float scanTime;
-    float scanDuration;
-    float scanRadius;
-    float3 scanLocation;
+    float4 scan;                    // xyz: position - scanLocation, w: position.y.
+    float maxDist [[flat]];         // Reach of the scan, after fading in and out.
 };
 
+// Matches OBEScanEnvironmentUniformsMetal in ScanEnvironmentShader.mm
 struct OBEScanEnvironmentUniformsMetal {
-    float scanTime;
-    float scanDuration;
-    float scanRadius;
+    float maxDist;
     float3 scanLocation;
 };
 
@@ -239,13 +333,10 @@ vertex OBEScanEnvironmentOut OBEScanEnvironmentVertex(const device packed_float3
 {
     OBEScanEnvironmentOut vertOut;
     
-    vertOut.worldPosition = vertex_array[vid];
-    vertOut.position = uniforms.projectionMatrix * uniforms.modelViewMatrix * float4(vertOut.worldPosition, 1.0);
-    
-    vertOut.scanTime = customUniforms.scanTime;
-    vertOut.scanDuration = customUniforms.scanDuration;
-    vertOut.scanRadius = customUniforms.scanRadius;
-    vertOut.scanLocation = customUniforms.scanLocation;
+    float3 worldPosition = vertex_array[vid];
+    vertOut.position = uniforms.projectionMatrix * uniforms.modelViewMatrix * float4(worldPosition, 1.0);
+    vertOut.scan = float4(worldPosition - customUniforms.scanLocation, worldPosition.y);
+    vertOut.maxDist = customUniforms.maxDist;
     
     return vertOut;
 }
@@ -253,22 +344,16 @@ vertex OBEScanEnvironmentOut OBEScanEnvironmentVertex(const device packed_float3
 fragment half4 OBEScanEnvironmentFragment(OBEScanEnvironmentOut fragIn [[stage_in]])
 {
     const float LinesPerMeter = 25.0;
-    const float ScanPeakDuration = 0.1;
-    const float ScanFadeDuration = 1.0;
     
-    float4 fragPos = float4(fragIn.worldPosition, 1.0);
-
-    // Calculate the decay parameters related to scanning time (0 min, to ScanRampDuration peak, to 1.0 sec min)
-    float strength = smoothstep( 0.0, ScanPeakDuration, fragIn.scanTime) * (1.0 - smoothstep( fragIn.scanDuration - ScanFadeDuration, fragIn.scanDuration, fragIn.scanTime));
-    float maxDist = fragIn.scanRadius * strength;
+    float maxDist = fragIn.maxDist;
 
-    float disty = fragIn.scanLocation.y - fragPos.y;
-    float dist = distance( fragPos.xz, fragIn.scanLocation.xz ) + (step(disty, -0.5) + step(0.5, disty)) * 10.0;
+    float disty = -fragIn.scan.y;
+    float dist = length( fragIn.scan.xz ) + (step(disty, -0.5) + step(0.5, disty)) * 10.0;
      
     float distanceFromScanPoint = clamp(1.0 - smoothstep(0.5 * maxDist, maxDist, dist), 0.0, 1.0);
      
     // worldStableScanY refers to the scanning lines.
-    float worldStableScanY = (fragPos.y) * LinesPerMeter;
+    float worldStableScanY = fragIn.scan.w * LinesPerMeter;
     float emissionAmount = (1.0 - smoothstep( 0., 0.15, abs( fract( worldStableScanY ) - .5) ));
     
     /* This color has been converted from sRGB to Linear space so it looks correct in metal (vs. the opengl shader)
@@ -284,3 +369,182 @@ fragment half4 OBEScanEnvironmentFragment(OBEScanEnvironmentOut fragIn [[stage_i
     
     return half4(float4(color, alpha));
 }
+
+
+#pragma mark - Environment Texturing
+
+/// Texels on a side of a cell. Matches ENVIRONMENT_TEXTURER_CELL_SIZE in EnvironmentTexturer.h.
+constant uint OBEEnvironmentCellSize = 6;
+
+/// Pulls the textured mesh in front of Bridge Engine's depth for the same mesh, in clip z per w.
+constant float OBEEnvironmentDepthNudge = 0.0001;
+
+/// One color keyframe. Matches OBEEnvironmentKeyframe in EnvironmentTexturer.mm.
+struct OBEEnvironmentKeyframe {
+    float4x4 viewProjection;    // Color camera at the frame, Metal clip space.
+    float4 cameraPosition;      // xyz: color camera position.
+    uint triangleCount;
+    float maxWeight;            // Accumulated weight stops here, so later keyframes still show.
+    float depthBias;            // NDC a texel can be behind the keyframe's depth.
+};
+
+/// Matches OBEEnvironmentUniforms in EnvironmentTexturer.mm.
+struct OBEEnvironmentUniforms {
+    float4x4 liveViewProjection;    // Color camera this frame, Metal clip space.
+    float liveMargin;               // NDC from the frame's edge over which the live image fades in.
+    float coverageScale;            // Texel alpha to coverage.
+};
+
+/// Texels sit two triangles to a square cell: the even triangle on and below the diagonal,
+/// the odd one above it, turned around. local is the texel in the triangle's own corner,
+/// x along its second vertex and y along its third.
+uint obeEnvironmentTexelIndex(uint triangle, uint2 local)
+{
+    uint2 texel = (triangle & 1) ? uint2(OBEEnvironmentCellSize - 1) - local : local;
+    return (triangle / 2) * OBEEnvironmentCellSize * OBEEnvironmentCellSize + texel.y * OBEEnvironmentCellSize + texel.x;
+}
+
+/// The texel under a point of triangle, given by its barycentric coordinates.
+uint obeEnvironmentTexel(uint triangle, float3 barycentric)
+{
+    uint2 local = uint2(min(barycentric.yz * float(OBEEnvironmentCellSize), float(OBEEnvironmentCellSize - 1)));
+
+    // Right on the diagonal, keep to this triangle's texels.
+    uint limit = (triangle & 1) ? OBEEnvironmentCellSize - 2 : OBEEnvironmentCellSize - 1;
+    uint sum = local.x + local.y;
+    if( sum > limit ) {
+        uint over = sum - limit;
+        uint dx = min(local.x, (over + 1) / 2);
+        local.x -= dx;
+        local.y -= over - dx;
+    }
+    return obeEnvironmentTexelIndex(triangle, local);
+}
+
+struct OBEEnvironmentDepthOut {
+    float4 position [[ position ]];
+};
+
+/// The mesh from a keyframe's color camera, depth only.
+vertex OBEEnvironmentDepthOut OBEEnvironmentDepthVertex(
+    const device packed_float3* positions [[buffer(0)]],
+    constant OBEEnvironmentKeyframe& keyframe [[buffer(1)]],
+    uint vid [[ vertex_id ]] )
+{
+    OBEEnvironmentDepthOut out;
+    out.position = keyframe.viewProjection * float4(float3(positions[vid]), 1.0);
+    return out;
+}
+
+/// Blend a keyframe into every texel it sees. x runs through a cell's texels, y through the cells.
+kernel void OBEEnvironmentAccumulate(
+    const device packed_float3* positions [[buffer(0)]],
+    const device uint* indices [[buffer(1)]],
+    device uchar4* texels [[buffer(2)]],
+    constant OBEEnvironmentKeyframe& keyframe [[buffer(3)]],
+    texture2d<float> color [[texture(0)]],
+    depth2d<float> depth [[texture(1)]],
+    uint2 gid [[ thread_position_in_grid ]] )
+{
+    const uint cellSize = OBEEnvironmentCellSize;
+    if( gid.x >= cellSize * cellSize ) return;
+
+    uint2 texel = uint2(gid.x % cellSize, gid.x / cellSize);
+    bool odd = texel.x + texel.y > cellSize - 1;
+    uint triangle = gid.y * 2 + (odd ? 1 : 0);
+    if( triangle >= keyframe.triangleCount ) return;
+
+    uint2 local = odd ? uint2(cellSize - 1) - texel : texel;
+    float2 uv = (float2(local) + 0.5) / float(cellSize);
+    float3 p0 = float3(positions[indices[triangle * 3 + 0]]);
+    float3 p1 = float3(positions[indices[triangle * 3 + 1]]);
+    float3 p2 = float3(positions[indices[triangle * 3 + 2]]);
+    float3 position = p0 * (1.0 - uv.x - uv.y) + p1 * uv.x + p2 * uv.y;
+
+    float4 clip = keyframe.viewProjection * float4(position, 1.0);
+    if( clip.w <= 0.0 ) return;
+    float3 ndc = clip.xyz / clip.w;
+    if( any(abs(ndc.xy) > 1.0) || ndc.z < 0.0 || ndc.z > 1.0 ) return;
+
+    // The color frame is read like Bridge Engine's GL texture of the same pixels,
+    // the depth was rendered by Metal, whose window y runs down.
+    float2 colorCoord = ndc.xy * 0.5 + 0.5;
+    float2 depthCoord = float2(colorCoord.x, 1.0 - colorCoord.y);
+
+    constexpr sampler nearestSampler(coord::normalized, filter::nearest, address::clamp_to_edge);
+    constexpr sampler linearSampler(coord::normalized, filter::linear, address::clamp_to_edge);
+    if( ndc.z > depth.sample(nearestSampler, depthCoord) + keyframe.depthBias ) return;
+
+    // Seen squarely and away from the frame's edge counts the most. Winding isn't known, either side faces.
+    float3 normal = normalize(cross(p1 - p0, p2 - p0));
+    float facing = abs(dot(normal, normalize(keyframe.cameraPosition.xyz - position)));
+    float2 edge = min(colorCoord, 1.0 - colorCoord);
+    float weight = facing * facing * smoothstep(0.0, 0.05, min(edge.x, edge.y));
+    if( weight < 0.01 ) return;
+
+    uint index = gid.y * cellSize * cellSize + gid.x;
+    float4 previous = float4(texels[index]) / 255.0;
+    float previousWeight = previous.a * keyframe.maxWeight;
+    float3 blended = mix(previous.rgb, color.sample(linearSampler, colorCoord).rgb, weight / (previousWeight + weight));
+    float blendedWeight = min(previousWeight + weight, keyframe.maxWeight);
+
+    texels[index] = uchar4(round(saturate(float4(blended, blendedWeight / keyframe.maxWeight)) * 255.0));
+}
+
+struct OBEEnvironmentVertexOut {
+    float4 position [[ position ]];
+    float3 barycentric;
+    float4 liveClip;            // Clip position in the color camera this frame.
+    uint triangle [[ flat ]];
+    uint eye [[ flat ]];
+};
+
+/// The scene mesh in one draw without vertex buffers: each vertex is read through the index of its corner.
+vertex OBEEnvironmentVertexOut OBEEnvironmentVertexInstanced(
+    constant OBEStereoNodeBuffer& node [[buffer(1)]],
+    constant OBEEnvironmentUniforms& environment [[buffer(2)]],
+    constant OBEStereoUniforms& stereo [[buffer(3)]],
+    const device packed_float3* positions [[buffer(4)]],
+    const device uint* indices [[buffer(5)]],
+    uint vid [[ vertex_id ]],
+    uint iid [[ instance_id ]] )
+{
+    OBEEnvironmentVertexOut out;
+
+    uint corner = vid % 3;
+    out.triangle = vid / 3;
+    out.barycentric = float3(corner == 0 ? 1. : 0., corner == 1 ? 1. : 0., corner == 2 ? 1. : 0.);
+
+    float4 worldPosition = node.modelTransform * float4(float3(positions[indices[vid]]), 1.0);
+    out.eye = obeStereoEye(iid, stereo);
+    float4 position = stereo.viewProjection[out.eye] * worldPosition;
+    position.z -= OBEEnvironmentDepthNudge * position.w;
+    out.position = obeStereoPlaceInEye(position, out.eye, stereo);
+    out.liveClip = environment.liveViewProjection * worldPosition;
+
+    return out;
+}
+
+fragment half4 OBEEnvironmentFragmentInstanced(
+    OBEEnvironmentVertexOut in [[ stage_in ]],
+    constant OBEEnvironmentUniforms& environment [[buffer(2)]],
+    constant OBEStereoUniforms& stereo [[buffer(3)]],
+    const device uchar4* texels [[buffer(6)]] )
+{
+    if( obeStereoOutsideEye(in.position, in.eye, stereo) ) discard_fragment();
+
+    // Where the color camera sees the mesh now, the live image shows instead.
+    float live = 0.0;
+    if( in.liveClip.w > 0.0 ) {
+        float2 ndc = abs(in.liveClip.xy / in.liveClip.w);
+        live = smoothstep(0.0, environment.liveMargin, 1.0 - max(ndc.x, ndc.y));
+    }
+
+    float4 texel = float4(texels[obeEnvironmentTexel(in.triangle, in.barycentric)]) / 255.0;
+    float alpha = saturate(texel.a * environment.coverageScale) * (1.0 - live);
+    if( alpha <= 0.0 ) discard_fragment();
+
+    // Texels hold the camera's sRGB, converted to linear like the other colors here.
+    float3 rgb = select(pow((texel.rgb + 0.055) / 1.055, 2.4), texel.rgb / 12.92, texel.rgb <= 0.04045);
+    return half4(half3(rgb), half(alpha));
+}
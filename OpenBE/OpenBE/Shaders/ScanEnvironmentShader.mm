@@ -12,16 +12,30 @@
 #import <BridgeEngine/BEShader.h>
 
 #import "../Utils/SceneKitExtensions.h"
+#import "../Core/UniformRing.h"
+#import "../Core/ShaderCache.h"
 
 #include <OpenGLES/ES2/gl.h>
 
+// Matches OBEScanEnvironmentUniformsMetal in OpenBE.metal
 struct OBEScanEnvironmentUniformsMetal {
-    float scanTime;
-    float scanDuration;
-    float scanRadius;
+    float maxDist;
     simd_float3 scanLocation;
 };
 
+// Scan fades in to its peak over this many seconds, and out over the last of its duration.
+#define SCAN_PEAK_DURATION 0.1f
+#define SCAN_FADE_DURATION 1.0f
+
+namespace {
+
+    float smoothstep( float edge0, float edge1, float x ) {
+        float t = fminf(fmaxf((x - edge0) / (edge1 - edge0), 0.f), 1.f);
+        return t * t * (3.f - 2.f * t);
+    }
+
+} // anonymous
+
 @interface ScanEnvironmentShader()
 
 @property (strong) NSString * shaderName;
@@ -31,6 +45,8 @@ struct OBEScanEnvironmentUniformsMetal {
 @property GLuint scanRadiusLocation;
 @property GLuint scanOriginLocation;
 
+@property (strong) UniformBlock * metalUniforms;
+
 @end;
 
 @implementation ScanEnvironmentShader
@@ -41,6 +57,7 @@ struct OBEScanEnvironmentUniformsMetal {
     self.shaderName = @"Shaders/ScanEnvironment/scanEnvironmentShader";
     // Alternative shader with distortions of the camera feed.
     // self.shaderName = @"Shaders/ScanEnvironment/scanEnvironmentShaderWithDistortion";
+    self.metalUniforms = [[UniformRing main] reserveBlockWithLength:sizeof(OBEScanEnvironmentUniformsMetal)];
     
     return self;
 }
@@ -122,54 +139,37 @@ struct OBEScanEnvironmentUniformsMetal {
 
 -(const char *) vertexShaderSource
 {
-    NSURL *vertexShaderURL   = [SceneKit URLForResource:self.shaderName withExtension:@"vsh"];
-    NSString *vertexShader   = [[NSString alloc] initWithContentsOfURL:vertexShaderURL
-                                                              encoding:NSUTF8StringEncoding
-                                                                 error:NULL];
-    return [vertexShader UTF8String];
+    return [[[ShaderCache main] glSourceNamed:self.shaderName extension:@"vsh"] UTF8String];
 }
 
 -(const char *) fragmentShaderSource
 {
-    NSURL *fragmentShaderURL = [SceneKit URLForResource:self.shaderName withExtension:@"fsh"];
-    NSString *fragmentShader = [[NSString alloc] initWithContentsOfURL:fragmentShaderURL
-                                                              encoding:NSUTF8StringEncoding
-                                                                 error:NULL];
-    return [fragmentShader UTF8String];
+    return [[[ShaderCache main] glSourceNamed:self.shaderName extension:@"fsh"] UTF8String];
 }
 
 
 #pragma mark - BridgeEngineGLShaderDelegate
 
-+ (id<MTLLibrary>)metalLibrary
-{
-    NSBundle *bundle = [NSBundle bundleForClass:SceneKit.class];
-    static id<MTLLibrary> lib = nil;
-    if( lib == nil ) {
-        lib = [MTLCreateSystemDefaultDevice() newDefaultLibraryWithBundle:bundle error:nil];
-    }
-    
-    return lib;
-}
-
 - (id<MTLFunction>)vertexFunction
 {
-    return [[self.class metalLibrary] newFunctionWithName:@"OBEScanEnvironmentVertex"];
+    return [[ShaderCache main] metalFunctionNamed:@"OBEScanEnvironmentVertex"];
 }
 
 - (id<MTLFunction>)fragmentFunction
 {
-    return [[self.class metalLibrary] newFunctionWithName:@"OBEScanEnvironmentFragment"];
+    return [[ShaderCache main] metalFunctionNamed:@"OBEScanEnvironmentFragment"];
 }
 
 - (NSData *)customUniforms {
+    // Same fade as the GL shader works out per fragment, done once here.
+    float strength = smoothstep(0.f, SCAN_PEAK_DURATION, self.scanTime)
+                   * (1.f - smoothstep(self.duration - SCAN_FADE_DURATION, self.duration, self.scanTime));
+
     OBEScanEnvironmentUniformsMetal custom;
-    custom.scanTime = self.scanTime;
-    custom.scanDuration = self.duration;
-    custom.scanRadius = self.scanRadius;
+    custom.maxDist = self.scanRadius * strength;
     custom.scanLocation = { self.scanOrigin.x, self.scanOrigin.y, self.scanOrigin.z };
     
-    return [NSData dataWithBytes:&custom length:sizeof(OBEScanEnvironmentUniformsMetal)];
+    return [self.metalUniforms update:&custom];
 }
 
 @end
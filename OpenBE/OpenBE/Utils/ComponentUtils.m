@@ -6,10 +6,18 @@
  */
 
 #import "ComponentUtils.h"
+#import "../Core/Core.h"
 
 @implementation ComponentUtils
 
 + (GKComponent *) getComponentFromEntity:(GKEntity *)entity ofClass:(Class)aClass {
+    // Registered Entities have an index by component class, no need to scan.
+    // Other GKEntities only had the components they held when registered indexed.
+    EntityRegistry * registry = [SceneManager main].registry;
+    if( [entity isKindOfClass:[Entity class]] && [registry containsEntity:entity] ) {
+        return [registry componentOfClass:aClass forEntity:entity];
+    }
+
     GKComponent * ret = NULL;
     int counter = 0;
     
@@ -30,6 +38,11 @@
 }
 
 + (NSMutableArray *) getComponentsFromEntity:(GKEntity *)entity ofClass:(Class)aClass {
+    EntityRegistry * registry = [SceneManager main].registry;
+    if( [entity isKindOfClass:[Entity class]] && [registry containsEntity:entity] ) {
+        return [registry componentsOfClass:aClass forEntity:entity];
+    }
+
     NSMutableArray * ret = [[NSMutableArray alloc] initWithCapacity:8];
     
     for( GKComponent* component in entity.components ) {
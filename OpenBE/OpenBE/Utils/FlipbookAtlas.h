@@ -0,0 +1,56 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  A set of same-purpose images, such as the robot's Vemoji faces, packed into
+//  one texture that's decoded and uploaded once.
+//
+//  Showing an image is then picking its frame: the material property keeps the
+//  atlas as contents and only its contentsTransform uniform changes, scaling
+//  and offsetting the mesh's UVs onto the frame's cell.
+//
+
+#import <UIKit/UIKit.h>
+#import <SceneKit/SceneKit.h>
+
+/// Frame index of names that aren't in the atlas.
+#define FLIPBOOK_FRAME_NONE (-1)
+
+@interface FlipbookAtlas : NSObject
+
+/**
+ * Shared atlas of every PNG in folderPath whose name starts with one of prefixes.
+ * Built on first use and cached under atlasName.
+ * THREAD SAFE
+ */
++ (FlipbookAtlas *) atlasNamed:(NSString *)atlasName folder:(NSString *)folderPath prefixes:(NSArray<NSString *> *)prefixes;
+
+/**
+ * Build the atlas on a background queue, so a later atlasNamed: finds it ready.
+ * THREAD SAFE
+ */
++ (void) prefetchAtlasNamed:(NSString *)atlasName folder:(NSString *)folderPath prefixes:(NSArray<NSString *> *)prefixes;
+
+@property (nonatomic, readonly) UIImage *image;
+@property (nonatomic, readonly) NSInteger frameCount;
+@property (nonatomic, readonly) CGSize cellSize;    // Pixels, every image is scaled to fill a cell.
+
+/// Frame of an image name, with or without its .png extension. FLIPBOOK_FRAME_NONE if missing.
+- (NSInteger) frameForName:(NSString *)name;
+
+/// UV transform showing frame through a material property using this atlas.
+- (SCNMatrix4) contentsTransformForFrame:(NSInteger)frame;
+
+/**
+ * Make the atlas property's contents, clamped and without mipmaps so
+ * neighbouring cells don't bleed in. Shows frame 0 until a frame is set.
+ */
+- (void) applyToMaterialProperty:(SCNMaterialProperty *)property;
+
+@end
@@ -0,0 +1,183 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "FlipbookAtlas.h"
+
+#import <BridgeEngine/BEDebugging.h>
+
+// Largest atlas side, the GLES2 limit on our devices.
+#define FLIPBOOK_MAX_DIMENSION 4096
+
+// Transparent pixels between cells.
+#define FLIPBOOK_GUTTER 2
+
+@implementation FlipbookAtlas
+{
+    NSDictionary<NSString *, NSNumber *> *_framesByName;
+    SCNMatrix4 *_transforms;
+}
+
++ (dispatch_queue_t) buildQueue {
+    static dispatch_queue_t buildQueue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        buildQueue = dispatch_queue_create("OpenBE.FlipbookAtlas", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+    });
+    return buildQueue;
+}
+
+/**
+ * Atlases by name. ON buildQueue ONLY.
+ */
++ (NSMutableDictionary<NSString *, FlipbookAtlas *> *) atlases {
+    static NSMutableDictionary<NSString *, FlipbookAtlas *> *atlases;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        atlases = [[NSMutableDictionary alloc] init];
+    });
+    return atlases;
+}
+
++ (FlipbookAtlas *) cachedAtlasNamed:(NSString *)atlasName folder:(NSString *)folderPath prefixes:(NSArray<NSString *> *)prefixes {
+    FlipbookAtlas *atlas = [self atlases][atlasName];
+    if( atlas == nil ) {
+        atlas = [[FlipbookAtlas alloc] initWithFolder:folderPath prefixes:prefixes];
+        if( atlas ) {
+            [self atlases][atlasName] = atlas;
+        }
+    }
+    return atlas;
+}
+
++ (FlipbookAtlas *) atlasNamed:(NSString *)atlasName folder:(NSString *)folderPath prefixes:(NSArray<NSString *> *)prefixes {
+    __block FlipbookAtlas *atlas = nil;
+    dispatch_sync([self buildQueue], ^{
+        atlas = [self cachedAtlasNamed:atlasName folder:folderPath prefixes:prefixes];
+    });
+    return atlas;
+}
+
++ (void) prefetchAtlasNamed:(NSString *)atlasName folder:(NSString *)folderPath prefixes:(NSArray<NSString *> *)prefixes {
+    dispatch_async([self buildQueue], ^{
+        [self cachedAtlasNamed:atlasName folder:folderPath prefixes:prefixes];
+    });
+}
+
+- (instancetype) initWithFolder:(NSString *)folderPath prefixes:(NSArray<NSString *> *)prefixes {
+    self = [super init];
+    if( self == nil ) return nil;
+
+    // Gather the matching images, sorted so frame numbers are stable.
+    NSArray<NSString *> *files = [[[NSFileManager defaultManager] contentsOfDirectoryAtPath:folderPath error:nil]
+                                  sortedArrayUsingSelector:@selector(compare:)];
+    NSMutableArray<NSString *> *names = [[NSMutableArray alloc] init];
+    NSMutableArray<UIImage *> *images = [[NSMutableArray alloc] init];
+    size_t cellWidth = 0, cellHeight = 0;
+    for( NSString *file in files ) {
+        if( ![[file pathExtension] isEqualToString:@"png"] ) continue;
+
+        BOOL matches = NO;
+        for( NSString *prefix in prefixes ) {
+            if( [file hasPrefix:prefix] ) { matches = YES; break; }
+        }
+        if( !matches ) continue;
+
+        // imageWithContentsOfFile: doesn't keep a second copy in the UIImage cache.
+        UIImage *image = [UIImage imageWithContentsOfFile:[folderPath stringByAppendingPathComponent:file]];
+        if( image.CGImage == nil ) {
+            NSLog(@"FlipbookAtlas: === Warning === Could not decode %@", file);
+            continue;
+        }
+
+        [names addObject:[file stringByDeletingPathExtension]];
+        [images addObject:image];
+        cellWidth = MAX(cellWidth, CGImageGetWidth(image.CGImage));
+        cellHeight = MAX(cellHeight, CGImageGetHeight(image.CGImage));
+    }
+
+    if( images.count == 0 ) {
+        NSLog(@"FlipbookAtlas: === Error === No images in %@ matching %@", folderPath, prefixes);
+        return nil;
+    }
+
+    // Layout, as square as fits.
+    const size_t strideX = cellWidth + FLIPBOOK_GUTTER;
+    const size_t strideY = cellHeight + FLIPBOOK_GUTTER;
+    size_t columns = (size_t)ceil(sqrt((double)images.count * strideY / strideX));
+    columns = MAX((size_t)1, MIN(columns, (size_t)(FLIPBOOK_MAX_DIMENSION / strideX)));
+    const size_t rows = (images.count + columns - 1) / columns;
+    const size_t width = columns * strideX;
+    const size_t height = rows * strideY;
+    be_assert( height <= FLIPBOOK_MAX_DIMENSION, "Too many images for one atlas" );
+
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, width * 4, colorSpace, kCGImageAlphaPremultipliedLast);
+    CGColorSpaceRelease(colorSpace);
+    if( context == NULL ) {
+        NSLog(@"FlipbookAtlas: === Error === Could not allocate a %zux%zu atlas", width, height);
+        return nil;
+    }
+    CGContextClearRect(context, CGRectMake(0, 0, width, height));
+    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+
+    NSMutableDictionary<NSString *, NSNumber *> *framesByName = [[NSMutableDictionary alloc] initWithCapacity:images.count];
+    _transforms = (SCNMatrix4 *)malloc(sizeof(SCNMatrix4) * images.count);
+    for( NSUInteger i=0; i<images.count; i++ ) {
+        size_t x = (i % columns) * strideX;
+        size_t y = (i / columns) * strideY;
+
+        // CoreGraphics is bottom-up, the atlas layout is top-down.
+        CGContextDrawImage(context, CGRectMake(x, height - y - cellHeight, cellWidth, cellHeight), images[i].CGImage);
+
+        // Texture coordinates are top-down too. Inset half a texel so linear filtering stays in the cell.
+        SCNMatrix4 scale = SCNMatrix4MakeScale((cellWidth - 1.f) / width, (cellHeight - 1.f) / height, 1);
+        SCNMatrix4 offset = SCNMatrix4MakeTranslation((x + 0.5f) / width, (y + 0.5f) / height, 0);
+        _transforms[i] = SCNMatrix4Mult(scale, offset);
+
+        framesByName[names[i]] = @(i);
+    }
+
+    CGImageRef atlasImage = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+
+    _image = [UIImage imageWithCGImage:atlasImage];
+    CGImageRelease(atlasImage);
+
+    _framesByName = [framesByName copy];
+    _frameCount = images.count;
+    _cellSize = CGSizeMake(cellWidth, cellHeight);
+
+    be_dbg("FlipbookAtlas: Packed %d images into %dx%d", (int)images.count, (int)width, (int)height);
+    return self;
+}
+
+- (void) dealloc {
+    free(_transforms);
+}
+
+- (NSInteger) frameForName:(NSString *)name {
+    NSNumber *frame = _framesByName[name];
+    if( frame == nil && [[name pathExtension] isEqualToString:@"png"] ) {
+        frame = _framesByName[[name stringByDeletingPathExtension]];
+    }
+    return frame ? frame.integerValue : FLIPBOOK_FRAME_NONE;
+}
+
+- (SCNMatrix4) contentsTransformForFrame:(NSInteger)frame {
+    if( frame < 0 || frame >= _frameCount ) return _transforms[0];
+    return _transforms[frame];
+}
+
+- (void) applyToMaterialProperty:(SCNMaterialProperty *)property {
+    property.contents = _image;
+    property.wrapS = SCNWrapModeClamp;
+    property.wrapT = SCNWrapModeClamp;
+    property.mipFilter = SCNFilterModeNone;
+    property.contentsTransform = _transforms[0];
+}
+
+@end
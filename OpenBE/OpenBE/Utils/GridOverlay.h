@@ -0,0 +1,55 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  A debug overlay of an 8 bit grid map, like PathFinding's dilated obstacles
+//  or connected components, as one quad lying on the floor under the grid.
+//
+//  The map's bytes are its texture, one R8 texel a cell, sampled without
+//  filtering. A surface shader modifier looks each value up in a 256 entry
+//  palette, so component IDs get colors and uninteresting values stay clear.
+//
+//  Updates compare the map with the bytes last uploaded, and upload only the
+//  rows between the first and last that changed. With Metal the rows are
+//  replaced in place in the texture. GLES 2 materials take an image, so there
+//  a change re-creates it from the bytes, without drawing.
+//
+//  RENDER THREAD ONLY
+//
+
+#import <SceneKit/SceneKit.h>
+#import <UIKit/UIKit.h>
+
+#include "../Core/OccupancyGrid.hpp"
+
+typedef struct {
+    NSUInteger updates;             // Updates that changed something.
+    NSUInteger uploadedRows;        // Rows uploaded by those.
+} GridOverlayStats;
+
+@interface GridOverlay : NSObject
+
+/// Yellow obstacles where the value is 254 or 255, clear elsewhere.
++ (GridOverlay *) obstacleOverlay;
+
+/// A color for every component ID, from 8 repeating ones, clear for 0.
++ (GridOverlay *) componentOverlay;
+
+/// palette holds up to 256 colors, indexed by value. Missing ones are clear.
+- (instancetype) initWithPalette:(NSArray<UIColor *> *)palette;
+
+/// The quad, add it to the scene. Positioned from the grid's metadata, at y 0; raise it off the floor with a small negative y, up is -y.
+@property (nonatomic, readonly) SCNNode *node;
+
+/// Upload what changed since the last update. The view is only read during the call.
+- (void) updateWithGrid:(const BE::OccupancyGridView &)grid;
+
+- (GridOverlayStats) stats;
+
+@end
@@ -0,0 +1,235 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "GridOverlay.h"
+#import "../Core/Core.h"
+
+#import <Metal/Metal.h>
+
+#include <cstring>
+#include <vector>
+
+// Lets the floor show through, and has SceneKit blend the palette's clear entries.
+#define GRID_OVERLAY_TRANSPARENCY 0.85
+
+namespace {
+
+    NSString * const GridOverlaySurfaceModifier =
+        @"uniform sampler2D gridPalette;\n"
+        "#pragma body\n"
+        "float gridValue = floor(_surface.diffuse.r * 255.0 + 0.5);\n"
+        "_surface.diffuse = texture2D(gridPalette, vec2((gridValue + 0.5) / 256.0, 0.5));\n";
+
+    /// 256 x 1 RGBA, straight from the colors' components.
+    CGImageRef createPaletteImage( NSArray<UIColor *> *palette ) {
+        NSMutableData *texels = [NSMutableData dataWithLength:256 * 4];
+        uint8_t *texel = (uint8_t *)texels.mutableBytes;
+        for( NSUInteger i=0; i<MIN(palette.count, (NSUInteger)256); i++ ) {
+            CGFloat r = 0, g = 0, b = 0, a = 0;
+            [palette[i] getRed:&r green:&g blue:&b alpha:&a];
+            texel[i*4 + 0] = (uint8_t)(r * 255.f + 0.5f);
+            texel[i*4 + 1] = (uint8_t)(g * 255.f + 0.5f);
+            texel[i*4 + 2] = (uint8_t)(b * 255.f + 0.5f);
+            texel[i*4 + 3] = (uint8_t)(a * 255.f + 0.5f);
+        }
+
+        CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)texels);
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+        CGImageRef image = CGImageCreate(256, 1, 8, 32, 256 * 4, colorSpace,
+                                         kCGImageAlphaLast | kCGBitmapByteOrderDefault,
+                                         provider, NULL, false, kCGRenderingIntentDefault);
+        CGColorSpaceRelease(colorSpace);
+        CGDataProviderRelease(provider);
+        return image;
+    }
+
+    /// Unfiltered, so every texel is its exact value.
+    void setNearest( SCNMaterialProperty *property ) {
+        property.minificationFilter = SCNFilterModeNone;
+        property.magnificationFilter = SCNFilterModeNone;
+        property.mipFilter = SCNFilterModeNone;
+        property.wrapS = SCNWrapModeClamp;
+        property.wrapT = SCNWrapModeClamp;
+    }
+
+} // anonymous
+
+@implementation GridOverlay
+{
+    SCNMaterial *_material;
+    std::vector<uint8_t> _pixels;       // As last uploaded, tightly packed.
+    int _width;
+    int _height;
+    BE::OccupancyGridMetadata _metadata;
+
+    id<MTLTexture> _texture;            // With Metal.
+    GridOverlayStats _stats;
+}
+
++ (GridOverlay *) obstacleOverlay {
+    NSMutableArray<UIColor *> *palette = [NSMutableArray arrayWithCapacity:256];
+    for( int i=0; i<256; i++ ) {
+        [palette addObject:i >= 254 ? [UIColor yellowColor] : [UIColor clearColor]];
+    }
+    return [[GridOverlay alloc] initWithPalette:palette];
+}
+
++ (GridOverlay *) componentOverlay {
+    NSArray<UIColor *> *colors = @[
+        [UIColor brownColor],
+        [UIColor redColor],
+        [UIColor orangeColor],
+        [UIColor magentaColor],
+        [UIColor greenColor],
+        [UIColor cyanColor],
+        [UIColor blueColor],
+        [UIColor purpleColor]
+    ];
+
+    NSMutableArray<UIColor *> *palette = [NSMutableArray arrayWithCapacity:256];
+    for( int i=0; i<256; i++ ) {
+        [palette addObject:i == 0 ? [UIColor clearColor] : colors[i % colors.count]];
+    }
+    return [[GridOverlay alloc] initWithPalette:palette];
+}
+
+- (instancetype) initWithPalette:(NSArray<UIColor *> *)palette {
+    self = [super init];
+    if( self ) {
+        _material = [SCNMaterial material];
+        _material.lightingModelName = SCNLightingModelConstant;
+        _material.transparency = GRID_OVERLAY_TRANSPARENCY;
+        _material.writesToDepthBuffer = NO;
+        setNearest(_material.diffuse);
+        // Turned face up, the plane's top edge is at the grid's highest z. Flipped so the texture's first row is at the lowest.
+        _material.diffuse.contentsTransform = SCNMatrix4Mult(SCNMatrix4MakeScale(1, -1, 1), SCNMatrix4MakeTranslation(0, 1, 0));
+
+        CGImageRef paletteImage = createPaletteImage(palette);
+        SCNMaterialProperty *paletteProperty = [SCNMaterialProperty materialPropertyWithContents:(__bridge id)paletteImage];
+        CGImageRelease(paletteImage);
+        setNearest(paletteProperty);
+        [_material setValue:paletteProperty forKey:@"gridPalette"];
+        _material.shaderModifiers = @{ SCNShaderModifierEntryPointSurface : GridOverlaySurfaceModifier };
+
+        _node = [SCNNode node];
+        _node.eulerAngles = SCNVector3Make(M_PI_2, 0, 0);   // Flat on the floor, facing up, -y, so it isn't culled from above.
+        _node.categoryBitMask |= RAYCAST_IGNORE_BIT;
+        _node.castsShadow = NO;
+
+        _stats = GridOverlayStats();
+    }
+    return self;
+}
+
+- (BOOL) usesMetal {
+    return [SceneManager main].renderingAPI == BEViewRenderingAPIMetal;
+}
+
+#pragma mark - Updating
+
+- (void) updateWithGrid:(const BE::OccupancyGridView &)grid {
+    if( grid.empty() ) return;
+
+    int firstRow = -1, lastRow = -1;
+    if( grid.width != _width || grid.height != _height
+        || memcmp(&grid.metadata, &_metadata, sizeof(BE::OccupancyGridMetadata)) != 0 )
+    {
+        [self resizeForGrid:grid];
+        firstRow = 0;
+        lastRow = _height - 1;
+    }
+
+    for( int y=0; y<_height; y++ ) {
+        const uint8_t *in = grid.row(y);
+        uint8_t *row = &_pixels[(size_t)y * _width];
+
+        bool changed = false;
+        if( grid.pixelStride == 1 ) {
+            changed = memcmp(row, in, _width) != 0;
+            if( changed ) memcpy(row, in, _width);
+        } else {
+            for( int x=0; x<_width; x++ ) {
+                uint8_t value = in[x * grid.pixelStride];
+                changed |= row[x] != value;
+                row[x] = value;
+            }
+        }
+
+        if( changed ) {
+            if( firstRow < 0 || y < firstRow ) firstRow = y;
+            if( y > lastRow ) lastRow = y;
+        }
+    }
+    if( firstRow < 0 ) return;
+
+    [self uploadRowsFrom:firstRow to:lastRow];
+    _stats.updates++;
+}
+
+- (void) resizeForGrid:(const BE::OccupancyGridView &)grid {
+    _width = grid.width;
+    _height = grid.height;
+    _metadata = grid.metadata;
+    _pixels.assign((size_t)_width * _height, 0);
+    _texture = nil;
+
+    // Pixel centers are at origin + index * metersPerPixel, x along x and y along z.
+    float metersPerPixel = _metadata.metersPerPixel;
+    SCNPlane *plane = [SCNPlane planeWithWidth:_width * metersPerPixel height:_height * metersPerPixel];
+    plane.materials = @[_material];
+    _node.geometry = plane;
+    _node.position = SCNVector3Make(_metadata.originX + (_width - 1) * 0.5f * metersPerPixel,
+                                    _node.position.y,
+                                    _metadata.originY + (_height - 1) * 0.5f * metersPerPixel);
+}
+
+- (void) uploadRowsFrom:(int)firstRow to:(int)lastRow {
+    if( [self usesMetal] ) {
+        if( _texture == nil ) {
+            id<MTLDevice> device = [SceneManager main].mixedRealityMode.sceneKitRenderer.device ?: MTLCreateSystemDefaultDevice();
+            MTLTextureDescriptor *descriptor = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR8Unorm
+                                                                                                  width:_width
+                                                                                                 height:_height
+                                                                                              mipmapped:NO];
+            descriptor.usage = MTLTextureUsageShaderRead;
+            _texture = [device newTextureWithDescriptor:descriptor];
+            if( _texture == nil ) {
+                NSLog(@"GridOverlay: === Error === Can't make a %dx%d texture", _width, _height);
+                return;
+            }
+            _material.diffuse.contents = _texture;
+            firstRow = 0;
+            lastRow = _height - 1;
+        }
+
+        // Only the rows that changed, in place.
+        int rows = lastRow - firstRow + 1;
+        [_texture replaceRegion:MTLRegionMake2D(0, firstRow, _width, rows)
+                    mipmapLevel:0
+                      withBytes:&_pixels[(size_t)firstRow * _width]
+                    bytesPerRow:_width];
+        _stats.uploadedRows += rows;
+    } else {
+        // A new image over the bytes, SceneKit uploads all of it.
+        NSData *bytes = [NSData dataWithBytes:_pixels.data() length:_pixels.size()];
+        CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)bytes);
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceGray();
+        CGImageRef image = CGImageCreate(_width, _height, 8, 8, _width, colorSpace, kCGImageAlphaNone,
+                                         provider, NULL, false, kCGRenderingIntentDefault);
+        _material.diffuse.contents = (__bridge id)image;
+        CGImageRelease(image);
+        CGColorSpaceRelease(colorSpace);
+        CGDataProviderRelease(provider);
+        _stats.uploadedRows += _height;
+    }
+}
+
+- (GridOverlayStats) stats {
+    return _stats;
+}
+
+@end
@@ -0,0 +1,83 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  A subtree of nodes, flattened once, for setting a property on all of them.
+//
+//  Capturing walks the hierarchy without recursion, into a flat list that is
+//  kept until refresh. Setting a property then runs one loop over the list,
+//  through the setter's cached implementation, and does nothing at all when
+//  the set already holds that value.
+//
+//  A deferred set spreads the nodes over the following frames, a budget of
+//  nodes per frame, for changes nobody is waiting on. Setting the same
+//  property right away cancels it.
+//
+//  The set holds its nodes weakly, so it never keeps a subtree alive; whoever
+//  owns the subtree owns its set, like GeometryComponent's nodeSet. It isn't
+//  told when the subtree changes: after adding or removing nodes, call
+//  refresh. Change detection only knows what went through the set: if
+//  something else sets the property on its nodes, call invalidate. Callers
+//  sharing a subtree should share its set.
+//
+//  RUN ON MAIN THREAD ONLY
+//
+
+#import <SceneKit/SceneKit.h>
+
+// Nodes set per frame by deferred sets, all sets together.
+#define NODE_SET_DEFERRED_NODES_PER_FRAME 64
+
+typedef NS_ENUM(NSUInteger, NodeSetProperty) {
+    NodeSetPropertyRenderingOrder = 0,
+    NodeSetPropertyCategoryBitMask,
+    NodeSetPropertyCastsShadow,
+    NodeSetPropertyOpacity,
+    NodeSetPropertyCount
+};
+
+/// A property's value, compared bit for bit.
+typedef union {
+    NSInteger integer;      // Rendering order, category bit mask, casts shadow.
+    CGFloat number;         // Opacity.
+} NodeSetValue;
+
+NS_INLINE NodeSetValue NodeSetInteger( NSInteger integer ) { NodeSetValue value; value.integer = integer; return value; }
+NS_INLINE NodeSetValue NodeSetNumber( CGFloat number ) { NodeSetValue value; value.number = number; return value; }
+
+@interface NodeSet : NSObject
+
+/// root and every node below it, captured now.
++ (NodeSet *) nodeSetWithRoot:(SCNNode *)root;
+
+@property (nonatomic, readonly, weak) SCNNode *root;
+@property (nonatomic, readonly) NSUInteger count;
+
+/// Capture the subtree again, after nodes were added or removed. Forgets the values set.
+- (void) refresh;
+
+/// Forget the values set, so the next set applies whatever they were.
+- (void) invalidate;
+
+/**
+ * Set property on every node, now.
+ * @return NO if the set already had that value, and nothing was done.
+ */
+- (BOOL) setValue:(NodeSetValue)value forProperty:(NodeSetProperty)property;
+
+/// Set property on every node, a few per frame. Ignored if already set, or on its way.
+- (void) deferValue:(NodeSetValue)value forProperty:(NodeSetProperty)property;
+
+/// Nodes left to set by deferred sets.
++ (NSUInteger) deferredNodes;
+
+/// Spend this frame's budget on the deferred sets. Called by the SceneManager.
++ (void) applyDeferred;
+
+@end
@@ -0,0 +1,208 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "NodeSet.h"
+
+#import <BridgeEngine/BEDebugging.h>
+#import <objc/runtime.h>
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+    typedef std::vector<__weak SCNNode *> WeakNodes;
+
+    /// Call selector's setter on nodes [begin, end), looking up its implementation once per class. Skips nodes gone since.
+    template <typename T>
+    void applyToNodes( const WeakNodes &nodes, NSUInteger begin, NSUInteger end, SEL selector, T value ) {
+        typedef void (*Setter)(id, SEL, T);
+        Class lastClass = Nil;
+        Setter setter = nullptr;
+        for( NSUInteger i=begin; i<end; i++ ) {
+            SCNNode *node = nodes[i];
+            if( node == nil ) continue;
+            Class nodeClass = object_getClass(node);
+            if( nodeClass != lastClass ) {
+                lastClass = nodeClass;
+                setter = (Setter)class_getMethodImplementation(nodeClass, selector);
+            }
+            setter(node, selector, value);
+        }
+    }
+
+    void applyProperty( const WeakNodes &nodes, NSUInteger begin, NSUInteger end, NodeSetProperty property, NodeSetValue value ) {
+        switch( property ) {
+            case NodeSetPropertyRenderingOrder:
+                applyToNodes<NSInteger>(nodes, begin, end, @selector(setRenderingOrder:), value.integer);
+                break;
+            case NodeSetPropertyCategoryBitMask:
+                applyToNodes<NSUInteger>(nodes, begin, end, @selector(setCategoryBitMask:), (NSUInteger)value.integer);
+                break;
+            case NodeSetPropertyCastsShadow:
+                applyToNodes<BOOL>(nodes, begin, end, @selector(setCastsShadow:), value.integer != 0);
+                break;
+            case NodeSetPropertyOpacity:
+                applyToNodes<CGFloat>(nodes, begin, end, @selector(setOpacity:), value.number);
+                break;
+            default:
+                be_assert(false);
+                break;
+        }
+    }
+
+    // Sets with deferred values left to apply, oldest first. Holds them until done, or their root is gone.
+    NSMutableArray<NodeSet *> *DeferredSets = nil;
+
+    bool sameValue( NodeSetValue a, NodeSetValue b ) {
+        return memcmp(&a, &b, sizeof(NodeSetValue)) == 0;
+    }
+
+} // anonymous
+
+@interface NodeSet ()
+/// Apply up to budget nodes of deferred values. Returns the nodes applied.
+- (NSUInteger) applyDeferredWithBudget:(NSUInteger)budget;
+- (BOOL) hasDeferred;
+@end
+
+@implementation NodeSet
+{
+    WeakNodes _nodes;                   // Root first, parents before children. Not owned.
+
+    // Last value set on every node, if known.
+    NodeSetValue _values[NodeSetPropertyCount];
+    BOOL _hasValue[NodeSetPropertyCount];
+
+    // Deferred values, set on nodes [0, cursor) so far.
+    NodeSetValue _deferredValues[NodeSetPropertyCount];
+    BOOL _deferred[NodeSetPropertyCount];
+    NSUInteger _cursors[NodeSetPropertyCount];
+}
+
++ (NodeSet *) nodeSetWithRoot:(SCNNode *)root {
+    NodeSet *set = [[NodeSet alloc] init];
+    set->_root = root;
+    [set refresh];
+    return set;
+}
+
+- (NSUInteger) count {
+    return _nodes.size();
+}
+
+- (void) refresh {
+    _nodes.clear();
+    [self invalidate];
+
+    SCNNode *root = _root;
+    if( root == nil ) return;
+
+    // Depth first, with our own stack.
+    std::vector<SCNNode *> stack;
+    stack.push_back(root);
+    while( !stack.empty() ) {
+        SCNNode *node = stack.back();
+        stack.pop_back();
+        _nodes.push_back(node);
+
+        NSArray<SCNNode *> *children = node.childNodes;
+        for( NSInteger i=(NSInteger)children.count-1; i>=0; i-- ) {
+            stack.push_back(children[i]);
+        }
+    }
+
+    // Deferred values start over on the new nodes.
+    for( NSUInteger p=0; p<NodeSetPropertyCount; p++ ) _cursors[p] = 0;
+}
+
+- (void) invalidate {
+    for( NSUInteger p=0; p<NodeSetPropertyCount; p++ ) _hasValue[p] = NO;
+}
+
+#pragma mark - Setting
+
+- (BOOL) setValue:(NodeSetValue)value forProperty:(NodeSetProperty)property {
+    be_assert(property < NodeSetPropertyCount);
+
+    _deferred[property] = NO;
+    if( _hasValue[property] && sameValue(_values[property], value) ) return NO;
+
+    applyProperty(_nodes, 0, _nodes.size(), property, value);
+    _values[property] = value;
+    _hasValue[property] = YES;
+    return YES;
+}
+
+- (void) deferValue:(NodeSetValue)value forProperty:(NodeSetProperty)property {
+    be_assert(property < NodeSetPropertyCount);
+
+    if( _deferred[property] ) {
+        if( sameValue(_deferredValues[property], value) ) return;
+    } else if( _hasValue[property] && sameValue(_values[property], value) ) {
+        return;
+    }
+
+    // Nodes are mixed until it's done.
+    _hasValue[property] = NO;
+    _deferred[property] = YES;
+    _deferredValues[property] = value;
+    _cursors[property] = 0;
+
+    if( DeferredSets == nil ) DeferredSets = [NSMutableArray array];
+    if( ![DeferredSets containsObject:self] ) [DeferredSets addObject:self];
+}
+
+- (BOOL) hasDeferred {
+    for( NSUInteger p=0; p<NodeSetPropertyCount; p++ ) {
+        if( _deferred[p] ) return YES;
+    }
+    return NO;
+}
+
+- (NSUInteger) applyDeferredWithBudget:(NSUInteger)budget {
+    NSUInteger applied = 0;
+    for( NSUInteger p=0; p<NodeSetPropertyCount && applied < budget; p++ ) {
+        if( !_deferred[p] ) continue;
+
+        NSUInteger begin = _cursors[p];
+        NSUInteger end = MIN(begin + (budget - applied), (NSUInteger)_nodes.size());
+        applyProperty(_nodes, begin, end, (NodeSetProperty)p, _deferredValues[p]);
+        applied += end - begin;
+        _cursors[p] = end;
+
+        if( end == _nodes.size() ) {
+            _deferred[p] = NO;
+            _values[p] = _deferredValues[p];
+            _hasValue[p] = YES;
+        }
+    }
+    return applied;
+}
+
+#pragma mark - Deferred
+
++ (NSUInteger) deferredNodes {
+    NSUInteger nodes = 0;
+    for( NodeSet *set in DeferredSets ) {
+        for( NSUInteger p=0; p<NodeSetPropertyCount; p++ ) {
+            if( set->_deferred[p] ) nodes += set->_nodes.size() - set->_cursors[p];
+        }
+    }
+    return nodes;
+}
+
++ (void) applyDeferred {
+    NSUInteger budget = NODE_SET_DEFERRED_NODES_PER_FRAME;
+    while( DeferredSets.count > 0 && budget > 0 ) {
+        NodeSet *set = DeferredSets.firstObject;
+        budget -= [set applyDeferredWithBudget:budget];
+        if( ![set hasDeferred] || set.root == nil ) [DeferredSets removeObjectAtIndex:0];
+    }
+}
+
+@end
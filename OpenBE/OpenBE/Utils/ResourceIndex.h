@@ -0,0 +1,56 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Index of every resource file in the app, BridgeEngine and OpenBE bundles,
+//  built once by walking their resource folders. Names resolve the way
+//  SceneKit pathForResourceNamed: resolves them: relative to a bundle's
+//  resources, or to its OpenBE.scnassets folder, in bundle order.
+//
+//  Lookups go through a minimal perfect hash: two hashes and one string
+//  compare, no filesystem access.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface ResourceIndex : NSObject
+
+/// The index of the app's bundles, built on first use.
++ (ResourceIndex *) main;
+
+/// Build the main index on a background queue, so the first lookup doesn't wait for it.
++ (void) prepareInBackground;
+
+/// Index of bundles, searched in order.
+- (instancetype) initWithBundles:(NSArray<NSBundle *> *)bundles;
+
+/// Files indexed.
+@property (nonatomic, readonly) NSUInteger count;
+
+/// Time it took to walk the bundles and build the table.
+@property (nonatomic, readonly) double buildMs;
+
+/**
+ * Absolute path of a resource, nil if no bundle has it.
+ * @param type Extension, or nil when it's part of the name.
+ * THREAD SAFE
+ */
+- (NSString *) pathForResourceNamed:(NSString *)name withExtension:(NSString *)type;
+
+@end
+
+@interface ResourceIndex (Benchmark)
+
+/**
+ * Time a cold index build, then resolving names through it against NSBundle lookups.
+ * @return Report, also logged.
+ */
++ (NSString *) benchmarkWithNames:(NSArray<NSString *> *)names iterations:(NSUInteger)iterations;
+
+@end
@@ -0,0 +1,304 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#import "ResourceIndex.h"
+
+#import <BridgeEngine/BridgeEngine.h>
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Same folder SceneKit pathForResourceNamed: searches under.
+#define RESOURCE_INDEX_ASSETS_FOLDER "OpenBE.scnassets/"
+
+// Average keys per bucket of the perfect hash. Lower builds faster, at a little more memory.
+#define RESOURCE_INDEX_KEYS_PER_BUCKET 2
+
+// Seeds tried per bucket before growing the table.
+#define RESOURCE_INDEX_MAX_SEED (1u << 16)
+
+namespace {
+
+    double machTicksToMs( uint64_t ticks ) {
+        static mach_timebase_info_data_t sTimebaseInfo;
+        if( sTimebaseInfo.denom == 0 ) mach_timebase_info(&sTimebaseInfo);
+        return (double)(ticks * (uint64_t)sTimebaseInfo.numer / (uint64_t)sTimebaseInfo.denom) / 1000000.0;
+    }
+
+    /// FNV-1a.
+    uint64_t hashKey( const char *key, size_t length ) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for( size_t i=0; i<length; i++ ) {
+            hash ^= (uint8_t)key[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    /// Derive a seeded hash from the key's hash, murmur3 finalizer.
+    uint64_t seededHash( uint64_t hash, uint32_t seed ) {
+        hash ^= seed * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    /**
+     * Hash and displace: keys are split in buckets by one hash, then each bucket,
+     * biggest first, gets the seed that puts all its keys in free slots.
+     * A lookup is one bucket read, one slot read and one compare.
+     */
+    class PerfectHashTable {
+    public:
+        void build( std::vector<std::string> keys ) {
+            _keys = std::move(keys);
+            const size_t keyCount = _keys.size();
+            if( keyCount == 0 ) return;
+
+            std::vector<uint64_t> hashes(keyCount);
+            for( size_t k=0; k<keyCount; k++ ) {
+                hashes[k] = hashKey(_keys[k].data(), _keys[k].size());
+            }
+
+            // Start minimal, grow only if some bucket can't be placed.
+            for( size_t slotCount = keyCount; ; slotCount += keyCount / 8 + 1 ) {
+                if( tryBuild(hashes, slotCount) ) return;
+            }
+        }
+
+        /// Index of key in the built keys, or -1.
+        int32_t find( const char *key, size_t length ) const {
+            if( _slots.empty() ) return -1;
+
+            uint64_t hash = hashKey(key, length);
+            uint32_t seed = _seeds[hash % _seeds.size()];
+            int32_t index = _slots[seededHash(hash, seed) % _slots.size()];
+            if( index < 0 ) return -1;
+
+            const std::string &candidate = _keys[index];
+            return candidate.size() == length && memcmp(candidate.data(), key, length) == 0 ? index : -1;
+        }
+
+    private:
+        bool tryBuild( const std::vector<uint64_t> &hashes, size_t slotCount ) {
+            const size_t keyCount = hashes.size();
+            const size_t bucketCount = std::max((size_t)1, keyCount / RESOURCE_INDEX_KEYS_PER_BUCKET);
+
+            std::vector<std::vector<int32_t>> buckets(bucketCount);
+            for( size_t k=0; k<keyCount; k++ ) {
+                buckets[hashes[k] % bucketCount].push_back((int32_t)k);
+            }
+
+            std::vector<size_t> order(bucketCount);
+            for( size_t b=0; b<bucketCount; b++ ) order[b] = b;
+            std::stable_sort(order.begin(), order.end(), [&]( size_t a, size_t b ) {
+                return buckets[a].size() > buckets[b].size();
+            });
+
+            _seeds.assign(bucketCount, 0);
+            _slots.assign(slotCount, -1);
+
+            std::vector<size_t> placed;
+            for( size_t b : order ) {
+                const std::vector<int32_t> &bucket = buckets[b];
+                if( bucket.empty() ) break;
+
+                bool found = false;
+                for( uint32_t seed=0; seed<RESOURCE_INDEX_MAX_SEED && !found; seed++ ) {
+                    placed.clear();
+                    found = true;
+                    for( int32_t k : bucket ) {
+                        size_t slot = seededHash(hashes[k], seed) % slotCount;
+                        if( _slots[slot] >= 0 || std::find(placed.begin(), placed.end(), slot) != placed.end() ) {
+                            found = false;
+                            break;
+                        }
+                        placed.push_back(slot);
+                    }
+
+                    if( found ) {
+                        _seeds[b] = seed;
+                        for( size_t i=0; i<bucket.size(); i++ ) {
+                            _slots[placed[i]] = bucket[i];
+                        }
+                    }
+                }
+
+                if( !found ) return false;
+            }
+            return true;
+        }
+
+        std::vector<std::string> _keys;
+        std::vector<uint32_t> _seeds;       // Per bucket.
+        std::vector<int32_t> _slots;        // Key index, -1 when empty.
+    };
+
+    std::string resourceKey( NSString *name, NSString *type ) {
+        std::string key = name.UTF8String;
+        if( type.length ) {
+            key += '.';
+            key += type.UTF8String;
+        }
+        return key;
+    }
+
+} // anonymous
+
+@implementation ResourceIndex
+{
+    PerfectHashTable _table;
+    NSArray<NSString *> *_paths;    // Parallel to the table's keys.
+}
+
++ (ResourceIndex *) main {
+    static ResourceIndex *mainIndex = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mainIndex = [[ResourceIndex alloc] initWithBundles:[ResourceIndex appBundles]];
+        NSLog(@"ResourceIndex: %lu resources indexed in %0.2f ms", (unsigned long)mainIndex.count, mainIndex.buildMs);
+    });
+
+    return mainIndex;
+}
+
+/// The bundles SceneKit pathForResourceNamed: searches, in its order.
++ (NSArray<NSBundle *> *) appBundles {
+    return @[[NSBundle mainBundle],                                 // The app bundle.
+             [NSBundle bundleForClass:[BEMixedRealityMode class]],  // The Bridge Engine framework bundle.
+             [NSBundle bundleForClass:self]];                       // OpenBE, may be one of the two above.
+}
+
++ (void) prepareInBackground {
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [ResourceIndex main];
+    });
+}
+
+- (instancetype) initWithBundles:(NSArray<NSBundle *> *)bundles {
+    self = [super init];
+    if( self ) {
+        uint64_t start = mach_absolute_time();
+
+        std::vector<std::string> keys;
+        std::unordered_set<std::string> seen;
+        NSMutableArray<NSString *> *paths = [NSMutableArray array];
+        NSMutableSet<NSString *> *indexedBundles = [NSMutableSet set];
+
+        auto add = [&]( const std::string &key, NSString *path ) {
+            // First one wins, like the search order.
+            if( seen.insert(key).second ) {
+                keys.push_back(key);
+                [paths addObject:path];
+            }
+        };
+
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        for( NSBundle *bundle in bundles ) {
+            NSString *root = bundle.resourcePath;
+            if( root == nil || [indexedBundles containsObject:root] ) continue;
+            [indexedBundles addObject:root];
+
+            std::vector<std::pair<std::string, NSString *>> assets;
+            NSDirectoryEnumerator *enumerator = [fileManager enumeratorAtPath:root];
+            for( NSString *relativePath in enumerator ) {
+                NSString *extension = relativePath.pathExtension;
+
+                // Other bundles nested in this one are indexed on their own, localizations fall back to NSBundle.
+                if( [extension isEqualToString:@"framework"] || [extension isEqualToString:@"lproj"] ) {
+                    [enumerator skipDescendants];
+                    continue;
+                }
+
+                NSString *path = [root stringByAppendingPathComponent:relativePath];
+                std::string key = relativePath.UTF8String;
+                add(key, path);
+
+                const size_t assetsPrefixLength = strlen(RESOURCE_INDEX_ASSETS_FOLDER);
+                if( key.size() > assetsPrefixLength && key.compare(0, assetsPrefixLength, RESOURCE_INDEX_ASSETS_FOLDER) == 0 ) {
+                    assets.emplace_back(key.substr(assetsPrefixLength), path);
+                }
+            }
+
+            // A bundle's own resources come before its OpenBE.scnassets ones.
+            for( auto &asset : assets ) {
+                add(asset.first, asset.second);
+            }
+        }
+
+        _paths = [paths copy];
+        _count = paths.count;
+        _table.build(std::move(keys));
+        _buildMs = machTicksToMs(mach_absolute_time() - start);
+    }
+    return self;
+}
+
+- (NSString *) pathForResourceNamed:(NSString *)name withExtension:(NSString *)type {
+    if( name == nil ) return nil;
+
+    std::string key = resourceKey(name, type);
+    int32_t index = _table.find(key.data(), key.size());
+    return index < 0 ? nil : _paths[index];
+}
+
+@end
+
+#pragma mark - Benchmark
+
+@implementation ResourceIndex (Benchmark)
+
++ (NSString *) benchmarkWithNames:(NSArray<NSString *> *)names iterations:(NSUInteger)iterations {
+    NSArray<NSBundle *> *bundles = [ResourceIndex appBundles];
+
+    ResourceIndex *index = [[ResourceIndex alloc] initWithBundles:bundles];
+
+    uint64_t start = mach_absolute_time();
+    NSUInteger indexFound = 0;
+    for( NSUInteger i=0; i<iterations; i++ ) {
+        for( NSString *name in names ) {
+            if( [index pathForResourceNamed:name withExtension:nil] ) indexFound++;
+        }
+    }
+    double indexMs = machTicksToMs(mach_absolute_time() - start);
+
+    // The two NSBundle lookups per bundle SceneKit pathForResourceNamed: used to do.
+    start = mach_absolute_time();
+    NSUInteger bundleFound = 0;
+    for( NSUInteger i=0; i<iterations; i++ ) {
+        for( NSString *name in names ) {
+            for( NSBundle *bundle in bundles ) {
+                if( [bundle pathForResource:name ofType:nil]
+                   || [bundle pathForResource:[@RESOURCE_INDEX_ASSETS_FOLDER stringByAppendingString:name] ofType:nil inDirectory:nil] ) {
+                    bundleFound++;
+                    break;
+                }
+            }
+        }
+    }
+    double bundleMs = machTicksToMs(mach_absolute_time() - start);
+
+    NSUInteger lookups = MAX((NSUInteger)1, iterations * names.count);
+    NSString *report = [NSString stringWithFormat:
+        @"ResourceIndex: cold build %0.2f ms for %lu resources. %lu lookups: index %0.4f ms each (%lu found), NSBundle %0.4f ms each (%lu found), %0.1fx",
+        index.buildMs, (unsigned long)index.count, (unsigned long)lookups,
+        indexMs / lookups, (unsigned long)indexFound, bundleMs / lookups, (unsigned long)bundleFound,
+        indexMs > 0 ? bundleMs / indexMs : 0.0];
+    NSLog(@"%@", report);
+    return report;
+}
+
+@end
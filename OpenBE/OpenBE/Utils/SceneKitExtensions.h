@@ -36,6 +36,9 @@
 /// the openbe.metal library
 + (SCNProgram*)openbeMetalProgramWithVertexFunctionName:(NSString*)vertexName
                                    fragmentFunctionName:(NSString*)fragmentName;
+
+/// The library compiled from OpenBE.metal, loaded once.
++ (id<MTLLibrary>)openbeMetalLibrary;
 @end
 
 @interface SCNScene (OpenBEExtensions)
@@ -6,7 +6,10 @@
  */
 
 #import "SceneKitExtensions.h"
+#import "ResourceIndex.h"
+#import "NodeSet.h"
 #import "../Core/Core.h"
+#import "../Core/ShaderCache.h"
 
 #import <BridgeEngine/BridgeEngine.h>
 
@@ -18,6 +21,34 @@
 @implementation SceneKit
 
 + (NSString*) pathForResourceNamed:(NSString*)resourceName withExtension:(NSString*)type
+{
+    NSString* indexedPath = [[ResourceIndex main] pathForResourceNamed:resourceName withExtension:type];
+    if (indexedPath)
+        return indexedPath;
+
+    // Names the index doesn't have, like localized ones, are probed on disk once, misses included.
+    static NSMutableDictionary<NSString*, id>* resolvedPaths = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        resolvedPaths = [NSMutableDictionary dictionary];
+    });
+
+    NSString* key = type ? [NSString stringWithFormat:@"%@|%@", resourceName, type] : resourceName;
+    id resolved;
+    @synchronized (resolvedPaths) {
+        resolved = resolvedPaths[key];
+    }
+    if (resolved)
+        return resolved == [NSNull null] ? nil : resolved;
+
+    NSString* resourcePath = [SceneKit searchBundlesForResourceNamed:resourceName withExtension:type];
+    @synchronized (resolvedPaths) {
+        resolvedPaths[key] = resourcePath ?: [NSNull null];
+    }
+    return resourcePath;
+}
+
++ (NSString*) searchBundlesForResourceNamed:(NSString*)resourceName withExtension:(NSString*)type
 {
     NSString* resourcePath = nil;
 //    NSLog(@"looking for %@", resourceName);
@@ -98,14 +129,9 @@
 /// Attributes: position, normal, textureCoordinate
 /// Uniforms: modelViewProjection, modelView, normalTransform, projection
 + (SCNProgram *)programWithGLShader:(NSString *)shaderName {
-    NSURL *vertexShaderURL   = [SceneKit URLForResource:shaderName withExtension:@"vsh"];
-    NSURL *fragmentShaderURL = [SceneKit URLForResource:shaderName withExtension:@"fsh"];
-    NSString *vertexShader   = [[NSString alloc] initWithContentsOfURL:vertexShaderURL
-                                                              encoding:NSUTF8StringEncoding
-                                                                 error:NULL];
-    NSString *fragmentShader = [[NSString alloc] initWithContentsOfURL:fragmentShaderURL
-                                                              encoding:NSUTF8StringEncoding
-                                                                 error:NULL];
+    // Read once, baked when available.
+    NSString *vertexShader   = [[ShaderCache main] glSourceNamed:shaderName extension:@"vsh"];
+    NSString *fragmentShader = [[ShaderCache main] glSourceNamed:shaderName extension:@"fsh"];
     
     // Create a shader program and assign the shaders
     SCNProgram *program = [SCNProgram program];
@@ -146,20 +172,24 @@
 + (SCNProgram*)openbeMetalProgramWithVertexFunctionName:(NSString*)vertexName
                              fragmentFunctionName:(NSString*)fragmentName {
 
-    // Use the bundle holds the SceneKit -Extensions- class, like the OpenBE.framework.
-    NSBundle *bundle = [NSBundle bundleForClass:SceneKit.class];
-    static id<MTLLibrary> openbeLib = nil;
-    if( openbeLib == nil ) {
-        openbeLib = [MTLCreateSystemDefaultDevice() newDefaultLibraryWithBundle:bundle error:nil];
-    }
-    
     SCNProgram * program = [SCNProgram program];
     program.vertexFunctionName = vertexName;
     program.fragmentFunctionName = fragmentName;
-    program.library = openbeLib;
+    program.library = [self openbeMetalLibrary];
     return program;
 }
 
++ (id<MTLLibrary>)openbeMetalLibrary {
+    // Use the bundle holds the SceneKit -Extensions- class, like the OpenBE.framework.
+    static id<MTLLibrary> openbeLib = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSBundle *bundle = [NSBundle bundleForClass:SceneKit.class];
+        openbeLib = [MTLCreateSystemDefaultDevice() newDefaultLibraryWithBundle:bundle error:nil];
+    });
+    return openbeLib;
+}
+
 @end
 
 #pragma mark - SCNNode
@@ -210,52 +240,37 @@
 }
 
 - (void) setCastsShadowRecursively:(bool)castShadow {
-    self.castsShadow = castShadow;
-    for( SCNNode * child in self.childNodes ) {
-        [child setCastsShadowRecursively:castShadow];
-    }
+    [[NodeSet nodeSetWithRoot:self] setValue:NodeSetInteger(castShadow) forProperty:NodeSetPropertyCastsShadow];
 }
 
 - (void) setCategoryBitMaskRecursively:(int)bitmask {
-    self.categoryBitMask = bitmask;
-    for( SCNNode * child in self.childNodes ) {
-        [child setCategoryBitMaskRecursively:bitmask];
-    }
+    [[NodeSet nodeSetWithRoot:self] setValue:NodeSetInteger(bitmask) forProperty:NodeSetPropertyCategoryBitMask];
 }
 
 - (void) setRenderingOrderRecursively:(int)order {
-    self.renderingOrder = order;
-    for( SCNNode * child in self.childNodes ) {
-        [child setRenderingOrderRecursively:order];
-    }
+    [[NodeSet nodeSetWithRoot:self] setValue:NodeSetInteger(order) forProperty:NodeSetPropertyRenderingOrder];
 }
 
 - (void) setOpacityRecursively:(float)opacity {
-    self.opacity = opacity;
-    for( SCNNode * child in self.childNodes ) {
-        [child setOpacityRecursively:opacity];
-    }
+    [[NodeSet nodeSetWithRoot:self] setValue:NodeSetNumber(opacity) forProperty:NodeSetPropertyOpacity];
 }
 
 - (void) setEmissionRecursively:(id)emissionValue {
-    [self.geometry.firstMaterial.emission setContents:emissionValue];
-    for( SCNNode * child in self.childNodes ) {
-        [child setEmissionRecursively:emissionValue];
-    }
+    [self _enumerateHierarchyUsingBlock:^(SCNNode *node, BOOL *stop) {
+        [node.geometry.firstMaterial.emission setContents:emissionValue];
+    }];
 }
 
 - (void) setWritesToDepthBufferRecursively:(BOOL)doDepthTest {
-    self.geometry.firstMaterial.writesToDepthBuffer = doDepthTest;
-    for( SCNNode * child in self.childNodes ) {
-        [child setWritesToDepthBufferRecursively:doDepthTest];
-    }
+    [self _enumerateHierarchyUsingBlock:^(SCNNode *node, BOOL *stop) {
+        node.geometry.firstMaterial.writesToDepthBuffer = doDepthTest;
+    }];
 }
 
 - (void) setReadsFromDepthBufferRecursively:(BOOL)doDepthTest {
-    self.geometry.firstMaterial.readsFromDepthBuffer = doDepthTest;
-    for( SCNNode * child in self.childNodes ) {
-        [child setReadsFromDepthBufferRecursively:doDepthTest];
-    }
+    [self _enumerateHierarchyUsingBlock:^(SCNNode *node, BOOL *stop) {
+        node.geometry.firstMaterial.readsFromDepthBuffer = doDepthTest;
+    }];
 }
 
 + (SCNNode*) firstNodeFromSceneNamed:(NSString*)sceneName
@@ -8,6 +8,7 @@
 #import <GLKit/GLKit.h>
 #import <SceneKit/SceneKit.h>
 #import "SceneKitTools.h"
+#import "NodeSet.h"
 
 NSString* NSStringFromSCNVector3(SCNVector3 vector)
 {
@@ -408,31 +409,19 @@ SCNMatrix4 SCNMatrix4MakeFromSCNVector3(SCNVector3 vector)
 }
 
 + (void) setCastShadow:(bool)castShadow ofNode:(SCNNode *)node {
-    node.castsShadow = castShadow;
-    for( SCNNode * child in node.childNodes ) {
-        [SceneKitTools setCastShadow:castShadow ofNode:child];
-    }
+    [[NodeSet nodeSetWithRoot:node] setValue:NodeSetInteger(castShadow) forProperty:NodeSetPropertyCastsShadow];
 }
 
 + (void) setCategoryBitMask:(int)bitmask ofNode:(SCNNode *)node {
-    node.categoryBitMask = bitmask;
-    for( SCNNode * child in node.childNodes ) {
-        [SceneKitTools setCategoryBitMask:bitmask ofNode:child];
-    }
+    [[NodeSet nodeSetWithRoot:node] setValue:NodeSetInteger(bitmask) forProperty:NodeSetPropertyCategoryBitMask];
 }
 
 + (void) setRenderingOrder:(int)order ofNode:(SCNNode *)node {
-    node.renderingOrder = order;
-    for( SCNNode * child in node.childNodes ) {
-        [SceneKitTools setRenderingOrder:order ofNode:child];
-    }
+    [[NodeSet nodeSetWithRoot:node] setValue:NodeSetInteger(order) forProperty:NodeSetPropertyRenderingOrder];
 }
 
 + (void) setOpacity:(float)opacity ofNode:(SCNNode *)node {
-    node.opacity = opacity;
-    for( SCNNode * child in node.childNodes ) {
-        [SceneKitTools setOpacity:opacity ofNode:child];
-    }
+    [[NodeSet nodeSetWithRoot:node] setValue:NodeSetNumber(opacity) forProperty:NodeSetPropertyOpacity];
 }
 
 @end
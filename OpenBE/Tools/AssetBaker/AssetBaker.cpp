@@ -0,0 +1,858 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Offline asset baker, see README.md.
+//
+//  Walks an .scnassets folder and writes BakedAsset files (OpenBE/Core/BakedAsset.hpp):
+//  - <path>.dae.bebk for each COLLADA scene: its node hierarchy and keyframed
+//    transform animations.
+//  - Shaders.bebk: every .vsh/.fsh pair, with includes resolved and comments
+//    and blank lines stripped, named like programWithGLShader: expects.
+//
+//  Scenes whose baked file already holds their source's hash are skipped, and
+//  files are only rewritten when their bytes change, so it's cheap to run on
+//  every build, as the OpenBE target's Bake Assets phase does.
+//
+//  Plain C++14 and POSIX, so it runs on the Linux build machines.
+//
+
+#include "BakedAsset.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace {
+
+    using namespace BE;
+
+    const char* kShadersFile = "Shaders.bebk";
+    const char* kBakedExtension = ".bebk";
+
+#pragma mark - Files
+
+    bool readFile (const std::string& path, std::string& contents)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) return false;
+        std::ostringstream buffer;
+        buffer << stream.rdbuf();
+        contents = buffer.str();
+        return true;
+    }
+
+    bool makeDirectories (const std::string& path)
+    {
+        for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+        {
+            std::string part = path.substr(0, slash);
+            if (!part.empty() && mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) return false;
+            if (slash == std::string::npos) return true;
+        }
+    }
+
+    std::string directoryOf (const std::string& path)
+    {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    }
+
+    bool hasSuffix (const std::string& s, const std::string& suffix)
+    {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    /// Files under root, as paths relative to it, sorted so bakes are reproducible.
+    void listFiles (const std::string& root, const std::string& relative, std::vector<std::string>& files)
+    {
+        std::string path = relative.empty() ? root : root + "/" + relative;
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr) return;
+
+        while (dirent* entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..") continue;
+
+            std::string child = relative.empty() ? name : relative + "/" + name;
+            struct stat info;
+            if (stat((root + "/" + child).c_str(), &info) != 0) continue;
+
+            if (S_ISDIR(info.st_mode)) listFiles(root, child, files);
+            else files.push_back(child);
+        }
+        closedir(dir);
+
+        std::sort(files.begin(), files.end());
+    }
+
+#pragma mark - XML
+
+    /// Just enough XML for the SceneKit COLLADA exporter: elements, attributes and text.
+    struct XmlElement
+    {
+        std::string name;
+        std::map<std::string, std::string> attributes;
+        std::string text;
+        std::vector<std::unique_ptr<XmlElement>> children;
+
+        std::string attribute (const char* key) const
+        {
+            auto found = attributes.find(key);
+            return found == attributes.end() ? std::string() : found->second;
+        }
+
+        const XmlElement* child (const char* childName) const
+        {
+            for (auto& c : children) if (c->name == childName) return c.get();
+            return nullptr;
+        }
+
+        template <typename Visitor>
+        void visit (Visitor&& visitor) const
+        {
+            visitor(*this);
+            for (auto& c : children) c->visit(visitor);
+        }
+    };
+
+    std::unique_ptr<XmlElement> parseXml (const std::string& xml, std::string& error)
+    {
+        auto root = std::unique_ptr<XmlElement>(new XmlElement());
+        std::vector<XmlElement*> stack { root.get() };
+
+        size_t pos = 0;
+        while (pos < xml.size())
+        {
+            size_t open = xml.find('<', pos);
+            if (open == std::string::npos) break;
+            stack.back()->text.append(xml, pos, open - pos);
+
+            if (xml.compare(open, 4, "<!--") == 0)
+            {
+                size_t end = xml.find("-->", open);
+                if (end == std::string::npos) { error = "unterminated comment"; return nullptr; }
+                pos = end + 3;
+                continue;
+            }
+
+            size_t close = xml.find('>', open);
+            if (close == std::string::npos) { error = "unterminated tag"; return nullptr; }
+            std::string tag = xml.substr(open + 1, close - open - 1);
+            pos = close + 1;
+
+            if (tag.empty() || tag[0] == '?' || tag[0] == '!') continue;
+
+            if (tag[0] == '/')
+            {
+                if (stack.size() < 2) { error = "unbalanced closing tag"; return nullptr; }
+                stack.pop_back();
+                continue;
+            }
+
+            bool selfClosing = tag.back() == '/';
+            if (selfClosing) tag.pop_back();
+
+            auto element = std::unique_ptr<XmlElement>(new XmlElement());
+            size_t nameEnd = tag.find_first_of(" \t\r\n");
+            element->name = tag.substr(0, nameEnd);
+
+            // Attributes: key="value" pairs.
+            size_t a = nameEnd;
+            while (a != std::string::npos && a < tag.size())
+            {
+                size_t equals = tag.find('=', a);
+                if (equals == std::string::npos) break;
+                size_t quote = tag.find_first_of("\"'", equals);
+                if (quote == std::string::npos) break;
+                size_t endQuote = tag.find(tag[quote], quote + 1);
+                if (endQuote == std::string::npos) break;
+
+                size_t keyStart = tag.find_first_not_of(" \t\r\n", a);
+                size_t keyEnd = tag.find_last_not_of(" \t\r\n", equals - 1);
+                element->attributes[tag.substr(keyStart, keyEnd - keyStart + 1)] = tag.substr(quote + 1, endQuote - quote - 1);
+                a = endQuote + 1;
+            }
+
+            XmlElement* raw = element.get();
+            stack.back()->children.push_back(std::move(element));
+            if (!selfClosing) stack.push_back(raw);
+        }
+
+        if (stack.size() != 1) { error = "unclosed elements"; return nullptr; }
+        return root;
+    }
+
+    std::vector<float> parseFloats (const std::string& text)
+    {
+        std::vector<float> values;
+        const char* p = text.c_str();
+        char* end = nullptr;
+        for (;;)
+        {
+            float v = strtof(p, &end);
+            if (end == p) break;
+            values.push_back(v);
+            p = end;
+        }
+        return values;
+    }
+
+    /// COLLADA matrices are row-major with the translation in the last column, SCNMatrix4 is its transpose.
+    void colladaToSCNMatrix (const float* collada, float* scn)
+    {
+        for (int row = 0; row < 4; ++row)
+            for (int col = 0; col < 4; ++col)
+                scn[row * 4 + col] = collada[col * 4 + row];
+    }
+
+#pragma mark - Writer
+
+    /// Records refer to blob offsets until write, which rebases them to file offsets.
+    struct BakedAssetWriter
+    {
+        uint64_t sourceHash = 0;
+        std::vector<BakedNode> nodes;
+        std::vector<BakedChannel> channels;
+        std::vector<BakedShader> shaders;
+        std::vector<uint8_t> blob;
+
+        uint32_t addBytes (const void* data, size_t size, size_t alignment)
+        {
+            while (blob.size() % alignment) blob.push_back(0);
+            uint32_t offset = (uint32_t)blob.size();
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            blob.insert(blob.end(), bytes, bytes + size);
+            return offset;
+        }
+
+        uint32_t addString (const std::string& s) { return addBytes(s.c_str(), s.size() + 1, 1); }
+        uint32_t addFloats (const float* f, size_t count) { return addBytes(f, count * sizeof(float), kBakedAssetAlignment); }
+
+        static size_t align (size_t offset) { return (offset + kBakedAssetAlignment - 1) & ~(size_t)(kBakedAssetAlignment - 1); }
+
+        bool write (const std::string& path, std::string& error)
+        {
+            std::vector<BakedSection> sections;
+            size_t offset = align(sizeof(BakedAssetHeader) + 3 * sizeof(BakedSection));
+
+            auto addSection = [&] (BakedSectionType type, size_t count, size_t recordSize)
+            {
+                if (count == 0) return;
+                sections.push_back({ type, (uint32_t)offset, (uint32_t)count, (uint32_t)recordSize });
+                offset = align(offset + count * recordSize);
+            };
+            addSection(BakedSectionNodes, nodes.size(), sizeof(BakedNode));
+            addSection(BakedSectionChannels, channels.size(), sizeof(BakedChannel));
+            addSection(BakedSectionShaders, shaders.size(), sizeof(BakedShader));
+
+            const uint32_t base = (uint32_t)offset;
+            for (auto& n : nodes) n.name += base;
+            for (auto& c : channels) { c.target += base; c.times += base; c.values += base; }
+            for (auto& s : shaders) { s.name += base; s.vertex += base; s.fragment += base; }
+
+            std::vector<uint8_t> file(base + blob.size(), 0);
+            BakedAssetHeader header = { kBakedAssetMagic, kBakedAssetVersion, (uint32_t)file.size(), (uint32_t)sections.size(), sourceHash };
+            memcpy(file.data(), &header, sizeof(header));
+            memcpy(file.data() + sizeof(header), sections.data(), sections.size() * sizeof(BakedSection));
+
+            for (const BakedSection& section : sections)
+            {
+                const void* records = section.type == BakedSectionNodes ? (const void*)nodes.data()
+                    : section.type == BakedSectionChannels ? (const void*)channels.data()
+                    : (const void*)shaders.data();
+                memcpy(file.data() + section.offset, records, section.count * section.recordSize);
+            }
+            memcpy(file.data() + base, blob.data(), blob.size());
+
+            // Round trip through the runtime's validation before writing anything.
+            std::unique_ptr<uint8_t, decltype(&free)> aligned((uint8_t*)aligned_alloc(kBakedAssetAlignment, align(file.size())), &free);
+            memcpy(aligned.get(), file.data(), file.size());
+            BakedAssetView view;
+            if (!view.open(aligned.get(), file.size(), &error)) return false;
+
+            // Leave an unchanged file alone, so Xcode doesn't copy it again.
+            std::string existing;
+            if (readFile(path, existing) && existing.size() == file.size() && memcmp(existing.data(), file.data(), file.size()) == 0)
+                return true;
+
+            if (!makeDirectories(directoryOf(path))) { error = "can't create output folder"; return false; }
+            std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+            stream.write((const char*)file.data(), file.size());
+            if (!stream) { error = "write failed"; return false; }
+            return true;
+        }
+    };
+
+#pragma mark - COLLADA
+
+    // Animations are resampled to matrix keys at this rate, whatever curves they were authored with.
+    const float kBakeSampleRate = 30.f;
+
+    struct ColladaStats
+    {
+        size_t nodes = 0;
+        size_t channels = 0;
+        size_t skipped = 0;     // Curves that couldn't be resolved.
+        bool upToDate = false;  // Already baked from this source.
+    };
+
+    /// One <translate>, <rotate>, <scale> or <matrix> of a node, in document order.
+    struct ColladaTransform
+    {
+        std::string type;
+        std::string sid;
+        std::vector<float> values;
+    };
+
+    /// Keyframed curve driving some of a transform's values.
+    struct ColladaCurve
+    {
+        size_t transform;       // Index in the node's transforms.
+        size_t first;           // First value driven.
+        size_t components;      // Values driven, 16 for a whole matrix.
+        std::vector<float> times;
+        std::vector<float> values;
+        std::vector<std::string> interpolations;
+        std::vector<float> inTangents;      // (time, value) per component per key.
+        std::vector<float> outTangents;
+
+        float evaluate (float t, size_t component) const
+        {
+            const size_t keys = times.size();
+            if (t <= times[0] || keys == 1) return values[component];
+            if (t >= times[keys - 1]) return values[(keys - 1) * components + component];
+
+            size_t k = std::upper_bound(times.begin(), times.end(), t) - times.begin() - 1;
+            float t0 = times[k], t1 = times[k + 1];
+            float v0 = values[k * components + component], v1 = values[(k + 1) * components + component];
+            const std::string& interpolation = k < interpolations.size() ? interpolations[k] : std::string("LINEAR");
+
+            if (interpolation == "STEP") return v0;
+
+            size_t tangent = (k * components + component) * 2;
+            size_t nextTangent = ((k + 1) * components + component) * 2;
+            if (interpolation == "BEZIER" && nextTangent + 1 < inTangents.size() && tangent + 1 < outTangents.size())
+            {
+                // 2D cubic: solve x(s) = t for s, then evaluate y(s).
+                float x0 = t0, x1 = outTangents[tangent], x2 = inTangents[nextTangent], x3 = t1;
+                float y0 = v0, y1 = outTangents[tangent + 1], y2 = inTangents[nextTangent + 1], y3 = v1;
+                float lo = 0.f, hi = 1.f, s = (t - t0) / (t1 - t0);
+                for (int i = 0; i < 24; ++i)
+                {
+                    float u = 1.f - s;
+                    float x = u*u*u*x0 + 3*u*u*s*x1 + 3*u*s*s*x2 + s*s*s*x3;
+                    if (x < t) lo = s; else hi = s;
+                    s = 0.5f * (lo + hi);
+                }
+                float u = 1.f - s;
+                return u*u*u*y0 + 3*u*u*s*y1 + 3*u*s*s*y2 + s*s*s*y3;
+            }
+
+            return v0 + (v1 - v0) * (t - t0) / (t1 - t0);
+        }
+    };
+
+    struct ColladaNode
+    {
+        std::string name;
+        int32_t parent;
+        std::vector<ColladaTransform> transforms;
+        std::vector<ColladaCurve> curves;
+    };
+
+    /// result = a * b, row-major with column vectors like COLLADA.
+    void multiply (const float* a, const float* b, float* result)
+    {
+        float m[16];
+        for (int r = 0; r < 4; ++r)
+            for (int c = 0; c < 4; ++c)
+                m[r * 4 + c] = a[r * 4 + 0] * b[0 * 4 + c] + a[r * 4 + 1] * b[1 * 4 + c]
+                             + a[r * 4 + 2] * b[2 * 4 + c] + a[r * 4 + 3] * b[3 * 4 + c];
+        memcpy(result, m, sizeof(m));
+    }
+
+    /// Local matrix of a node's transform stack, in SCNMatrix4 order.
+    void composeTransforms (const std::vector<ColladaTransform>& transforms, float* scn)
+    {
+        float m[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+        for (const ColladaTransform& transform : transforms)
+        {
+            const std::vector<float>& v = transform.values;
+            float e[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+            if (transform.type == "matrix" && v.size() == 16) {
+                memcpy(e, v.data(), sizeof(e));
+            } else if (transform.type == "translate" && v.size() == 3) {
+                e[3] = v[0]; e[7] = v[1]; e[11] = v[2];
+            } else if (transform.type == "scale" && v.size() == 3) {
+                e[0] = v[0]; e[5] = v[1]; e[10] = v[2];
+            } else if (transform.type == "rotate" && v.size() == 4) {
+                float length = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+                if (length == 0.f) continue;
+                float x = v[0] / length, y = v[1] / length, z = v[2] / length;
+                float angle = v[3] * (float)M_PI / 180.f;
+                float c = cosf(angle), s = sinf(angle), t = 1.f - c;
+                float r[16] = {
+                    t*x*x + c,   t*x*y - s*z, t*x*z + s*y, 0,
+                    t*x*y + s*z, t*y*y + c,   t*y*z - s*x, 0,
+                    t*x*z - s*y, t*y*z + s*x, t*z*z + c,   0,
+                    0,           0,           0,           1 };
+                memcpy(e, r, sizeof(e));
+            } else {
+                continue;
+            }
+            multiply(m, e, m);
+        }
+        colladaToSCNMatrix(m, scn);
+    }
+
+    /// Which values of a transform a channel target's member selects, e.g. "X" or "ANGLE".
+    bool memberRange (const std::string& type, const std::string& member, size_t& first, size_t& count)
+    {
+        count = 1;
+        if (member.empty()) { first = 0; count = type == "matrix" ? 16 : type == "rotate" ? 4 : 3; return true; }
+        if (member == "ANGLE" && type == "rotate") { first = 3; return true; }
+        if (member == "X") { first = 0; return true; }
+        if (member == "Y") { first = 1; return true; }
+        if (member == "Z") { first = 2; return true; }
+        return false;
+    }
+
+    /**
+     * Some exports target sids ("SID_3") that no transform carries. The sampler id still says
+     * what's driven, like "locator396Node_translation399_Z30" or "locator319Node_rotation428X_ANGLE60".
+     * Resolve to the node's matching transform, adding an identity one in Maya order when it has none.
+     */
+    bool resolveBySamplerID (ColladaNode& node, const std::string& samplerID, size_t& transform, std::string& memberHint)
+    {
+        static const std::regex pattern("_(translation|rotation|scale)[0-9]+([XYZ]?)_([A-Z]+)[0-9]*$");
+        std::smatch match;
+        if (!std::regex_search(samplerID, match, pattern)) return false;
+
+        const std::string kind = match[1], axis = match[2];
+        memberHint = match[3];
+
+        ColladaTransform wanted;
+        size_t insertAt = 0;
+        if (kind == "translation") { wanted = { "translate", "", { 0, 0, 0 } }; insertAt = 0; }
+        else if (kind == "scale") { wanted = { "scale", "", { 1, 1, 1 } }; insertAt = node.transforms.size(); }
+        else if (!axis.empty())
+        {
+            wanted = { "rotate", "", { axis == "X" ? 1.f : 0.f, axis == "Y" ? 1.f : 0.f, axis == "Z" ? 1.f : 0.f, 0 } };
+            insertAt = 0;
+            while (insertAt < node.transforms.size() && node.transforms[insertAt].type != "scale") ++insertAt;
+        }
+        else return false;
+
+        for (size_t i = 0; i < node.transforms.size(); ++i)
+        {
+            const ColladaTransform& candidate = node.transforms[i];
+            if (candidate.type != wanted.type) continue;
+            if (candidate.type == "rotate" && !std::equal(wanted.values.begin(), wanted.values.begin() + 3, candidate.values.begin())) continue;
+            transform = i;
+            return true;
+        }
+
+        node.transforms.insert(node.transforms.begin() + insertAt, wanted);
+        for (ColladaCurve& curve : node.curves)
+            if (curve.transform >= insertAt) curve.transform++;
+        transform = insertAt;
+        return true;
+    }
+
+    std::vector<std::string> parseNames (const std::string& text)
+    {
+        std::vector<std::string> names;
+        std::istringstream stream(text);
+        std::string name;
+        while (stream >> name) names.push_back(name);
+        return names;
+    }
+
+    bool bakeCollada (const std::string& sourcePath, const std::string& bakedPath, ColladaStats& stats, std::string& error)
+    {
+        std::string xml;
+        if (!readFile(sourcePath, xml)) { error = "can't read"; return false; }
+
+        const uint64_t sourceHash = bakedSourceHash(xml.data(), xml.size());
+        BakedAssetFile existing;
+        if (existing.map(bakedPath.c_str()) && existing.view().sourceHash() == sourceHash)
+        {
+            stats.upToDate = true;
+            return true;
+        }
+
+        std::unique_ptr<XmlElement> root = parseXml(xml, error);
+        if (!root) return false;
+
+        // Node hierarchy, depth first so parents come first.
+        std::vector<ColladaNode> nodes;
+        std::map<std::string, size_t> nodesByID;
+        std::function<void(const XmlElement&, int32_t)> addNodes = [&] (const XmlElement& element, int32_t parent)
+        {
+            for (auto& child : element.children)
+            {
+                if (child->name != "node") continue;
+
+                ColladaNode node;
+                node.name = child->attribute("name");
+                if (node.name.empty()) node.name = child->attribute("id");
+                node.parent = parent;
+                for (auto& t : child->children)
+                {
+                    if (t->name == "matrix" || t->name == "translate" || t->name == "rotate" || t->name == "scale")
+                        node.transforms.push_back({ t->name, t->attribute("sid"), parseFloats(t->text) });
+                }
+
+                size_t index = nodes.size();
+                nodesByID[child->attribute("id")] = index;
+                nodes.push_back(std::move(node));
+                addNodes(*child, (int32_t)index);
+            }
+        };
+        root->visit([&] (const XmlElement& element) {
+            if (element.name == "visual_scene") addNodes(element, -1);
+        });
+
+        // Animation sources, samplers and channels.
+        std::map<std::string, std::vector<float>> floatSources;
+        std::map<std::string, std::vector<std::string>> nameSources;
+        std::map<std::string, std::map<std::string, std::string>> samplers;  // id -> semantic -> source
+        std::vector<std::pair<std::string, std::string>> channels;          // (sampler, target)
+        auto stripHash = [] (std::string s) { if (!s.empty() && s[0] == '#') s.erase(0, 1); return s; };
+        root->visit([&] (const XmlElement& element) {
+            if (element.name == "source") {
+                if (const XmlElement* array = element.child("float_array"))
+                    floatSources[element.attribute("id")] = parseFloats(array->text);
+                if (const XmlElement* array = element.child("Name_array"))
+                    nameSources[element.attribute("id")] = parseNames(array->text);
+            } else if (element.name == "sampler") {
+                auto& inputs = samplers[element.attribute("id")];
+                for (auto& in : element.children)
+                    if (in->name == "input") inputs[in->attribute("semantic")] = stripHash(in->attribute("source"));
+            } else if (element.name == "channel") {
+                channels.push_back({ stripHash(element.attribute("source")), element.attribute("target") });
+            }
+        });
+
+        // Attach each channel's curve to the transform it drives. Target is "<node id>/<sid>[.<member>]".
+        float duration = 0.f;
+        for (auto& channel : channels)
+        {
+            const std::string& target = channel.second;
+            size_t slash = target.find('/');
+            size_t dot = target.find('.', slash);
+            auto node = nodesByID.find(target.substr(0, slash));
+            auto sampler = samplers.find(channel.first);
+            if (slash == std::string::npos || node == nodesByID.end() || sampler == samplers.end()) { stats.skipped++; continue; }
+
+            ColladaNode& colladaNode = nodes[node->second];
+            std::string sid = target.substr(slash + 1, dot == std::string::npos ? std::string::npos : dot - slash - 1);
+            std::string member = dot == std::string::npos ? std::string() : target.substr(dot + 1);
+
+            auto& inputs = sampler->second;
+            ColladaCurve curve;
+            curve.times = floatSources[inputs["INPUT"]];
+            curve.values = floatSources[inputs["OUTPUT"]];
+            curve.interpolations = nameSources[inputs["INTERPOLATION"]];
+            curve.inTangents = floatSources[inputs["IN_TANGENT"]];
+            curve.outTangents = floatSources[inputs["OUT_TANGENT"]];
+
+            curve.transform = colladaNode.transforms.size();
+            for (size_t i = 0; i < colladaNode.transforms.size(); ++i)
+                if (colladaNode.transforms[i].sid == sid) curve.transform = i;
+
+            std::string memberHint;
+            if (curve.transform == colladaNode.transforms.size()
+                && !resolveBySamplerID(colladaNode, channel.first, curve.transform, memberHint))
+            {
+                stats.skipped++;
+                continue;
+            }
+
+            // Whole targets of those exports are sometimes the single member the sampler id names.
+            const std::string& type = colladaNode.transforms[curve.transform].type;
+            bool resolved = memberRange(type, member, curve.first, curve.components);
+            if (member.empty() && !memberHint.empty() && curve.values.size() != curve.times.size() * curve.components)
+                resolved = memberRange(type, memberHint, curve.first, curve.components);
+
+            if (!resolved || curve.times.empty() || curve.values.size() != curve.times.size() * curve.components
+                || curve.first + curve.components > colladaNode.transforms[curve.transform].values.size())
+            {
+                stats.skipped++;
+                continue;
+            }
+
+            duration = std::max(duration, curve.times.back());
+            colladaNode.curves.push_back(std::move(curve));
+        }
+
+        BakedAssetWriter writer;
+        writer.sourceHash = sourceHash;
+        for (const ColladaNode& node : nodes)
+        {
+            BakedNode baked = {};
+            baked.name = writer.addString(node.name);
+            baked.parent = node.parent;
+            composeTransforms(node.transforms, baked.transform);
+            writer.nodes.push_back(baked);
+        }
+
+        // Resample every animated node's whole transform stack.
+        const uint32_t keyCount = (uint32_t)ceilf(duration * kBakeSampleRate) + 1;
+        std::vector<float> times(keyCount), values(keyCount * 16);
+        for (uint32_t k = 0; k < keyCount; ++k) times[k] = std::min(duration, k / kBakeSampleRate);
+
+        for (const ColladaNode& node : nodes)
+        {
+            if (node.curves.empty()) continue;
+
+            std::vector<ColladaTransform> transforms = node.transforms;
+            for (uint32_t k = 0; k < keyCount; ++k)
+            {
+                for (const ColladaCurve& curve : node.curves)
+                    for (size_t c = 0; c < curve.components; ++c)
+                        transforms[curve.transform].values[curve.first + c] = curve.evaluate(times[k], c);
+
+                composeTransforms(transforms, &values[k * 16]);
+            }
+
+            BakedChannel baked = {};
+            baked.target = writer.addString(node.name);
+            baked.keyCount = keyCount;
+            baked.times = writer.addFloats(times.data(), times.size());
+            baked.values = writer.addFloats(values.data(), values.size());
+            writer.channels.push_back(baked);
+        }
+
+        stats.nodes += writer.nodes.size();
+        stats.channels += writer.channels.size();
+        return writer.write(bakedPath, error);
+    }
+
+#pragma mark - Shaders
+
+    /// Resolve #include "file", drop comments, indentation and blank lines. Line structure is kept for directives.
+    bool preprocessShader (const std::string& path, std::string& out, int depth, std::string& error)
+    {
+        if (depth > 8) { error = "includes nested too deep in " + path; return false; }
+
+        std::string source;
+        if (!readFile(path, source)) { error = "can't read " + path; return false; }
+
+        // Comments first, they can span lines.
+        std::string code;
+        code.reserve(source.size());
+        for (size_t i = 0; i < source.size(); )
+        {
+            if (source.compare(i, 2, "//") == 0) {
+                i = source.find('\n', i);
+                if (i == std::string::npos) break;
+            } else if (source.compare(i, 2, "/*") == 0) {
+                size_t end = source.find("*/", i + 2);
+                if (end == std::string::npos) break;
+                code.append(std::count(source.begin() + i, source.begin() + end, '\n'), '\n');
+                i = end + 2;
+            } else {
+                code.push_back(source[i++]);
+            }
+        }
+
+        std::istringstream lines(code);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            size_t first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos) continue;
+            size_t last = line.find_last_not_of(" \t\r");
+            line = line.substr(first, last - first + 1);
+
+            if (line.compare(0, 8, "#include") == 0)
+            {
+                size_t open = line.find('"');
+                size_t close = line.find('"', open + 1);
+                if (open == std::string::npos || close == std::string::npos) { error = "bad #include in " + path; return false; }
+                if (!preprocessShader(directoryOf(path) + "/" + line.substr(open + 1, close - open - 1), out, depth + 1, error)) return false;
+                continue;
+            }
+
+            out += line;
+            out += '\n';
+        }
+        return true;
+    }
+
+    bool bakeShaders (const std::string& root, const std::vector<std::string>& files, const std::string& bakedPath, size_t& count, std::string& error)
+    {
+        BakedAssetWriter writer;
+        for (const std::string& file : files)
+        {
+            if (!hasSuffix(file, ".vsh")) continue;
+
+            std::string name = file.substr(0, file.size() - 4);
+            if (std::find(files.begin(), files.end(), name + ".fsh") == files.end()) continue;
+
+            std::string vertex, fragment, vertexSource, fragmentSource;
+            if (!preprocessShader(root + "/" + file, vertex, 0, error)) return false;
+            if (!preprocessShader(root + "/" + name + ".fsh", fragment, 0, error)) return false;
+            if (!readFile(root + "/" + file, vertexSource) || !readFile(root + "/" + name + ".fsh", fragmentSource))
+            {
+                error = "can't read " + name;
+                return false;
+            }
+
+            BakedShader shader = {};
+            shader.sourceHash = bakedSourceHash(fragmentSource.data(), fragmentSource.size(),
+                                                bakedSourceHash(vertexSource.data(), vertexSource.size()));
+            writer.sourceHash = bakedSourceHash(&shader.sourceHash, sizeof(shader.sourceHash),
+                                                writer.shaders.empty() ? kBakedSourceHashSeed : writer.sourceHash);
+            shader.name = writer.addString(name);
+            shader.vertex = writer.addString(vertex);
+            shader.vertexLength = (uint32_t)vertex.size();
+            shader.fragment = writer.addString(fragment);
+            shader.fragmentLength = (uint32_t)fragment.size();
+            writer.shaders.push_back(shader);
+        }
+
+        count = writer.shaders.size();
+        return count == 0 || writer.write(bakedPath, error);
+    }
+
+#pragma mark - Benchmark
+
+    double msSince (std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * Compare reading the sources against mapping the baked files.
+     * The baked side touches every key, so the pages are really read in.
+     */
+    int benchmark (const std::string& root, const std::vector<std::string>& files, const std::string& outputRoot)
+    {
+        double sourceMs = 0, bakedMs = 0;
+        size_t sourceBytes = 0, bakedBytes = 0;
+        volatile float sink = 0;
+
+        for (const std::string& file : files)
+        {
+            if (!hasSuffix(file, ".dae")) continue;
+
+            auto start = std::chrono::steady_clock::now();
+            std::string xml, error;
+            readFile(root + "/" + file, xml);
+            std::unique_ptr<XmlElement> dom = parseXml(xml, error);
+            size_t floats = 0;
+            if (dom) dom->visit([&] (const XmlElement& e) { if (e.name == "float_array") floats += parseFloats(e.text).size(); });
+            sourceMs += msSince(start);
+            sourceBytes += xml.size();
+            sink = sink + (float)floats;
+
+            start = std::chrono::steady_clock::now();
+            BakedAssetFile baked;
+            if (!baked.map((outputRoot + "/" + file + kBakedExtension).c_str(), &error))
+            {
+                fprintf(stderr, "%s: %s, bake first\n", file.c_str(), error.c_str());
+                return 1;
+            }
+            const BakedAssetView& view = baked.view();
+            for (uint32_t c = 0; c < view.channelCount(); ++c)
+            {
+                const BakedChannel& channel = view.channel(c);
+                const float* values = view.channelValues(channel);
+                for (uint32_t k = 0; k < channel.keyCount * 16; k += 16) sink = sink + values[k];
+            }
+            bakedMs += msSince(start);
+            bakedBytes += view.size();
+        }
+
+        printf("Sources: %8.2f ms, %7.1f KB\n", sourceMs, sourceBytes / 1024.0);
+        printf("Baked:   %8.2f ms, %7.1f KB\n", bakedMs, bakedBytes / 1024.0);
+        printf("Speedup: %8.1fx\n", bakedMs > 0 ? sourceMs / bakedMs : 0.0);
+        return 0;
+    }
+
+} // anonymous
+
+int main (int argc, char** argv)
+{
+    bool bench = argc > 1 && strcmp(argv[1], "--benchmark") == 0;
+    if (argc != (bench ? 4 : 3))
+    {
+        fprintf(stderr, "usage: %s [--benchmark] <OpenBE.scnassets> <output folder>\n", argv[0]);
+        return 2;
+    }
+
+    std::string root = argv[bench ? 2 : 1];
+    std::string outputRoot = argv[bench ? 3 : 2];
+
+    std::vector<std::string> files;
+    listFiles(root, "", files);
+    if (files.empty())
+    {
+        fprintf(stderr, "No files in %s\n", root.c_str());
+        return 1;
+    }
+
+    if (bench) return benchmark(root, files, outputRoot);
+
+    int failures = 0;
+    for (const std::string& file : files)
+    {
+        if (!hasSuffix(file, ".dae")) continue;
+
+        ColladaStats stats;
+        std::string error;
+        if (!bakeCollada(root + "/" + file, outputRoot + "/" + file + kBakedExtension, stats, error))
+        {
+            fprintf(stderr, "%s: %s\n", file.c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+        if (stats.upToDate)
+        {
+            printf("%s: up to date\n", file.c_str());
+            continue;
+        }
+        printf("%s: %zu nodes, %zu channels", file.c_str(), stats.nodes, stats.channels);
+        if (stats.skipped) printf(", %zu skipped", stats.skipped);
+        printf("\n");
+    }
+
+    size_t shaderCount = 0;
+    std::string error;
+    if (!bakeShaders(root, files, outputRoot + "/" + kShadersFile, shaderCount, error))
+    {
+        fprintf(stderr, "%s: %s\n", kShadersFile, error.c_str());
+        failures++;
+    }
+    else
+    {
+        printf("%s: %zu shaders\n", kShadersFile, shaderCount);
+    }
+
+    return failures ? 1 : 0;
+}
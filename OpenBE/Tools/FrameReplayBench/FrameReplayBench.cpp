@@ -0,0 +1,384 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Off-device replay of a FrameReplay recording, see README.md.
+//
+//  Loads the frames and button events the app recorded, or makes some up, and
+//  runs them through the portable per-frame systems headlessly: each frame's
+//  recorded delta time, the recorded camera as the listener of a
+//  SpatialAudioMixer and the eye of LineOfSight style sight lines over an
+//  OcclusionGrid, and button presses re-injected at their frame. Each system is
+//  timed and the report is written in the same CSV shape as the device's.
+//
+//  The ObjC components, SceneKit and tracking don't run here, so it measures
+//  the portable systems against real input, not the whole frame.
+//
+//  Plain C++14 and libpng, so it runs on the Linux build machines.
+//
+
+#include "FrameRecording.hpp"
+#include "OcclusionGrid.hpp"
+#include "OccupancyGridPNG.hpp"
+#include "SpatialAudioMixer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace BE;
+
+    double secondsSince (std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+#pragma mark - Synthetic input
+
+    /// A walled room with a few boxes, as a BEOccupancy bitmask grid, 4cm a pixel, centered on the origin.
+    void makeRoom (int size, OccupancyGridImage& grid)
+    {
+        grid.reset(size, size, OccupancyFloor);
+        grid.metadata.originX = -0.02f * size;
+        grid.metadata.originY = -0.02f * size;
+        grid.metadata.metersPerPixel = 0.04f;
+
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<int> position(0, size - 1);
+        std::uniform_int_distribution<int> extent(2, size / 10);
+        for (int box = 0; box < 20; ++box)
+        {
+            const int x0 = position(random), y0 = position(random);
+            const int x1 = std::min(size - 1, x0 + extent(random)), y1 = std::min(size - 1, y0 + extent(random));
+            for (int y = y0; y <= y1; ++y)
+                for (int x = x0; x <= x1; ++x) grid.row(y)[x] = OccupancyObstacle | OccupancyFloor;
+        }
+
+        for (int i = 0; i < size; ++i)
+        {
+            grid.row(0)[i] = grid.row(size - 1)[i] = OccupancyObstacle;
+            grid.row(i)[0] = grid.row(i)[size - 1] = OccupancyObstacle;
+        }
+    }
+
+    /// Walking a circle at head height, looking around, with a button press every two seconds. 60fps with jitter.
+    void makeRecording (double seconds, FrameRecording& recording)
+    {
+        std::mt19937 random(5678);
+        std::uniform_real_distribution<double> jitter(-0.002, 0.002);
+
+        recording.frames.clear();
+        recording.events.clear();
+
+        double time = 0;
+        for (uint32_t index = 0; time < seconds; ++index)
+        {
+            FrameRecordingFrame frame = {};
+            frame.deltaTime = 1.0 / 60.0 + jitter(random);
+            time += frame.deltaTime;
+
+            // World y points down.
+            const float walk = (float)(time * 0.3), look = (float)(time * 0.7);
+            frame.position[0] = 1.2f * cosf(walk);
+            frame.position[1] = -1.5f;
+            frame.position[2] = 1.2f * sinf(walk);
+            frame.forward[0] = cosf(look);
+            frame.forward[1] = 0.3f;
+            frame.forward[2] = sinf(look);
+            memcpy(frame.reticleForward, frame.forward, sizeof(frame.forward));
+            recording.frames.push_back(frame);
+
+            if (index % 120 == 60) recording.events.push_back({ index, FrameRecordingControllerButtonDown, {} });
+            if (index % 120 == 72) recording.events.push_back({ index, FrameRecordingControllerButtonUp, {} });
+        }
+    }
+
+    std::vector<float> makeTone (float sampleRate, float seconds, float frequency)
+    {
+        std::vector<float> samples((size_t)(sampleRate * seconds));
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            const float t = i / sampleRate;
+            samples[i] = 0.3f * sinf(2.f * (float)M_PI * frequency * t) * expf(-3.f * t / seconds);
+        }
+        return samples;
+    }
+
+#pragma mark - Systems
+
+    /// One system's timing, summed into a report row like a component's on device.
+    struct SystemTiming
+    {
+        const char* name;
+        double frameSeconds = 0;
+        double totalSeconds = 0;
+        double maxFrameSeconds = 0;
+        uint32_t frames = 0;
+
+        explicit SystemTiming (const char* name) : name(name) {}
+
+        double endFrame ()
+        {
+            const double seconds = frameSeconds;
+            if (seconds > 0)
+            {
+                totalSeconds += seconds;
+                maxFrameSeconds = std::max(maxFrameSeconds, seconds);
+                frames++;
+            }
+            frameSeconds = 0;
+            return seconds;
+        }
+    };
+
+    OcclusionPoint occlusionPoint (const float position[3])
+    {
+        OcclusionPoint point;
+        point.x = position[0];
+        point.z = position[2];
+        point.height = -position[1];
+        return point;
+    }
+
+    /// Where the reticle's ray meets the floor, or two meters along it when it doesn't.
+    SpatialAudioVector reticleTarget (const FrameRecordingFrame& frame)
+    {
+        const float* p = frame.position;
+        const float* d = frame.reticleForward;
+        const float t = (d[1] > 0.01f) ? -p[1] / d[1] : 2.f;
+        return { p[0] + d[0] * t, p[1] + d[1] * t, p[2] + d[2] * t };
+    }
+
+    /// Listener up from the forward, world up being -y.
+    SpatialAudioVector listenerUp (const float forward[3])
+    {
+        const float along = -forward[1];
+        float up[3] = { -forward[0] * along, -1.f - forward[1] * along, -forward[2] * along };
+        const float length = sqrtf(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
+        if (length < 1e-4f) return { 0.f, 0.f, 1.f };
+        return { up[0] / length, up[1] / length, up[2] / length };
+    }
+
+    std::vector<double> sortedCopy (std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return values;
+    }
+
+    int usage ()
+    {
+        fprintf(stderr, "Usage: FrameReplayBench [--scan directory | --room size] [--targets n] [--report path] [--write path] <recording | --synthetic seconds>\n");
+        return 1;
+    }
+
+} // anonymous
+
+int main (int argc, char** argv)
+{
+    std::string recordingPath, scanDirectory, reportPath, writePath;
+    double syntheticSeconds = 0;
+    int roomSize = 128;
+    int targetCount = 16;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--scan") == 0 && i + 1 < argc) scanDirectory = argv[++i];
+        else if (strcmp(argv[i], "--room") == 0 && i + 1 < argc) roomSize = std::max(8, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--targets") == 0 && i + 1 < argc) targetCount = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) reportPath = argv[++i];
+        else if (strcmp(argv[i], "--write") == 0 && i + 1 < argc) writePath = argv[++i];
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) syntheticSeconds = atof(argv[++i]);
+        else if (argv[i][0] != '-' && recordingPath.empty()) recordingPath = argv[i];
+        else return usage();
+    }
+    if (recordingPath.empty() == (syntheticSeconds <= 0)) return usage();
+
+    FrameRecording recording;
+    if (syntheticSeconds > 0)
+    {
+        makeRecording(syntheticSeconds, recording);
+        printf("Synthetic recording, %.1f seconds\n", syntheticSeconds);
+    }
+    else
+    {
+        std::string error;
+        if (!readFrameRecording(recordingPath.c_str(), recording, &error))
+        {
+            fprintf(stderr, "Can't load %s: %s\n", recordingPath.c_str(), error.c_str());
+            return 1;
+        }
+    }
+    printf("%zu frames, %zu events\n", recording.frames.size(), recording.events.size());
+
+    if (!writePath.empty())
+    {
+        if (!writeFrameRecording(writePath.c_str(), recording))
+        {
+            fprintf(stderr, "Can't write %s\n", writePath.c_str());
+            return 1;
+        }
+        printf("Written to %s\n", writePath.c_str());
+    }
+
+    OccupancyGridImage grid;
+    if (!scanDirectory.empty())
+    {
+        std::string error;
+        if (!loadOccupancyGridScan(scanDirectory, grid, &error))
+        {
+            fprintf(stderr, "Can't load %s: %s\n", scanDirectory.c_str(), error.c_str());
+            return 1;
+        }
+    }
+    else
+    {
+        makeRoom(roomSize, grid);
+    }
+
+    // Obstacles half a meter tall, like LineOfSight before the scan mesh raises them.
+    OcclusionGrid occlusion;
+    occlusion.reset(grid.metadata, grid.width(), grid.height(), 0.05f, 2.2f);
+    occlusion.addOccupancy(grid.view(), OccupancyObstacle, 0.5f);
+
+    // Standing queries from the camera to points on the floor, robot height, like RobotSeesMeComponent's.
+    std::vector<OcclusionPoint> targets(targetCount);
+    {
+        const OccupancyGridMetadata& metadata = grid.metadata;
+        std::mt19937 random(91011);
+        std::uniform_real_distribution<float> x(metadata.originX, metadata.originX + grid.width() * metadata.metersPerPixel);
+        std::uniform_real_distribution<float> z(metadata.originY, metadata.originY + grid.height() * metadata.metersPerPixel);
+        for (OcclusionPoint& target : targets)
+        {
+            target.x = x(random);
+            target.z = z(random);
+            target.height = 0.3f;
+        }
+    }
+    std::vector<SightLine> lines(targets.size());
+    std::vector<uint8_t> visible(targets.size());
+
+    // A looping ambience and a one-shot for each button press, like Bridget's.
+    SpatialAudioMixer mixer;
+    const float sampleRate = mixer.settings().sampleRate;
+    const std::vector<float> ambience = makeTone(sampleRate, 2.f, 110.f);
+    const std::vector<float> press = makeTone(sampleRate, 0.5f, 880.f);
+    const int ambienceSound = mixer.addSound(ambience.data(), ambience.size(), sampleRate);
+    const int pressSound = mixer.addSound(press.data(), press.size(), sampleRate);
+    for (const OcclusionPoint& target : targets) mixer.play(ambienceSound, 0.2f, { target.x, -target.height, target.z }, 1.f, true);
+
+    std::vector<float> left, right;
+    double pendingFrames = 0;
+
+    SystemTiming events("Events"), sight("LineOfSight"), audio("SpatialAudioMixer");
+    SystemTiming* systems[] = { &events, &sight, &audio };
+
+    std::vector<double> frameSeconds;
+    frameSeconds.reserve(recording.frames.size());
+    size_t nextEvent = 0, presses = 0;
+    uint64_t clearLines = 0;
+
+    for (uint32_t index = 0; index < recording.frames.size(); ++index)
+    {
+        const FrameRecordingFrame& frame = recording.frames[index];
+
+        // Re-inject this frame's input, in recorded order.
+        auto start = std::chrono::steady_clock::now();
+        while (nextEvent < recording.events.size() && recording.events[nextEvent].frame <= index)
+        {
+            if (recording.events[nextEvent].event == FrameRecordingControllerButtonDown)
+            {
+                mixer.play(pressSound, 1.f, reticleTarget(frame));
+                presses++;
+            }
+            nextEvent++;
+        }
+        events.frameSeconds += secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        const OcclusionPoint eye = occlusionPoint(frame.position);
+        for (size_t i = 0; i < targets.size(); ++i) lines[i] = { eye, targets[i] };
+        occlusion.resolve(lines.data(), lines.size(), visible.data());
+        sight.frameSeconds += secondsSince(start);
+        for (uint8_t v : visible) clearLines += v;
+
+        // Render the audio the frame's delta time covers, as the output unit would have pulled it.
+        start = std::chrono::steady_clock::now();
+        const float* p = frame.position;
+        const float* f = frame.forward;
+        mixer.setListener({ p[0], p[1], p[2] }, { f[0], f[1], f[2] }, listenerUp(f));
+        pendingFrames += std::max(0.0, frame.deltaTime) * sampleRate;
+        const size_t renderFrames = (size_t)pendingFrames;
+        pendingFrames -= renderFrames;
+        if (renderFrames > left.size())
+        {
+            left.resize(renderFrames);
+            right.resize(renderFrames);
+        }
+        if (renderFrames) mixer.render(left.data(), right.data(), renderFrames);
+        audio.frameSeconds += secondsSince(start);
+
+        double total = 0;
+        for (SystemTiming* system : systems) total += system->endFrame();
+        frameSeconds.push_back(total);
+    }
+
+    const size_t frameCount = frameSeconds.size();
+    const std::vector<double> sorted = sortedCopy(frameSeconds);
+    double mean = 0;
+    for (double seconds : sorted) mean += seconds;
+    if (frameCount) mean /= frameCount;
+    const double p95 = frameCount ? sorted[std::min(frameCount - 1, (size_t)(frameCount * 0.95))] : 0;
+    const double max = frameCount ? sorted.back() : 0;
+
+    std::sort(std::begin(systems), std::end(systems), [](const SystemTiming* a, const SystemTiming* b) {
+        return a->totalSeconds > b->totalSeconds;
+    });
+
+    // Same shape as FrameReplay's report, less the pose drift: nothing tracks here.
+    std::string report;
+    char line[256];
+    snprintf(line, sizeof(line), "# frames,%zu\n", frameCount);
+    report += line;
+    snprintf(line, sizeof(line), "# frame_mean_ms,%0.4f\n# frame_p95_ms,%0.4f\n# frame_max_ms,%0.4f\n", mean * 1000.0, p95 * 1000.0, max * 1000.0);
+    report += line;
+    report += "component,frames,mean_ms,max_ms,total_ms\n";
+    for (const SystemTiming* system : systems)
+    {
+        const double totalMs = system->totalSeconds * 1000.0;
+        snprintf(line, sizeof(line), "%s,%u,%0.4f,%0.4f,%0.4f\n",
+                 system->name, system->frames, frameCount ? totalMs / frameCount : 0.0, system->maxFrameSeconds * 1000.0, totalMs);
+        report += line;
+    }
+
+    printf("%zu button presses, %.1f%% of sight lines clear, %u voices playing\n", presses,
+           (frameCount && !targets.empty()) ? 100.0 * clearLines / (frameCount * targets.size()) : 0.0, mixer.stats().activeVoices);
+    fputs(report.c_str(), stdout);
+
+    if (!reportPath.empty())
+    {
+        FILE* file = fopen(reportPath.c_str(), "w");
+        if (!file || fputs(report.c_str(), file) < 0)
+        {
+            fprintf(stderr, "Can't write %s\n", reportPath.c_str());
+            if (file) fclose(file);
+            return 1;
+        }
+        fclose(file);
+    }
+
+    return 0;
+}
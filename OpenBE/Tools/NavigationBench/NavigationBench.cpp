@@ -0,0 +1,401 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Off-device benchmark of the navigation maps PathFinding builds, see README.md.
+//
+//  Loads a scan's occupancy grid, or makes up a room, converts it to obstacles
+//  and times NavigationGrid::build. With --compare it also times the maps the
+//  way PathFinding used to build them, nested column vectors and a search per
+//  pixel, and checks both agree pixel for pixel.
+//
+//  With --visibility it also builds an OcclusionGrid from the obstacles and
+//  times batches of random sight lines over it, checked against sampling
+//  every line finely with --compare.
+//
+//  Plain C++14 and libpng, so it runs on the Linux build machines.
+//
+
+#include "NavigationGrid.hpp"
+#include "OcclusionGrid.hpp"
+#include "OccupancyGridPNG.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace BE;
+
+    double secondsSince (std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+#pragma mark - Synthetic scan
+
+    /// A walled room with furniture, as a BEOccupancy bitmask grid, 4cm a pixel.
+    void makeRoom (int size, OccupancyGridImage& grid)
+    {
+        grid.reset(size, size, OccupancyUnknown);
+        grid.metadata.originX = -0.02f * size;
+        grid.metadata.originY = -0.02f * size;
+        grid.metadata.metersPerPixel = 0.04f;
+
+        const int wall = size / 16;
+        for (int y = wall; y < size - wall; ++y)
+        {
+            uint8_t* row = grid.row(y);
+            for (int x = wall; x < size - wall; ++x) row[x] = OccupancyFloor;
+        }
+
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<int> position(wall, size - wall);
+        std::uniform_int_distribution<int> extent(2, size / 10);
+        for (int box = 0; box < 40; ++box)
+        {
+            const int x0 = position(random), y0 = position(random);
+            const int x1 = std::min(size - 1, x0 + extent(random)), y1 = std::min(size - 1, y0 + extent(random));
+            const uint8_t bits = (box % 3 == 0) ? OccupancyCovered : OccupancyObstacle;
+            for (int y = y0; y <= y1; ++y)
+                for (int x = x0; x <= x1; ++x) grid.row(y)[x] = bits | OccupancyFloor;
+        }
+
+        // Walls all round, with a doorway.
+        for (int i = 0; i < size; ++i)
+        {
+            grid.row(wall)[i] = grid.row(size - wall - 1)[i] = OccupancyObstacle;
+            grid.row(i)[wall] = grid.row(i)[size - wall - 1] = OccupancyObstacle;
+        }
+        for (int i = size / 2 - wall; i < size / 2 + wall; ++i) grid.row(wall)[i] = OccupancyFloor;
+    }
+
+#pragma mark - Previous implementation
+
+    /// PathFinding's maps as they were built before NavigationGrid, for comparison.
+    struct ReferenceMaps
+    {
+        typedef std::vector<std::vector<unsigned char>> Matrix;    // [x][y]
+        Matrix dilated, topology, components;
+    };
+
+    struct ReferenceSetNode
+    {
+        ReferenceSetNode* parent;
+        unsigned char label;
+    };
+
+    ReferenceSetNode* referenceFind (ReferenceSetNode* x)
+    {
+        if (x->parent != x)
+        {
+            x->parent = referenceFind(x->parent);
+            x->label = x->parent->label;
+        }
+        return x->parent;
+    }
+
+    ReferenceSetNode* referenceUnion (ReferenceSetNode* x, ReferenceSetNode* y)
+    {
+        ReferenceSetNode* xRoot = referenceFind(x);
+        ReferenceSetNode* yRoot = referenceFind(y);
+        if (xRoot->label < yRoot->label) { yRoot->parent = xRoot; return xRoot; }
+        xRoot->parent = yRoot;
+        return yRoot;
+    }
+
+    void buildReference (const OccupancyGridView& grid, int radius, ReferenceMaps& maps)
+    {
+        const int w = grid.width, h = grid.height;
+        ReferenceMaps::Matrix map(w, std::vector<unsigned char>(h));
+        for (int x = 0; x < w; ++x)
+            for (int y = 0; y < h; ++y) map[x][y] = grid.at(x, y);
+
+        maps.dilated = map;
+        for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            for (int dy = -radius; dy <= radius; dy++)
+            for (int dx = -radius; dx <= radius; dx++)
+            {
+                const int py = y + dy, px = x + dx;
+                if (dy * dy + dx * dx > radius * radius) continue;
+                if (py < 0 || py >= h || px < 0 || px >= w) continue;
+                if (map[px][py] == 255) maps.dilated[x][y] = 255;
+            }
+
+        const ReferenceMaps::Matrix& conv = maps.dilated;
+        maps.topology = conv;
+        const int accumulateSize = radius * 2;
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+            {
+                float accumulator = 0;
+                for (int dy = -accumulateSize; dy <= accumulateSize; dy++)
+                    for (int dx = -accumulateSize; dx <= accumulateSize; dx++)
+                    {
+                        const int py = y + dy, px = x + dx;
+                        if (dx == 0 && dy == 0) continue;
+                        if (py < 0 || py >= h || px < 0 || px >= w)
+                        {
+                            accumulator += 255.0f / (dx * dx + dy * dy);
+                            continue;
+                        }
+                        if (conv[px][py] >= 254) accumulator += ((float)conv[px][py]) / (dx * dx + dy * dy);
+                    }
+                accumulator = accumulator / (accumulateSize / 1.414);
+                accumulator += conv[x][y];
+                if (accumulator > 254) accumulator = 255;
+                maps.topology[x][y] = (unsigned char)accumulator;
+            }
+
+        std::vector<std::vector<ReferenceSetNode*>> disjointSet(h, std::vector<ReferenceSetNode*>(w, nullptr));
+        std::vector<ReferenceSetNode*> owned;
+        std::vector<ReferenceSetNode*> linked(1, nullptr);
+        unsigned char nextLabel = 1;
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+            {
+                if (conv[x][y] == 255) continue;
+
+                struct Point { int x, y; unsigned char label; };
+                std::vector<Point> neighbors;
+                for (int dy = -1; dy <= 0; dy++)
+                    for (int dx = -1; dx <= 1; dx++)
+                    {
+                        if (dy >= 0 && dx >= 0) continue;
+                        const int px = x + dx, py = y + dy;
+                        if (px < 0 || px >= w || py < 0 || py >= h) continue;
+                        if (conv[px][py] <= 254) neighbors.push_back({ px, py, disjointSet[py][px]->label });
+                    }
+
+                if (neighbors.empty())
+                {
+                    ReferenceSetNode* node = new ReferenceSetNode { nullptr, nextLabel };
+                    node->parent = node;
+                    owned.push_back(node);
+                    disjointSet[y][x] = node;
+                    linked.push_back(node);
+                    nextLabel++;
+                }
+                else
+                {
+                    int smallestLabel = INT_MAX;
+                    for (const Point& p : neighbors) if (p.label < smallestLabel) smallestLabel = p.label;
+                    disjointSet[y][x] = linked[smallestLabel];
+                    for (const Point& p : neighbors)
+                        linked[smallestLabel] = referenceUnion(linked[smallestLabel], disjointSet[p.y][p.x]);
+                }
+            }
+
+        maps.components.assign(w, std::vector<unsigned char>(h));
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+                maps.components[x][y] = disjointSet[y][x] ? referenceFind(disjointSet[y][x])->label : 0;
+
+        for (ReferenceSetNode* node : owned) delete node;
+    }
+
+    int countDifferences (const NavigationGrid& grid, const ReferenceMaps& maps)
+    {
+        int differences = 0;
+        for (int y = 0; y < grid.height(); ++y)
+            for (int x = 0; x < grid.width(); ++x)
+            {
+                differences += grid.dilated(x, y) != maps.dilated[x][y];
+                differences += grid.topology(x, y) != maps.topology[x][y];
+                differences += grid.component(x, y) != maps.components[x][y];
+            }
+        return differences;
+    }
+
+#pragma mark - Sight lines
+
+    /// Random lines between points over the grid, from the floor to head height.
+    std::vector<SightLine> makeSightLines (const OcclusionGrid& grid, int count)
+    {
+        const OccupancyGridMetadata& metadata = grid.metadata();
+        std::mt19937 random(5678);
+        std::uniform_real_distribution<float> x(metadata.originX, metadata.originX + grid.width() * metadata.metersPerPixel);
+        std::uniform_real_distribution<float> z(metadata.originY, metadata.originY + grid.height() * metadata.metersPerPixel);
+        std::uniform_real_distribution<float> height(0.1f, 1.8f);
+
+        std::vector<SightLine> lines(count);
+        for (SightLine& line : lines)
+        {
+            line.from.x = x(random);
+            line.from.z = z(random);
+            line.from.height = height(random);
+            line.to.x = x(random);
+            line.to.z = z(random);
+            line.to.height = height(random);
+        }
+        return lines;
+    }
+
+    /// The line tested every tenth of a cell, the slow way, except in its end cells.
+    bool sampledVisible (const OcclusionGrid& grid, const SightLine& line)
+    {
+        const OccupancyGridMetadata& metadata = grid.metadata();
+        auto cell = [&metadata] (float position, float origin) {
+            return (int)std::floor((position - origin) / metadata.metersPerPixel + 0.5f);
+        };
+
+        const int startX = cell(line.from.x, metadata.originX), startY = cell(line.from.z, metadata.originY);
+        const int endX = cell(line.to.x, metadata.originX), endY = cell(line.to.z, metadata.originY);
+        const float length = std::max(std::fabs(line.to.x - line.from.x), std::fabs(line.to.z - line.from.z));
+        const int steps = std::max(1, (int)(length / metadata.metersPerPixel * 10.f));
+
+        for (int i = 0; i <= steps; ++i)
+        {
+            const float t = (float)i / steps;
+            const int x = cell(line.from.x + (line.to.x - line.from.x) * t, metadata.originX);
+            const int y = cell(line.from.z + (line.to.z - line.from.z) * t, metadata.originY);
+            if (!grid.contains(x, y) || (x == startX && y == startY) || (x == endX && y == endY)) continue;
+
+            const float height = line.from.height + (line.to.height - line.from.height) * t;
+            if (height < grid.cellHeight(x, y)) return false;
+        }
+        return true;
+    }
+
+#pragma mark - Report
+
+    void printGrid (const NavigationGrid& grid)
+    {
+        int blocked = 0;
+        int sizes[256] = {};
+        for (int y = 0; y < grid.height(); ++y)
+            for (int x = 0; x < grid.width(); ++x)
+            {
+                blocked += grid.dilated(x, y) == 255;
+                sizes[grid.component(x, y)]++;
+            }
+
+        int components = 0, largest = 0;
+        for (int label = 1; label < 256; ++label)
+        {
+            components += sizes[label] > 0;
+            if (sizes[label] > sizes[largest] || (largest == 0 && sizes[label] > 0)) largest = label;
+        }
+
+        printf("  %d x %d, %.3f m a pixel, origin (%.3f, %.3f)\n", grid.width(), grid.height(),
+               grid.metadata().metersPerPixel, grid.metadata().originX, grid.metadata().originY);
+        printf("  %.1f%% blocked after dilation, %d components, largest %d with %d pixels\n",
+               100.0 * blocked / std::max(1, grid.width() * grid.height()), components, largest, sizes[largest]);
+    }
+
+    int usage ()
+    {
+        fprintf(stderr, "Usage: NavigationBench [--radius pixels] [--iterations n] [--compare] [--visibility lines] <scan directory | --synthetic size>\n");
+        return 1;
+    }
+
+} // anonymous
+
+int main (int argc, char** argv)
+{
+    std::string scanDirectory;
+    int syntheticSize = 0;
+    int radius = 5;             // PathFinding's robotRadiusInPixels.
+    int iterations = 10;
+    bool compare = false;
+    int sightLines = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc) radius = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) syntheticSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--compare") == 0) compare = true;
+        else if (strcmp(argv[i], "--visibility") == 0 && i + 1 < argc) sightLines = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && scanDirectory.empty()) scanDirectory = argv[i];
+        else return usage();
+    }
+    if (scanDirectory.empty() == (syntheticSize <= 0)) return usage();
+
+    OccupancyGridImage grid;
+    auto start = std::chrono::steady_clock::now();
+    if (syntheticSize > 0)
+    {
+        makeRoom(syntheticSize, grid);
+        printf("Synthetic room, %d pixels square\n", syntheticSize);
+    }
+    else
+    {
+        std::string error;
+        if (!loadOccupancyGridScan(scanDirectory, grid, &error))
+        {
+            fprintf(stderr, "Can't load %s: %s\n", scanDirectory.c_str(), error.c_str());
+            return 1;
+        }
+        printf("Loaded %s in %.2f ms\n", scanDirectory.c_str(), secondsSince(start) * 1000.0);
+    }
+
+    start = std::chrono::steady_clock::now();
+    OccupancyGridImage obstacles;
+    convertOccupancyGrid(grid.view(), OccupancyObstacle, obstacles);
+    printf("Obstacles converted in %.2f ms\n", secondsSince(start) * 1000.0);
+
+    NavigationGrid navigation;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) navigation.build(obstacles.view(), radius);
+    const double buildSeconds = secondsSince(start) / iterations;
+    printf("NavigationGrid built in %.2f ms, robot radius %d pixels\n", buildSeconds * 1000.0, radius);
+    printGrid(navigation);
+
+    if (compare)
+    {
+        ReferenceMaps maps;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) buildReference(obstacles.view(), radius, maps);
+        const double referenceSeconds = secondsSince(start) / iterations;
+
+        const int differences = countDifferences(navigation, maps);
+        printf("Previous maps built in %.2f ms, %.1fx, %d pixels differ\n",
+               referenceSeconds * 1000.0, referenceSeconds / buildSeconds, differences);
+        if (differences != 0) return 1;
+    }
+
+    if (sightLines > 0)
+    {
+        // Obstacles half a meter tall, like LineOfSight before the scan mesh raises them.
+        OcclusionGrid occlusion;
+        occlusion.reset(grid.metadata, grid.width(), grid.height(), 0.05f, 2.2f);
+        occlusion.addOccupancy(grid.view(), OccupancyObstacle, 0.5f);
+
+        const std::vector<SightLine> lines = makeSightLines(occlusion, sightLines);
+        std::vector<uint8_t> visible(lines.size());
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) occlusion.resolve(lines.data(), lines.size(), visible.data());
+        const double lineSeconds = secondsSince(start) / iterations / lines.size();
+
+        int clear = 0;
+        for (uint8_t v : visible) clear += v;
+        printf("%d sight lines resolved in %.3f us each, %.1f%% visible\n",
+               sightLines, lineSeconds * 1e6, 100.0 * clear / lines.size());
+
+        if (compare)
+        {
+            // Sampling can step over a cell's corner the walk clips, so a few may differ.
+            int differences = 0;
+            for (size_t i = 0; i < lines.size(); ++i) differences += sampledVisible(occlusion, lines[i]) != (visible[i] != 0);
+            printf("Sampled lines, %d of %d differ\n", differences, sightLines);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+#include "OccupancyGridPNG.hpp"
+
+#include <csetjmp>
+#include <cstdio>
+#include <vector>
+
+#include <png.h>
+
+namespace {
+
+    bool fail (std::string* error, const std::string& reason)
+    {
+        if (error) *error = reason;
+        return false;
+    }
+
+} // anonymous
+
+namespace BE
+{
+
+    bool loadOccupancyGridPNG (const char* path, OccupancyGridImage& image, std::string* error)
+    {
+        FILE* file = fopen(path, "rb");
+        if (file == nullptr) return fail(error, std::string("can't open ") + path);
+
+        png_byte signature[8];
+        if (fread(signature, 1, sizeof(signature), file) != sizeof(signature) || png_sig_cmp(signature, 0, sizeof(signature)) != 0)
+        {
+            fclose(file);
+            return fail(error, std::string(path) + " is not a PNG");
+        }
+
+        png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        png_infop info = png ? png_create_info_struct(png) : nullptr;
+        if (info == nullptr)
+        {
+            png_destroy_read_struct(&png, nullptr, nullptr);
+            fclose(file);
+            return fail(error, "out of memory");
+        }
+
+        // Declared before setjmp, libpng errors jump back over everything after it.
+        std::vector<png_byte> rows;
+        std::vector<png_bytep> rowPointers;
+        if (setjmp(png_jmpbuf(png)))
+        {
+            png_destroy_read_struct(&png, &info, nullptr);
+            fclose(file);
+            return fail(error, std::string(path) + " is corrupt");
+        }
+
+        png_init_io(png, file);
+        png_set_sig_bytes(png, sizeof(signature));
+        png_read_info(png, info);
+
+        // Whatever it holds, read it as 8 bit samples.
+        png_set_expand(png);
+        png_set_strip_16(png);
+        png_read_update_info(png, info);
+
+        const png_uint_32 width = png_get_image_width(png, info);
+        const png_uint_32 height = png_get_image_height(png, info);
+        const int channels = png_get_channels(png, info);
+        const size_t rowBytes = png_get_rowbytes(png, info);
+
+        rows.resize(rowBytes * height);
+        rowPointers.resize(height);
+        for (png_uint_32 y = 0; y < height; ++y) rowPointers[y] = &rows[y * rowBytes];
+        png_read_image(png, rowPointers.data());
+        png_read_end(png, nullptr);
+
+        png_destroy_read_struct(&png, &info, nullptr);
+        fclose(file);
+
+        // First channel only, through a view, like OccupancyGridLoader.
+        OccupancyGridView view;
+        view.pixels = rows.data();
+        view.rowStride = rowBytes;
+        view.pixelStride = channels;
+        view.width = (int)width;
+        view.height = (int)height;
+
+        image.reset(view.width, view.height);
+        for (int y = 0; y < view.height; ++y)
+        {
+            uint8_t* out = image.row(y);
+            for (int x = 0; x < view.width; ++x) out[x] = view.at(x, y);
+        }
+        return true;
+    }
+
+    bool loadOccupancyGridScan (const std::string& directory, OccupancyGridImage& image, std::string* error)
+    {
+        OccupancyGridMetadata metadata;
+        if (!readOccupancyGridMetadata((directory + "/occupancy_grid_metadata.json").c_str(), metadata, error))
+            return false;
+
+        if (!loadOccupancyGridPNG((directory + "/occupancy_grid.png").c_str(), image, error))
+            return false;
+
+        image.metadata = metadata;
+        return true;
+    }
+
+} // BE
@@ -0,0 +1,40 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Loads a scan's occupancy_grid.png and occupancy_grid_metadata.json with
+//  libpng, the way OccupancyGridLoader does on device with ImageIO: 8 bit
+//  pixels, the first channel of color images, and the same metadata parser.
+//
+//  For tests and benchmarks off-device, see README.md.
+//
+
+#pragma once
+
+#include "OccupancyGrid.hpp"
+
+#include <string>
+
+namespace BE
+{
+
+    /**
+     * Decode an 8 bit grid PNG into image. Palettes and low bit depths are expanded,
+     * 16 bit samples keep their high byte, and only the first channel is kept.
+     * @return false with a reason in error if the file can't be read.
+     */
+    bool loadOccupancyGridPNG (const char* path, OccupancyGridImage& image, std::string* error = nullptr);
+
+    /**
+     * Load a scan's grid and its metadata.
+     * @param directory holding occupancy_grid.png and occupancy_grid_metadata.json.
+     */
+    bool loadOccupancyGridScan (const std::string& directory, OccupancyGridImage& image, std::string* error = nullptr);
+
+} // BE
@@ -0,0 +1,212 @@
+/*
+ Bridge Engine Open Source
+ This file is part of the Structure SDK.
+ Copyright © 2018 Occipital, Inc. All rights reserved.
+ http://structure.io
+ */
+
+//
+//  Description:
+//
+//  Off-device benchmark and regression check of the SpatialAudioMixer, see README.md.
+//
+//  Times benchmarkSpatialAudioMixer for a number of moving voices, then renders
+//  a fixed scene with renderSpatialAudioToWav: more voices than the mixer has,
+//  so some are stolen, around a turned listener, at every distance and height.
+//  With --golden the rendering is compared sample for sample to a WAV file
+//  rendered before, and fails if any sample is further off than --tolerance.
+//
+//  Plain C++14, so it runs on the Linux build machines.
+//
+
+#include "SpatialAudioMixer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace BE;
+
+    const float kPi = 3.14159265358979f;
+
+#pragma mark - Golden scene
+
+    /// Uniform in [-1, 1], the same on every platform, unlike std's distributions.
+    float noise (uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / (float)(1u << 23) - 1.f;
+    }
+
+    /**
+     * Three sounds, more voices than the mixer has and a turned listener, so stealing,
+     * attenuation, panning, the head model and the reverb all show in the rendering.
+     */
+    void playGoldenScene (SpatialAudioMixer& mixer, int voiceCount)
+    {
+        const float rate = mixer.settings().sampleRate;
+
+        // A decaying 440Hz tone, a falling chirp and a noise burst. Quiet, so 80 voices don't clip.
+        std::vector<float> tone((size_t)(rate / 2)), chirp((size_t)(rate / 4)), burst((size_t)(rate / 8));
+        for (size_t i = 0; i < tone.size(); i++)
+        {
+            const float t = i / rate;
+            tone[i] = 0.25f * std::sin(2.f * kPi * 440.f * t) * std::exp(-6.f * t);
+        }
+        for (size_t i = 0; i < chirp.size(); i++)
+        {
+            const float t = i / rate;
+            chirp[i] = 0.2f * std::sin(2.f * kPi * (1200.f - 1600.f * t) * t);
+        }
+        uint32_t state = 1234;
+        for (size_t i = 0; i < burst.size(); i++)
+        {
+            burst[i] = 0.15f * noise(state) * (1.f - (float)i / burst.size());
+        }
+
+        const int sounds[3] = {
+            mixer.addSound(tone.data(), tone.size(), rate),
+            mixer.addSound(chirp.data(), chirp.size(), rate / 2),   // Resampled.
+            mixer.addSound(burst.data(), burst.size(), rate),
+        };
+
+        mixer.setListener({ 0.5f, 0.f, 0.f }, { 0.6f, 0.f, -0.8f }, { 0.f, 1.f, 0.f });
+
+        for (int v = 0; v < voiceCount; v++)
+        {
+            const float angle = 2.f * kPi * v / voiceCount;
+            const float distance = 0.5f + (v % 7) * 1.5f;
+            const float height = (v % 3 - 1) * 0.8f;
+            const SpatialAudioVector position = { distance * std::cos(angle), height, distance * std::sin(angle) };
+            mixer.play(sounds[v % 3], 0.2f - (v % 4) * 0.04f, position, (v % 5) * 0.25f, v % 2 == 0);
+        }
+    }
+
+#pragma mark - WAV files
+
+    uint32_t readLE32 (const uint8_t* bytes) { return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24; }
+    uint16_t readLE16 (const uint8_t* bytes) { return (uint16_t)(bytes[0] | bytes[1] << 8); }
+
+    /// Interleaved samples of a 16-bit stereo PCM WAV file, like SpatialAudioWavWriter writes.
+    bool readWav (const std::string& path, std::vector<int16_t>& samples, int& sampleRate)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) return false;
+
+        std::vector<uint8_t> bytes;
+        uint8_t chunk[4096];
+        size_t count;
+        while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) bytes.insert(bytes.end(), chunk, chunk + count);
+        fclose(file);
+
+        if (bytes.size() < 12 || memcmp(&bytes[0], "RIFF", 4) != 0 || memcmp(&bytes[8], "WAVE", 4) != 0) return false;
+
+        bool format = false;
+        for (size_t offset = 12; offset + 8 <= bytes.size();)
+        {
+            const uint32_t size = readLE32(&bytes[offset + 4]);
+            const uint8_t* body = &bytes[offset + 8];
+            if (offset + 8 + size > bytes.size()) return false;
+
+            if (memcmp(&bytes[offset], "fmt ", 4) == 0 && size >= 16)
+            {
+                if (readLE16(body) != 1 || readLE16(body + 2) != 2 || readLE16(body + 14) != 16) return false;
+                sampleRate = (int)readLE32(body + 4);
+                format = true;
+            }
+            else if (memcmp(&bytes[offset], "data", 4) == 0 && format)
+            {
+                samples.resize(size / 2);
+                for (size_t i = 0; i < samples.size(); i++) samples[i] = (int16_t)readLE16(body + i * 2);
+                return true;
+            }
+            offset += 8 + size + (size & 1);
+        }
+        return false;
+    }
+
+    /// Count the samples of rendered further than tolerance from golden, and the largest difference.
+    int countDifferences (const std::vector<int16_t>& rendered, const std::vector<int16_t>& golden, int tolerance, int& largest)
+    {
+        largest = 0;
+        int differences = 0;
+        for (size_t i = 0; i < rendered.size(); i++)
+        {
+            const int difference = std::abs((int)rendered[i] - (int)golden[i]);
+            largest = std::max(largest, difference);
+            if (difference > tolerance) differences++;
+        }
+        return differences;
+    }
+
+    int usage ()
+    {
+        fprintf(stderr, "Usage: SpatialAudioBench [--voices n] [--seconds s] [--output rendering.wav] [--golden golden.wav] [--tolerance lsb]\n");
+        return 1;
+    }
+
+} // anonymous
+
+int main (int argc, char** argv)
+{
+    int voices = 64;
+    double seconds = 10;
+    std::string outputPath = "SpatialAudioRender.wav";
+    std::string goldenPath;
+    int tolerance = 2;          // 16-bit steps, for SIMD and libm rounding across platforms.
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--voices") == 0 && i + 1 < argc) voices = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = std::max(0.1, atof(argv[++i]));
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) outputPath = argv[++i];
+        else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) goldenPath = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = std::max(0, atoi(argv[++i]));
+        else return usage();
+    }
+
+    const SpatialAudioBenchmarkResult result = benchmarkSpatialAudioMixer(voices, seconds);
+    printf("%d voices, %.1f s of audio in %.2f s: %.3f ms per block, %.1fx real time\n",
+           result.voiceCount, result.audioSeconds, result.renderSeconds, result.msPerBlock, result.realtimeFactor);
+
+    // The golden scene is fixed, whatever --voices is, so renderings stay comparable.
+    SpatialAudioMixer mixer;
+    playGoldenScene(mixer, mixer.settings().maxVoices + 16);
+    if (!renderSpatialAudioToWav(mixer, outputPath.c_str(), 1.0, 500))
+    {
+        fprintf(stderr, "Can't write %s\n", outputPath.c_str());
+        return 1;
+    }
+
+    const SpatialAudioStats stats = mixer.stats();
+    printf("Rendered %s, %llu voices started, %llu stolen\n",
+           outputPath.c_str(), (unsigned long long)stats.started, (unsigned long long)stats.stolen);
+
+    if (goldenPath.empty()) return 0;
+
+    std::vector<int16_t> rendered, golden;
+    int renderedRate = 0, goldenRate = 0;
+    if (!readWav(outputPath, rendered, renderedRate) || !readWav(goldenPath, golden, goldenRate))
+    {
+        fprintf(stderr, "Can't read %s or %s as 16-bit stereo WAV\n", outputPath.c_str(), goldenPath.c_str());
+        return 1;
+    }
+    if (renderedRate != goldenRate || rendered.size() != golden.size())
+    {
+        fprintf(stderr, "%s is %zu samples at %d Hz, %s is %zu at %d Hz\n", outputPath.c_str(), rendered.size(), renderedRate,
+                goldenPath.c_str(), golden.size(), goldenRate);
+        return 1;
+    }
+
+    int largest = 0;
+    const int differences = countDifferences(rendered, golden, tolerance, largest);
+    printf("Compared to %s: %d of %zu samples differ by more than %d, by up to %d\n",
+           goldenPath.c_str(), differences, rendered.size(), tolerance, largest);
+    return differences == 0 ? 0 : 1;
+}
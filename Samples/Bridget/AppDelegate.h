@@ -37,6 +37,12 @@
 /// Tells us to show the bridge controller component
 #define SETTING_SHOW_CONTROLLER                 @"showControllerComponent"
 
+/// Record the frame timing and controller input for a later benchmark replay.
+#define SETTING_RECORD_BENCHMARK                @"recordBenchmark"
+
+/// Deterministically replay the last OCC recording and recorded input, then write a per-component CPU report.
+#define SETTING_REPLAY_BENCHMARK                @"replayBenchmark"
+
 //----
 
 /// Check to make sure we are executing on device
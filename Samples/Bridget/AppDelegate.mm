@@ -125,6 +125,9 @@ void preventApplicationFromStartingInTheBackgroundWhenTheStructureSensorIsPlugge
     
     [vc addKey:SETTING_REPLAY_CAPTURE label:@"Replay last OCC Recording" defaultBool:NO];
     [vc addKey:SETTING_SHOW_CONTROLLER label:@"Show Bridge Controller" defaultBool:NO];
+    
+    [vc addKey:SETTING_RECORD_BENCHMARK label:@"Record Benchmark Input" defaultBool:NO];
+    [vc addKey:SETTING_REPLAY_BENCHMARK label:@"Replay Benchmark" defaultBool:NO];
 }
 
 /**
@@ -140,6 +143,8 @@ void preventApplicationFromStartingInTheBackgroundWhenTheStructureSensorIsPlugge
     [BEAppSettings setBooleanValue:NO forAppSetting:SETTING_REPLAY_CAPTURE];
     [BEAppSettings setBooleanValue:NO forAppSetting:SETTING_SHOW_RENDER_TYPES];
     [BEAppSettings setBooleanValue:NO forAppSetting:SETTING_SHOW_CONTROLLER];
+    [BEAppSettings setBooleanValue:NO forAppSetting:SETTING_RECORD_BENCHMARK];
+    [BEAppSettings setBooleanValue:NO forAppSetting:SETTING_REPLAY_BENCHMARK];
 }
 
 /**
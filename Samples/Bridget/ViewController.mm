@@ -12,6 +12,9 @@
 // Bridge Open Source
 #import <OpenBE/Core/SceneManager.h>
 #import <OpenBE/Core/AudioEngine.h>
+#import <OpenBE/Core/AudioAssetManager.h>
+#import <OpenBE/Core/AssetStreamer.h>
+#import <OpenBE/Core/FrameReplay.h>
 
 #import <OpenBE/Components/AnimationComponent.h>
 #import <OpenBE/Components/BeamComponent.h>
@@ -105,6 +108,13 @@
     {
         replayMode = BECaptureReplayModeRealTime;
     }
+
+    // Benchmarks must see the same sensor frames every run, so never skip any.
+    if ([BEAppSettings booleanValueFromAppSetting:SETTING_REPLAY_BENCHMARK
+             defaultValueIfSettingIsNotInBundle:NO])
+    {
+        replayMode = BECaptureReplayModeDeterministic;
+    }
     
     BOOL isiPhone = (UI_USER_INTERFACE_IDIOM() == UIUserInterfaceIdiomPhone);
 
@@ -126,6 +136,8 @@
             kBEUsingColorCameraOnly:
                 @([BEAppSettings booleanValueFromAppSetting:SETTING_COLOR_CAMERA_ONLY
                        defaultValueIfSettingIsNotInBundle:NO]),
+            // Track at the display rate FrameReplay records at, so a deterministic capture replays frame for frame.
+            kBEExpectedFpsForTrackingEstimation:@(60),
         }
         markupNames:_markupNameList
     ];
@@ -196,12 +208,23 @@
     // main Audio engine and Scene Manager
     [[SceneManager main] initWithMixedRealityMode:_mixedReality stereo:stereo];
     [AudioEngine main];
+
+    // Decode Bridget's sounds in the background, so components don't hitch loading them.
+    // Robot_ScanBeam is left out, it's long enough to be streamed.
+    [[AudioAssetManager main] prefetchSoundBank:@[
+        @"BallToss.caf", @"BallPickup.caf", @"BallReturn.caf", @"BallBounce.caf",
+        @"Robot_ThinkingLoop.caf", @"Robot_UmWhat.caf", @"Robot_IdleMovingLoop.caf", @"Robot_Unboxing.caf",
+        @"Robot_WarpIn.caf", @"Robot_WarpOut.caf", @"ExitVR_PowerUp.caf", @"ExitVR_PowerAbort.caf",
+        @"VRWorld_LightsOn.caf", @"VRWorld_BayDoorsOpening.caf", @"BeamLoop.caf",
+        @"Robot_MenuClick.caf", @"Robot_MenuOpen.caf", @"Robot_MenuClose.caf"
+    ] completion:nil];
     
     // Set up our PBR Lighting Environment
     SCNScene *scene = [Scene main].scene;
-    UIImage *lighting = [UIImage imageNamed:[SceneKit pathForImageResourceNamed:@"environment.jpg"]];
-    scene.lightingEnvironment.contents = lighting;
     scene.lightingEnvironment.intensity = 3.0;
+    [[[AssetStreamer main] requestImageNamed:@"environment.jpg" priority:AssetPriorityVisibleSoon] whenDoneOnMain:^(UIImage *lighting, NSError *error) {
+        scene.lightingEnvironment.contents = lighting;
+    }];
     
     // Selection UI
     GazeComponent *gazeComponent = [[GazeComponent alloc] init];
@@ -505,6 +528,30 @@
     _experienceIsRunning = YES;
     
     [self updateReticleInputMode];
+    
+    [self startFrameReplay];
+}
+
+/**
+ * Record, or replay, the input stream from the start of the experience.
+ * Files live next to the OCC capture, in Documents/BridgeEngineScene.
+ */
+- (void)startFrameReplay
+{
+    if ([FrameReplay main].mode != FrameReplayModeOff) {
+        return;
+    }
+
+    NSString *documentsDirectory = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES) objectAtIndex:0];
+    NSString *scenePath = [documentsDirectory stringByAppendingPathComponent:@"BridgeEngineScene"];
+    NSString *recordingPath = [scenePath stringByAppendingPathComponent:@"benchmarkInput.obfr"];
+
+    if ([BEAppSettings booleanValueFromAppSetting:SETTING_REPLAY_BENCHMARK defaultValueIfSettingIsNotInBundle:NO]) {
+        [[FrameReplay main] startReplayFromPath:recordingPath
+                                     reportPath:[scenePath stringByAppendingPathComponent:@"benchmarkReport.csv"]];
+    } else if ([BEAppSettings booleanValueFromAppSetting:SETTING_RECORD_BENCHMARK defaultValueIfSettingIsNotInBundle:NO]) {
+        [[FrameReplay main] startRecordingToPath:recordingPath];
+    }
 }
 
 - (void)mixedRealityMarkupEditingEnded